@@ -27,6 +27,7 @@
 #include "qgsattributeeditorrelation.h"
 #include "qgsattributeeditorcontainer.h"
 #include "qgsvectorlayerutils.h"
+#include "qgsfeaturerequest.h"
 #include "qgsrelation.h"
 #include "qgsmessagelog.h"
 #include "inpututils.h"
@@ -361,6 +362,95 @@ void AttributeController::clearAll()
   mFormItems.clear();
   mTabItems.clear();
   mHasTabs = false;
+  mDefaultValueExpressions.clear();
+  mVisibilityExpressions.clear();
+  mTabVisibilityExpressions.clear();
+  mConstraintDependencies.clear();
+}
+
+bool AttributeController::CompiledExpression::dependsOn( const QSet<QString> &fields ) const
+{
+  return dependsOnAnyField || referencedColumns.intersects( fields );
+}
+
+QVariant AttributeController::CompiledExpression::evaluate( QgsExpressionContext &context )
+{
+  if ( !prepared )
+  {
+    expression->prepare( &context );
+    prepared = true;
+  }
+  return expression->evaluate( &context );
+}
+
+AttributeController::CompiledExpression AttributeController::compileExpression( const QgsExpression &expression )
+{
+  CompiledExpression compiled;
+  compiled.expression.reset( new QgsExpression( expression ) );
+  compiled.referencedColumns = compiled.expression->referencedColumns();
+  compiled.dependsOnAnyField = compiled.referencedColumns.isEmpty() ||
+                               compiled.referencedColumns.contains( QgsFeatureRequest::ALL_ATTRIBUTES );
+  return compiled;
+}
+
+void AttributeController::compileExpressions()
+{
+  QgsVectorLayer *layer = mFeatureLayerPair.layer();
+  if ( !layer )
+    return;
+
+  const QgsFields fields = layer->fields();
+
+  QMap<QUuid, std::shared_ptr<FormItem>>::const_iterator formItemsIterator = mFormItems.constBegin();
+  while ( formItemsIterator != mFormItems.constEnd() )
+  {
+    std::shared_ptr<FormItem> item = formItemsIterator.value();
+
+    const QgsExpression visibilityExpression = item->visibilityExpression();
+    if ( visibilityExpression.isValid() )
+      mVisibilityExpressions.insert( item->id(), compileExpression( visibilityExpression ) );
+
+    if ( item->type() == FormItem::Field )
+    {
+      const QgsField field = item->field();
+      const QString defaultValueExpression = field.defaultValueDefinition().expression();
+      if ( !defaultValueExpression.isEmpty() )
+      {
+        CompiledExpression compiled = compileExpression( QgsExpression( defaultValueExpression ) );
+        if ( compiled.expression->hasParserError() )
+          QgsMessageLog::logMessage( tr( "Default value expression for %1:%2 has parser error: %3" ).arg(
+                                       layer->name(),
+                                       field.name(),
+                                       compiled.expression->parserErrorString() ),
+                                     QStringLiteral( "Input" ),
+                                     Qgis::Warning );
+        mDefaultValueExpressions.insert( item->id(), compiled );
+      }
+
+      // unique and not null constraints only depend on the field itself, expression constraint on the referenced fields
+      QSet<QString> constraintDependencies;
+      constraintDependencies << field.name();
+      const QString constraintExpression = field.constraints().constraintExpression();
+      if ( !constraintExpression.isEmpty() )
+      {
+        CompiledExpression compiled = compileExpression( QgsExpression( constraintExpression ) );
+        if ( compiled.dependsOnAnyField )
+          constraintDependencies.clear();
+        else
+          constraintDependencies += compiled.referencedColumns;
+      }
+      mConstraintDependencies.insert( item->id(), constraintDependencies );
+    }
+    ++formItemsIterator;
+  }
+
+  mTabVisibilityExpressions.resize( mTabItems.size() );
+  for ( const std::shared_ptr<TabItem> &tabItem : qAsConst( mTabItems ) )
+  {
+    const QgsExpression visibilityExpression = tabItem->visibilityExpression();
+    if ( visibilityExpression.isValid() )
+      mTabVisibilityExpressions[tabItem->tabIndex()] = compileExpression( visibilityExpression );
+  }
 }
 
 void AttributeController::updateOnLayerChange()
@@ -417,6 +507,8 @@ void AttributeController::updateOnLayerChange()
 
     if ( mRememberAttributesController )
       mRememberAttributesController->storeLayerFields( layer );
+
+    compileExpressions();
   }
 
   // 2) MODELS
@@ -498,40 +590,33 @@ bool AttributeController::recalculateDefaultValues(
   QSet<QUuid> &changedFormItems,
   QgsExpressionContext &expressionContext,
   bool isFormValueChange,
-  bool isFirstUpdateOfNewFeature
+  bool isFirstUpdateOfNewFeature,
+  const QSet<QString> *changedFields,
+  QSet<QString> &updatedFields
 )
 {
   bool hasChanges = false;
-  QMap<QUuid, std::shared_ptr<FormItem>>::iterator formItemsIterator = mFormItems.begin();
-  while ( formItemsIterator != mFormItems.end() )
+  QMap<QUuid, CompiledExpression>::iterator expressionsIterator = mDefaultValueExpressions.begin();
+  while ( expressionsIterator != mDefaultValueExpressions.end() )
   {
-    std::shared_ptr<FormItem> item = formItemsIterator.value();
+    std::shared_ptr<FormItem> item = mFormItems.value( expressionsIterator.key() );
+    CompiledExpression &exp = expressionsIterator.value();
     const QgsField field = item->field();
     const QgsDefaultValue defaultDefinition = field.defaultValueDefinition();
 
     bool shouldApplyDefaultValue =
-      !defaultDefinition.expression().isEmpty() &&
-      ( isFirstUpdateOfNewFeature || ( isFormValueChange && defaultDefinition.applyOnUpdate() ) );
+      ( isFirstUpdateOfNewFeature || ( isFormValueChange && defaultDefinition.applyOnUpdate() ) ) &&
+      ( !changedFields || exp.dependsOn( *changedFields ) );
 
     if ( shouldApplyDefaultValue )
     {
-      QgsExpression exp( field.defaultValueDefinition().expression() );
-      exp.prepare( &expressionContext );
-      if ( exp.hasParserError() )
-        QgsMessageLog::logMessage( tr( "Default value expression for %1:%2 has parser error: %3" ).arg(
-                                     mFeatureLayerPair.layer()->name(),
-                                     field.name(),
-                                     exp.parserErrorString() ),
-                                   QStringLiteral( "Input" ),
-                                   Qgis::Warning );
-
-      QVariant value = exp.evaluate( &expressionContext );
+      QVariant value = exp.evaluate( expressionContext );
 
-      if ( exp.hasEvalError() )
+      if ( exp.expression->hasEvalError() )
         QgsMessageLog::logMessage( tr( "Default value expression for %1:%2 has evaluation error: %3" ).arg(
                                      mFeatureLayerPair.layer()->name(),
                                      field.name(),
-                                     exp.evalErrorString() ),
+                                     exp.expression->evalErrorString() ),
                                    QStringLiteral( "Input" ),
                                    Qgis::Warning );
       else
@@ -551,17 +636,18 @@ bool AttributeController::recalculateDefaultValues(
             // Update also expression context after an attribute change
             expressionContext.setFeature( featureLayerPair().featureRef() );
             changedFormItems.insert( item->id() );
+            updatedFields.insert( field.name() );
             hasChanges = true;
           }
         }
       }
     }
-    ++formItemsIterator;
+    ++expressionsIterator;
   }
   return hasChanges;
 }
 
-void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool isFirstUpdateOfNewFeature )
+void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool isFirstUpdateOfNewFeature, const QString &changedField )
 {
   QSet<QUuid> changedFormItems;
 
@@ -581,15 +667,27 @@ void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool
   expressionContext.setFields( fields );
   expressionContext.setFeature( featureLayerPair().featureRef() );
 
+  // After a change of a single field, only items depending on the changed fields are evaluated
+  const bool incremental = isFormValueChange && !isFirstUpdateOfNewFeature && !changedField.isEmpty();
+  QSet<QString> changedFields;
+  if ( incremental )
+    changedFields << changedField;
+
   // Evaluate default values
   // it could be recursive, so
   // let say try few times
   const int LIMIT = 3;
   int tryNumber = 0;
   bool anyValueChanged = true;
+  QSet<QString> fieldsToPropagate = changedFields;
   while ( anyValueChanged && tryNumber < LIMIT )
   {
-    anyValueChanged = recalculateDefaultValues( changedFormItems, expressionContext, isFormValueChange, isFirstUpdateOfNewFeature );
+    // in the incremental mode each round only follows fields updated by the previous one
+    QSet<QString> updatedFields;
+    anyValueChanged = recalculateDefaultValues( changedFormItems, expressionContext, isFormValueChange, isFirstUpdateOfNewFeature,
+                      incremental ? &fieldsToPropagate : nullptr, updatedFields );
+    changedFields += updatedFields;
+    fieldsToPropagate = updatedFields;
     ++tryNumber;
   }
   if ( anyValueChanged )
@@ -604,12 +702,17 @@ void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool
     while ( tabItemsIterator != mTabItems.end() )
     {
       std::shared_ptr<TabItem> item = *tabItemsIterator;
-      QgsExpression exp = item->visibilityExpression();
-      exp.prepare( &expressionContext );
+      CompiledExpression &exp = mTabVisibilityExpressions[item->tabIndex()];
+      if ( incremental && ( !exp.expression || !exp.dependsOn( changedFields ) ) )
+      {
+        ++tabItemsIterator;
+        continue;
+      }
+
       bool visible = true;
-      if ( exp.isValid() )
+      if ( exp.expression )
       {
-        visible = exp.evaluate( &expressionContext ).toBool();
+        visible = exp.evaluate( expressionContext ).toBool();
       }
 
       if ( item->isVisible() != visible )
@@ -627,18 +730,21 @@ void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool
     while ( formItemsIterator != mFormItems.end() )
     {
       std::shared_ptr<FormItem> item = formItemsIterator.value();
+      QMap<QUuid, CompiledExpression>::iterator exp = mVisibilityExpressions.find( item->id() );
+      if ( incremental && ( exp == mVisibilityExpressions.end() || !exp->dependsOn( changedFields ) ) )
+      {
+        ++formItemsIterator;
+        continue;
+      }
+
       bool visible = true;
       if ( item->editorWidgetType() == QLatin1String( "Hidden" ) )
       {
         visible = false;
       }
-      else
+      else if ( exp != mVisibilityExpressions.end() )
       {
-        QgsExpression exp = item->visibilityExpression();
-        exp.prepare( &expressionContext );
-
-        if ( exp.isValid() )
-          visible = exp.evaluate( &expressionContext ).toInt();
+        visible = exp->evaluate( expressionContext ).toInt();
       }
 
       if ( item->visible() != visible )
@@ -660,12 +766,17 @@ void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool
         std::shared_ptr<FormItem> item = formItemsIterator.value();
         if ( item->type() == FormItem::Field )
         {
-          QStringList errors;
-          bool hardConstraintSatisfied = QgsVectorLayerUtils::validateAttribute( layer,  featureLayerPair().feature(), item->fieldIndex(), errors, QgsFieldConstraints::ConstraintStrengthHard );
-          if ( hardConstraintSatisfied != item->constraintHardValid() )
+          bool hardConstraintSatisfied = item->constraintHardValid();
+          const QSet<QString> dependencies = mConstraintDependencies.value( item->id() );
+          if ( !incremental || dependencies.isEmpty() || dependencies.intersects( changedFields ) )
           {
-            item->setConstraintHardValid( hardConstraintSatisfied );
-            changedFormItems << item->id();
+            QStringList errors;
+            hardConstraintSatisfied = QgsVectorLayerUtils::validateAttribute( layer,  featureLayerPair().feature(), item->fieldIndex(), errors, QgsFieldConstraints::ConstraintStrengthHard );
+            if ( hardConstraintSatisfied != item->constraintHardValid() )
+            {
+              item->setConstraintHardValid( hardConstraintSatisfied );
+              changedFormItems << item->id();
+            }
           }
           if ( !hardConstraintSatisfied )
           {
@@ -692,12 +803,17 @@ void AttributeController::recalculateDerivedItems( bool isFormValueChange, bool
         std::shared_ptr<FormItem> item = formItemsIterator.value();
         if ( item->type() == FormItem::Field )
         {
-          QStringList errors;
-          bool softConstraintSatisfied = QgsVectorLayerUtils::validateAttribute( layer,  featureLayerPair().feature(), item->fieldIndex(), errors, QgsFieldConstraints::ConstraintStrengthSoft );
-          if ( softConstraintSatisfied != item->constraintSoftValid() )
+          bool softConstraintSatisfied = item->constraintSoftValid();
+          const QSet<QString> dependencies = mConstraintDependencies.value( item->id() );
+          if ( !incremental || dependencies.isEmpty() || dependencies.intersects( changedFields ) )
           {
-            item->setConstraintSoftValid( softConstraintSatisfied );
-            changedFormItems << item->id();
+            QStringList errors;
+            softConstraintSatisfied = QgsVectorLayerUtils::validateAttribute( layer,  featureLayerPair().feature(), item->fieldIndex(), errors, QgsFieldConstraints::ConstraintStrengthSoft );
+            if ( softConstraintSatisfied != item->constraintSoftValid() )
+            {
+              item->setConstraintSoftValid( softConstraintSatisfied );
+              changedFormItems << item->id();
+            }
           }
           if ( !softConstraintSatisfied )
           {
@@ -1138,7 +1254,7 @@ bool AttributeController::setFormValue( const QUuid &id, QVariant value )
 
       emit formDataChanged( id );
       updateFieldValuesValidity();
-      recalculateDerivedItems( true, false );
+      recalculateDerivedItems( true, false, fld.name() );
     }
     else
     {
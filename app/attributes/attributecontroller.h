@@ -21,6 +21,8 @@
 #include <QVariant>
 #include <memory>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QVector>
 #include <QUuid>
 
@@ -197,9 +199,37 @@ class  AttributeController : public QObject
      * Note that reevaluate default values is needed only when an attribnute has changed.
      * Evaluation of default values for a new feature is done in digitizing controller when a feature is created.
      * @param isFormValueChange True if recalculation has to be done after an attribute has changed (called by setFormValue function).
+     * @param changedField Name of the field that has changed. If set, only default values, visibility and constraints
+     * depending on this field (directly or through other default values) are evaluated.
      */
-    void recalculateDerivedItems( bool isFormValueChange = false, bool isFirstUpdateOfNewFeature = false );
-    bool recalculateDefaultValues( QSet<QUuid> &changedFormItems, QgsExpressionContext &context, bool isFormValueChange = false, bool isFirstUpdateOfNewFeature = false );
+    void recalculateDerivedItems( bool isFormValueChange = false, bool isFirstUpdateOfNewFeature = false, const QString &changedField = QString() );
+
+    /**
+     * Evaluates default values. If changedFields is not null, only default values depending on these fields are evaluated.
+     * Names of fields with a new value are added to updatedFields.
+     */
+    bool recalculateDefaultValues( QSet<QUuid> &changedFormItems, QgsExpressionContext &context, bool isFormValueChange, bool isFirstUpdateOfNewFeature,
+                                   const QSet<QString> *changedFields, QSet<QString> &updatedFields );
+
+    /**
+     * Expression of the form compiled once per layer (parsed when the form is built, prepared on the first evaluation)
+     * together with names of the fields it depends on.
+     */
+    struct CompiledExpression
+    {
+      std::shared_ptr<QgsExpression> expression;
+      QSet<QString> referencedColumns;
+      bool dependsOnAnyField = false;  //!< uses all attributes or no attributes at all (e.g. now() or position variables)
+      bool prepared = false;
+
+      //! Returns TRUE if the expression needs to be evaluated again after the fields have changed
+      bool dependsOn( const QSet<QString> &fields ) const;
+      QVariant evaluate( QgsExpressionContext &context );
+    };
+
+    //! Builds the compiled expressions and the field dependency graph of the form
+    void compileExpressions();
+    static CompiledExpression compileExpression( const QgsExpression &expression );
 
     // generate tab
     void createTab( QgsAttributeEditorContainer *container );
@@ -242,5 +272,10 @@ class  AttributeController : public QObject
 
     AttributeController *mParentController = nullptr; // not owned
     QgsRelation mLinkedRelation;
+
+    QMap<QUuid, CompiledExpression> mDefaultValueExpressions; // only form items with default value expression
+    QMap<QUuid, CompiledExpression> mVisibilityExpressions; // only form items with valid visibility expression
+    QVector<CompiledExpression> mTabVisibilityExpressions; // by tab row, null expression if the tab has none
+    QHash<QUuid, QSet<QString>> mConstraintDependencies; // field form item -> fields its constraints depend on (including itself), empty set if on any field
 };
 #endif // ATTRIBUTECONTROLLER_H
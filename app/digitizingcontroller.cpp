@@ -21,6 +21,7 @@ DigitizingController::DigitizingController( QObject *parent )
   : QObject( parent )
   , mMapSettings( nullptr )
 {
+  connect( this, &DigitizingController::mapSettingsChanged, this, &DigitizingController::onMapSettingsChanged );
 }
 
 void DigitizingController::setPositionKit( PositionKit *kit )
@@ -29,6 +30,7 @@ void DigitizingController::setPositionKit( PositionKit *kit )
     disconnect( mPositionKit, &PositionKit::positionChanged, this, &DigitizingController::onPositionChanged );
 
   mPositionKit = kit;
+  resetTransforms();
 
   if ( mPositionKit )
     connect( mPositionKit, &PositionKit::positionChanged, this, &DigitizingController::onPositionChanged );
@@ -46,6 +48,9 @@ void DigitizingController::setFeatureLayerPair( FeatureLayerPair pair )
   if ( pair == mFeatureLayerPair )
     return;
 
+  if ( pair.layer() != mFeatureLayerPair.layer() )
+    resetTransforms();
+
   mFeatureLayerPair = pair;
   emit layerChanged();
 }
@@ -62,6 +67,7 @@ void DigitizingController::setLayer( QgsVectorLayer *layer )
 
   FeatureLayerPair pair( mFeatureLayerPair.featureRef(), layer );
   mFeatureLayerPair = pair;
+  resetTransforms();
   emit layerChanged();
 }
 
@@ -125,17 +131,105 @@ bool DigitizingController::hasEnoughPoints() const
 {
   if ( hasLineGeometry( featureLayerPair().layer() ) )
   {
-    return mRecordedPoints.length() >= 2;
+    return recordedPointsCount() >= 2;
   }
   else if ( hasPolygonGeometry( featureLayerPair().layer() ) )
   {
-    return mRecordedPoints.length() >= 3;
+    return recordedPointsCount() >= 3;
   }
 
-  // Point capturing doesn't use mRecordedPoints
+  // Point capturing doesn't use recorded points
   return true;
 }
 
+void DigitizingController::onMapSettingsChanged()
+{
+  if ( mMapSettings )
+    connect( mMapSettings, &QgsQuickMapSettings::destinationCrsChanged, this, &DigitizingController::resetTransforms, Qt::UniqueConnection );
+
+  resetTransforms();
+}
+
+void DigitizingController::resetTransforms()
+{
+  mPositionToLayerTransform = QgsCoordinateTransform();
+  mLayerToMapTransform = QgsCoordinateTransform();
+}
+
+const QgsCoordinateTransform &DigitizingController::positionToLayerTransform()
+{
+  if ( !mPositionToLayerTransform.isValid() )
+  {
+    mPositionToLayerTransform = QgsCoordinateTransform( mPositionKit->positionCRS(),
+                                featureLayerPair().layer()->crs(),
+                                mMapSettings->mapSettings().transformContext() );
+  }
+  return mPositionToLayerTransform;
+}
+
+const QgsCoordinateTransform &DigitizingController::layerToMapTransform()
+{
+  if ( !mLayerToMapTransform.isValid() )
+  {
+    mLayerToMapTransform = QgsCoordinateTransform( featureLayerPair().layer()->crs(),
+                           mMapSettings->destinationCrs(),
+                           mMapSettings->transformContext() );
+  }
+  return mLayerToMapTransform;
+}
+
+QgsPoint DigitizingController::layerToMapPoint( const QgsPoint &point )
+{
+  QgsPoint mapPoint( point );
+  try
+  {
+    mapPoint.transform( layerToMapTransform() );
+  }
+  catch ( QgsCsException &e )
+  {
+    Q_UNUSED( e )
+    // Caught an error in transform
+  }
+  return mapPoint;
+}
+
+void DigitizingController::appendRecordedPoint( const QgsPoint &point )
+{
+  mRecordedX.append( point.x() );
+  mRecordedY.append( point.y() );
+  if ( QgsWkbTypes::hasZ( point.wkbType() ) )
+    mRecordedZ.append( point.z() );
+}
+
+void DigitizingController::moveLastRecordedPoint( const QgsPoint &point )
+{
+  if ( mRecordedX.isEmpty() )
+    return;
+
+  mRecordedX.last() = point.x();
+  mRecordedY.last() = point.y();
+  if ( !mRecordedZ.isEmpty() && QgsWkbTypes::hasZ( point.wkbType() ) )
+    mRecordedZ.last() = point.z();
+}
+
+void DigitizingController::removeLastRecordedPoint()
+{
+  if ( mRecordedX.isEmpty() )
+    return;
+
+  if ( mRecordedZ.count() == mRecordedX.count() )
+    mRecordedZ.removeLast();
+  mRecordedX.removeLast();
+  mRecordedY.removeLast();
+}
+
+void DigitizingController::clearRecordedPoints()
+{
+  mRecordedX.clear();
+  mRecordedY.clear();
+  mRecordedZ.clear();
+}
+
 VariablesManager *DigitizingController::variablesManager() const
 {
   return mVariablesManager;
@@ -169,6 +263,11 @@ bool DigitizingController::manualRecording() const
 void DigitizingController::setManualRecording( bool manualRecording )
 {
   mManualRecording = manualRecording;
+
+  // featureLayerPair is not updated with every streamed point, bring it up to date for the other mode
+  if ( mRecording && recordedPointsCount() > 0 )
+    setFeatureLayerPair( lineOrPolygonFeature() );
+
   emit manualRecordingChanged();
 }
 
@@ -189,13 +288,8 @@ std::unique_ptr<QgsPoint> DigitizingController::getLayerPoint( const QgsPoint &p
   std::unique_ptr<QgsPoint> layerPoint = nullptr;
   if ( isGpsPoint )
   {
-
-    QgsPoint *tempPoint = point.clone();
-    QgsGeometry geom( tempPoint );
-    QgsCoordinateTransform ct( mPositionKit->positionCRS(), featureLayerPair().layer()->crs(), mMapSettings->mapSettings().transformContext() );
-    geom.transform( ct );
-    layerPoint = std::unique_ptr<QgsPoint>( qgsgeometry_cast<QgsPoint *>( geom.get() )->clone() );
-
+    layerPoint = std::unique_ptr<QgsPoint>( point.clone() );
+    layerPoint->transform( positionToLayerTransform() );
   }
   else
   {
@@ -243,7 +337,7 @@ void DigitizingController::startRecording()
 {
   if ( mRecording ) return;
 
-  mRecordedPoints.clear();
+  clearRecordedPoints();
   mRecording = true;
   emit recordingChanged();
 }
@@ -251,7 +345,7 @@ void DigitizingController::startRecording()
 void DigitizingController::stopRecording()
 {
   mRecording = false;
-  mRecordedPoints.clear();
+  clearRecordedPoints();
   emit recordingChanged();
 }
 
@@ -269,18 +363,28 @@ void DigitizingController::onPositionChanged()
   QgsPoint point = mPositionKit->position();
   std::unique_ptr<QgsPoint> layerPoint = getLayerPoint( point, true );
 
+  // once the track highlight has a line, it is extended by the change instead of the whole geometry
+  const bool highlightHasTrack = recordedPointsCount() >= 2;
+
   if ( mLastTimeRecorded.addSecs( mLineRecordingInterval ) <= QDateTime::currentDateTime() )
   {
     mLastTimeRecorded = QDateTime::currentDateTime();
-    mRecordedPoints.append( *layerPoint.get() );
+    appendRecordedPoint( *layerPoint.get() );
+
+    if ( highlightHasTrack )
+    {
+      emit recordedPointAdded( layerToMapPoint( *layerPoint.get() ) );
+      return;
+    }
   }
   else
   {
-    if ( !mRecordedPoints.isEmpty() )
+    moveLastRecordedPoint( *layerPoint.get() );
+
+    if ( highlightHasTrack )
     {
-      mRecordedPoints.last().setX( layerPoint->x() );
-      mRecordedPoints.last().setY( layerPoint->y() );
-      mRecordedPoints.last().setZ( layerPoint->z() );
+      emit lastRecordedPointMoved( layerToMapPoint( *layerPoint.get() ) );
+      return;
     }
   }
 
@@ -293,13 +397,13 @@ FeatureLayerPair DigitizingController::lineOrPolygonFeature()
   if ( !featureLayerPair().layer() )
     return FeatureLayerPair();
 
-  if ( mRecordedPoints.isEmpty() )
+  if ( mRecordedX.isEmpty() )
     return FeatureLayerPair();
 
   QgsGeometry geom;
-  QgsLineString *linestring = new QgsLineString;
-  Q_FOREACH ( const QgsPoint &pt, mRecordedPoints )
-    linestring->addVertex( pt );
+  // coordinate arrays are implicitly shared, nothing is copied until another point is recorded
+  QgsLineString *linestring = new QgsLineString( mRecordedX, mRecordedY,
+      mRecordedZ.count() == mRecordedX.count() ? mRecordedZ : QVector<double>() );
   if ( hasLineGeometry( featureLayerPair().layer() ) )
   {
     geom = QgsGeometry( linestring );
@@ -341,17 +445,17 @@ void DigitizingController::addRecordPoint( const QgsPoint &point, bool isGpsPoin
     return;
 
   std::unique_ptr<QgsPoint> layerPoint = getLayerPoint( point, isGpsPoint );
-  mRecordedPoints.append( *layerPoint.get() );
+  appendRecordedPoint( *layerPoint.get() );
 
   setFeatureLayerPair( lineOrPolygonFeature() );
 }
 
 void DigitizingController::removeLastPoint()
 {
-  if ( mRecordedPoints.isEmpty() )
+  if ( recordedPointsCount() == 0 )
     return;
 
-  if ( mRecordedPoints.size() == 1 )
+  if ( recordedPointsCount() == 1 )
   {
     // cancel recording
     mRecording = false;
@@ -360,6 +464,6 @@ void DigitizingController::removeLastPoint()
     return;
   }
 
-  mRecordedPoints.removeLast();
+  removeLastRecordedPoint();
   setFeatureLayerPair( lineOrPolygonFeature() );
 }
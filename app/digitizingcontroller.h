@@ -97,22 +97,53 @@ class DigitizingController : public QObject
     void lineRecordingIntervalChanged();
     void useGpsPointChanged();
 
+    /**
+     * Emitted when a point from GPS is appended to the recorded track (streaming mode).
+     * Once the track has at least two points, featureLayerPair is not updated on every position change
+     * anymore - highlight of the track should be extended by the point (in map CRS) instead.
+     */
+    void recordedPointAdded( const QgsPoint &mapPoint );
+
+    //! Emitted when the last point of the recorded track (in map CRS) is moved to the latest GPS position (streaming mode)
+    void lastRecordedPointMoved( const QgsPoint &mapPoint );
+
   private slots:
     void onPositionChanged();
+    void onMapSettingsChanged();
+    void resetTransforms();
 
   private:
     void fixZ( QgsPoint &point ) const; // add/remove Z coordinate based on layer wkb type
     QgsCoordinateTransform transformer() const;
     bool hasEnoughPoints() const;
 
+    //! Returns transform from position CRS to layer CRS, it is only recreated when the layer or map settings change
+    const QgsCoordinateTransform &positionToLayerTransform();
+    //! Returns transform from layer CRS to map CRS, it is only recreated when the layer or map settings change
+    const QgsCoordinateTransform &layerToMapTransform();
+    //! Returns the point (in layer CRS) transformed to map CRS
+    QgsPoint layerToMapPoint( const QgsPoint &point );
+
+    int recordedPointsCount() const { return mRecordedX.count(); }
+    void appendRecordedPoint( const QgsPoint &point );
+    void moveLastRecordedPoint( const QgsPoint &point );
+    void removeLastRecordedPoint();
+    void clearRecordedPoints();
+
     bool mRecording = false;
-    //! Flag if a point is added to mRecordedPoints by user interaction (true) or onPositionChanged (false)
+    //! Flag if a point is recorded by user interaction (true) or onPositionChanged (false)
     //! Used only for polyline and polygon features.
     bool mManualRecording = true;
     PositionKit *mPositionKit = nullptr;
-    QVector<QgsPoint> mRecordedPoints;  //!< for recording of linestrings, point's coord in layer CRS
+    //! For recording of linestrings and polygons, coordinates of points in layer CRS.
+    //! Kept as arrays so that points are appended in place and the geometry is created without copying them one by one
+    QVector<double> mRecordedX;
+    QVector<double> mRecordedY;
+    QVector<double> mRecordedZ; //!< empty if the layer has no Z coordinate
     FeatureLayerPair mFeatureLayerPair; //!< to be used for highlight of feature being recorded
     QgsQuickMapSettings *mMapSettings = nullptr;
+    QgsCoordinateTransform mPositionToLayerTransform;
+    QgsCoordinateTransform mLayerToMapTransform;
     VariablesManager *mVariablesManager = nullptr; // not owned
     int mLineRecordingInterval = 3; // in seconds
     QDateTime mLastTimeRecorded;
@@ -16,6 +16,8 @@
 #include <memory>
 
 #include "qgsvectorlayer.h"
+#include "qgslinestring.h"
+#include "qgspolygon.h"
 
 #include "featurehighlight.h"
 #include "qgsquickmapsettings.h"
@@ -31,10 +33,11 @@ FeatureHighlight::FeatureHighlight( QQuickItem *parent )
   // transform to device coords
   mTransform.appendToItem( this );
 
+  // pan and zoom only change the matrix of mTransform, the node is kept
   connect( this, &FeatureHighlight::mapSettingsChanged, this, &FeatureHighlight::onMapSettingsChanged );
-  connect( this, &FeatureHighlight::featureLayerPairChanged, this, &FeatureHighlight::markDirty );
-  connect( this, &FeatureHighlight::colorChanged, this, &FeatureHighlight::markDirty );
-  connect( this, &FeatureHighlight::widthChanged, this, &FeatureHighlight::markDirty );
+  connect( this, &FeatureHighlight::featureLayerPairChanged, this, &FeatureHighlight::updateMapGeometry );
+  connect( this, &FeatureHighlight::colorChanged, this, &FeatureHighlight::markStyleDirty );
+  connect( this, &FeatureHighlight::widthChanged, this, &FeatureHighlight::markStyleDirty );
 }
 
 void FeatureHighlight::markDirty()
@@ -43,34 +46,35 @@ void FeatureHighlight::markDirty()
   update();
 }
 
-void FeatureHighlight::onMapSettingsChanged()
+void FeatureHighlight::markStyleDirty()
 {
-  mTransform.setMapSettings( mMapSettings );
-  markDirty();
+  mStyleDirty = true;
+  update();
 }
 
-QSGNode *FeatureHighlight::updatePaintNode( QSGNode *n, QQuickItem::UpdatePaintNodeData * )
+void FeatureHighlight::onMapSettingsChanged()
 {
-  if ( !mDirty || !mMapSettings || !mFeatureLayerPair.isValid() )
-    return n;
+  mTransform.setMapSettings( mMapSettings );
+  if ( mMapSettings )
+    connect( mMapSettings, &QgsQuickMapSettings::destinationCrsChanged, this, &FeatureHighlight::updateMapGeometry, Qt::UniqueConnection );
 
-  delete n;
-  n = new QSGNode;
+  updateMapGeometry();
+}
 
-  QgsVectorLayer *layer = mFeatureLayerPair.layer();
-  Q_ASSERT( layer ); // we checked the validity of feature-layer pair
-  QgsCoordinateTransform transf( layer->crs(), mMapSettings->destinationCrs(), mMapSettings->transformContext() );
+void FeatureHighlight::updateMapGeometry()
+{
+  mMapGeometry = QgsGeometry();
 
-  QgsFeature feature = mFeatureLayerPair.feature();
-  if ( feature.hasGeometry() )
+  if ( mMapSettings && mFeatureLayerPair.isValid() && mFeatureLayerPair.feature().hasGeometry() )
   {
-    QgsGeometry geom( feature.geometry() );
+    QgsVectorLayer *layer = mFeatureLayerPair.layer();
+    QgsCoordinateTransform transf( layer->crs(), mMapSettings->destinationCrs(), mMapSettings->transformContext() );
+
+    QgsGeometry geom( mFeatureLayerPair.feature().geometry() );
     try
     {
       geom.transform( transf );
-      std::unique_ptr<HighlightSGNode> rb( new HighlightSGNode( geom, mColor, mWidth ) );
-      rb->setFlag( QSGNode::OwnedByParent );
-      n->appendChildNode( rb.release() );
+      mMapGeometry = geom;
     }
     catch ( QgsCsException &e )
     {
@@ -78,6 +82,99 @@ QSGNode *FeatureHighlight::updatePaintNode( QSGNode *n, QQuickItem::UpdatePaintN
       // Caught an error in transform
     }
   }
+
+  markDirty();
+}
+
+void FeatureHighlight::appendPoint( const QgsPoint &mapPoint )
+{
+  if ( QgsLineString *line = qgsgeometry_cast<QgsLineString *>( mMapGeometry.get() ) )
+  {
+    line->addVertex( mapPoint );
+    mAppendedPoints.append( mapPoint );
+    update();
+  }
+  else if ( const QgsPolygon *polygon = qgsgeometry_cast<const QgsPolygon *>( mMapGeometry.constGet() ) )
+  {
+    if ( !polygon->exteriorRing() )
+      return;
+
+    // the ring ends with its closing vertex, the new point goes right before it
+    mMapGeometry.insertVertex( mapPoint, polygon->exteriorRing()->numPoints() - 1 );
+    markDirty();
+  }
+}
+
+void FeatureHighlight::moveLastPoint( const QgsPoint &mapPoint )
+{
+  if ( QgsLineString *line = qgsgeometry_cast<QgsLineString *>( mMapGeometry.get() ) )
+  {
+    if ( line->numPoints() == 0 )
+      return;
+
+    mMapGeometry.moveVertex( mapPoint, line->numPoints() - 1 );
+
+    // a point appended since the last update is moved before it reaches the node
+    if ( !mAppendedPoints.isEmpty() )
+      mAppendedPoints.last() = mapPoint;
+    else
+    {
+      mLastPointMoved = true;
+      mLastPoint = mapPoint;
+    }
+    update();
+  }
+  else if ( const QgsPolygon *polygon = qgsgeometry_cast<const QgsPolygon *>( mMapGeometry.constGet() ) )
+  {
+    if ( !polygon->exteriorRing() || polygon->exteriorRing()->numPoints() < 2 )
+      return;
+
+    mMapGeometry.moveVertex( mapPoint, polygon->exteriorRing()->numPoints() - 2 );
+    markDirty();
+  }
+}
+
+QSGNode *FeatureHighlight::updatePaintNode( QSGNode *n, QQuickItem::UpdatePaintNodeData * )
+{
+  if ( !mMapSettings )
+    return n;
+
+  if ( n && !mDirty )
+  {
+    // the node is updated in place, vertex buffers (and tessellated polygons) are kept
+    HighlightSGNode *rb = static_cast<HighlightSGNode *>( n->firstChild() );
+
+    if ( mStyleDirty && rb )
+      rb->setStyle( mColor, mWidth );
+
+    // the last point is moved before new ones are appended, as it was in mMapGeometry
+    if ( mLastPointMoved && !( rb && rb->moveLastLinePoint( mLastPoint ) ) )
+      mDirty = true;
+
+    if ( !mAppendedPoints.isEmpty() && !( rb && rb->appendLinePoints( mAppendedPoints ) ) )
+      mDirty = true;
+  }
+  else if ( !n )
+  {
+    mDirty = true;
+  }
+
+  mStyleDirty = false;
+  mLastPointMoved = false;
+  mAppendedPoints.clear();
+
+  if ( !mDirty )
+    return n;
+
+  delete n;
+  n = new QSGNode;
+
+  if ( !mMapGeometry.isNull() )
+  {
+    std::unique_ptr<HighlightSGNode> rb( new HighlightSGNode( mMapGeometry, mColor, mWidth ) );
+    rb->setFlag( QSGNode::OwnedByParent );
+    n->appendChildNode( rb.release() );
+  }
   mDirty = false;
 
   return n;
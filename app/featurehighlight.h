@@ -68,6 +68,15 @@ class  FeatureHighlight : public QQuickItem
     //! Creates a new feature highlight
     explicit FeatureHighlight( QQuickItem *parent = nullptr );
 
+    /**
+     * Extends the highlighted line or polygon by a point (in map CRS) without resetting featureLayerPair.
+     * Points of a line are appended to its scene graph node, a polygon is tessellated again.
+     */
+    Q_INVOKABLE void appendPoint( const QgsPoint &mapPoint );
+
+    //! Moves the last point of the highlighted line or polygon (in map CRS), the closing vertex of a polygon is kept
+    Q_INVOKABLE void moveLastPoint( const QgsPoint &mapPoint );
+
   signals:
     //! \copydoc FeatureHighlight::featureLayerPair
     void featureLayerPairChanged();
@@ -83,13 +92,21 @@ class  FeatureHighlight : public QQuickItem
 
   private slots:
     void markDirty();
+    void markStyleDirty();
     void onMapSettingsChanged();
+    //! Transforms geometry of the feature to map CRS, the scene graph node is then recreated
+    void updateMapGeometry();
 
   private:
     QSGNode *updatePaintNode( QSGNode *n, UpdatePaintNodeData * ) override;
 
     QColor mColor = Qt::yellow;
-    bool mDirty = false;
+    bool mDirty = false; //!< the node needs to be recreated
+    bool mStyleDirty = false; //!< only color or width of the node changed
+    QgsGeometry mMapGeometry; //!< highlighted geometry in map CRS
+    QVector<QgsPoint> mAppendedPoints; //!< points appended to the line since the node was last updated
+    bool mLastPointMoved = false;
+    QgsPoint mLastPoint; //!< position of the last point of the line if mLastPointMoved
     float mWidth = 20;
     FeatureLayerPair mFeatureLayerPair;
     QgsQuickMapSettings *mMapSettings = nullptr; // not owned
@@ -16,17 +16,37 @@
 #include "featureslistmodel.h"
 #include "qgsexpressioncontextutils.h"
 #include "qgslogger.h"
+#include "qgsfeaturerequest.h"
+#include "qgsvectorlayerfeatureiterator.h"
 #include "coreutils.h"
 
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QtConcurrent>
+
 FeaturesListModel::FeaturesListModel( QObject *parent )
   : QAbstractListModel( parent ),
     mCurrentLayer( nullptr )
 {
   // avoid dangling pointers to mCurrentLayer/mCurrentFeature when switching projects
   QObject::connect( QgsProject::instance(), &QgsProject::cleared, this, &FeaturesListModel::emptyData );
+
+  mSearchGeneration = std::make_shared< std::atomic<int> >( 0 );
+
+  // do not search for every typed character
+  mSearchTimer.setSingleShot( true );
+  mSearchTimer.setInterval( SEARCH_DELAY_MS );
+  QObject::connect( &mSearchTimer, &QTimer::timeout, this, [this]() { loadFeaturesFromLayer(); } );
 }
 
-FeaturesListModel::~FeaturesListModel() = default;
+FeaturesListModel::~FeaturesListModel()
+{
+  // the workers only hold snapshots of the layer, but they post results to this model
+  cancelSearch();
+  for ( QFuture<void> &future : mSearchFutures )
+    future.waitForFinished();
+}
 
 int FeaturesListModel::rowCount( const QModelIndex &parent ) const
 {
@@ -75,8 +95,8 @@ QVariant FeaturesListModel::data( const QModelIndex &index, int role ) const
   {
     case FeatureTitle: return featureTitle( pair );
     case FeatureId: return QVariant( pair.feature().id() );
-    case Feature: return QVariant::fromValue<QgsFeature>( pair.feature() );
-    case FeaturePair: return QVariant::fromValue<FeatureLayerPair>( pair );
+    case Feature: return QVariant::fromValue<QgsFeature>( completeFeaturePair( pair ).feature() );
+    case FeaturePair: return QVariant::fromValue<FeatureLayerPair>( completeFeaturePair( pair ) );
     case Description: return QVariant( QString( "Feature ID %1" ).arg( pair.feature().id() ) );
     case KeyColumn: return mKeyField.isEmpty() ? QVariant() : pair.feature().attribute( mKeyField );
     case FoundPair: return foundPair( pair );
@@ -91,26 +111,30 @@ QString FeaturesListModel::foundPair( const FeatureLayerPair &pair ) const
   if ( mSearchExpression.isEmpty() )
     return QString();
 
-  QgsFields fields = pair.feature().fields();
-  QStringList words = mSearchExpression.split( ' ', QString::SplitBehavior::SkipEmptyParts );
+  // computed by the search worker together with the feature
+  return mFoundPairs.value( pair.feature().id() );
+}
+
+QString FeaturesListModel::foundPair( const QgsFeature &feature, const QStringList &words, const QStringList &searchableFields )
+{
+  QStringList fields = searchableFields;
   QStringList foundPairs;
 
   for ( const QString &word : words )
   {
-    for ( const QgsField &field : fields )
+    for ( int i = 0; i < fields.count(); )
     {
-      if ( field.configurationFlags().testFlag( QgsField::ConfigurationFlag::NotSearchable ) )
-        continue;
-
-      QString attrValue = pair.feature().attribute( field.name() ).toString();
+      const QString attrValue = feature.attribute( fields.at( i ) ).toString();
 
-      if ( attrValue.toLower().indexOf( word.toLower() ) != -1 )
+      if ( attrValue.contains( word, Qt::CaseInsensitive ) )
       {
-        foundPairs << field.name() + ": " + attrValue;
+        foundPairs << fields.at( i ) + ": " + attrValue;
 
         // remove found field from list of fields to not select it more than once
-        fields.remove( fields.lookupField( field.name() ) );
+        fields.removeAt( i );
       }
+      else
+        ++i;
     }
   }
 
@@ -172,6 +196,30 @@ void FeaturesListModel::setupFeatureRequest( QgsFeatureRequest &request )
 
   request.setLimit( FEATURES_LIMIT );
 
+  // only attributes shown in the list and searched by are needed, geometry is never shown
+  QgsExpression displayExpression( mCurrentLayer->displayExpression() );
+  QSet<QString> attributes = displayExpression.referencedColumns();
+  if ( !displayExpression.needsGeometry() && !attributes.contains( QgsFeatureRequest::ALL_ATTRIBUTES ) )
+  {
+    if ( !mKeyField.isEmpty() )
+      attributes << mKeyField;
+    if ( !mFeatureTitleField.isEmpty() )
+      attributes << mFeatureTitleField;
+
+    if ( !mSearchExpression.isEmpty() )
+    {
+      const QgsFields fields = mCurrentLayer->fields();
+      for ( const QgsField &field : fields )
+      {
+        if ( !field.configurationFlags().testFlag( QgsField::ConfigurationFlag::NotSearchable ) )
+          attributes << field.name();
+      }
+    }
+
+    request.setFlags( QgsFeatureRequest::NoGeometry );
+    request.setSubsetOfAttributes( attributes, mCurrentLayer->fields() );
+  }
+
   // create context for filter expression
   if ( !mFilterExpression.isEmpty() && QgsValueRelationFieldFormatter::expressionIsUsable( mFilterExpression, mCurrentFeature ) )
   {
@@ -192,22 +240,262 @@ void FeaturesListModel::loadFeaturesFromLayer( QgsVectorLayer *layer )
 
   if ( mCurrentLayer )
   {
+    if ( !mSearchExpression.isEmpty() )
+    {
+      startSearch();
+      return;
+    }
+
+    cancelSearch();
+
     beginResetModel();
-    mFeatures.clear();
+    // closes the query of the previous (now stale) search too
+    clearFeatures();
 
     QgsFeatureRequest req;
     setupFeatureRequest( req );
+    mPartialFeatures = req.flags().testFlag( QgsFeatureRequest::NoGeometry );
+
+    // only the first page is loaded now, the rest once the view asks for it
+    mFeatureIterator = mCurrentLayer->getFeatures( req );
+    mHasMoreFeatures = true;
+    mFeatures = nextFeatures( FEATURES_PAGE_SIZE );
+
+    emit featuresCountChanged( featuresCount() );
+    endResetModel();
+  }
+}
+
+void FeaturesListModel::startSearch()
+{
+  cancelSearch();
 
-    QgsFeatureIterator it = mCurrentLayer->getFeatures( req );
-    QgsFeature f;
+  beginResetModel();
+  clearFeatures();
+
+  QgsFeatureRequest req;
+  setupFeatureRequest( req );
+  mPartialFeatures = req.flags().testFlag( QgsFeatureRequest::NoGeometry );
+
+  emit featuresCountChanged( featuresCount() );
+  endResetModel();
+
+  const QStringList words = mSearchExpression.split( ' ', QString::SplitBehavior::SkipEmptyParts );
+  QStringList searchableFields;
+  const QgsFields fields = mCurrentLayer->fields();
+  for ( const QgsField &field : fields )
+  {
+    if ( !field.configurationFlags().testFlag( QgsField::ConfigurationFlag::NotSearchable ) )
+      searchableFields << field.name();
+  }
+
+  // the worker reads from a snapshot of the layer, so the layer itself is never touched outside of the GUI thread
+  std::shared_ptr<QgsVectorLayerFeatureSource> source = std::make_shared<QgsVectorLayerFeatureSource>( mCurrentLayer );
+  std::shared_ptr< std::atomic<int> > currentGeneration = mSearchGeneration;
+  const int generation = ++( *mSearchGeneration );
 
-    while ( it.nextFeature( f ) )
+  // workers of stale searches which have already stopped are not needed anymore
+  mSearchFutures.erase( std::remove_if( mSearchFutures.begin(), mSearchFutures.end(), []( const QFuture<void> &future ) { return future.isFinished(); } ),
+                        mSearchFutures.end() );
+
+  setIsSearching( true );
+  mSearchFutures << QtConcurrent::run( [this, source, req, words, searchableFields, currentGeneration, generation]()
+  {
+    searchFeatures( this, source, req, words, searchableFields, currentGeneration, generation );
+  } );
+}
+
+void FeaturesListModel::cancelSearch()
+{
+  mSearchTimer.stop();
+
+  // the running worker stops and its queued results are ignored
+  ++( *mSearchGeneration );
+  setIsSearching( false );
+}
+
+void FeaturesListModel::searchFeatures( FeaturesListModel *model, std::shared_ptr<QgsVectorLayerFeatureSource> source, const QgsFeatureRequest &request,
+                                        const QStringList &words, const QStringList &searchableFields,
+                                        std::shared_ptr< std::atomic<int> > currentGeneration, int generation )
+{
+  QgsFeatureList features;
+  QHash<QgsFeatureId, QString> foundPairs;
+  QElapsedTimer sinceLastBatch;
+  sinceLastBatch.start();
+
+  auto postResults = [&]( bool finished )
+  {
+    // a superseded search posts nothing, the model waits for all workers before it is destroyed
+    if ( *currentGeneration != generation )
+      return;
+
+    QMetaObject::invokeMethod( model, [model, generation, features, foundPairs, finished]()
+    {
+      model->addSearchResults( generation, features, foundPairs, finished );
+    }, Qt::QueuedConnection );
+    features.clear();
+    foundPairs.clear();
+    sinceLastBatch.restart();
+  };
+
+  QgsFeatureIterator it = source->getFeatures( request );
+  QgsFeature f;
+  while ( it.nextFeature( f ) )
+  {
+    if ( *currentGeneration != generation )
     {
-      mFeatures << FeatureLayerPair( f, mCurrentLayer );
+      // results of a stale search would be dropped anyway
+      it.close();
+      return;
     }
 
-    emit featuresCountChanged( featuresCount() );
-    endResetModel();
+    foundPairs.insert( f.id(), foundPair( f, words, searchableFields ) );
+    features << f;
+
+    // the first results are shown as soon as possible, later ones in bigger batches
+    if ( features.count() >= SEARCH_BATCH_SIZE || sinceLastBatch.elapsed() > 100 )
+      postResults( false );
+  }
+
+  postResults( true );
+}
+
+void FeaturesListModel::addSearchResults( int generation, const QgsFeatureList &features, const QHash<QgsFeatureId, QString> &foundPairs, bool finished )
+{
+  if ( generation != *mSearchGeneration || !mCurrentLayer )
+    return;
+
+  if ( !features.isEmpty() )
+  {
+    beginInsertRows( QModelIndex(), mFeatures.count(), mFeatures.count() + features.count() - 1 );
+    for ( const QgsFeature &feature : features )
+      mFeatures << FeatureLayerPair( feature, mCurrentLayer );
+    for ( auto it = foundPairs.constBegin(); it != foundPairs.constEnd(); ++it )
+      mFoundPairs.insert( it.key(), it.value() );
+    endInsertRows();
+  }
+
+  if ( finished )
+    setIsSearching( false );
+}
+
+bool FeaturesListModel::isSearching() const
+{
+  return mIsSearching;
+}
+
+void FeaturesListModel::setIsSearching( bool isSearching )
+{
+  if ( mIsSearching == isSearching )
+    return;
+
+  mIsSearching = isSearching;
+  emit isSearchingChanged();
+}
+
+FeatureLayerPairs FeaturesListModel::nextFeatures( int count )
+{
+  FeatureLayerPairs features;
+  if ( !mHasMoreFeatures )
+    return features;
+
+  QgsFeature f;
+  while ( features.count() < count && mFeatureIterator.nextFeature( f ) )
+  {
+    features << FeatureLayerPair( f, mCurrentLayer );
+  }
+
+  if ( features.count() < count )
+  {
+    mHasMoreFeatures = false;
+    mFeatureIterator.close();
+  }
+
+  return features;
+}
+
+bool FeaturesListModel::canFetchMore( const QModelIndex &parent ) const
+{
+  if ( parent.isValid() )
+    return false;
+
+  return mHasMoreFeatures && mFeatures.count() < FEATURES_LIMIT;
+}
+
+void FeaturesListModel::fetchMore( const QModelIndex &parent )
+{
+  if ( !canFetchMore( parent ) )
+    return;
+
+  const FeatureLayerPairs features = nextFeatures( qMin( FEATURES_PAGE_SIZE, FEATURES_LIMIT - mFeatures.count() ) );
+  if ( features.isEmpty() )
+    return;
+
+  beginInsertRows( QModelIndex(), mFeatures.count(), mFeatures.count() + features.count() - 1 );
+  mFeatures << features;
+  endInsertRows();
+}
+
+void FeaturesListModel::clearFeatures()
+{
+  mFeatures.clear();
+  mFeatureIterator.close();
+  mFeatureIterator = QgsFeatureIterator();
+  mHasMoreFeatures = false;
+  mPartialFeatures = false;
+  mRowsById.clear();
+  mRowsByKey.clear();
+  mIndexedRows = 0;
+  mFoundPairs.clear();
+  mCompleteFeatures.clear();
+}
+
+FeatureLayerPair FeaturesListModel::completeFeaturePair( const FeatureLayerPair &pair ) const
+{
+  if ( !mPartialFeatures || !pair.layer() )
+    return pair;
+
+  // views ask for the roles again and again, the layer is only queried the first time
+  const QgsFeatureId fid = pair.feature().id();
+  auto it = mCompleteFeatures.constFind( fid );
+  if ( it == mCompleteFeatures.constEnd() )
+    it = mCompleteFeatures.insert( fid, pair.layer()->getFeature( fid ) );
+
+  return FeatureLayerPair( *it, pair.layer() );
+}
+
+int FeaturesListModel::indexedRow( int role, const QVariant &value )
+{
+  Q_ASSERT( role == FeatureId || role == KeyColumn );
+
+  bool ok = true;
+  const QgsFeatureId fid = role == FeatureId ? value.toLongLong( &ok ) : FID_NULL;
+  const QString key = role == KeyColumn ? value.toString().trimmed() : QString();
+  if ( !ok || ( role == KeyColumn && mKeyField.isEmpty() ) )
+    return -1;
+
+  while ( true )
+  {
+    // extend indexes with rows loaded since the last lookup (the first row wins for duplicate keys)
+    for ( ; mIndexedRows < mFeatures.count(); ++mIndexedRows )
+    {
+      const QgsFeature &feature = mFeatures.at( mIndexedRows ).feature();
+      if ( !mRowsById.contains( feature.id() ) )
+        mRowsById.insert( feature.id(), mIndexedRows );
+
+      if ( !mKeyField.isEmpty() )
+      {
+        const QString rowKey = feature.attribute( mKeyField ).toString().trimmed();
+        if ( !mRowsByKey.contains( rowKey ) )
+          mRowsByKey.insert( rowKey, mIndexedRows );
+      }
+    }
+
+    const int row = role == FeatureId ? mRowsById.value( fid, -1 ) : mRowsByKey.value( key, -1 );
+    if ( row != -1 || !canFetchMore( QModelIndex() ) )
+      return row;
+
+    fetchMore( QModelIndex() );
   }
 }
 
@@ -261,7 +549,8 @@ void FeaturesListModel::reloadFeatures()
 
 void FeaturesListModel::emptyData()
 {
-  mFeatures.clear();
+  cancelSearch();
+  clearFeatures();
   mCurrentLayer = nullptr;
   mKeyField.clear();
   mFeatureTitleField.clear();
@@ -300,7 +589,18 @@ void FeaturesListModel::setSearchExpression( const QString &searchExpression )
   mSearchExpression = searchExpression;
   emit searchExpressionChanged( mSearchExpression );
 
-  loadFeaturesFromLayer();
+  if ( mSearchExpression.isEmpty() || !mCurrentLayer )
+  {
+    // going back to the full list is cheap, it is loaded by pages
+    loadFeaturesFromLayer();
+  }
+  else
+  {
+    // results of the previous search are not valid anymore
+    cancelSearch();
+    setIsSearching( true );
+    mSearchTimer.start();
+  }
 }
 
 void FeaturesListModel::setFeatureTitleField( const QString &attribute )
@@ -311,6 +611,11 @@ void FeaturesListModel::setFeatureTitleField( const QString &attribute )
 void FeaturesListModel::setKeyField( const QString &attribute )
 {
   mKeyField = attribute;
+
+  // rebuild the key index on the next lookup
+  mRowsById.clear();
+  mRowsByKey.clear();
+  mIndexedRows = 0;
 }
 
 void FeaturesListModel::setFilterExpression( const QString &filterExpression )
@@ -338,8 +643,11 @@ int FeaturesListModel::featuresLimit() const
   return FEATURES_LIMIT;
 }
 
-int FeaturesListModel::rowFromAttribute( const int role, const QVariant &value ) const
+int FeaturesListModel::rowFromAttribute( const int role, const QVariant &value )
 {
+  if ( role == FeatureId || role == KeyColumn )
+    return indexedRow( role, value );
+
   for ( int i = 0; i < mFeatures.count(); ++i )
   {
     QVariant d = data( index( i, 0 ), role );
@@ -351,8 +659,14 @@ int FeaturesListModel::rowFromAttribute( const int role, const QVariant &value )
   return -1;
 }
 
-QVariant FeaturesListModel::attributeFromValue( const int role, const QVariant &value, const int requestedRole ) const
+QVariant FeaturesListModel::attributeFromValue( const int role, const QVariant &value, const int requestedRole )
 {
+  if ( role == FeatureId || role == KeyColumn )
+  {
+    int row = indexedRow( role, value );
+    return row == -1 ? QVariant() : data( index( row, 0 ), requestedRole );
+  }
+
   for ( int i = 0; i < mFeatures.count(); ++i )
   {
     QVariant d = data( index( i, 0 ), role );
@@ -382,10 +696,9 @@ QVariant FeaturesListModel::convertMultivalueFormat( const QVariant &multivalue,
 
 FeatureLayerPair FeaturesListModel::featureLayerPair( const int &featureId )
 {
-  for ( const FeatureLayerPair &i : mFeatures )
-  {
-    if ( i.feature().id() == featureId )
-      return i;
-  }
-  return FeatureLayerPair();
+  int row = indexedRow( FeatureId, featureId );
+  if ( row == -1 )
+    return FeatureLayerPair();
+
+  return completeFeaturePair( mFeatures.at( row ) );
 }
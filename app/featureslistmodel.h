@@ -16,12 +16,19 @@
 #ifndef FEATURESMODEL_H
 #define FEATURESMODEL_H
 
+#include <atomic>
+#include <memory>
+
 #include <QAbstractListModel>
+#include <QFuture>
+#include <QTimer>
 
 #include "qgsvectorlayer.h"
 #include "featurelayerpair.h"
 #include "qgsvaluerelationfieldformatter.h"
 
+class QgsVectorLayerFeatureSource;
+
 /**
  * \brief List Model holding features of specific layer.
  *
@@ -57,6 +64,13 @@ class  FeaturesListModel : public QAbstractListModel
       */
     Q_PROPERTY( QgsFeature currentFeature READ currentFeature WRITE setCurrentFeature NOTIFY currentFeatureChanged )
 
+    /**
+     * True while features matching the search expression are being searched for (on a worker thread).
+     * Found features are added to the model as they arrive.
+     * Read only property
+     */
+    Q_PROPERTY( bool isSearching READ isSearching NOTIFY isSearchingChanged )
+
   public:
 
     //! Roles for FeaturesListModel
@@ -83,6 +97,12 @@ class  FeaturesListModel : public QAbstractListModel
     QVariant data( const QModelIndex &index, int role = Qt::DisplayRole ) const override;
     QHash<int, QByteArray> roleNames() const override;
 
+    //! Returns true if there are more features of the current query that have not been loaded yet
+    bool canFetchMore( const QModelIndex &parent ) const override;
+
+    //! Loads next page of features of the current query
+    void fetchMore( const QModelIndex &parent ) override;
+
     /**
      * \brief setupValueRelation populates model with value relation data from config
      * \param config to be used
@@ -106,8 +126,9 @@ class  FeaturesListModel : public QAbstractListModel
      * \param value to find
      * \return Row index for found feature, returns -1 if no feature is found. If more features
      * match requested role and value, index of first is returned.
+     * \note for FeatureId and KeyColumn roles further pages are loaded until the feature is found
      */
-    Q_INVOKABLE int rowFromAttribute( const int role, const QVariant &value ) const;
+    Q_INVOKABLE int rowFromAttribute( const int role, const QVariant &value );
 
     /**
      * \brief attributeFromValue finds feature with role and value, returns value for requested role
@@ -116,8 +137,9 @@ class  FeaturesListModel : public QAbstractListModel
      * \param requestedRole a role whose value is returned
      * \return If feature is found by role and value, method returns value for requested role. Returns empty QVariant if no feature is found. If more features
      * match requested role and value, value for first is returned.
+     * \note for FeatureId and KeyColumn roles further pages are loaded until the feature is found
      */
-    Q_INVOKABLE QVariant attributeFromValue( const int role, const QVariant &value, const int requestedRole ) const;
+    Q_INVOKABLE QVariant attributeFromValue( const int role, const QVariant &value, const int requestedRole );
 
     /**
      * \brief convertMultivalueFormat converts postgres string like string to an array of variants with requested role.
@@ -137,10 +159,14 @@ class  FeaturesListModel : public QAbstractListModel
 
     /**
      * \brief setSearchExpression Sets search expression, upon setting also reloads features from current layer with new expression
+     * The search starts once the expression has not changed for a short while and runs on a worker thread.
      * \param searchExpression QString to set, empty string represents no filter
      */
     void setSearchExpression( const QString &searchExpression );
 
+    //! Returns true while the search is running
+    bool isSearching() const;
+
     /**
      * \brief setFeatureTitleField Sets name of attribute that will be used for FeatureTitle and Qt::DisplayRole
      * \param attribute Name of attribute to use. If empty, displayExpression will be used.
@@ -179,6 +205,9 @@ class  FeaturesListModel : public QAbstractListModel
     //! Signal emitted when current feature has changed
     void currentFeatureChanged( QgsFeature feature );
 
+    //! Signal emitted when the search starts or finishes
+    void isSearchingChanged();
+
   protected:
 
     //! Sets maximum limit and filter expression for request.
@@ -190,6 +219,25 @@ class  FeaturesListModel : public QAbstractListModel
     //! Empty data when resetting model
     virtual void emptyData();
 
+    //! Removes all loaded features, closes the current query and clears lookup indexes
+    void clearFeatures();
+
+    //! Reads up to count further features of the current query (closes the query when there are no more features)
+    FeatureLayerPairs nextFeatures( int count );
+
+    /**
+     * Returns the feature with all attributes and geometry.
+     * Features loaded by pages only hold attributes needed by the list, the full feature is fetched from the layer
+     * once and then kept in mCompleteFeatures.
+     */
+    FeatureLayerPair completeFeaturePair( const FeatureLayerPair &pair ) const;
+
+    /**
+     * Finds row of the feature by its id (FeatureId role) or key (KeyColumn role) using hash indexes.
+     * Further pages are loaded until the feature is found. Returns -1 if there is no such feature.
+     */
+    int indexedRow( int role, const QVariant &value );
+
     //! Builds feature title in list
     QVariant featureTitle( const FeatureLayerPair &featurePair ) const;
 
@@ -199,6 +247,28 @@ class  FeaturesListModel : public QAbstractListModel
     //! Returns found attribute and its value from search expression
     QString foundPair( const FeatureLayerPair &feat ) const;
 
+    //! Starts the search for features matching the search expression on a worker thread
+    void startSearch();
+
+    //! Stops the pending or running search (its results are dropped)
+    void cancelSearch();
+
+    //! Appends results of the search with given generation, results of stale searches are ignored
+    void addSearchResults( int generation, const QgsFeatureList &features, const QHash<QgsFeatureId, QString> &foundPairs, bool finished );
+
+    void setIsSearching( bool isSearching );
+
+    /**
+     * Reads features matching the request from the snapshot of the layer and passes them to the model in batches.
+     * Runs on a worker thread and stops as soon as the current generation of the search changes.
+     */
+    static void searchFeatures( FeaturesListModel *model, std::shared_ptr<QgsVectorLayerFeatureSource> source, const QgsFeatureRequest &request,
+                                const QStringList &words, const QStringList &searchableFields,
+                                std::shared_ptr< std::atomic<int> > currentGeneration, int generation );
+
+    //! Returns pairs of searchable attributes and their values containing any of the (lowercase) words
+    static QString foundPair( const QgsFeature &feature, const QStringList &words, const QStringList &searchableFields );
+
     /**
      * QList of loaded features from layer
      * Hold maximum of FEATURES_LIMIT features
@@ -209,6 +279,42 @@ class  FeaturesListModel : public QAbstractListModel
     //! Number of maximum features loaded from layer
     const int FEATURES_LIMIT = 10000;
 
+    //! Number of features loaded at once when the view asks for more
+    const int FEATURES_PAGE_SIZE = 100;
+
+    //! Query of the currently loaded features (open while there are more features to load)
+    QgsFeatureIterator mFeatureIterator;
+
+    //! True if features of the current query have not been all loaded yet
+    bool mHasMoreFeatures = false;
+
+    //! True if features were loaded with only a subset of attributes and without geometry
+    bool mPartialFeatures = false;
+
+    //! Delays the search after a change of the search expression
+    QTimer mSearchTimer;
+    const int SEARCH_DELAY_MS = 300;
+
+    //! Number of features the search worker passes to the model at once
+    static const int SEARCH_BATCH_SIZE = 100;
+
+    //! Id of the current search - the worker stops and its results are dropped once it changes
+    std::shared_ptr< std::atomic<int> > mSearchGeneration;
+    //! Workers of the searches that may still run (stale ones stop at their next feature), all are waited for on destruction
+    QList< QFuture<void> > mSearchFutures;
+    bool mIsSearching = false;
+
+    //! Found attribute pairs of search results (computed by the search worker)
+    QHash<QgsFeatureId, QString> mFoundPairs;
+
+    //! Features fetched with all attributes and geometry (when the loaded ones are partial), by their ids
+    mutable QHash<QgsFeatureId, QgsFeature> mCompleteFeatures;
+
+    //! Indexes of loaded features by id and by key (string value of the key field), up to mIndexedRows
+    QHash<QgsFeatureId, int> mRowsById;
+    QHash<QString, int> mRowsByKey;
+    int mIndexedRows = 0;
+
     //! Search string, change of string results in reloading features from mCurrentLayer
     QString mSearchExpression;
 
@@ -13,6 +13,8 @@
  *                                                                         *
  ***************************************************************************/
 
+#include <algorithm>
+
 #include "highlightsgnode.h"
 
 #include "qgstessellator.h"
@@ -31,6 +33,67 @@ HighlightSGNode::HighlightSGNode( const QgsGeometry &geom,
   handleGeometryCollection( geom.constGet(), geom.type() );
 }
 
+void HighlightSGNode::setStyle( const QColor &color, float width )
+{
+  mMaterial.setColor( color );
+  mWidth = width;
+
+  for ( QSGNode *child = firstChild(); child; child = child->nextSibling() )
+  {
+    QSGGeometryNode *node = static_cast<QSGGeometryNode *>( child );
+    node->geometry()->setLineWidth( mWidth );
+    node->markDirty( QSGNode::DirtyMaterial | QSGNode::DirtyGeometry );
+  }
+}
+
+bool HighlightSGNode::appendLinePoints( const QVector<QgsPoint> &points )
+{
+  if ( mLinesCount != 1 || !mLineNode )
+    return false;
+
+  for ( const QgsPoint &point : points )
+  {
+    QSGGeometry *sgGeom = mLineNode->geometry();
+    int count = sgGeom->vertexCount();
+
+    if ( count >= LINE_BLOCK_VERTICES )
+    {
+      // the new block starts at the last vertex of the full one, so that the line stays connected
+      const QSGGeometry::Point2D lastVertex = sgGeom->vertexDataAsPoint2D()[count - 1];
+      mLineNode = createLineNode( 1 );
+      mLineNode->geometry()->vertexDataAsPoint2D()[0] = lastVertex;
+      appendChildNode( mLineNode );
+
+      sgGeom = mLineNode->geometry();
+      count = 1;
+    }
+
+    // allocate() does not keep the vertices, the (bounded) block is copied back
+    const QVector<QSGGeometry::Point2D> vertices( sgGeom->vertexDataAsPoint2D(), sgGeom->vertexDataAsPoint2D() + count );
+    sgGeom->allocate( count + 1 );
+    QSGGeometry::Point2D *data = sgGeom->vertexDataAsPoint2D();
+    std::copy( vertices.constBegin(), vertices.constEnd(), data );
+    data[count].set( static_cast< float >( point.x() ), static_cast< float >( point.y() ) );
+  }
+
+  mLineNode->markDirty( QSGNode::DirtyGeometry );
+  return true;
+}
+
+bool HighlightSGNode::moveLastLinePoint( const QgsPoint &point )
+{
+  if ( mLinesCount != 1 || !mLineNode )
+    return false;
+
+  QSGGeometry *sgGeom = mLineNode->geometry();
+  if ( sgGeom->vertexCount() == 0 )
+    return false;
+
+  sgGeom->vertexDataAsPoint2D()[sgGeom->vertexCount() - 1].set( static_cast< float >( point.x() ), static_cast< float >( point.y() ) );
+  mLineNode->markDirty( QSGNode::DirtyGeometry );
+  return true;
+}
+
 void HighlightSGNode::handleGeometryCollection( const QgsAbstractGeometry *geom, QgsWkbTypes::GeometryType type )
 {
   const QgsGeometryCollection *collection = qgsgeometry_cast<const QgsGeometryCollection *>( geom );
@@ -64,7 +127,11 @@ void HighlightSGNode::handleSingleGeometry( const QgsAbstractGeometry *geom, Qgs
     {
       const QgsLineString *line = qgsgeometry_cast<const QgsLineString *>( geom );
       if ( line )
-        appendChildNode( createLineGeometry( line ) );
+      {
+        mLineNode = createLineGeometry( line );
+        appendChildNode( mLineNode );
+        ++mLinesCount;
+      }
       break;
     }
 
@@ -86,9 +153,8 @@ QSGGeometryNode *HighlightSGNode::createLineGeometry( const QgsLineString *line
 {
   Q_ASSERT( line );
 
-  std::unique_ptr<QSGGeometryNode> node( new QSGGeometryNode() );
-  std::unique_ptr<QSGGeometry> sgGeom( new QSGGeometry( QSGGeometry::defaultAttributes_Point2D(), line->numPoints() ) );
-  QSGGeometry::Point2D *vertices = sgGeom->vertexDataAsPoint2D();
+  QSGGeometryNode *node = createLineNode( line->numPoints() );
+  QSGGeometry::Point2D *vertices = node->geometry()->vertexDataAsPoint2D();
 
   const double *x = line->xData();
   const double *y = line->yData();
@@ -101,6 +167,14 @@ QSGGeometryNode *HighlightSGNode::createLineGeometry( const QgsLineString *line
     );
   }
 
+  return node;
+}
+
+QSGGeometryNode *HighlightSGNode::createLineNode( int vertexCount )
+{
+  std::unique_ptr<QSGGeometryNode> node( new QSGGeometryNode() );
+  std::unique_ptr<QSGGeometry> sgGeom( new QSGGeometry( QSGGeometry::defaultAttributes_Point2D(), vertexCount ) );
+
   sgGeom->setLineWidth( mWidth );
   sgGeom->setDrawingMode( GL_LINE_STRIP );
   node->setGeometry( sgGeom.release() );
@@ -50,16 +50,37 @@ class  HighlightSGNode : public QSGNode
     //! Destructor
     ~HighlightSGNode() = default;
 
+    //! Changes color and width of the rendered geometry, the vertex buffers are kept
+    void setStyle( const QColor &color, float width );
+
+    /**
+     * Appends points (in map coordinates) to the rendered line. Vertices are added to the last
+     * block of the line, a new block is started once it is full, so an append never copies
+     * more than LINE_BLOCK_VERTICES vertices.
+     *
+     * Returns false if the node does not render exactly one line.
+     */
+    bool appendLinePoints( const QVector<QgsPoint> &points );
+
+    //! Moves the last point of the rendered line, returns false if the node does not render exactly one line
+    bool moveLastLinePoint( const QgsPoint &point );
+
   private:
     void handleGeometryCollection( const QgsAbstractGeometry *geom, QgsWkbTypes::GeometryType type );
     void handleSingleGeometry( const QgsAbstractGeometry *geom, QgsWkbTypes::GeometryType type );
 
     QSGGeometryNode *createLineGeometry( const QgsLineString *line );
+    QSGGeometryNode *createLineNode( int vertexCount );
     QSGGeometryNode *createPointGeometry( const QgsPoint *point );
     QSGGeometryNode *createPolygonGeometry( const QgsPolygon *polygon );
 
+    //! Maximum number of vertices of a line block which is still extended by appended points
+    static const int LINE_BLOCK_VERTICES = 256;
+
     QSGFlatColorMaterial mMaterial;
     float mWidth  = 20;
+    int mLinesCount = 0;
+    QSGGeometryNode *mLineNode = nullptr; //!< last block of the rendered line, owned by this node
 };
 
 #endif // HIGHLIGHTSGNODE
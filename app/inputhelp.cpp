@@ -98,6 +98,9 @@ QString InputHelp::fullLog( bool isHtml )
   qint64 limit = 500000;
   QVector<QString> retLines = logHeader( isHtml );
 
+  // entries are written in the background
+  CoreUtils::flushLog();
+
   QFile file( CoreUtils::logFilename() );
   if ( file.open( QIODevice::ReadOnly ) )
   {
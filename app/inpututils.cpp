@@ -32,6 +32,8 @@
 #include "qgsvaluerelationfieldformatter.h"
 #include "qgsdatetimefieldformatter.h"
 #include "qgslayertree.h"
+#include "qgsabstractdatabaseproviderconnection.h"
+#include "qgsproviderregistry.h"
 
 #include "featurelayerpair.h"
 #include "qgsquickmapsettings.h"
@@ -41,6 +43,7 @@
 
 #include <Qt>
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
 #include <QRegularExpression>
@@ -481,6 +484,54 @@ void InputUtils::onQgsLogMessageReceived( const QString &message, const QString
   CoreUtils::log( "QGIS " + tag, levelStr + ": " + message );
 }
 
+bool InputUtils::checkpointGeoPackages( const QString &projectDir )
+{
+  QgsProviderMetadata *ogrMetadata = QgsProviderRegistry::instance()->providerMetadata( QStringLiteral( "ogr" ) );
+  if ( !ogrMetadata )
+    return false;
+
+  bool result = true;
+  QDirIterator it( projectDir, QStringList() << QStringLiteral( "*.gpkg" ), QDir::Files, QDirIterator::Subdirectories );
+  while ( it.hasNext() )
+  {
+    QString path = it.next();
+    if ( path.contains( QStringLiteral( "/.mergin/" ) ) )
+      continue;
+
+    // nothing to checkpoint - the file is not in WAL mode or all its changes are already in the database file
+    QFileInfo walInfo( path + QStringLiteral( "-wal" ) );
+    if ( !walInfo.exists() || walInfo.size() == 0 )
+      continue;
+
+    try
+    {
+      // the connection is only used for the checkpoint and it is closed right away
+      std::unique_ptr<QgsAbstractDatabaseProviderConnection> conn( static_cast<QgsAbstractDatabaseProviderConnection *>( ogrMetadata->createConnection( path, QVariantMap() ) ) );
+      if ( !conn )
+      {
+        CoreUtils::log( "checkpoint", QStringLiteral( "Failed to open %1" ).arg( path ) );
+        result = false;
+        continue;
+      }
+
+      const QList<QList<QVariant>> rows = conn->executeSql( QStringLiteral( "PRAGMA wal_checkpoint(TRUNCATE)" ) );
+
+      // the pragma returns a single row (busy, log, checkpointed) - busy is set if some other connection blocked the checkpoint
+      if ( rows.isEmpty() || rows.first().isEmpty() || rows.first().first().toInt() != 0 )
+      {
+        CoreUtils::log( "checkpoint", QStringLiteral( "Unable to fully checkpoint %1, it is busy" ).arg( path ) );
+        result = false;
+      }
+    }
+    catch ( QgsProviderConnectionException &e )
+    {
+      CoreUtils::log( "checkpoint", QStringLiteral( "Failed to checkpoint %1: %2" ).arg( path, e.what() ) );
+      result = false;
+    }
+  }
+  return result;
+}
+
 bool InputUtils::cpDir( const QString &srcPath, const QString &dstPath, bool onlyDiffable )
 {
   bool result  = true;
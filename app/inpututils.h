@@ -128,6 +128,14 @@ class InputUtils: public QObject
 
     static QString filesToString( QList<MerginFile> files );
 
+    /**
+     * Checkpoints GeoPackages of the project edited in WAL journal mode - moves all changes from their "-wal" files
+     * to the database files and truncates the "-wal" files. Files in the project's .mergin directory are skipped.
+     * \returns false if any of the GeoPackages could not be fully checkpointed (e.g. it is busy)
+     * \note it is called by sync before it reads or replaces project files (see MerginApi::setGeoPackagesCheckpoint())
+     */
+    static bool checkpointGeoPackages( const QString &projectDir );
+
     /** InputApp platform */
     static QString appPlatform();
 
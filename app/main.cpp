@@ -441,9 +441,29 @@ int main( int argc, char *argv[] )
   QObject::connect( &app, &QCoreApplication::aboutToQuit, &loader, &Loader::appAboutToQuit );
   QObject::connect( &pw, &ProjectWizard::projectCreated, &localProjectsManager, &LocalProjectsManager::addLocalProject );
   QObject::connect( ma.get(), &MerginApi::reloadProject, &loader, &Loader::reloadProject );
+  // sync checkpoints GeoPackages before it reads or replaces them
+  MerginApi::setGeoPackagesCheckpoint( &InputUtils::checkpointGeoPackages );
+  QObject::connect( &loader, &Loader::projectReloaded, &localProjectsManager, [&localProjectsManager]( QgsProject * project )
+  {
+    // edits saved by the app are recorded right away, the file system watcher may report them later
+    const QMap<QString, QgsMapLayer *> layers = project->mapLayers();
+    for ( QgsMapLayer *layer : layers )
+    {
+      QgsVectorLayer *vectorLayer = qobject_cast<QgsVectorLayer *>( layer );
+      if ( !vectorLayer || vectorLayer->providerType() != QStringLiteral( "ogr" ) )
+        continue;
+
+      QString filePath = vectorLayer->source().section( '|', 0, 0 );
+      QObject::connect( vectorLayer, &QgsVectorLayer::afterCommitChanges, &localProjectsManager, [&localProjectsManager, filePath]()
+      {
+        localProjectsManager.changeTracker().notifyFileChanged( filePath );
+      } );
+    }
+  } );
   QObject::connect( &mtm, &MapThemesModel::mapThemeChanged, &recordingLpm, &LayersProxyModel::onMapThemeChanged );
   QObject::connect( &loader, &Loader::projectReloaded, vm.get(), &VariablesManager::merginProjectChanged );
   QObject::connect( &loader, &Loader::projectWillBeReloaded, &inputProjUtils, &InputProjUtils::resetHandlers );
+  QObject::connect( &loader, &Loader::projectWillBeReloaded, ma.get(), &MerginApi::setActiveProject );
   QObject::connect( &pw, &ProjectWizard::notify, &iu, &InputUtils::showNotificationRequested );
   QObject::connect( &iosUtils, &IosUtils::showToast, &iu, &InputUtils::showNotificationRequested );
   QObject::connect( QgsApplication::messageLog(),
@@ -486,9 +506,9 @@ int main( int argc, char *argv[] )
   addQmlImportPath( engine );
   initDeclarative();
   // QGIS environment variables to set
-  // OGR_SQLITE_JOURNAL is set to DELETE to avoid working with WAL files
-  // and properly close connection after writting changes to gpkg.
-  qputenv( "OGR_SQLITE_JOURNAL", "DELETE" );
+  // OGR_SQLITE_JOURNAL is set to WAL, so saving of a feature does not need to sync the whole rollback journal.
+  // Changes are checkpointed to the gpkg files before they are synced (see MerginApi::setGeoPackagesCheckpoint)
+  qputenv( "OGR_SQLITE_JOURNAL", "WAL" );
 
   // Register to QQmlEngine
   engine.rootContext()->setContextProperty( "__androidUtils", &au );
@@ -13,8 +13,12 @@
 #include "merginuserauth.h"
 #include "coreutils.h"
 
+#include <QtConcurrent>
+
 ProjectsModel::ProjectsModel( QObject *parent ) : QAbstractListModel( parent )
 {
+  connect( &mStatusScanWatcher, &QFutureWatcher<StatusScan>::resultReadyAt, this, &ProjectsModel::onStatusScanResult );
+  connect( &mStatusScanWatcher, &QFutureWatcher<StatusScan>::finished, this, &ProjectsModel::onStatusScansFinished );
 }
 
 void ProjectsModel::initializeProjectsModel()
@@ -106,6 +110,7 @@ QVariant ProjectsModel::data( const QModelIndex &index, int role ) const
       if ( role == ProjectPending ) return QVariant( project->mergin->pending );
       else if ( role == ProjectSyncProgress ) return QVariant( project->mergin->progress );
       else if ( role == ProjectRemoteError ) return QVariant( project->mergin->remoteError );
+      else if ( role == ProjectCheckingChanges ) return QVariant( isCheckingChanges( *project ) );
       return QVariant();
     }
   }
@@ -135,6 +140,7 @@ QHash<int, QByteArray> ProjectsModel::roleNames() const
   roles[Roles::ProjectPending]      = QStringLiteral( "ProjectPending" ).toLatin1();
   roles[Roles::ProjectSyncProgress] = QStringLiteral( "ProjectSyncProgress" ).toLatin1();
   roles[Roles::ProjectRemoteError]  = QStringLiteral( "ProjectRemoteError" ).toLatin1();
+  roles[Roles::ProjectCheckingChanges] = QStringLiteral( "ProjectCheckingChanges" ).toLatin1();
   return roles;
 }
 
@@ -155,10 +161,8 @@ void ProjectsModel::listProjects( const QString &searchExpression, int page )
 
   if ( !mLastRequestId.isEmpty() )
   {
+    // projects are kept until the response arrives, then only rows that differ get updated
     setModelIsLoading( true );
-    // clear only after requesting the very first page, otherwise we want to append results to the model
-    if ( page == 1 )
-      clearProjects();
   }
 }
 
@@ -174,7 +178,6 @@ void ProjectsModel::listProjectsByName()
   if ( !mLastRequestId.isEmpty() )
   {
     setModelIsLoading( true );
-    clearProjects();
   }
 }
 
@@ -195,20 +198,8 @@ void ProjectsModel::onListProjectsFinished( const MerginProjectsList &merginProj
     return;
   }
 
-  if ( page == 1 )
-  {
-    // if we are populating first page, reset model and throw away previous projects
-    beginResetModel();
-    mergeProjects( merginProjects, pendingProjects, false );
-    endResetModel();
-  }
-  else
-  {
-    // paginating next page, keep previous projects and emit model add items
-    beginInsertRows( QModelIndex(), mProjects.size(), mProjects.size() + merginProjects.size() - 1 );
-    mergeProjects( merginProjects, pendingProjects, true );
-    endInsertRows();
-  }
+  // first page replaces previous projects, next pages are appended to them
+  mergeProjects( merginProjects, pendingProjects, page != 1 );
 
   mServerProjectsCount = projectsCount;
   mPaginatedPage = page;
@@ -224,45 +215,49 @@ void ProjectsModel::onListProjectsByNameFinished( const MerginProjectsList &merg
     return;
   }
 
-  beginResetModel();
   mergeProjects( merginProjects, pendingProjects );
-  endResetModel();
 
   setModelIsLoading( false );
 }
 
 void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Transactions pendingProjects, bool keepPrevious )
 {
-  const LocalProjectsList localProjects = mLocalProjectsManager->projects();
-
-  if ( !keepPrevious )
-    mProjects.clear();
+  QList<std::shared_ptr<Project>> projects;
 
   if ( mModelType == ProjectModelTypes::LocalProjectsModel )
   {
+    const LocalProjectsList localProjects = mLocalProjectsManager->projects();
+
+    // remote projects by their full name - the first one wins, like when the list was searched
+    QHash<QString, const MerginProject *> merginProjectsById;
+    merginProjectsById.reserve( merginProjects.count() );
+    for ( const MerginProject &merginProject : merginProjects )
+    {
+      QString id = merginProject.id();
+      if ( !merginProjectsById.contains( id ) )
+        merginProjectsById.insert( id, &merginProject );
+    }
+
     // Keep all local projects and ignore all not downloaded remote projects
     for ( const auto &localProject : localProjects )
     {
       std::shared_ptr<Project> project = std::shared_ptr<Project>( new Project() );
       project->local = std::unique_ptr<LocalProject>( localProject.clone() );
 
-      const auto res = std::find_if( merginProjects.begin(), merginProjects.end(), [&project]( const MerginProject & me )
-      {
-        return ( project->local->projectName == me.projectName && project->local->projectNamespace == me.projectNamespace );
-      } );
+      const MerginProject *res = merginProjectsById.value( MerginApi::getFullProjectName( localProject.projectNamespace, localProject.projectName ) );
 
-      if ( res != merginProjects.end() )
+      if ( res )
       {
         project->mergin = std::unique_ptr<MerginProject>( res->clone() );
 
         if ( pendingProjects.contains( project->mergin->id() ) )
         {
           TransactionStatus transaction = pendingProjects.value( project->mergin->id() );
-          project->mergin->progress = transaction.totalSize != 0 ? transaction.transferedSize / transaction.totalSize : 0;
+          project->mergin->progress = transaction.progress();
           project->mergin->pending = true;
           pendingProjects.remove( project->mergin->id() );
         }
-        project->mergin->status = ProjectStatus::projectStatus( project );
+        project->mergin->status = projectStatus( project );
       }
       else if ( project->local->localVersion > -1 )
       {
@@ -270,10 +265,10 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
         project->mergin = std::unique_ptr<MerginProject>( new MerginProject() );
         project->mergin->projectName = project->local->projectName;
         project->mergin->projectNamespace = project->local->projectNamespace;
-        project->mergin->status = ProjectStatus::projectStatus( project );
+        project->mergin->status = projectStatus( project );
       }
 
-      mProjects << project;
+      projects << project;
     }
 
     // lets check also for projects that are currently being downloaded and add them to local projects list
@@ -286,11 +281,11 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
       project->mergin = std::unique_ptr<MerginProject>( new MerginProject() );
 
       MerginApi::extractProjectName( i.key(), project->mergin->projectNamespace, project->mergin->projectName );
-      project->mergin->progress = i.value().totalSize != 0 ? i.value().transferedSize / i.value().totalSize : 0;
+      project->mergin->progress = i.value().progress();
       project->mergin->pending = true;
-      project->mergin->status = ProjectStatus::projectStatus( project );
+      project->mergin->status = projectStatus( project );
 
-      mProjects << project;
+      projects << project;
       ++i;
     }
   }
@@ -305,24 +300,276 @@ void ProjectsModel::mergeProjects( const MerginProjectsList &merginProjects, Tra
       if ( pendingProjects.contains( project->mergin->id() ) )
       {
         TransactionStatus projectTransaction = pendingProjects.value( project->mergin->id() );
-        project->mergin->progress = projectTransaction.transferedSize / projectTransaction.totalSize;
+        project->mergin->progress = projectTransaction.progress();
         project->mergin->pending = true;
       }
 
-      const auto res = std::find_if( localProjects.begin(), localProjects.end(), [&project]( const LocalProject & le )
-      {
-        return ( project->mergin->projectName == le.projectName && project->mergin->projectNamespace == le.projectNamespace );
-      } );
-
-      if ( res != localProjects.end() )
+      // local projects are indexed by their full names
+      LocalProject localProject = mLocalProjectsManager->projectFromMerginName( remoteEntry.projectNamespace, remoteEntry.projectName );
+      if ( localProject.isValid() )
       {
-        project->local = std::unique_ptr<LocalProject>( res->clone() );
+        project->local = std::unique_ptr<LocalProject>( localProject.clone() );
       }
-      project->mergin->status = ProjectStatus::projectStatus( project );
+      project->mergin->status = projectStatus( project );
 
-      mProjects << project;
+      projects << project;
     }
   }
+
+  if ( !keepPrevious )
+  {
+    updateProjects( projects );
+  }
+  else if ( !projects.isEmpty() )
+  {
+    beginInsertRows( QModelIndex(), mProjects.size(), mProjects.size() + projects.size() - 1 );
+    mProjects << projects;
+    endInsertRows();
+  }
+}
+
+//! Returns whether the projects would give the same data to views (not counting data read from the disk by the model)
+static bool hasSameData( const Project &project, const Project &other )
+{
+  if ( project.isLocal() != other.isLocal() || project.isMergin() != other.isMergin() )
+    return false;
+
+  if ( project.isLocal() )
+  {
+    const LocalProject &a = *project.local;
+    const LocalProject &b = *other.local;
+    if ( a.projectName != b.projectName || a.projectNamespace != b.projectNamespace || a.projectDir != b.projectDir ||
+         a.projectError != b.projectError || a.qgisProjectFilePath != b.qgisProjectFilePath || a.localVersion != b.localVersion )
+      return false;
+  }
+
+  if ( project.isMergin() )
+  {
+    const MerginProject &a = *project.mergin;
+    const MerginProject &b = *other.mergin;
+    if ( a.projectName != b.projectName || a.projectNamespace != b.projectNamespace || a.serverUpdated != b.serverUpdated ||
+         a.serverVersion != b.serverVersion || a.status != b.status || a.pending != b.pending || a.progress != b.progress ||
+         a.remoteError != b.remoteError )
+      return false;
+  }
+
+  return true;
+}
+
+//! Rows moved one by one by ProjectsModel::updateProjects() at most, a list reordered more is reset
+static const int MAX_MOVED_ROWS = 16;
+
+void ProjectsModel::updateProjects( const QList<std::shared_ptr<Project>> &projects )
+{
+  // new row of each project (the first one of duplicates)
+  QHash<QString, int> ids;
+  ids.reserve( projects.count() );
+  for ( int row = 0; row < projects.count(); ++row )
+  {
+    QString id = projects.at( row )->projectId();
+    if ( !ids.contains( id ) )
+      ids.insert( id, row );
+  }
+
+  // remove projects that are gone, a run of adjacent rows at once
+  for ( int row = mProjects.count() - 1; row >= 0; --row )
+  {
+    if ( ids.contains( mProjects.at( row )->projectId() ) )
+      continue;
+
+    int first = row;
+    while ( first > 0 && !ids.contains( mProjects.at( first - 1 )->projectId() ) )
+      --first;
+
+    beginRemoveRows( QModelIndex(), first, row );
+    mProjects.erase( mProjects.begin() + first, mProjects.begin() + row + 1 );
+    endRemoveRows();
+    row = first;
+  }
+
+  // rows out of the new order need to be looked up and moved - with many of them, it is cheaper to reset the model
+  int movedCount = 0;
+  int lastRow = -1;
+  QSet<QString> currentIds;
+  currentIds.reserve( mProjects.count() );
+  for ( const std::shared_ptr<Project> &project : qAsConst( mProjects ) )
+  {
+    QString id = project->projectId();
+    currentIds.insert( id );
+
+    int row = ids.value( id );
+    if ( row < lastRow )
+      ++movedCount;
+    else
+      lastRow = row;
+  }
+
+  if ( movedCount > MAX_MOVED_ROWS )
+  {
+    beginResetModel();
+    mProjects = projects;
+    endResetModel();
+    return;
+  }
+
+  // the rest is in the new order already unless the order has changed - then matching rows are moved
+  for ( int row = 0; row < projects.count(); ++row )
+  {
+    const std::shared_ptr<Project> &project = projects.at( row );
+    QString id = project->projectId();
+
+    if ( !currentIds.contains( id ) )
+    {
+      // a run of new projects is inserted at once
+      int last = row;
+      while ( last + 1 < projects.count() && !currentIds.contains( projects.at( last + 1 )->projectId() ) )
+        ++last;
+
+      beginInsertRows( QModelIndex(), row, last );
+      for ( int i = row; i <= last; ++i )
+        mProjects.insert( i, projects.at( i ) );
+      endInsertRows();
+      row = last;
+      continue;
+    }
+
+    // usually found at the row right away
+    int current = row;
+    while ( current < mProjects.count() && mProjects.at( current )->projectId() != id )
+      ++current;
+
+    if ( current == mProjects.count() )
+    {
+      // another project with the same id has taken the row already
+      beginInsertRows( QModelIndex(), row, row );
+      mProjects.insert( row, project );
+      endInsertRows();
+      continue;
+    }
+
+    if ( current != row )
+    {
+      beginMoveRows( QModelIndex(), current, current, QModelIndex(), row );
+      mProjects.move( current, row );
+      endMoveRows();
+    }
+
+    bool changed = !hasSameData( *mProjects.at( row ), *project );
+    mProjects[row] = project;
+    if ( changed )
+    {
+      QModelIndex ix = index( row );
+      emit dataChanged( ix, ix );
+    }
+  }
+
+  // duplicates left over
+  if ( mProjects.count() > projects.count() )
+  {
+    beginRemoveRows( QModelIndex(), projects.count(), mProjects.count() - 1 );
+    mProjects.erase( mProjects.begin() + projects.count(), mProjects.end() );
+    endRemoveRows();
+  }
+}
+
+ProjectStatus::Status ProjectsModel::projectStatus( const std::shared_ptr<Project> &project )
+{
+  ProjectChangeTracker &tracker = mLocalProjectsManager->changeTracker();
+  if ( !project->isMergin() || !project->isLocal() || project->local->localVersion < 0 )
+    return ProjectStatus::projectStatus( project, &tracker );
+
+  if ( tracker.isBaselineKnown( project->local->projectDir ) )
+  {
+    ProjectStatus::Status status = ProjectStatus::projectStatus( project, &tracker );
+    mKnownChanges.insert( project->local->projectDir, status == ProjectStatus::Modified );
+    return status;
+  }
+
+  // scanning the whole project could block the UI for a while
+  requestStatusScan( project->local->projectDir );
+  return ProjectStatus::projectStatusWithChanges( project, mKnownChanges.value( project->local->projectDir, false ) );
+}
+
+bool ProjectsModel::isCheckingChanges( const Project &project ) const
+{
+  if ( !project.isMergin() || !project.isLocal() || mKnownChanges.contains( project.local->projectDir ) )
+    return false;
+
+  return mRunningStatusScans.contains( project.local->projectDir ) || mPendingStatusScans.contains( project.local->projectDir );
+}
+
+void ProjectsModel::requestStatusScan( const QString &projectDir )
+{
+  if ( mRunningStatusScans.contains( projectDir ) || mPendingStatusScans.contains( projectDir ) )
+    return;
+
+  // projects requested during one pass of the event loop are scanned in one batch
+  if ( mPendingStatusScans.isEmpty() && mRunningStatusScans.isEmpty() )
+    QMetaObject::invokeMethod( this, &ProjectsModel::startStatusScans, Qt::QueuedConnection );
+
+  mPendingStatusScans << projectDir;
+}
+
+void ProjectsModel::startStatusScans()
+{
+  if ( !mRunningStatusScans.isEmpty() || mPendingStatusScans.isEmpty() )
+    return;
+
+  ProjectChangeTracker &tracker = mLocalProjectsManager->changeTracker();
+  QList<StatusScan> scans;
+  for ( const QString &projectDir : qAsConst( mPendingStatusScans ) )
+  {
+    StatusScan scan;
+    scan.projectDir = projectDir;
+    scan.snapshot = tracker.startFullScan( projectDir );
+    scans << scan;
+    mRunningStatusScans.insert( projectDir );
+  }
+  mPendingStatusScans.clear();
+
+  CoreUtils::log( "Projects model", QStringLiteral( "Scanning local changes of %1 projects" ).arg( scans.count() ) );
+  mStatusScanWatcher.setFuture( QtConcurrent::mapped( scans, &ProjectsModel::scanProjectChanges ) );
+}
+
+ProjectsModel::StatusScan ProjectsModel::scanProjectChanges( const StatusScan &scan )
+{
+  StatusScan result = scan;
+  result.modified = ProjectChangeTracker::scanLocalChanges( scan.projectDir, &result.modifiedPaths );
+  return result;
+}
+
+void ProjectsModel::onStatusScanResult( int resultIndex )
+{
+  StatusScan scan = mStatusScanWatcher.resultAt( resultIndex );
+
+  ProjectChangeTracker &tracker = mLocalProjectsManager->changeTracker();
+  tracker.finishFullScan( scan.projectDir, scan.snapshot, scan.modifiedPaths );
+  bool wasChecking = !mKnownChanges.contains( scan.projectDir );
+  mKnownChanges.insert( scan.projectDir, scan.modified );
+
+  for ( int row = 0; row < mProjects.count(); ++row )
+  {
+    const std::shared_ptr<Project> &project = mProjects.at( row );
+    if ( !project->isMergin() || !project->isLocal() || project->local->projectDir != scan.projectDir )
+      continue;
+
+    // changes recorded since the scan has started are only known to the tracker
+    ProjectStatus::Status status = tracker.isBaselineKnown( scan.projectDir ) ?
+                                   ProjectStatus::projectStatus( project, &tracker ) :
+                                   ProjectStatus::projectStatusWithChanges( project, scan.modified );
+    if ( status != project->mergin->status || wasChecking )
+    {
+      project->mergin->status = status;
+      QModelIndex ix = index( row );
+      emit dataChanged( ix, ix, { ProjectSyncStatus, ProjectCheckingChanges } );
+    }
+  }
+}
+
+void ProjectsModel::onStatusScansFinished()
+{
+  mRunningStatusScans.clear();
+  startStatusScans();
 }
 
 void ProjectsModel::syncProject( const QString &projectId )
@@ -345,6 +592,18 @@ void ProjectsModel::syncProject( const QString &projectId )
   }
 }
 
+void ProjectsModel::syncAllProjects()
+{
+  for ( const std::shared_ptr<Project> &project : qAsConst( mProjects ) )
+  {
+    if ( !project->isLocal() || !project->isMergin() )
+      continue;
+
+    if ( project->mergin->status == ProjectStatus::OutOfDate || project->mergin->status == ProjectStatus::Modified )
+      syncProject( project->mergin->id() );
+  }
+}
+
 void ProjectsModel::stopProjectSync( const QString &projectId )
 {
   std::shared_ptr<Project> project = projectFromId( projectId );
@@ -391,7 +650,7 @@ void ProjectsModel::onProjectSyncFinished( const QString &projectDir, const QStr
     project->mergin->pending = false;
     project->mergin->progress = 0;
     project->mergin->serverVersion = newVersion;
-    project->mergin->status = ProjectStatus::projectStatus( project );
+    project->mergin->status = projectStatus( project );
 
     QModelIndex ix = index( mProjects.indexOf( project ) );
     emit dataChanged( ix, ix );
@@ -429,7 +688,7 @@ void ProjectsModel::onProjectAdded( const LocalProject &project )
     // add local information ~ project downloaded
     proj->local = std::unique_ptr<LocalProject>( project.clone() );
     if ( proj->isMergin() )
-      proj->mergin->status = ProjectStatus::projectStatus( proj );
+      proj->mergin->status = projectStatus( proj );
 
     QModelIndex ix = index( mProjects.indexOf( proj ) );
     emit dataChanged( ix, ix );
@@ -468,7 +727,7 @@ void ProjectsModel::onAboutToRemoveProject( const LocalProject project )
       proj->local.reset();
 
       if ( proj->isMergin() )
-        proj->mergin->status = ProjectStatus::projectStatus( proj );
+        proj->mergin->status = projectStatus( proj );
 
       QModelIndex ix = index( mProjects.indexOf( proj ) );
       emit dataChanged( ix, ix );
@@ -484,7 +743,7 @@ void ProjectsModel::onProjectDataChanged( const LocalProject &project )
   {
     proj->local = std::unique_ptr<LocalProject>( project.clone() );
     if ( proj->isMergin() )
-      proj->mergin->status = ProjectStatus::projectStatus( proj );
+      proj->mergin->status = projectStatus( proj );
 
     QModelIndex editIndex = index( mProjects.indexOf( proj ) );
 
@@ -596,9 +855,7 @@ void ProjectsModel::loadLocalProjects()
 {
   if ( mModelType == LocalProjectsModel )
   {
-    beginResetModel();
     mergeProjects( MerginProjectsList(), Transactions() ); // Fills model with local projects
-    endResetModel();
   }
 }
 
@@ -11,6 +11,8 @@
 #define PROJECTSMODEL_H
 
 #include <QAbstractListModel>
+#include <QFutureWatcher>
+#include <QSet>
 #include <memory>
 
 #include "project.h"
@@ -22,8 +24,12 @@ class LocalProjectsManager;
  * \brief The ProjectsModel class holds projects (both local and mergin). Model loads local projects from LocalProjectsManager that hold them
    during runtime. Remote (Mergin) projects are fetched from MerginAPI calling listProjects or listProjectsByName (based on the type of the model).
  *
- * The main job of the model is to merge projects coming from MerginAPI and LocalProjectsManager. By merging it means Each time new response is received from MerginAPI, model erases
- * old remembered projects and fetches new. Merge logic depends on the model type (described below).
+ * The main job of the model is to merge projects coming from MerginAPI and LocalProjectsManager. By merging it means Each time new response is received from MerginAPI, model replaces
+ * old remembered projects with new ones - only rows that have been added, removed, moved or changed are reported to views. Merge logic depends on the model type (described below).
+ *
+ * Sync status of a project whose local changes are not known by the change tracker (see ProjectChangeTracker) yet requires a scan of the whole project.
+ * Such projects are scanned in batches on worker threads, the ProjectSyncStatus role is updated as results arrive. Until then, the status
+ * is based on the changes known last time - if they have never been known, the ProjectCheckingChanges role is true.
  *
  * Model can have different types that affect handling of the projects.
  *  - LocalProjectsModel always keeps all local projects and seek their mergin part when listProjectsByNameFinished
@@ -59,7 +65,8 @@ class ProjectsModel : public QAbstractListModel
       ProjectIsValid,
       ProjectSyncStatus,
       ProjectSyncProgress,
-      ProjectRemoteError
+      ProjectRemoteError,
+      ProjectCheckingChanges
     };
     Q_ENUM( Roles )
 
@@ -110,6 +117,12 @@ class ProjectsModel : public QAbstractListModel
     //! Syncs specified project - upload or update
     Q_INVOKABLE void syncProject( const QString &projectId );
 
+    /**
+     * Syncs all downloaded projects that are out of date or modified. The syncs are queued by MerginApi,
+     * only a few of them transfer data at once (see SyncScheduler)
+     */
+    Q_INVOKABLE void syncAllProjects();
+
     //! Stops running project upload or update
     Q_INVOKABLE void stopProjectSync( const QString &projectId );
 
@@ -122,7 +135,10 @@ class ProjectsModel : public QAbstractListModel
     //! Calls listProjects with incremented page
     Q_INVOKABLE void fetchAnotherPage( const QString &searchExpression );
 
-    //! Merges local and remote projects based on the model type
+    /**
+     * Merges local and remote projects based on the model type and updates rows of the model. Merged projects
+     * are appended to the current ones if \a keepPrevious is set, otherwise they replace them.
+     */
     void mergeProjects( const MerginProjectsList &merginProjects, Transactions pendingProjects, bool keepPrevious = false );
 
     ProjectsModel::ProjectModelTypes modelType() const;
@@ -141,6 +157,9 @@ class ProjectsModel : public QAbstractListModel
 
     void setModelIsLoading( bool state );
 
+    //! Returns whether there are projects waiting for their local changes to be scanned in the background
+    bool hasPendingStatusScans() const { return !mPendingStatusScans.isEmpty() || !mRunningStatusScans.isEmpty(); }
+
   public slots:
     // MerginAPI - backend signals
     void onListProjectsFinished( const MerginProjectsList &merginProjects, Transactions pendingProjects, int projectsCount, int page, QString requestId );
@@ -166,17 +185,57 @@ class ProjectsModel : public QAbstractListModel
 
     void isLoadingChanged( bool isLoading );
 
+  private slots:
+    void startStatusScans();
+    void onStatusScanResult( int resultIndex );
+    void onStatusScansFinished();
+
   private:
+    //! Local changes of a project found by a scan in the background
+    struct StatusScan
+    {
+      QString projectDir;
+      quint64 snapshot = 0;  //!< see ProjectChangeTracker::startFullScan()
+      bool modified = false;
+      QStringList modifiedPaths;
+    };
+
     QString modelTypeToFlag() const;
     QStringList projectNames() const;
     void clearProjects();
     void loadLocalProjects();
     void initializeProjectsModel();
 
+    /**
+     * Replaces projects of the model with \a projects, emitting signals only for rows that
+     * have been removed, inserted, moved or changed.
+     */
+    void updateProjects( const QList<std::shared_ptr<Project>> &projects );
+
+    /**
+     * Returns sync status of the project. If the whole project would need to be scanned, the scan is
+     * started in the background and the status is based on the last known changes (if any) for the time being.
+     */
+    ProjectStatus::Status projectStatus( const std::shared_ptr<Project> &project );
+
+    //! Returns whether local changes of the project are being scanned and have not been known before
+    bool isCheckingChanges( const Project &project ) const;
+
+    //! Adds the project to the next batch of scans in the background
+    void requestStatusScan( const QString &projectDir );
+
+    //! Scans the whole project, runs on a worker thread
+    static StatusScan scanProjectChanges( const StatusScan &scan );
+
     MerginApi *mBackend = nullptr;
     LocalProjectsManager *mLocalProjectsManager = nullptr;
     QList<std::shared_ptr<Project>> mProjects;
 
+    QStringList mPendingStatusScans;   //!< project dirs to be scanned by the next batch
+    QSet<QString> mRunningStatusScans; //!< project dirs being scanned by the current batch
+    QFutureWatcher<StatusScan> mStatusScanWatcher;
+    QHash<QString, bool> mKnownChanges;  //!< project dir -> whether the project has had local changes when they were known last time
+
     ProjectModelTypes mModelType = EmptyProjectsModel;
 
     //! For pagination
@@ -137,6 +137,21 @@ Item {
     }
   }
 
+  // recorded feature is shown by the digitizing highlight, a track streamed from GPS by the track highlight
+  function showRecordedFeature() {
+    if ( !_digitizingController.recording )
+      return
+
+    if ( _digitizingController.manualRecording ) {
+      _digitizingHighlight.visible = true
+      _digitizingHighlight.featureLayerPair = _digitizingController.featureLayerPair
+    }
+    else {
+      _digitizingHighlight.visible = false
+      _trackHighlight.featureLayerPair = _digitizingController.featureLayerPair
+    }
+  }
+
   function isPositionOutOfExtent() {
     let border = InputStyle.mapOutOfExtentBorder
     return ( ( _positionKit.screenPosition.x < border ) ||
@@ -381,15 +396,19 @@ Item {
     lineRecordingInterval: __appSettings.lineRecordingInterval
     variablesManager: __variablesManager
 
-    onRecordingChanged: __loader.recording = recording
-
-    onFeatureLayerPairChanged: {
-      if ( recording ) {
-        _digitizingHighlight.visible = true
-        _digitizingHighlight.featureLayerPair = featureLayerPair
-      }
+    onRecordingChanged: {
+      __loader.recording = recording
+      // no track is recorded yet (or anymore)
+      _trackHighlight.featureLayerPair = lineOrPolygonFeature()
     }
 
+    onFeatureLayerPairChanged: showRecordedFeature()
+    onManualRecordingChanged: showRecordedFeature()
+
+    // a streamed track is extended in place by the latest position
+    onRecordedPointAdded: _trackHighlight.appendPoint( mapPoint )
+    onLastRecordedPointMoved: _trackHighlight.moveLastPoint( mapPoint )
+
     onUseGpsPointChanged: __variablesManager.useGpsPoint = _digitizingController.useGpsPoint
   }
 
@@ -426,6 +445,19 @@ Item {
     guideLineAllowed: _digitizingController.manualRecording && root.isInRecordState
   }
 
+  // track recorded in stream mode, its geometry grows with the recorded points
+  FeatureHighlight {
+    id: _trackHighlight
+    anchors.fill: _map
+
+    mapSettings: _map.mapSettings
+
+    color: InputStyle.highlightLineColor
+    width: InputStyle.highlightLineWidth
+
+    visible: _digitizingController.recording && !_digitizingController.manualRecording
+  }
+
   Banner {
     id: _gpsAccuracyBanner
 
@@ -57,7 +57,7 @@ void RelationFeaturesModel::populate()
     return;
 
   beginResetModel();
-  mFeatures.clear();
+  clearFeatures();
 
   QgsFeatureIterator it = mRelation.getRelatedFeatures( mParentFeatureLayerPair.feature() );
   QgsFeature feat;
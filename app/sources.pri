@@ -99,6 +99,7 @@ contains(DEFINES, INPUT_TEST) {
       test/testutilsfunctions.cpp \
       test/testmerginapi.cpp \
       test/testingpurchasingbackend.cpp \
+      test/testingmerginserver.cpp \
       test/testpurchasing.cpp \
       test/testlinks.cpp \
       test/testattributepreviewcontroller.cpp \
@@ -109,6 +110,8 @@ contains(DEFINES, INPUT_TEST) {
       test/testscalebarkit.cpp \
       test/testvariablesmanager.cpp \
       test/testformeditors.cpp \
+      test/testfeatureslistmodel.cpp \
+      test/testdigitizingcontroller.cpp \
 
   HEADERS += \
       test/inputtests.h \
@@ -116,6 +119,7 @@ contains(DEFINES, INPUT_TEST) {
       test/testutilsfunctions.h \
       test/testmerginapi.h \
       test/testingpurchasingbackend.h \
+      test/testingmerginserver.h \
       test/testpurchasing.h \
       test/testpositionkit.h \
       test/testlinks.h \
@@ -126,6 +130,8 @@ contains(DEFINES, INPUT_TEST) {
       test/testscalebarkit.h \
       test/testvariablesmanager.h \
       test/testformeditors.h \
+      test/testfeatureslistmodel.h \
+      test/testdigitizingcontroller.h \
 }
 
 contains(DEFINES, APPLE_PURCHASING) {
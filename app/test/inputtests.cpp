@@ -23,6 +23,8 @@
 #include "test/testscalebarkit.h"
 #include "test/testvariablesmanager.h"
 #include "test/testformeditors.h"
+#include "test/testfeatureslistmodel.h"
+#include "test/testdigitizingcontroller.h"
 
 #if not defined APPLE_PURCHASING
 #include "test/testpurchasing.h"
@@ -147,6 +149,16 @@ int InputTests::runTest() const
     TestFormEditors edTest;
     nFailed = QTest::qExec( &edTest, mTestArgs );
   }
+  else if ( mTestRequested == "--testFeaturesListModel" )
+  {
+    TestFeaturesListModel flmTest;
+    nFailed = QTest::qExec( &flmTest, mTestArgs );
+  }
+  else if ( mTestRequested == "--testDigitizingController" )
+  {
+    TestDigitizingController dcTest;
+    nFailed = QTest::qExec( &dcTest, mTestArgs );
+  }
 #if not defined APPLE_PURCHASING
   else if ( mTestRequested == "--testPurchasing" )
   {
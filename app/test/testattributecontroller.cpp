@@ -311,3 +311,85 @@ void TestAttributeController::tabsAndFieldsMixed()
   const QVector<QUuid> formItems = tabItem->formItems();
   QCOMPARE( formItems.size(), 6 );
 }
+
+static QHash<QString, QUuid> formItemIdsByName( const AttributeController &controller )
+{
+  QHash<QString, QUuid> ids;
+  const TabItem *tabItem = controller.tabItem( 0 );
+  const QVector<QUuid> formItems = tabItem->formItems();
+  for ( const QUuid &itemId : formItems )
+    ids.insert( controller.formItem( itemId )->name(), itemId );
+  return ids;
+}
+
+void TestAttributeController::dependentDefaultValues()
+{
+  std::unique_ptr<QgsVectorLayer> layer(
+    new QgsVectorLayer( QStringLiteral( "Point?field=a:integer&field=b:integer&field=total:integer&field=c:integer&field=random:integer" ),
+                        QStringLiteral( "layer" ),
+                        QStringLiteral( "memory" )
+                      )
+  );
+  QVERIFY( layer && layer->isValid() );
+
+  // "total" depends on "a" and "b", "random" only on "c"
+  layer->setDefaultValueDefinition( 2, QgsDefaultValue( QStringLiteral( "\"a\" + \"b\"" ), true ) );
+  layer->setDefaultValueDefinition( 4, QgsDefaultValue( QStringLiteral( "coalesce(\"c\", 0) + rand(1, 1000000000)" ), true ) );
+
+  QgsFeature feature( layer->fields() );
+  feature.setAttribute( QStringLiteral( "a" ), 1 );
+  feature.setAttribute( QStringLiteral( "b" ), 2 );
+  feature.setAttribute( QStringLiteral( "c" ), 3 );
+
+  AttributeController controller;
+  controller.setFeatureLayerPair( FeatureLayerPair( feature, layer.get() ) );
+  QHash<QString, QUuid> ids = formItemIdsByName( controller );
+
+  // all default values are evaluated for a new feature
+  QCOMPARE( controller.formValue( 2 ), 3 );
+  QVariant random = controller.formValue( 4 );
+  QVERIFY( !random.isNull() );
+
+  // only default values depending on the changed field are evaluated again
+  QVERIFY( controller.setFormValue( ids.value( QStringLiteral( "a" ) ), 10 ) );
+  QCOMPARE( controller.formValue( 2 ), 12 );
+  QCOMPARE( controller.formValue( 4 ), random );
+
+  QVERIFY( controller.setFormValue( ids.value( QStringLiteral( "c" ) ), 5 ) );
+  QCOMPARE( controller.formValue( 2 ), 12 );
+  QVERIFY( controller.formValue( 4 ) != random );
+}
+
+void TestAttributeController::benchmarkFormValueChange()
+{
+  // a big form where each field has a default value and a constraint, but only one of them depends on the edited field
+  const int FIELDS_COUNT = 80;
+  QString uri = QStringLiteral( "Point" );
+  for ( int i = 0; i < FIELDS_COUNT; ++i )
+    uri += QStringLiteral( "%1field=f%2:integer" ).arg( i == 0 ? "?" : "&" ).arg( i );
+
+  std::unique_ptr<QgsVectorLayer> layer( new QgsVectorLayer( uri, QStringLiteral( "layer" ), QStringLiteral( "memory" ) ) );
+  QVERIFY( layer && layer->isValid() );
+
+  layer->setDefaultValueDefinition( 1, QgsDefaultValue( QStringLiteral( "\"f0\" * 2" ), true ) );
+  for ( int i = 2; i < FIELDS_COUNT; ++i )
+  {
+    layer->setDefaultValueDefinition( i, QgsDefaultValue( QStringLiteral( "coalesce(\"f%1\", 0) + 1" ).arg( i - 1 ), true ) );
+    layer->setConstraintExpression( i, QStringLiteral( "\"f%1\" >= 0" ).arg( i ) );
+  }
+
+  QgsFeature feature( layer->fields() );
+  feature.setAttribute( 0, 0 );
+
+  AttributeController controller;
+  controller.setFeatureLayerPair( FeatureLayerPair( feature, layer.get() ) );
+  QUuid editedItemId = formItemIdsByName( controller ).value( QStringLiteral( "f0" ) );
+
+  int value = 0;
+  QBENCHMARK
+  {
+    QVERIFY( controller.setFormValue( editedItemId, ++value ) );
+  }
+  QCOMPARE( controller.formValue( 1 ), value * 2 );
+  QVERIFY( controller.constraintsHardValid() );
+}
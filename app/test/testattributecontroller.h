@@ -24,6 +24,8 @@ class TestAttributeController: public QObject
     void twoTabsDragAndDropLayout();
     void twoGroupsDragAndDropLayout();
     void tabsAndFieldsMixed();
+    void dependentDefaultValues();
+    void benchmarkFormValueChange();
 };
 
 #endif // TESTATTRIBUTECONTROLLER_H
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "testdigitizingcontroller.h"
+
+#include <memory>
+
+#include "qgslinestring.h"
+#include "qgsvectorlayer.h"
+#include "qgsquickmapsettings.h"
+
+#include "digitizingcontroller.h"
+#include "positionkit.h"
+#include "testutils.h"
+
+//! Prepares controller recording a line in stream mode from simulated positions
+static void setupStreamRecording( DigitizingController &controller, PositionKit &positionKit, QgsQuickMapSettings &mapSettings, QgsVectorLayer *layer )
+{
+  mapSettings.setDestinationCrs( QgsCoordinateReferenceSystem( QStringLiteral( "EPSG:3857" ) ) );
+  positionKit.setMapSettings( &mapSettings );
+  positionKit.useSimulatedLocation( 17.1, 48.1, 0.01 );
+  positionKit.source()->stopUpdates(); // positions are requested by the test
+
+  controller.setPositionKit( &positionKit );
+  controller.setProperty( "mapSettings", QVariant::fromValue( &mapSettings ) );
+  controller.setLayer( layer );
+  controller.setManualRecording( false );
+  controller.setLineRecordingInterval( 0 ); // every position is a new point
+  controller.startRecording();
+}
+
+void TestDigitizingController::testStreamRecording()
+{
+  std::unique_ptr<QgsVectorLayer> layer( new QgsVectorLayer( QStringLiteral( "LineStringZ?crs=epsg:3857" ), QStringLiteral( "track" ), QStringLiteral( "memory" ) ) );
+  QVERIFY( layer->isValid() );
+
+  QgsQuickMapSettings mapSettings;
+  PositionKit positionKit;
+  DigitizingController controller;
+  setupStreamRecording( controller, positionKit, mapSettings, layer.get() );
+
+  QSignalSpy spyPair( &controller, &DigitizingController::layerChanged );
+  QSignalSpy spyAdded( &controller, &DigitizingController::recordedPointAdded );
+  QSignalSpy spyMoved( &controller, &DigitizingController::lastRecordedPointMoved );
+
+  for ( int i = 0; i < 10; ++i )
+    positionKit.source()->requestUpdate();
+
+  // the whole geometry is only passed until the highlight shows a line, then just the new points
+  QCOMPARE( spyPair.count(), 2 );
+  QCOMPARE( spyAdded.count(), 8 );
+
+  QgsPoint lastPoint = spyAdded.last().at( 0 ).value<QgsPoint>();
+  QgsPoint projectedPosition = positionKit.projectedPosition();
+  COMPARENEAR( lastPoint.x(), projectedPosition.x(), 1e-3 );
+  COMPARENEAR( lastPoint.y(), projectedPosition.y(), 1e-3 );
+
+  // within the interval, the last point follows the position
+  controller.setLineRecordingInterval( 3600 );
+  positionKit.source()->requestUpdate();
+  QCOMPARE( spyAdded.count(), 8 );
+  QCOMPARE( spyMoved.count(), 1 );
+
+  FeatureLayerPair pair = controller.lineOrPolygonFeature();
+  QVERIFY( controller.isPairValid( pair ) );
+  const QgsLineString *line = qgsgeometry_cast<const QgsLineString *>( pair.feature().geometry().constGet() );
+  QVERIFY( line );
+  QCOMPARE( line->numPoints(), 10 );
+  QVERIFY( line->is3D() );
+  COMPARENEAR( line->xAt( 9 ), positionKit.projectedPosition().x(), 1e-3 );
+
+  // recorded points are not shared with the created feature
+  controller.removeLastPoint();
+  QCOMPARE( line->numPoints(), 10 );
+  QCOMPARE( qgsgeometry_cast<const QgsLineString *>( controller.lineOrPolygonFeature().feature().geometry().constGet() )->numPoints(), 9 );
+}
+
+void TestDigitizingController::benchmarkStreamRecording()
+{
+  const int fixesCount = 20000;
+
+  std::unique_ptr<QgsVectorLayer> layer( new QgsVectorLayer( QStringLiteral( "LineStringZ?crs=epsg:3857" ), QStringLiteral( "track" ), QStringLiteral( "memory" ) ) );
+  QVERIFY( layer->isValid() );
+
+  QgsQuickMapSettings mapSettings;
+  PositionKit positionKit;
+  DigitizingController controller;
+  setupStreamRecording( controller, positionKit, mapSettings, layer.get() );
+
+  QSignalSpy spyAdded( &controller, &DigitizingController::recordedPointAdded );
+
+  QBENCHMARK_ONCE
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qint64 firstFixesMs = 0;
+    for ( int i = 0; i < fixesCount; ++i )
+    {
+      positionKit.source()->requestUpdate();
+      if ( i == 999 )
+        firstFixesMs = timer.elapsed();
+    }
+    qDebug() << "first 1000 fixes recorded in" << firstFixesMs << "ms, all" << fixesCount << "fixes in" << timer.elapsed() << "ms";
+  }
+
+  QCOMPARE( spyAdded.count(), fixesCount - 2 );
+
+  FeatureLayerPair pair = controller.lineOrPolygonFeature();
+  QCOMPARE( pair.feature().geometry().constGet()->nCoordinates(), fixesCount );
+}
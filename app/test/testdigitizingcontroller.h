@@ -0,0 +1,26 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QObject>
+#include <QtTest>
+
+#ifndef TESTDIGITIZINGCONTROLLER_H
+#define TESTDIGITIZINGCONTROLLER_H
+
+class TestDigitizingController: public QObject
+{
+    Q_OBJECT
+  private slots:
+    void init() {} // will be called before each testfunction is executed.
+    void cleanup() {} // will be called after every testfunction.
+
+    void testStreamRecording(); // positions are appended to the track and reported as changes
+    void benchmarkStreamRecording(); // records a long track from simulated positions
+};
+
+#endif // TESTDIGITIZINGCONTROLLER_H
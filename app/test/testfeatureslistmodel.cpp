@@ -0,0 +1,208 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "testfeatureslistmodel.h"
+
+#include <memory>
+
+#include "qgsvectorfilewriter.h"
+#include "qgsvectorlayer.h"
+
+#include "featureslistmodel.h"
+#include "testutils.h"
+
+static const int FEATURES_COUNT = 1000;
+
+//! Creates memory layer with point features having key = 10 * i and name "feature i"
+static QgsVectorLayer *createLayer()
+{
+  QgsVectorLayer *layer = new QgsVectorLayer( QStringLiteral( "Point?field=key:integer&field=name:string" ),
+      QStringLiteral( "layer" ),
+      QStringLiteral( "memory" ) );
+
+  QgsFeatureList features;
+  for ( int i = 0; i < FEATURES_COUNT; ++i )
+  {
+    QgsFeature f( layer->fields() );
+    f.setAttribute( QStringLiteral( "key" ), i * 10 );
+    f.setAttribute( QStringLiteral( "name" ), QStringLiteral( "feature %1" ).arg( i ) );
+    f.setGeometry( QgsGeometry( new QgsPoint( i, i ) ) );
+    features << f;
+  }
+  layer->dataProvider()->addFeatures( features );
+  layer->setDisplayExpression( QStringLiteral( "\"name\"" ) );
+  return layer;
+}
+
+//! Returns how many of numbers 0 .. count - 1 contain \a digits - search for "feature <digits>" matches features with these numbers
+static int numbersContaining( int count, const QString &digits )
+{
+  int found = 0;
+  for ( int i = 0; i < count; ++i )
+  {
+    if ( QString::number( i ).contains( digits ) )
+      ++found;
+  }
+  return found;
+}
+
+void TestFeaturesListModel::testPaging()
+{
+  std::unique_ptr<QgsVectorLayer> layer( createLayer() );
+  QVERIFY( layer->isValid() );
+
+  FeaturesListModel model;
+  model.populateFromLayer( layer.get() );
+
+  QCOMPARE( model.featuresCount(), FEATURES_COUNT );
+  int firstPage = model.rowCount();
+  QVERIFY( firstPage > 0 && firstPage < FEATURES_COUNT );
+  QVERIFY( model.canFetchMore( QModelIndex() ) );
+
+  QSignalSpy spyInserted( &model, &QAbstractItemModel::rowsInserted );
+  model.fetchMore( QModelIndex() );
+  QCOMPARE( spyInserted.count(), 1 );
+  QVERIFY( model.rowCount() > firstPage );
+
+  while ( model.canFetchMore( QModelIndex() ) )
+    model.fetchMore( QModelIndex() );
+  QCOMPARE( model.rowCount(), FEATURES_COUNT );
+
+  // the list does not need geometries, but features provided for forms/highlights are complete
+  QModelIndex lastIndex = model.index( FEATURES_COUNT - 1, 0 );
+  FeatureLayerPair pair = model.data( lastIndex, FeaturesListModel::FeaturePair ).value<FeatureLayerPair>();
+  QVERIFY( pair.feature().hasGeometry() );
+  QCOMPARE( pair.feature().attribute( QStringLiteral( "name" ) ).toString(), model.data( lastIndex, FeaturesListModel::FeatureTitle ).toString() );
+
+  // a new search replaces the previous query
+  model.setSearchExpression( QStringLiteral( "feature 123" ) );
+  QVERIFY( model.isSearching() );
+  QTRY_VERIFY( !model.isSearching() );
+  QCOMPARE( model.rowCount(), 1 );
+  QVERIFY( !model.canFetchMore( QModelIndex() ) );
+  QCOMPARE( model.data( model.index( 0, 0 ), FeaturesListModel::FeatureTitle ).toString(), QStringLiteral( "feature 123" ) );
+}
+
+void TestFeaturesListModel::testLookups()
+{
+  std::unique_ptr<QgsVectorLayer> layer( createLayer() );
+  QVERIFY( layer->isValid() );
+
+  FeaturesListModel model;
+  model.populateFromLayer( layer.get() );
+  model.setKeyField( QStringLiteral( "key" ) );
+  int firstPage = model.rowCount();
+
+  // the last feature has not been loaded yet
+  int row = model.rowFromAttribute( FeaturesListModel::KeyColumn, ( FEATURES_COUNT - 1 ) * 10 );
+  QVERIFY( row >= firstPage );
+  QCOMPARE( model.data( model.index( row, 0 ), FeaturesListModel::KeyColumn ).toInt(), ( FEATURES_COUNT - 1 ) * 10 );
+
+  QVariant fid = model.data( model.index( row, 0 ), FeaturesListModel::FeatureId );
+  QCOMPARE( model.rowFromAttribute( FeaturesListModel::FeatureId, fid ), row );
+  QCOMPARE( model.attributeFromValue( FeaturesListModel::KeyColumn, QStringLiteral( " 20 " ), FeaturesListModel::FeatureTitle ).toString(), QStringLiteral( "feature 2" ) );
+  QVERIFY( model.featureLayerPair( fid.toInt() ).feature().hasGeometry() );
+
+  QCOMPARE( model.rowFromAttribute( FeaturesListModel::KeyColumn, 5 ), -1 );
+  QVERIFY( !model.canFetchMore( QModelIndex() ) );
+  QVERIFY( !model.attributeFromValue( FeaturesListModel::FeatureId, -100, FeaturesListModel::FeatureTitle ).isValid() );
+}
+
+void TestFeaturesListModel::testSearch()
+{
+  std::unique_ptr<QgsVectorLayer> layer( createLayer() );
+  QVERIFY( layer->isValid() );
+
+  FeaturesListModel model;
+  model.populateFromLayer( layer.get() );
+
+  // only the last expression is searched for
+  model.setSearchExpression( QStringLiteral( "feature 1" ) );
+  model.setSearchExpression( QStringLiteral( "feature 12" ) );
+  model.setSearchExpression( QStringLiteral( "FEATURE 99" ) );
+  QVERIFY( model.isSearching() );
+  QTRY_VERIFY( !model.isSearching() );
+
+  // words are searched anywhere in the name (or the key) - "feature 99", "feature 199" ... "feature 999" and "feature 990" - "feature 998"
+  QCOMPARE( model.rowCount(), numbersContaining( FEATURES_COUNT, QStringLiteral( "99" ) ) );
+  QCOMPARE( model.rowCount(), 19 );
+  for ( int i = 0; i < model.rowCount(); ++i )
+  {
+    QString title = model.data( model.index( i, 0 ), FeaturesListModel::FeatureTitle ).toString();
+    QVERIFY( title.startsWith( QStringLiteral( "feature " ) ) && title.contains( QStringLiteral( "99" ) ) );
+    QCOMPARE( model.data( model.index( i, 0 ), FeaturesListModel::FoundPair ).toString(), QStringLiteral( "name: " ) + title );
+  }
+
+  // results of a search that is superseded while running are dropped
+  model.reloadFeatures();
+  QVERIFY( model.isSearching() );
+  model.setSearchExpression( QStringLiteral( "feature 5" ) );
+  QTRY_VERIFY( !model.isSearching() );
+  QCOMPARE( model.rowCount(), numbersContaining( FEATURES_COUNT, QStringLiteral( "5" ) ) );
+
+  // clearing the search goes back to the paged list
+  model.setSearchExpression( QString() );
+  QVERIFY( !model.isSearching() );
+  QVERIFY( model.canFetchMore( QModelIndex() ) );
+  QVERIFY( model.data( model.index( 0, 0 ), FeaturesListModel::FoundPair ).toString().isEmpty() );
+}
+
+void TestFeaturesListModel::benchmarkSearch()
+{
+  const int featuresCount = 200000;
+  QTemporaryDir dir;
+  const QString path = dir.filePath( QStringLiteral( "search.gpkg" ) );
+
+  QgsFields fields;
+  fields.append( QgsField( QStringLiteral( "key" ), QVariant::Int ) );
+  fields.append( QgsField( QStringLiteral( "name" ), QVariant::String ) );
+  fields.append( QgsField( QStringLiteral( "note" ), QVariant::String ) );
+
+  QgsVectorFileWriter::SaveVectorOptions options;
+  options.driverName = QStringLiteral( "GPKG" );
+  options.layerName = QStringLiteral( "search" );
+  {
+    std::unique_ptr< QgsVectorFileWriter > writer( QgsVectorFileWriter::create( path, fields, QgsWkbTypes::Point, QgsCoordinateReferenceSystem( QStringLiteral( "EPSG:4326" ) ), QgsCoordinateTransformContext(), options ) );
+    QCOMPARE( writer->hasError(), QgsVectorFileWriter::NoError );
+    for ( int i = 0; i < featuresCount; ++i )
+    {
+      QgsFeature f( fields );
+      f.setAttribute( 0, i );
+      f.setAttribute( 1, QStringLiteral( "feature %1" ).arg( i ) );
+      f.setAttribute( 2, QStringLiteral( "note about %1" ).arg( i % 1000 ) );
+      f.setGeometry( QgsGeometry( new QgsPoint( i % 360 - 180, i % 180 - 90 ) ) );
+      writer->addFeature( f );
+    }
+  }
+
+  QgsVectorLayer layer( path + QStringLiteral( "|layername=search" ), QStringLiteral( "search" ), QStringLiteral( "ogr" ) );
+  QVERIFY( layer.isValid() );
+  layer.setDisplayExpression( QStringLiteral( "\"name\"" ) );
+
+  FeaturesListModel model;
+  model.populateFromLayer( &layer );
+  model.setSearchExpression( QStringLiteral( "about 123" ) );
+  QTRY_VERIFY_WITH_TIMEOUT( !model.isSearching(), 60000 );
+  // "about" is in every note, "123" in the key and the name of features with the number containing it (the note is implied)
+  QCOMPARE( model.rowCount(), numbersContaining( featuresCount, QStringLiteral( "123" ) ) );
+
+  QBENCHMARK
+  {
+    // the GUI thread is only blocked while the search is started, results stream in later
+    QElapsedTimer timer;
+    timer.start();
+    model.reloadFeatures();
+    qint64 startMs = timer.elapsed();
+
+    QTRY_VERIFY_WITH_TIMEOUT( model.rowCount() > 0, 60000 );
+    qint64 firstResultsMs = timer.elapsed();
+
+    QTRY_VERIFY_WITH_TIMEOUT( !model.isSearching(), 60000 );
+    qDebug() << "search started in" << startMs << "ms, first results after" << firstResultsMs << "ms, finished after" << timer.elapsed() << "ms";
+  }
+}
@@ -0,0 +1,28 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QObject>
+#include <QtTest>
+
+#ifndef TESTFEATURESLISTMODEL_H
+#define TESTFEATURESLISTMODEL_H
+
+class TestFeaturesListModel: public QObject
+{
+    Q_OBJECT
+  private slots:
+    void init() {} // will be called before each testfunction is executed.
+    void cleanup() {} // will be called after every testfunction.
+
+    void testPaging(); // features are loaded by pages as the view asks for them
+    void testLookups(); // lookups by id and key load further pages if needed
+    void testSearch(); // search runs in the background and only results of the latest search are kept
+    void benchmarkSearch(); // search in a large GeoPackage layer
+};
+
+#endif // TESTFEATURESLISTMODEL_H
@@ -0,0 +1,321 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "testingmerginserver.h"
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include "transfercompression.h"
+
+//! Returns URL of the request target - a path that may start with "//" (API root with trailing slash + "/v1/...")
+static QUrl targetUrl( const QByteArray &target )
+{
+  return QUrl( QStringLiteral( "http://localhost" ) + QString::fromUtf8( target ) );
+}
+
+//! Returns checksum of the data like the real server computes it
+static QString checksum( const QByteArray &data )
+{
+  return QString::fromLatin1( QCryptographicHash::hash( data, QCryptographicHash::Sha1 ).toHex() );
+}
+
+TestingMerginServer::TestingMerginServer( QObject *parent )
+  : QTcpServer( parent )
+{
+  connect( this, &QTcpServer::newConnection, this, &TestingMerginServer::onNewConnection );
+}
+
+bool TestingMerginServer::start()
+{
+  return listen( QHostAddress::LocalHost );
+}
+
+QString TestingMerginServer::apiRoot() const
+{
+  return QStringLiteral( "http://127.0.0.1:%1/" ).arg( serverPort() );
+}
+
+void TestingMerginServer::onNewConnection()
+{
+  while ( QTcpSocket *socket = nextPendingConnection() )
+  {
+    connect( socket, &QTcpSocket::readyRead, this, &TestingMerginServer::onReadyRead );
+    connect( socket, &QTcpSocket::disconnected, this, [this, socket]()
+    {
+      mBuffers.remove( socket );
+      socket->deleteLater();
+    } );
+  }
+}
+
+void TestingMerginServer::onReadyRead()
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>( sender() );
+  Q_ASSERT( socket );
+
+  QByteArray &buffer = mBuffers[socket];
+  buffer.append( socket->readAll() );
+
+  Request request;
+  while ( takeRequest( buffer, request ) )
+    handleRequest( socket, request );
+}
+
+bool TestingMerginServer::takeRequest( QByteArray &buffer, Request &request )
+{
+  int headerEnd = buffer.indexOf( "\r\n\r\n" );
+  if ( headerEnd < 0 )
+    return false;
+
+  QList<QByteArray> lines = buffer.left( headerEnd ).split( '\n' );
+  QList<QByteArray> requestLine = lines.takeFirst().trimmed().split( ' ' );
+  if ( requestLine.count() < 2 )
+    return false;
+
+  request = Request();
+  request.method = requestLine.at( 0 );
+  request.target = requestLine.at( 1 );
+  for ( const QByteArray &line : qAsConst( lines ) )
+  {
+    int colon = line.indexOf( ':' );
+    if ( colon > 0 )
+      request.headers.insert( line.left( colon ).trimmed().toLower(), line.mid( colon + 1 ).trimmed() );
+  }
+
+  int bodySize = request.headers.value( "content-length" ).toInt();
+  if ( buffer.size() < headerEnd + 4 + bodySize )
+    return false;  // wait for the rest of the body
+
+  request.body = buffer.mid( headerEnd + 4, bodySize );
+  buffer.remove( 0, headerEnd + 4 + bodySize );
+  return true;
+}
+
+void TestingMerginServer::handleRequest( QTcpSocket *socket, const Request &request )
+{
+  mBytesReceived += request.body.size();
+
+  QString path = targetUrl( request.target ).path();
+  if ( request.method == "GET" && path.contains( QStringLiteral( "/v1/project/raw/" ) ) )
+    handleRaw( socket, request );
+  else if ( request.method == "GET" && path.contains( QStringLiteral( "/v1/project/" ) ) )
+    sendResponse( socket, 200, projectMetadata( path.section( '/', -2 ) ) );
+  else if ( request.method == "POST" && path.contains( QStringLiteral( "/v1/project/push/chunk/" ) ) )
+    handleChunk( socket, request );
+  else if ( request.method == "POST" && path.contains( QStringLiteral( "/v1/project/push/finish/" ) ) )
+    handleFinish( socket, request );
+  else if ( request.method == "POST" && path.contains( QStringLiteral( "/v1/project/push/cancel/" ) ) )
+  {
+    mTransactions.remove( path.section( '/', -1 ) );
+    sendResponse( socket, 200, QByteArray( "{}" ) );
+  }
+  else if ( request.method == "POST" && path.contains( QStringLiteral( "/v1/project/push/" ) ) )
+    handlePush( socket, request );
+  else
+    sendResponse( socket, 404, QByteArray( "{\"detail\": \"Not found\"}" ) );
+}
+
+void TestingMerginServer::handleRaw( QTcpSocket *socket, const Request &request )
+{
+  QUrlQuery query( targetUrl( request.target ) );
+  QString filePath = QUrl::fromPercentEncoding( query.queryItemValue( QStringLiteral( "file" ), QUrl::FullyDecoded ).toUtf8() );
+  if ( !mFiles.contains( filePath ) )
+  {
+    sendResponse( socket, 404, QByteArray( "{\"detail\": \"File not found\"}" ) );
+    return;
+  }
+
+  QByteArray body = mFiles.value( filePath );
+  int status = 200;
+  QList< QPair<QByteArray, QByteArray> > headers;
+
+  QByteArray range = request.headers.value( "range" );
+  if ( range.startsWith( "bytes=" ) )
+  {
+    QList<QByteArray> bounds = range.mid( 6 ).split( '-' );
+    int from = bounds.value( 0 ).toInt();
+    int to = bounds.value( 1 ).toInt();
+    headers << qMakePair( QByteArray( "Content-Range" ), QStringLiteral( "bytes %1-%2/%3" ).arg( from ).arg( to ).arg( body.size() ).toUtf8() );
+    body = body.mid( from, to - from + 1 );
+    status = 206;
+  }
+
+  if ( mCompressionSupported && request.headers.value( "accept-encoding" ).contains( "deflate" ) )
+  {
+    body = TransferCompression::deflate( body );
+    headers << qMakePair( QByteArray( "Content-Encoding" ), QByteArray( "deflate" ) );
+    ++mCompressedCount;
+  }
+
+  sendResponse( socket, status, body, headers );
+}
+
+void TestingMerginServer::handlePush( QTcpSocket *socket, const Request &request )
+{
+  QJsonObject push = QJsonDocument::fromJson( request.body ).object();
+  if ( push.value( QStringLiteral( "version" ) ).toString() != QStringLiteral( "v%1" ).arg( mVersion ) )
+  {
+    sendResponse( socket, 409, QByteArray( "{\"detail\": \"There is a newer version of the project\"}" ) );
+    return;
+  }
+
+  QString projectFullName = targetUrl( request.target ).path().section( '/', -2 );
+  QJsonObject changes = push.value( QStringLiteral( "changes" ) ).toObject();
+  if ( changes.value( QStringLiteral( "added" ) ).toArray().isEmpty() && changes.value( QStringLiteral( "updated" ) ).toArray().isEmpty() )
+  {
+    // nothing to upload
+    createVersion( changes );
+    sendResponse( socket, 200, projectMetadata( projectFullName ) );
+    return;
+  }
+
+  PushTransaction transaction;
+  transaction.projectFullName = projectFullName;
+  transaction.changes = changes;
+  QString transactionId = QStringLiteral( "transaction-%1" ).arg( ++mTransactionsCount );
+  mTransactions.insert( transactionId, transaction );
+
+  QJsonObject response;
+  response.insert( QStringLiteral( "transaction" ), transactionId );
+  sendResponse( socket, 200, QJsonDocument( response ).toJson( QJsonDocument::Compact ) );
+}
+
+void TestingMerginServer::handleChunk( QTcpSocket *socket, const Request &request )
+{
+  QByteArray data = request.body;
+  if ( request.headers.value( "content-encoding" ) == "deflate" )
+  {
+    if ( !mCompressionSupported )
+    {
+      sendResponse( socket, 415, QByteArray( "{\"detail\": \"Unsupported content encoding\"}" ) );
+      return;
+    }
+
+    data = TransferCompression::inflate( data );
+    if ( data.isNull() )
+    {
+      sendResponse( socket, 400, QByteArray( "{\"detail\": \"Corrupted chunk\"}" ) );
+      return;
+    }
+    ++mCompressedCount;
+  }
+
+  QString chunkId = targetUrl( request.target ).path().section( '/', -1 );
+  mChunks.insert( chunkId, data );
+
+  QJsonObject response;
+  response.insert( QStringLiteral( "checksum" ), checksum( data ) );
+  response.insert( QStringLiteral( "size" ), data.size() );
+  sendResponse( socket, 200, QJsonDocument( response ).toJson( QJsonDocument::Compact ) );
+}
+
+void TestingMerginServer::handleFinish( QTcpSocket *socket, const Request &request )
+{
+  QString transactionId = targetUrl( request.target ).path().section( '/', -1 );
+  if ( !mTransactions.contains( transactionId ) )
+  {
+    sendResponse( socket, 404, QByteArray( "{\"detail\": \"Transaction not found\"}" ) );
+    return;
+  }
+  const PushTransaction transaction = mTransactions.take( transactionId );
+
+  // all pushed files need to be complete before any of them gets to the new version
+  QHash<QString, QByteArray> files;
+  QHash<QString, QStringList> fileChunks;
+  for ( const QString &key : { QStringLiteral( "added" ), QStringLiteral( "updated" ) } )
+  {
+    const QJsonArray pushedFiles = transaction.changes.value( key ).toArray();
+    for ( const QJsonValue &value : pushedFiles )
+    {
+      QJsonObject file = value.toObject();
+      QString filePath = file.value( QStringLiteral( "path" ) ).toString();
+      const QJsonArray chunks = file.value( QStringLiteral( "chunks" ) ).toArray();
+      QByteArray content;
+      QStringList chunkIds;
+      for ( const QJsonValue &chunk : chunks )
+      {
+        QString chunkId = chunk.toString();
+        if ( !mChunks.contains( chunkId ) )
+        {
+          sendResponse( socket, 422, QByteArray( "{\"detail\": \"Missing chunk\"}" ) );
+          return;
+        }
+        content += mChunks.value( chunkId );
+        chunkIds << chunkId;
+      }
+
+      if ( checksum( content ) != file.value( QStringLiteral( "checksum" ) ).toString() )
+      {
+        sendResponse( socket, 422, QByteArray( "{\"detail\": \"Checksum does not match\"}" ) );
+        return;
+      }
+      files.insert( filePath, content );
+      fileChunks.insert( filePath, chunkIds );
+    }
+  }
+
+  for ( auto it = files.constBegin(); it != files.constEnd(); ++it )
+  {
+    mFiles.insert( it.key(), it.value() );
+    mFileChunks.insert( it.key(), fileChunks.value( it.key() ) );
+  }
+  createVersion( transaction.changes );
+  sendResponse( socket, 200, projectMetadata( transaction.projectFullName ) );
+}
+
+void TestingMerginServer::createVersion( const QJsonObject &changes )
+{
+  const QJsonArray removedFiles = changes.value( QStringLiteral( "removed" ) ).toArray();
+  for ( const QJsonValue &value : removedFiles )
+  {
+    QString filePath = value.toObject().value( QStringLiteral( "path" ) ).toString();
+    mFiles.remove( filePath );
+    mFileChunks.remove( filePath );
+  }
+  ++mVersion;
+}
+
+QByteArray TestingMerginServer::projectMetadata( const QString &projectFullName ) const
+{
+  QJsonArray files;
+  for ( auto it = mFiles.constBegin(); it != mFiles.constEnd(); ++it )
+  {
+    QJsonObject file;
+    file.insert( QStringLiteral( "path" ), it.key() );
+    file.insert( QStringLiteral( "checksum" ), checksum( it.value() ) );
+    file.insert( QStringLiteral( "size" ), it.value().size() );
+    files.append( file );
+  }
+
+  QJsonObject project;
+  project.insert( QStringLiteral( "namespace" ), projectFullName.section( '/', 0, 0 ) );
+  project.insert( QStringLiteral( "name" ), projectFullName.section( '/', 1 ) );
+  project.insert( QStringLiteral( "version" ), QStringLiteral( "v%1" ).arg( mVersion ) );
+  project.insert( QStringLiteral( "files" ), files );
+  return QJsonDocument( project ).toJson( QJsonDocument::Compact );
+}
+
+void TestingMerginServer::sendResponse( QTcpSocket *socket, int status, const QByteArray &body, const QList< QPair<QByteArray, QByteArray> > &headers )
+{
+  QByteArray response = QStringLiteral( "HTTP/1.1 %1 %2\r\n" ).arg( status ).arg( status < 300 ? "OK" : "Error" ).toUtf8();
+  response += "Content-Length: " + QByteArray::number( body.size() ) + "\r\n";
+  for ( const auto &header : headers )
+    response += header.first + ": " + header.second + "\r\n";
+  response += "\r\n";
+  response += body;
+
+  mBytesSent += body.size();
+  socket->write( response );
+}
@@ -0,0 +1,125 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TESTINGMERGINSERVER_H
+#define TESTINGMERGINSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+/**
+ * Local stand-in for the sync endpoints of Mergin server, so that pulls and pushes can be tested
+ * without the real server. It keeps a single project (of any namespace and name):
+ *
+ * - GET /v1/project/<namespace>/<name> replies with metadata of the latest version of the project (without history)
+ * - GET /v1/project/raw/<namespace>/<name>?file=<path> serves the latest content of the file (with Range support),
+ *   compressed with "deflate" content coding when the client accepts it and compression is supported
+ * - POST /v1/project/push/<namespace>/<name> starts a push transaction - unless it only removes files,
+ *   then the new version is created at once
+ * - POST /v1/project/push/chunk/<transaction>/<chunk id> stores the (inflated) chunk and replies with its size
+ *   and checksum like the real server
+ * - POST /v1/project/push/finish/<transaction> assembles the pushed files from their chunks, creates a new version
+ *   and replies with its metadata
+ *
+ * Pushes of diffs are not supported. Requests to other endpoints get 404.
+ */
+class TestingMerginServer: public QTcpServer
+{
+    Q_OBJECT
+  public:
+    explicit TestingMerginServer( QObject *parent = nullptr );
+
+    //! Starts listening on a free port of the local host
+    bool start();
+
+    //! Returns API root to be used by MerginApi (with trailing slash)
+    QString apiRoot() const;
+
+    //! Sets whether responses get compressed and compressed requests accepted
+    void setCompressionSupported( bool supported ) { mCompressionSupported = supported; }
+
+    //! Sets content of the file (path within the project) in the latest version of the project
+    void setFile( const QString &filePath, const QByteArray &content ) { mFiles.insert( filePath, content ); }
+
+    //! Returns content of the file (path within the project) in the latest version of the project
+    QByteArray file( const QString &filePath ) const { return mFiles.value( filePath ); }
+
+    //! Returns IDs of chunks the file (path within the project) has been pushed in, empty if it has not been pushed
+    QStringList fileChunks( const QString &filePath ) const { return mFileChunks.value( filePath ); }
+
+    //! Returns the latest version of the project, zero until the first push
+    int version() const { return mVersion; }
+
+    //! Returns uploaded chunks (chunk ID -> uncompressed data)
+    QHash<QString, QByteArray> chunks() const { return mChunks; }
+
+    //! Returns number of bytes of bodies received in requests (as sent over the network)
+    qint64 bytesReceived() const { return mBytesReceived; }
+    //! Returns number of bytes of bodies sent in responses (as sent over the network)
+    qint64 bytesSent() const { return mBytesSent; }
+    //! Returns number of requests and responses with compressed body
+    int compressedCount() const { return mCompressedCount; }
+
+  private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+  private:
+    struct Request
+    {
+      QByteArray method;
+      QByteArray target;
+      QHash<QByteArray, QByteArray> headers;  //!< lower case names
+      QByteArray body;
+    };
+
+    struct PushTransaction
+    {
+      QString projectFullName;
+      QJsonObject changes;  //!< as sent in the push request
+    };
+
+    //! Takes one complete request from the buffer, returns false if there is none yet
+    static bool takeRequest( QByteArray &buffer, Request &request );
+
+    void handleRequest( QTcpSocket *socket, const Request &request );
+    void handleRaw( QTcpSocket *socket, const Request &request );
+    void handlePush( QTcpSocket *socket, const Request &request );
+    void handleChunk( QTcpSocket *socket, const Request &request );
+    void handleFinish( QTcpSocket *socket, const Request &request );
+
+    //! Removes files removed by the changes and creates a new version of the project
+    void createVersion( const QJsonObject &changes );
+
+    //! Returns metadata of the latest version of the project, like the project info endpoint of the real server
+    QByteArray projectMetadata( const QString &projectFullName ) const;
+
+    void sendResponse( QTcpSocket *socket, int status, const QByteArray &body,
+                       const QList< QPair<QByteArray, QByteArray> > &headers = QList< QPair<QByteArray, QByteArray> >() );
+
+    bool mCompressionSupported = true;
+    QHash<QString, QByteArray> mFiles;
+    QHash<QString, QStringList> mFileChunks;
+    QHash<QString, QByteArray> mChunks;
+    QHash<QString, PushTransaction> mTransactions;
+    int mTransactionsCount = 0;
+    int mVersion = 0;
+    QHash<QTcpSocket *, QByteArray> mBuffers;
+    qint64 mBytesReceived = 0;
+    qint64 mBytesSent = 0;
+    int mCompressedCount = 0;
+};
+
+#endif // TESTINGMERGINSERVER_H
@@ -1,5 +1,8 @@
 #include <QtTest/QtTest>
 #include <QtCore/QObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRandomGenerator>
 
 #define STR1(x)  #x
 #define STR(x)  STR1(x)
@@ -8,6 +11,16 @@
 #include "inpututils.h"
 #include "coreutils.h"
 #include "geodiffutils.h"
+#include "changesetsession.h"
+#include "checksumcache.h"
+#include "chunkindex.h"
+#include "contentchunker.h"
+#include "projectchangetracker.h"
+#include "projectmetadatastore.h"
+#include "syncjournal.h"
+#include "syncscheduler.h"
+#include "testingmerginserver.h"
+#include "transfercompression.h"
 #include "testutils.h"
 #include "merginuserauth.h"
 #include "merginuserinfo.h"
@@ -94,6 +107,12 @@ void TestMerginApi::initTestCase()
   deleteRemoteProject( mApiExtra, mUsername, "testCreateProjectTwice" );
   deleteRemoteProject( mApiExtra, mUsername, "testCreateDeleteProject" );
   deleteRemoteProject( mApiExtra, mUsername, "testMultiChunkUploadDownload" );
+  deleteRemoteProject( mApiExtra, mUsername, "testParallelChunkPull" );
+  deleteRemoteProject( mApiExtra, mUsername, "testParallelChunkPush" );
+  deleteRemoteProject( mApiExtra, mUsername, "testResumePull" );
+  deleteRemoteProject( mApiExtra, mUsername, "testResumePush" );
+  deleteRemoteProject( mApiExtra, mUsername, "testSyncQueue1" );
+  deleteRemoteProject( mApiExtra, mUsername, "testSyncQueue2" );
   deleteRemoteProject( mApiExtra, mUsername, "testEmptyFileUploadDownload" );
   deleteRemoteProject( mApiExtra, mUsername, "testUploadWithUpdate" );
   deleteRemoteProject( mApiExtra, mUsername, "testDiffUpload" );
@@ -113,8 +132,22 @@ void TestMerginApi::initTestCase()
   deleteRemoteProject( mApiExtra, mUsername, "testSelectiveSyncChangeSyncFolder" );
   deleteRemoteProject( mApiExtra, mUsername, "testSelectiveSyncDisabledInConfig" );
   deleteRemoteProject( mApiExtra, mUsername, "testSelectiveSyncCorruptedFormat" );
+  deleteRemoteProject( mApiExtra, mUsername, "testStreamingJsonParser" );
 
   deleteLocalDir( mApi, "testExcludeFromSync" );
+  deleteLocalDir( mApi, "testChecksumCache" );
+  deleteLocalDir( mApi, "testCompressedTransfer" );
+  deleteLocalDir( mApi, "testCompressedTransferPull" );
+  deleteLocalDir( mApi, "testChunkDedupPush" );
+  deleteLocalDir( mApi, "testContentChunker" );
+  deleteLocalDir( mApi, "testProjectChangeTracker" );
+  deleteLocalDir( mApi, "testChangesetSession" );
+  deleteLocalDir( mApi, "testProjectMetadataStore" );
+  deleteLocalDir( mApi, "testLargeFileTransfer" );
+  deleteLocalDir( mApi, "testLocalProjectsManagerReload" );
+  deleteLocalDir( mApi, "testProjectsModelMerge" );
+  deleteLocalDir( mApi, "testLocalProjectFilesParallel" );
+  deleteLocalDir( mApi, "testStreamingJsonParser" );
 }
 
 void TestMerginApi::cleanupTestCase()
@@ -172,12 +205,20 @@ void TestMerginApi::testDownloadProject()
 
   // try to download the project
   QSignalSpy spy( mApi, &MerginApi::syncProjectFinished );
+  // update tasks report progress from a worker thread - the context object makes it a queued connection
+  qreal finalizationProgress = -1;
+  QMetaObject::Connection progressConnection = connect( mApi, &MerginApi::syncProjectFinalizationProgress, this, [&finalizationProgress]( const QString &, qreal progress )
+  {
+    finalizationProgress = progress;
+  } );
   mApi->updateProject( projectNamespace, projectName );
   QCOMPARE( mApi->transactions().count(), 1 );
   QVERIFY( spy.wait( TestUtils::LONG_REPLY * 5 ) );
   QCOMPARE( spy.count(), 1 );
+  disconnect( progressConnection );
 
   QCOMPARE( mApi->transactions().count(), 0 );
+  QCOMPARE( finalizationProgress, 1. );
 
   // check that the local projects are updated
   QVERIFY( mApi->localProjectsManager().projectFromMerginName( mUsername, projectName ).isValid() );
@@ -551,6 +592,386 @@ void TestMerginApi::testMultiChunkUploadDownload()
   QCOMPARE( checksum, checksum2 );
 }
 
+void TestMerginApi::testParallelChunkPull()
+{
+  // a pull requests multiple items in parallel, but no more than the download window allows,
+  // and streams them to disk without buffering whole chunks in memory
+
+  QString projectName = "testParallelChunkPull";
+
+  createRemoteProject( mApiExtra, mUsername, projectName, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+
+  // another client adds a big file (21mb -> three chunks)
+  downloadRemoteProject( mApiExtra, mUsername, projectName );
+  QString bigFilePathExtra = mApiExtra->projectsPath() + "/" + projectName + "/big_file.dat";
+  QFile bigFile( bigFilePathExtra );
+  QVERIFY( bigFile.open( QIODevice::WriteOnly ) );
+  for ( int i = 0; i < 21; ++i )
+    bigFile.write( QByteArray( 1024 * 1024, static_cast<char>( 'A' + i ) ) );
+  bigFile.close();
+  QByteArray checksum = MerginApi::getChecksum( bigFilePathExtra );
+  uploadRemoteProject( mApiExtra, mUsername, projectName );
+
+  int downloadWindow = mApi->downloadWindow();
+  mApi->setDownloadWindow( 4 );
+  TestUtils::resetPeakMemoryUsage();
+  qint64 memoryBeforePull = TestUtils::memoryUsage();
+  QSignalSpy spyStarted( mApi, &MerginApi::pullFilesStarted );
+  QSignalSpy spyFinished( mApi, &MerginApi::syncProjectFinished );
+  mApi->updateProject( mUsername, projectName );
+  QVERIFY( spyStarted.wait( TestUtils::LONG_REPLY ) );
+
+  // three chunks of the big file + two small files, but no more than the window allows
+  TransactionStatus transaction = mApi->transactions().value( MerginApi::getFullProjectName( mUsername, projectName ) );
+  QCOMPARE( transaction.replyDownloadItems.count(), 4 );
+  QCOMPARE( transaction.downloadQueue.count(), 1 );
+
+  QVERIFY( spyFinished.wait( TestUtils::LONG_REPLY * 5 ) );
+  QVERIFY( spyFinished.takeFirst().at( 2 ).toBool() );
+  mApi->setDownloadWindow( downloadWindow );
+
+  // downloaded chunks are streamed to disk - the pull must not need memory for even one whole chunk (10 MB)
+  qint64 peakMemoryDuringPull = TestUtils::memoryUsage( true );
+  if ( memoryBeforePull >= 0 && peakMemoryDuringPull >= 0 )
+  {
+    qDebug() << "peak memory growth during pull:" << ( peakMemoryDuringPull - memoryBeforePull ) / 1024 << "kB";
+    QVERIFY( peakMemoryDuringPull - memoryBeforePull < MerginApi::UPLOAD_CHUNK_SIZE );
+  }
+
+  // chunks are assembled in order regardless of arrival order
+  QCOMPARE( MerginApi::getChecksum( mApi->projectsPath() + "/" + projectName + "/big_file.dat" ), checksum );
+}
+
+void TestMerginApi::testParallelChunkPush()
+{
+  // all chunks of a big file are sent in parallel when the upload window allows it
+
+  QString projectName = "testParallelChunkPush";
+
+  createRemoteProject( mApiExtra, mUsername, projectName, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+
+  downloadRemoteProject( mApi, mUsername, projectName );
+
+  // create a big file (21mb -> three chunks)
+  QString bigFilePath = mApi->projectsPath() + "/" + projectName + "/" + "big_file.dat";
+  QFile bigFile( bigFilePath );
+  QVERIFY( bigFile.open( QIODevice::WriteOnly ) );
+  for ( int i = 0; i < 21; ++i )
+    bigFile.write( QByteArray( 1024 * 1024, static_cast<char>( 'A' + i ) ) );
+  bigFile.close();
+  QByteArray checksum = MerginApi::getChecksum( bigFilePath );
+
+  int uploadWindow = mApi->uploadWindow();
+  mApi->setUploadWindow( 4 );
+  QSignalSpy spyPushStarted( mApi, &MerginApi::pushFilesStarted );
+  QSignalSpy spyPushFinished( mApi, &MerginApi::syncProjectFinished );
+  mApi->uploadProject( mUsername, projectName );
+  QVERIFY( spyPushStarted.wait( TestUtils::LONG_REPLY ) );
+
+  TransactionStatus pushTransaction = mApi->transactions().value( MerginApi::getFullProjectName( mUsername, projectName ) );
+  QCOMPARE( pushTransaction.replyUploadFiles.count(), 3 );
+  QVERIFY( pushTransaction.uploadChunkQueue.isEmpty() );
+
+  QVERIFY( spyPushFinished.wait( TestUtils::LONG_REPLY * 30 ) );
+  QVERIFY( spyPushFinished.takeFirst().at( 2 ).toBool() );
+  mApi->setUploadWindow( uploadWindow );
+
+  // the server got the whole file
+  deleteLocalProject( mApi, mUsername, projectName );
+  downloadRemoteProject( mApi, mUsername, projectName );
+  QCOMPARE( MerginApi::getChecksum( bigFilePath ), checksum );
+}
+
+void TestMerginApi::testResumePull()
+{
+  // a pull interrupted by a network failure continues with the items that have not been downloaded yet
+
+  QString projectName = "testResumePull";
+  QString projectFullName = MerginApi::getFullProjectName( mUsername, projectName );
+  QString projectDir = mApi->projectsPath() + "/" + projectName;
+
+  createRemoteProject( mApiExtra, mUsername, projectName, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+  downloadRemoteProject( mApi, mUsername, projectName );
+
+  // another client adds a big file (21mb -> three chunks)
+  downloadRemoteProject( mApiExtra, mUsername, projectName );
+  QString bigFilePathExtra = mApiExtra->projectsPath() + "/" + projectName + "/big_file.dat";
+  QFile bigFile( bigFilePathExtra );
+  QVERIFY( bigFile.open( QIODevice::WriteOnly ) );
+  for ( int i = 0; i < 21; ++i )
+    bigFile.write( QByteArray( 1024 * 1024, static_cast<char>( 'A' + i ) ) );
+  bigFile.close();
+  QByteArray checksum = MerginApi::getChecksum( bigFilePathExtra );
+  uploadRemoteProject( mApiExtra, mUsername, projectName );
+
+  // download one item at a time and drop the connection once the first one has arrived
+  int downloadWindow = mApi->downloadWindow();
+  mApi->setDownloadWindow( 1 );
+  QSignalSpy spyFinished( mApi, &MerginApi::syncProjectFinished );
+  mApi->updateProject( mUsername, projectName );
+  QTRY_VERIFY_WITH_TIMEOUT( SyncJournal::read( projectDir, SyncJournal::Pull ).entries().count() >= 1, TestUtils::LONG_REPLY * 5 );
+
+  TransactionStatus transaction = mApi->transactions().value( projectFullName );
+  QVERIFY( !transaction.replyDownloadItems.isEmpty() );
+  transaction.replyDownloadItems.first()->abort();
+  QCOMPARE( spyFinished.count(), 1 );
+  QVERIFY( !spyFinished.takeFirst().at( 2 ).toBool() );
+  QVERIFY( !QFileInfo::exists( projectDir + "/big_file.dat" ) );
+
+  SyncJournal journal = SyncJournal::read( projectDir, SyncJournal::Pull );
+  QVERIFY( journal.isValid() );
+  int downloadedItems = journal.entries().count();
+  QVERIFY( downloadedItems >= 1 && downloadedItems < 3 );
+
+  // the next pull only requests the rest
+  QSignalSpy spyStarted( mApi, &MerginApi::pullFilesStarted );
+  mApi->updateProject( mUsername, projectName );
+  QVERIFY( spyStarted.wait( TestUtils::LONG_REPLY ) );
+
+  transaction = mApi->transactions().value( projectFullName );
+  QCOMPARE( transaction.downloadQueue.count() + transaction.replyDownloadItems.count(), 3 - downloadedItems );
+  QVERIFY( transaction.transferedSize > 0 );
+
+  QVERIFY( spyFinished.wait( TestUtils::LONG_REPLY * 5 ) );
+  QVERIFY( spyFinished.takeFirst().at( 2 ).toBool() );
+  mApi->setDownloadWindow( downloadWindow );
+
+  QCOMPARE( MerginApi::getChecksum( projectDir + "/big_file.dat" ), checksum );
+  QVERIFY( !SyncJournal::read( projectDir, SyncJournal::Pull ).isValid() );
+}
+
+void TestMerginApi::testResumePush()
+{
+  // a push interrupted by a network failure continues within the same transaction
+  // and only uploads the chunks that have not been acknowledged by the server yet
+
+  QString projectName = "testResumePush";
+  QString projectFullName = MerginApi::getFullProjectName( mUsername, projectName );
+  QString projectDir = mApi->projectsPath() + "/" + projectName;
+
+  createRemoteProject( mApiExtra, mUsername, projectName, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+  downloadRemoteProject( mApi, mUsername, projectName );
+
+  QString bigFilePath = projectDir + "/big_file.dat";
+  QFile bigFile( bigFilePath );
+  QVERIFY( bigFile.open( QIODevice::WriteOnly ) );
+  for ( int i = 0; i < 21; ++i )   // three chunks
+    bigFile.write( QByteArray( 1024 * 1024, static_cast<char>( 'A' + i ) ) );
+  bigFile.close();
+  QByteArray checksum = MerginApi::getChecksum( bigFilePath );
+
+  // upload one chunk at a time and drop the connection once the first one has been acknowledged
+  int uploadWindow = mApi->uploadWindow();
+  mApi->setUploadWindow( 1 );
+  QSignalSpy spyFinished( mApi, &MerginApi::syncProjectFinished );
+  mApi->uploadProject( mUsername, projectName );
+  QTRY_VERIFY_WITH_TIMEOUT( SyncJournal::read( projectDir, SyncJournal::Push ).entries().count() >= 1, TestUtils::LONG_REPLY * 5 );
+
+  TransactionStatus transaction = mApi->transactions().value( projectFullName );
+  QVERIFY( !transaction.replyUploadFiles.isEmpty() );
+  QString transactionUUID = transaction.transactionUUID;
+  transaction.replyUploadFiles.first()->abort();
+  QCOMPARE( spyFinished.count(), 1 );
+  QVERIFY( !spyFinished.takeFirst().at( 2 ).toBool() );
+
+  SyncJournal journal = SyncJournal::read( projectDir, SyncJournal::Push );
+  QVERIFY( journal.isValid() );
+  QCOMPARE( journal.header().value( QStringLiteral( "transaction" ) ).toString(), transactionUUID );
+  int uploadedChunks = journal.entries().count();
+  QVERIFY( uploadedChunks >= 1 && uploadedChunks < 3 );
+
+  // the next push continues the transaction
+  QSignalSpy spyStarted( mApi, &MerginApi::pushFilesStarted );
+  mApi->uploadProject( mUsername, projectName );
+  QVERIFY( spyStarted.wait( TestUtils::LONG_REPLY ) );
+
+  transaction = mApi->transactions().value( projectFullName );
+  QCOMPARE( transaction.transactionUUID, transactionUUID );
+  QCOMPARE( transaction.uploadChunkQueue.count() + transaction.replyUploadFiles.count(), 3 - uploadedChunks );
+
+  QVERIFY( spyFinished.wait( TestUtils::LONG_REPLY * 30 ) );
+  QVERIFY( spyFinished.takeFirst().at( 2 ).toBool() );
+  mApi->setUploadWindow( uploadWindow );
+  QVERIFY( !SyncJournal::read( projectDir, SyncJournal::Push ).isValid() );
+
+  // the server has got the whole file
+  deleteLocalProject( mApi, mUsername, projectName );
+  downloadRemoteProject( mApi, mUsername, projectName );
+  QCOMPARE( MerginApi::getChecksum( bigFilePath ), checksum );
+}
+
+void TestMerginApi::testSyncQueue()
+{
+  // with a single transfer slot, the second pull waits in the queue until the first one finishes
+
+  QString projectName1 = "testSyncQueue1";
+  QString projectName2 = "testSyncQueue2";
+  QString projectFullName1 = MerginApi::getFullProjectName( mUsername, projectName1 );
+  QString projectFullName2 = MerginApi::getFullProjectName( mUsername, projectName2 );
+
+  createRemoteProject( mApiExtra, mUsername, projectName1, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+  createRemoteProject( mApiExtra, mUsername, projectName2, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+
+  // keep the first pull transferring - the bandwidth limit only lets its first item through
+  int maxActiveTransfers = mApi->maxActiveTransfers();
+  mApi->setMaxActiveTransfers( 1 );
+  mApi->setBandwidthLimit( 1 );
+
+  QSignalSpy spyFinished( mApi, &MerginApi::syncProjectFinished );
+  mApi->updateProject( mUsername, projectName1 );
+  mApi->updateProject( mUsername, projectName2 );
+  QCOMPARE( mApi->transactions().count(), 2 );
+
+  QTRY_COMPARE_WITH_TIMEOUT( mApi->mSyncScheduler.queuedProjects().count(), 1, TestUtils::LONG_REPLY );
+  QString activeProject = mApi->mSyncScheduler.activeProjects().first();
+  QString queuedProject = mApi->mSyncScheduler.queuedProjects().first();
+  QVERIFY( QSet<QString>( { activeProject, queuedProject } ) == QSet<QString>( { projectFullName1, projectFullName2 } ) );
+  QVERIFY( mApi->transactions().value( queuedProject ).replyDownloadItems.isEmpty() );
+
+  // a queued pull can be canceled
+  mApi->updateCancel( queuedProject );
+  QCOMPARE( spyFinished.count(), 1 );
+  QList<QVariant> arguments = spyFinished.takeFirst();
+  QCOMPARE( arguments.at( 1 ).toString(), queuedProject );
+  QVERIFY( !arguments.at( 2 ).toBool() );
+  QVERIFY( !mApi->mSyncScheduler.isQueued( queuedProject ) );
+  QVERIFY( mApi->mSyncScheduler.isActive( activeProject ) );
+
+  // queue it again and lift the limit - both pulls finish one after another
+  QString queuedName = queuedProject.split( "/" ).last();
+  mApi->updateProject( mUsername, queuedName );
+  QTRY_VERIFY_WITH_TIMEOUT( mApi->mSyncScheduler.isQueued( queuedProject ), TestUtils::LONG_REPLY );
+  mApi->setBandwidthLimit( 0 );
+
+  QTRY_COMPARE_WITH_TIMEOUT( spyFinished.count(), 2, TestUtils::LONG_REPLY * 5 );
+  QCOMPARE( spyFinished.at( 0 ).at( 1 ).toString(), activeProject );
+  QCOMPARE( spyFinished.at( 1 ).at( 1 ).toString(), queuedProject );
+  QVERIFY( spyFinished.at( 0 ).at( 2 ).toBool() );
+  QVERIFY( spyFinished.at( 1 ).at( 2 ).toBool() );
+  QVERIFY( mApi->mSyncScheduler.activeProjects().isEmpty() );
+
+  mApi->setMaxActiveTransfers( maxActiveTransfers );
+}
+
+void TestMerginApi::testCompressedTransfer()
+{
+  // compressible files are pushed and pulled compressed, the others as they are - against a local stand-in server
+
+  std::shared_ptr<TestingMerginServer> server = startStandInServer();
+  QVERIFY( server );
+
+  QString projectName = "testCompressedTransfer";
+  QString projectFullName = MerginApi::getFullProjectName( "standin", projectName );
+  QString projectDir = mApi->projectsPath() + "/" + projectName;
+  QVERIFY( QDir().mkpath( projectDir ) );
+
+  QByteArray csv;
+  for ( int i = 0; i < 20000; ++i )
+    csv += QStringLiteral( "%1,point %1,%2\n" ).arg( i ).arg( i % 7 ).toUtf8();
+  QByteArray jpg;
+  for ( int i = 0; i < 100000; ++i )
+    jpg += static_cast<char>( QRandomGenerator::global()->bounded( 256 ) );
+  writeFileContent( projectDir + "/data.csv", csv );
+  writeFileContent( projectDir + "/photo.jpg", jpg );
+  mApi->localProjectsManager().addMerginProject( projectDir, "standin", projectName );
+
+  mApi->setTransferCompression( true );
+
+  // push
+  uploadRemoteProject( mApi, "standin", projectName );
+  QCOMPARE( server->version(), 1 );
+  QCOMPARE( server->file( "data.csv" ), csv );
+  QCOMPARE( server->file( "photo.jpg" ), jpg );
+  QCOMPARE( server->compressedCount(), 1 );
+  QVERIFY( server->bytesReceived() < jpg.size() + csv.size() / 2 );
+
+  // pull the files to a new directory
+  deleteLocalProject( mApi, "standin", projectName );
+  qint64 bytesSent = server->bytesSent();
+  downloadRemoteProject( mApi, "standin", projectName );
+  QString pullDir = mApi->getLocalProject( projectFullName ).projectDir;
+  QVERIFY( !pullDir.isEmpty() );
+
+  QCOMPARE( readFileContent( pullDir + "/data.csv" ), csv );
+  QCOMPARE( readFileContent( pullDir + "/photo.jpg" ), jpg );
+  QCOMPARE( server->compressedCount(), 2 );
+  QVERIFY( server->bytesSent() - bytesSent < jpg.size() + csv.size() / 2 );
+
+  // without compression, everything is transferred as it is
+  mApi->setTransferCompression( false );
+  csv += QByteArray( "20000,point 20000,1\n" );
+  writeFileContent( pullDir + "/data.csv", csv );
+  uploadRemoteProject( mApi, "standin", projectName );
+  QCOMPARE( server->version(), 2 );
+  QCOMPARE( server->file( "data.csv" ), csv );
+  QCOMPARE( server->compressedCount(), 2 );
+
+  deleteLocalProject( mApi, "standin", projectName );
+}
+
+void TestMerginApi::testChunkDedupPush()
+{
+  // with content-defined chunks, repeated content is uploaded once and a push of an edited raster
+  // only uploads chunks around the edit - against a local stand-in server
+
+  std::shared_ptr<TestingMerginServer> server = startStandInServer();
+  QVERIFY( server );
+
+  QString projectName = "testChunkDedupPush";
+  QString projectDir = mApi->projectsPath() + "/" + projectName;
+  QVERIFY( QDir().mkpath( projectDir ) );
+
+  QVector<quint32> words( 6 * 1024 * 1024 );
+  QRandomGenerator::global()->fillRange( words.data(), words.size() );
+  QByteArray raster( reinterpret_cast<const char *>( words.constData() ), words.size() * static_cast<int>( sizeof( quint32 ) ) );
+  writeFileContent( projectDir + "/raster.tif", raster );
+  writeFileContent( projectDir + "/copy.tif", raster );
+  mApi->localProjectsManager().addMerginProject( projectDir, "standin", projectName );
+
+  mApi->setServerSupportsChunkDedup( true );
+
+  // the copy has the same chunks as the raster - they are only uploaded once
+  uploadRemoteProject( mApi, "standin", projectName );
+  QCOMPARE( server->version(), 1 );
+  QCOMPARE( server->file( "raster.tif" ), raster );
+  QCOMPARE( server->file( "copy.tif" ), raster );
+
+  const QStringList chunks = server->fileChunks( "raster.tif" );
+  QVERIFY( chunks.count() > 2 );
+  QCOMPARE( server->fileChunks( "copy.tif" ), chunks );
+  const QHash<QString, QByteArray> uploadedChunks = server->chunks();
+  QCOMPARE( uploadedChunks.count(), chunks.count() );
+  for ( const QByteArray &chunk : uploadedChunks )
+    QVERIFY( chunk.size() <= ContentChunker::DEFAULT_MAX_SIZE );
+  QVERIFY( server->bytesReceived() < raster.size() + ContentChunker::DEFAULT_MAX_SIZE );
+  QCOMPARE( ChunkIndex( projectDir ).count(), chunks.count() );
+
+  // edit in the middle of the raster - only the chunks around it are uploaded
+  QByteArray editedRaster = raster;
+  editedRaster.insert( 10 * 1024 * 1024, QByteArray( 1000, 'x' ) );
+  writeFileContent( projectDir + "/raster.tif", editedRaster );
+
+  int chunksCount = server->chunks().count();
+  qint64 bytesReceived = server->bytesReceived();
+  uploadRemoteProject( mApi, "standin", projectName );
+  QCOMPARE( server->version(), 2 );
+  QCOMPARE( server->file( "raster.tif" ), editedRaster );
+  QCOMPARE( server->file( "copy.tif" ), raster );
+  QVERIFY( server->chunks().count() - chunksCount <= 3 );
+  QVERIFY( server->bytesReceived() - bytesReceived < editedRaster.size() / 2 );
+
+  // without the server support, files are split to chunks of fixed size with random IDs
+  mApi->setServerSupportsChunkDedup( false );
+  MerginFile file;
+  file.path = QStringLiteral( "raster.tif" );
+  file.size = editedRaster.size();
+  MerginApi::setChunksForFullUpload( projectDir, file, false );
+  QVERIFY( file.chunkSizes.isEmpty() );
+  QCOMPARE( file.chunks.count(), 3 );
+
+  deleteLocalProject( mApi, "standin", projectName );
+}
+
 void TestMerginApi::testEmptyFileUploadDownload()
 {
   // test will try to upload a project with empty file
@@ -2309,6 +2730,1238 @@ void TestMerginApi::testExcludeFromSync()
   QVERIFY( mApi->excludeFromSync( selectiveSyncDir + "/image.jpg", config ) );
 }
 
+void TestMerginApi::testChecksumCache()
+{
+  QString projectDir = mApi->projectsPath() + "/testChecksumCache";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+  QVERIFY( InputUtils::cpDir( mTestDataPath + "/" + TEST_PROJECT_NAME, projectDir ) );
+
+  // make sure files are not considered as "just modified" (those are not cached)
+  QString testFile = projectDir + "/test1.txt";
+  QDateTime past = QDateTime::currentDateTime().addSecs( -60 );
+  for ( const QString &fileName : QDir( projectDir ).entryList( QDir::Files ) )
+  {
+    QFile f( projectDir + "/" + fileName );
+    QVERIFY( f.open( QIODevice::ReadWrite ) );
+    QVERIFY( f.setFileTime( past, QFileDevice::FileModificationTime ) );
+  }
+
+  ChecksumCache::setVerificationEnabled( true );
+
+  // first scan computes everything and stores the index
+  QList<MerginFile> files1 = MerginApi::getLocalProjectFiles( projectDir + "/" );
+  QVERIFY( QFileInfo::exists( ChecksumCache::cacheFilePath( projectDir + "/" ) ) );
+
+  ChecksumCache cache( projectDir + "/" );
+  QByteArray cached;
+  ChecksumCache::FileStamp stamp = ChecksumCache::fileStamp( testFile );
+  QVERIFY( cache.lookup( "test1.txt", stamp, cached ) );
+  QCOMPARE( cached, MerginApi::getChecksum( testFile ) );
+
+  // second scan gives the same result
+  QList<MerginFile> files2 = MerginApi::getLocalProjectFiles( projectDir + "/" );
+  QCOMPARE( files1.count(), files2.count() );
+  for ( const MerginFile &f : files1 )
+  {
+    auto it = std::find_if( files2.begin(), files2.end(), [&f]( const MerginFile & f2 ) { return f2.path == f.path; } );
+    QVERIFY( it != files2.end() );
+    QCOMPARE( it->checksum, f.checksum );
+  }
+
+  // a changed file is not found in the cache
+  writeFileContent( testFile, QByteArray( "modified content" ) );
+  QFile f( testFile );
+  QVERIFY( f.open( QIODevice::ReadWrite ) );
+  QVERIFY( f.setFileTime( past.addSecs( 10 ), QFileDevice::FileModificationTime ) );
+  f.close();
+
+  QVERIFY( !cache.lookup( "test1.txt", ChecksumCache::fileStamp( testFile ), cached ) );
+  QList<MerginFile> files3 = MerginApi::getLocalProjectFiles( projectDir + "/" );
+  for ( const MerginFile &file : files3 )
+  {
+    if ( file.path == "test1.txt" )
+      QCOMPARE( file.checksum, QString::fromLatin1( MerginApi::getChecksum( testFile ) ) );
+  }
+
+  // verification mode detects stale entries - fake one with the current stamp
+  ChecksumCache cache2( projectDir + "/" );
+  cache2.insert( "test1.txt", ChecksumCache::fileStamp( testFile ), QByteArray( "bogus" ) );
+  cache2.verify( "test1.txt", ChecksumCache::fileStamp( testFile ), QByteArray( "bogus" ), MerginApi::getChecksum( testFile ) );
+  QCOMPARE( cache2.verificationFailures(), 1 );
+
+  // explicit invalidation
+  ChecksumCache::invalidate( projectDir + "/", QStringList() << "test1.txt" );
+  ChecksumCache cache3( projectDir + "/" );
+  QVERIFY( !cache3.lookup( "test1.txt", ChecksumCache::fileStamp( testFile ), cached ) );
+  QVERIFY( cache3.lookup( "project.qgs", ChecksumCache::fileStamp( projectDir + "/project.qgs" ), cached ) );
+
+  ChecksumCache::invalidate( projectDir + "/", QStringList() );
+  ChecksumCache cache4( projectDir + "/" );
+  QVERIFY( !cache4.lookup( "project.qgs", ChecksumCache::fileStamp( projectDir + "/project.qgs" ), cached ) );
+
+  // caches of the same project used at once keep each other's entries
+  ChecksumCache cacheA( projectDir + "/" );
+  ChecksumCache cacheB( projectDir + "/" );
+  cacheA.insert( "project.qgs", ChecksumCache::fileStamp( projectDir + "/project.qgs" ), MerginApi::getChecksum( projectDir + "/project.qgs" ) );
+  cacheB.insert( "test1.txt", ChecksumCache::fileStamp( testFile ), MerginApi::getChecksum( testFile ) );
+  QVERIFY( cacheA.save() );
+  QVERIFY( cacheB.save() );
+  ChecksumCache cache5( projectDir + "/" );
+  QVERIFY( cache5.lookup( "project.qgs", ChecksumCache::fileStamp( projectDir + "/project.qgs" ), cached ) );
+  QVERIFY( cache5.lookup( "test1.txt", ChecksumCache::fileStamp( testFile ), cached ) );
+
+  ChecksumCache::setVerificationEnabled( false );
+}
+
+void TestMerginApi::testSyncJournal()
+{
+  QString projectDir = mApi->projectsPath() + "/testSyncJournal";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+
+  QVERIFY( !SyncJournal::read( projectDir, SyncJournal::Push ).isValid() );
+  QVERIFY( !SyncJournal::append( projectDir, SyncJournal::Push, QJsonObject() ) );  // not started yet
+
+  QJsonObject header;
+  header.insert( QStringLiteral( "transaction" ), QStringLiteral( "abc" ) );
+  QVERIFY( SyncJournal::start( projectDir, SyncJournal::Push, 5, header ) );
+  for ( int i = 0; i < 3; ++i )
+  {
+    QJsonObject entry;
+    entry.insert( QStringLiteral( "chunk" ), QString::number( i ) );
+    QVERIFY( SyncJournal::append( projectDir, SyncJournal::Push, entry ) );
+  }
+
+  SyncJournal journal = SyncJournal::read( projectDir, SyncJournal::Push );
+  QVERIFY( journal.isValid() );
+  QCOMPARE( journal.version(), 5 );
+  QCOMPARE( journal.header().value( QStringLiteral( "transaction" ) ).toString(), QStringLiteral( "abc" ) );
+  QCOMPARE( journal.entries().count(), 3 );
+  QCOMPARE( journal.entries().at( 2 ).value( QStringLiteral( "chunk" ) ).toString(), QStringLiteral( "2" ) );
+
+  // pull and push have their own journals
+  QVERIFY( !SyncJournal::read( projectDir, SyncJournal::Pull ).isValid() );
+
+  // an entry written only partially (the app has been killed) is dropped, entries appended later are kept
+  QFile file( SyncJournal::journalFilePath( projectDir, SyncJournal::Push ) );
+  QVERIFY( file.open( QIODevice::Append ) );
+  file.write( "{\"chunk\":\"3" );
+  file.close();
+  QCOMPARE( SyncJournal::read( projectDir, SyncJournal::Push ).entries().count(), 3 );
+
+  QJsonObject entry;
+  entry.insert( QStringLiteral( "chunk" ), QStringLiteral( "4" ) );
+  QVERIFY( SyncJournal::append( projectDir, SyncJournal::Push, entry ) );
+  journal = SyncJournal::read( projectDir, SyncJournal::Push );
+  QCOMPARE( journal.entries().count(), 4 );
+  QCOMPARE( journal.entries().at( 3 ).value( QStringLiteral( "chunk" ) ).toString(), QStringLiteral( "4" ) );
+
+  // starting again replaces the journal
+  QVERIFY( SyncJournal::start( projectDir, SyncJournal::Push, 6 ) );
+  journal = SyncJournal::read( projectDir, SyncJournal::Push );
+  QCOMPARE( journal.version(), 6 );
+  QVERIFY( journal.entries().isEmpty() );
+
+  SyncJournal::remove( projectDir, SyncJournal::Push );
+  QVERIFY( !SyncJournal::read( projectDir, SyncJournal::Push ).isValid() );
+
+  // local projects never get a journal
+  QString localProjectDir = mApi->projectsPath() + "/testSyncJournalLocal";
+  QVERIFY( QDir().mkpath( localProjectDir ) );
+  QVERIFY( !SyncJournal::start( localProjectDir, SyncJournal::Pull, 1 ) );
+
+  QDir( projectDir ).removeRecursively();
+  QDir( localProjectDir ).removeRecursively();
+}
+
+void TestMerginApi::testSyncScheduler()
+{
+  SyncScheduler scheduler;
+  scheduler.setMaxActiveTransfers( 1 );
+  QStringList started;
+  auto start = [&started]( const QString & name ) { return [&started, name]() { started << name; }; };
+
+  // the first one gets the slot right away, the others wait
+  QVERIFY( scheduler.requestTransfer( "ns/big", 1000, start( "ns/big" ) ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/large", 500, start( "ns/large" ) ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/small", 10, start( "ns/small" ) ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/small2", 10, start( "ns/small2" ) ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/open", 5000, start( "ns/open" ) ) );
+  QCOMPARE( started, QStringList() << "ns/big" );
+  QVERIFY( scheduler.isActive( "ns/big" ) );
+
+  // the open project goes first, then smaller deltas in order of arrival
+  scheduler.setPreferredProject( "ns/open" );
+  QCOMPARE( scheduler.queuedProjects(), QStringList() << "ns/open" << "ns/small" << "ns/small2" << "ns/large" );
+
+  scheduler.release( "ns/big" );
+  QCOMPARE( started.last(), QString( "ns/open" ) );
+
+  // a queued transfer can be removed
+  scheduler.release( "ns/small2" );
+  QVERIFY( !scheduler.isQueued( "ns/small2" ) );
+
+  // more slots start more queued transfers at once
+  scheduler.setMaxActiveTransfers( 3 );
+  QCOMPARE( started, QStringList() << "ns/big" << "ns/open" << "ns/small" << "ns/large" );
+  QCOMPARE( scheduler.activeProjects().count(), 3 );
+  QVERIFY( scheduler.queuedProjects().isEmpty() );
+
+  // a transfer that releases its slot right away (e.g. it fails) lets the next one start
+  scheduler.setMaxActiveTransfers( 1 );
+  scheduler.release( "ns/open" );
+  scheduler.release( "ns/small" );
+  QVERIFY( !scheduler.requestTransfer( "ns/fail", 1, [&scheduler]() { scheduler.release( "ns/fail" ); } ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/next", 2, start( "ns/next" ) ) );
+  scheduler.release( "ns/large" );
+  QVERIFY( !scheduler.isActive( "ns/fail" ) );
+  QVERIFY( scheduler.isActive( "ns/next" ) );
+
+  // a large delta that has waited for too long is not passed by smaller ones anymore
+  scheduler.setPreferredProject( QString() );
+  scheduler.setMaxQueueWait( 50 );
+  QVERIFY( !scheduler.requestTransfer( "ns/waiting", 1000, start( "ns/waiting" ) ) );
+  QVERIFY( !scheduler.requestTransfer( "ns/quick", 10, start( "ns/quick" ) ) );
+  QCOMPARE( scheduler.queuedProjects(), QStringList() << "ns/quick" << "ns/waiting" );
+  QTest::qWait( 100 );
+  QVERIFY( !scheduler.requestTransfer( "ns/quick2", 10, start( "ns/quick2" ) ) );
+  QCOMPARE( scheduler.queuedProjects(), QStringList() << "ns/waiting" << "ns/quick" << "ns/quick2" );
+  scheduler.release( "ns/next" );
+  QCOMPARE( started.last(), QString( "ns/waiting" ) );
+  scheduler.release( "ns/quick" );
+  scheduler.release( "ns/quick2" );
+  scheduler.release( "ns/waiting" );
+
+  // bandwidth limit - the bucket may get in debt, but then requests wait until it is paid back
+  QCOMPARE( scheduler.reserveBandwidth( 1000000 ), 0 );
+  scheduler.setBandwidthLimit( 1000 );
+  QCOMPARE( scheduler.reserveBandwidth( 1500 ), 0 );
+  int delay = scheduler.reserveBandwidth( 100 );
+  QVERIFY( delay > 300 && delay <= 500 );
+  QTest::qWait( delay + 10 );
+  QCOMPARE( scheduler.reserveBandwidth( 100 ), 0 );
+  scheduler.setBandwidthLimit( 0 );
+  QCOMPARE( scheduler.reserveBandwidth( 1000000 ), 0 );
+}
+
+void TestMerginApi::testTransferCompression()
+{
+  QVERIFY( TransferCompression::isCompressible( "survey.gpkg" ) );
+  QVERIFY( TransferCompression::isCompressible( "project.qgs" ) );
+  QVERIFY( TransferCompression::isCompressible( "subdir/Data.CSV" ) );
+  QVERIFY( !TransferCompression::isCompressible( "project.qgz" ) );
+  QVERIFY( !TransferCompression::isCompressible( "photos/img01.jpg" ) );
+  QVERIFY( !TransferCompression::isCompressible( "noextension" ) );
+
+  QByteArray data;
+  for ( int i = 0; i < 1000; ++i )
+    data += QStringLiteral( "<feature id=\"%1\"/>\n" ).arg( i ).toUtf8();
+
+  QByteArray compressed = TransferCompression::deflate( data );
+  QVERIFY( compressed.size() * 5 < data.size() );
+  QCOMPARE( TransferCompression::inflate( compressed, data.size() ), data );
+  QCOMPARE( TransferCompression::inflate( compressed ), data );  // the size is just a hint
+
+  QVERIFY( TransferCompression::inflate( QByteArray( "not a zlib stream" ) ).isNull() );
+  QVERIFY( TransferCompression::inflate( QByteArray() ).isEmpty() );
+}
+
+void TestMerginApi::testUploadRetryDelay()
+{
+  // each next retry waits twice as long, jitter adds at most a half
+  for ( int retries = 1; retries <= 3; ++retries )
+  {
+    int base = MerginApi::UPLOAD_CHUNK_RETRY_DELAY_MS << ( retries - 1 );
+    for ( int i = 0; i < 20; ++i )
+    {
+      int delay = MerginApi::uploadRetryDelay( retries );
+      QVERIFY( delay >= base );
+      QVERIFY( delay <= base + base / 2 );
+    }
+  }
+}
+
+void TestMerginApi::testContentChunker()
+{
+  // small chunks to keep the test fast
+  ContentChunker chunker( 1024, 4096, 16384 );
+
+  QVector<quint32> words( 256 * 1024 );
+  QRandomGenerator::global()->fillRange( words.data(), words.size() );
+  QByteArray data( reinterpret_cast<const char *>( words.constData() ), words.size() * static_cast<int>( sizeof( quint32 ) ) );
+
+  // chunks cover the data and respect the sizes
+  QList<ContentChunker::Chunk> chunks = chunker.chunkData( data );
+  QVERIFY( chunks.count() > 50 );
+  qint64 offset = 0;
+  for ( int i = 0; i < chunks.count(); ++i )
+  {
+    const ContentChunker::Chunk &chunk = chunks.at( i );
+    QCOMPARE( chunk.offset, offset );
+    QVERIFY( chunk.size <= 16384 );
+    QVERIFY( chunk.size >= 1024 || i == chunks.count() - 1 );
+    QCOMPARE( chunk.id, ContentChunker::chunkId( data.mid( static_cast<int>( chunk.offset ), static_cast<int>( chunk.size ) ) ) );
+    offset += chunk.size;
+  }
+  QCOMPARE( offset, static_cast<qint64>( data.size() ) );
+
+  // the same content gives the same chunks, also when read from a file
+  QString projectDir = mApi->projectsPath() + "/testContentChunker";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+  writeFileContent( projectDir + "/data.bin", data );
+  QList<ContentChunker::Chunk> fileChunks = chunker.chunkFile( projectDir + "/data.bin" );
+  QCOMPARE( fileChunks.count(), chunks.count() );
+  for ( int i = 0; i < chunks.count(); ++i )
+    QCOMPARE( fileChunks.at( i ).id, chunks.at( i ).id );
+
+  // an insertion and a removal only change the chunks around them
+  QByteArray editedData = data;
+  editedData.insert( data.size() / 3, QByteArray( 100, 'x' ) );
+  editedData.remove( 2 * data.size() / 3, 50 );
+  QSet<QString> ids;
+  for ( const ContentChunker::Chunk &chunk : qAsConst( chunks ) )
+    ids << chunk.id;
+  const QList<ContentChunker::Chunk> editedChunks = chunker.chunkData( editedData );
+  int changed = 0;
+  for ( const ContentChunker::Chunk &chunk : editedChunks )
+  {
+    if ( !ids.contains( chunk.id ) )
+      ++changed;
+  }
+  QVERIFY( changed <= 6 );
+
+  // empty content has a single empty chunk
+  QList<ContentChunker::Chunk> emptyChunks = chunker.chunkData( QByteArray() );
+  QCOMPARE( emptyChunks.count(), 1 );
+  QCOMPARE( emptyChunks.first().size, static_cast<qint64>( 0 ) );
+  QVERIFY( chunker.chunkFile( projectDir + "/missing.bin" ).isEmpty() );
+
+  // the index of known chunks is persisted in the project
+  ChunkIndex index( projectDir );
+  QCOMPARE( index.count(), 0 );
+  index.insert( { chunks.at( 0 ).id, chunks.at( 1 ).id, chunks.at( 0 ).id } );
+  QCOMPARE( index.count(), 2 );
+  QVERIFY( index.save() );
+
+  ChunkIndex loadedIndex( projectDir );
+  QCOMPARE( loadedIndex.count(), 2 );
+  QVERIFY( loadedIndex.contains( chunks.at( 1 ).id ) );
+  QVERIFY( !loadedIndex.contains( chunks.at( 2 ).id ) );
+
+  loadedIndex.clear();
+  QVERIFY( loadedIndex.save() );
+  QCOMPARE( ChunkIndex( projectDir ).count(), 0 );
+
+  // the index does not turn a local project into a mergin one
+  QVERIFY( QDir( projectDir + "/.mergin" ).removeRecursively() );
+  ChunkIndex localIndex( projectDir );
+  localIndex.insert( { chunks.at( 0 ).id } );
+  QVERIFY( !localIndex.save() );
+  QVERIFY( !QFile::exists( ChunkIndex::indexFilePath( projectDir ) ) );
+}
+
+void TestMerginApi::testProjectChangeTracker()
+{
+  QString projectDir = mApi->projectsPath() + "/testProjectChangeTracker";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+  QVERIFY( QDir().mkpath( projectDir + "/subdir" ) );
+  writeFileContent( projectDir + "/file1.txt", "first" );
+  writeFileContent( projectDir + "/subdir/file2.txt", "second" );
+
+  // metadata of the project as if it has just been synced
+  QJsonArray files;
+  for ( const QString &path : { QStringLiteral( "file1.txt" ), QStringLiteral( "subdir/file2.txt" ) } )
+  {
+    QFileInfo info( projectDir + "/" + path );
+    QJsonObject file;
+    file.insert( QStringLiteral( "path" ), path );
+    file.insert( QStringLiteral( "checksum" ), QString::fromLatin1( MerginApi::getChecksum( info.filePath() ) ) );
+    file.insert( QStringLiteral( "size" ), info.size() );
+    file.insert( QStringLiteral( "mtime" ), info.lastModified().toUTC().toString( Qt::ISODateWithMs ) );
+    files.append( file );
+  }
+  QJsonObject metadata;
+  metadata.insert( QStringLiteral( "name" ), QStringLiteral( "testProjectChangeTracker" ) );
+  metadata.insert( QStringLiteral( "namespace" ), mUsername );
+  metadata.insert( QStringLiteral( "version" ), QStringLiteral( "v1" ) );
+  metadata.insert( QStringLiteral( "files" ), files );
+  writeFileContent( projectDir + "/" + MerginApi::sMetadataFile, QJsonDocument( metadata ).toJson() );
+
+  // the first check scans the whole project and sets the baseline
+  ProjectChangeTracker tracker;
+  QVERIFY( !tracker.isBaselineKnown( projectDir ) );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+  QCOMPARE( tracker.fullScansCount(), 1 );
+  QVERIFY( tracker.isBaselineKnown( projectDir ) );
+  QVERIFY( tracker.watchedPathsCount() > 0 );
+  QVERIFY( tracker.dirtyFiles( projectDir ).isEmpty() );
+
+  // an updated file is noticed by the watcher, only the file gets compared
+  writeFileContent( projectDir + "/subdir/file2.txt", "updated" );
+  QTRY_VERIFY( tracker.dirtyFiles( projectDir ).contains( QStringLiteral( "subdir/file2.txt" ) ) );
+  QVERIFY( tracker.hasLocalChanges( projectDir ) );
+  QVERIFY( tracker.hasLocalChanges( projectDir ) );  // stays dirty until it matches the metadata
+  QCOMPARE( tracker.fullScansCount(), 1 );
+
+  // ... and is not a change once its content is back
+  writeFileContent( projectDir + "/subdir/file2.txt", "second" );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+  QVERIFY( tracker.dirtyFiles( projectDir ).isEmpty() );
+
+  // added and removed files are found through their directories
+  writeFileContent( projectDir + "/subdir/file3.txt", "third" );
+  QTRY_VERIFY( tracker.dirtyDirectories( projectDir ).contains( QStringLiteral( "subdir" ) ) );
+  QVERIFY( tracker.hasLocalChanges( projectDir ) );
+  QVERIFY( QFile::remove( projectDir + "/subdir/file3.txt" ) );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+
+  QVERIFY( QFile::remove( projectDir + "/file1.txt" ) );
+  QTRY_VERIFY( tracker.dirtyDirectories( projectDir ).contains( QString() ) );
+  QVERIFY( tracker.hasLocalChanges( projectDir ) );
+  writeFileContent( projectDir + "/file1.txt", "first" );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+  QCOMPARE( tracker.fullScansCount(), 1 );
+
+  // ignored files are not tracked
+  tracker.notifyFileChanged( projectDir + "/project.qgs~" );
+  tracker.notifyFileChanged( projectDir + "/data.gpkg-shm" );
+  QVERIFY( !tracker.dirtyFiles( projectDir ).contains( QStringLiteral( "project.qgs~" ) ) );
+  QVERIFY( !tracker.dirtyFiles( projectDir ).contains( QStringLiteral( "data.gpkg-shm" ) ) );
+  tracker.notifyFileChanged( projectDir + "/data.gpkg-wal" );
+  QVERIFY( tracker.dirtyFiles( projectDir ).contains( QStringLiteral( "data.gpkg" ) ) );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+
+  // changes recorded after the snapshot of a push are kept by the new baseline
+  quint64 snapshot = tracker.snapshot();
+  tracker.notifyFileChanged( projectDir + "/file1.txt" );
+  tracker.setBaseline( projectDir, snapshot );
+  QCOMPARE( tracker.dirtyFiles( projectDir ), QStringList() << QStringLiteral( "file1.txt" ) );
+  tracker.setBaseline( projectDir, tracker.snapshot() );
+  QVERIFY( tracker.dirtyFiles( projectDir ).isEmpty() );
+
+  // a forgotten project is scanned whole again
+  tracker.forgetProject( projectDir );
+  QVERIFY( !tracker.isBaselineKnown( projectDir ) );
+  QCOMPARE( tracker.watchedPathsCount(), 0 );
+  QVERIFY( !tracker.hasLocalChanges( projectDir ) );
+  QCOMPARE( tracker.fullScansCount(), 2 );
+
+  // a project that does not fit into the watchers is always scanned whole
+  ProjectChangeTracker limitedTracker;
+  limitedTracker.setMaxWatchedPaths( 2 );
+  QVERIFY( !limitedTracker.hasLocalChanges( projectDir ) );
+  QCOMPARE( limitedTracker.watchedPathsCount(), 0 );
+  QVERIFY( !limitedTracker.isBaselineKnown( projectDir ) );
+  writeFileContent( projectDir + "/subdir/file2.txt", "updated" );
+  QVERIFY( limitedTracker.hasLocalChanges( projectDir ) );
+  QCOMPARE( limitedTracker.fullScansCount(), 2 );
+}
+
+void TestMerginApi::testChangesetSession()
+{
+  // two GeoPackages changed against their base files and one unchanged
+  QString projectDir = mApi->projectsPath() + "/testChangesetSession";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin/subdir" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/diff_project/base.gpkg", projectDir + "/.mergin/base.gpkg" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/modified_1_geom.gpkg", projectDir + "/base.gpkg" ) );
+  QVERIFY( QDir().mkpath( projectDir + "/subdir" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/diff_project/base.gpkg", projectDir + "/.mergin/subdir/rows.gpkg" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/added_row.gpkg", projectDir + "/subdir/rows.gpkg" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/diff_project/base.gpkg", projectDir + "/.mergin/same.gpkg" ) );
+  QVERIFY( QFile::copy( mTestDataPath + "/diff_project/base.gpkg", projectDir + "/same.gpkg" ) );
+
+  // the summary read from the changeset matches the one listed by geodiff
+  QString diffName;
+  QCOMPARE( GeodiffUtils::createChangeset( projectDir, "base.gpkg", diffName ), GEODIFF_SUCCESS );
+  GeodiffUtils::ChangesetSummary summary;
+  QVERIFY( GeodiffUtils::readChangesetSummary( projectDir + "/.mergin/" + diffName, summary ) );
+  QCOMPARE( summary, GeodiffUtils::parseChangesetSummary( GeodiffUtils::diffableFilePendingChanges( projectDir, "base.gpkg", true ) ) );
+  GeodiffUtils::ChangesetSummary expectedSummary;
+  expectedSummary["simple"] = GeodiffUtils::TableSummary( 0, 1, 0 );
+  expectedSummary["gpkg_contents"] = GeodiffUtils::TableSummary( 0, 1, 0 );
+  QCOMPARE( summary, expectedSummary );
+  QVERIFY( QFile::remove( projectDir + "/.mergin/" + diffName ) );
+
+  // invalid changesets are refused
+  writeFileContent( projectDir + "/.mergin/invalid-diff", QByteArray( "T\x02\x01" ) );
+  QVERIFY( !GeodiffUtils::readChangesetSummary( projectDir + "/.mergin/invalid-diff", summary ) );
+  QVERIFY( !GeodiffUtils::readChangesetSummary( projectDir + "/.mergin/missing-diff", summary ) );
+  QVERIFY( QFile::remove( projectDir + "/.mergin/invalid-diff" ) );
+
+  QStringList diffFiles;
+  {
+    ChangesetSession changesets( projectDir );
+    changesets.prepare( { "base.gpkg", "subdir/rows.gpkg", "same.gpkg" } );
+    QCOMPARE( changesets.createdCount(), 3 );
+
+    QVERIFY( changesets.hasPendingChanges( "base.gpkg" ) );
+    QVERIFY( changesets.hasPendingChanges( "subdir/rows.gpkg" ) );
+    QVERIFY( !changesets.hasPendingChanges( "same.gpkg" ) );
+    QCOMPARE( changesets.changeset( "base.gpkg" ).summary, expectedSummary );
+    QCOMPARE( changesets.changeset( "subdir/rows.gpkg" ).summary,
+              GeodiffUtils::parseChangesetSummary( GeodiffUtils::diffableFilePendingChanges( projectDir, "subdir/rows.gpkg", true ) ) );
+
+    // changesets are not created again
+    changesets.prepare( { "base.gpkg", "same.gpkg" } );
+    QCOMPARE( changesets.createdCount(), 3 );
+
+    // a file without base fails, it counts as changed
+    QVERIFY( QFile::copy( mTestDataPath + "/added_row.gpkg", projectDir + "/nobase.gpkg" ) );
+    QVERIFY( changesets.changeset( "nobase.gpkg" ).result != GEODIFF_SUCCESS );
+    QVERIFY( changesets.hasPendingChanges( "nobase.gpkg" ) );
+    QVERIFY( changesets.takeDiff( "nobase.gpkg" ).isEmpty() );
+    QCOMPARE( changesets.createdCount(), 4 );
+
+    // the taken diff stays, the rest is removed with the session
+    diffName = changesets.takeDiff( "base.gpkg" );
+    QVERIFY( !diffName.isEmpty() );
+    QVERIFY( changesets.takeDiff( "base.gpkg" ).isEmpty() );
+    diffFiles << changesets.changeset( "subdir/rows.gpkg" ).diffName << changesets.changeset( "same.gpkg" ).diffName;
+    for ( const QString &diffFile : qAsConst( diffFiles ) )
+      QVERIFY( QFile::exists( projectDir + "/.mergin/" + diffFile ) );
+  }
+  QVERIFY( QFile::exists( projectDir + "/.mergin/" + diffName ) );
+  for ( const QString &diffFile : qAsConst( diffFiles ) )
+    QVERIFY( !QFile::exists( projectDir + "/.mergin/" + diffFile ) );
+}
+
+void TestMerginApi::testProjectMetadataStore()
+{
+  // metadata of a big project - 20000 files
+  const int filesCount = 20000;
+  QString projectDir = mApi->projectsPath() + "/testProjectMetadataStore";
+  QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+  QString metadataFilePath = projectDir + "/" + MerginApi::sMetadataFile;
+
+  auto writeMetadata = [&]( int version, const QDateTime & mtime )
+  {
+    QJsonArray files;
+    for ( int i = 0; i < filesCount; ++i )
+    {
+      QJsonObject file;
+      file.insert( QStringLiteral( "path" ), QStringLiteral( "dir%1/file%2.txt" ).arg( i % 100 ).arg( i ) );
+      file.insert( QStringLiteral( "checksum" ), QString::fromLatin1( QCryptographicHash::hash( QByteArray::number( i + version ), QCryptographicHash::Sha1 ).toHex() ) );
+      file.insert( QStringLiteral( "size" ), i );
+      file.insert( QStringLiteral( "mtime" ), QStringLiteral( "2021-01-02T03:04:05.678Z" ) );
+      files.append( file );
+    }
+    QJsonObject metadata;
+    metadata.insert( QStringLiteral( "name" ), QStringLiteral( "testProjectMetadataStore" ) );
+    metadata.insert( QStringLiteral( "namespace" ), mUsername );
+    metadata.insert( QStringLiteral( "version" ), QStringLiteral( "v%1" ).arg( version ) );
+    metadata.insert( QStringLiteral( "files" ), files );
+    writeFileContent( metadataFilePath, QJsonDocument( metadata ).toJson() );
+
+    if ( mtime.isValid() )
+    {
+      QFile file( metadataFilePath );
+      QVERIFY( file.open( QIODevice::ReadWrite ) );
+      QVERIFY( file.setFileTime( mtime, QFileDevice::FileModificationTime ) );
+    }
+  };
+
+  // not modified recently - the store may keep it
+  writeMetadata( 1, QDateTime::currentDateTimeUtc().addSecs( -60 ) );
+
+  ProjectMetadataStore store;
+  QElapsedTimer timer;
+  timer.start();
+  MerginProjectMetadata parsed = store.metadata( metadataFilePath );
+  qint64 jsonMs = timer.restart();
+  MerginProjectMetadata fromMemory = store.metadata( metadataFilePath );
+  qint64 memoryMs = timer.restart();
+  store.clear();
+  MerginProjectMetadata fromCacheFile = store.metadata( metadataFilePath );
+  qint64 cacheFileMs = timer.elapsed();
+
+  qDebug() << "metadata of" << filesCount << "files: JSON" << jsonMs << "ms, memory" << memoryMs << "ms, cache file" << cacheFileMs << "ms";
+
+  QCOMPARE( store.jsonLoads(), 1 );
+  QCOMPARE( store.memoryHits(), 1 );
+  QCOMPARE( store.cacheFileLoads(), 1 );
+  QVERIFY( QFile::exists( ProjectMetadataStore::cacheFilePath( metadataFilePath ) ) );
+
+  QCOMPARE( parsed.version, 1 );
+  QCOMPARE( parsed.files.count(), filesCount );
+  for ( const MerginProjectMetadata &metadata : { fromMemory, fromCacheFile } )
+  {
+    QCOMPARE( metadata.name, parsed.name );
+    QCOMPARE( metadata.projectNamespace, parsed.projectNamespace );
+    QCOMPARE( metadata.version, parsed.version );
+    QCOMPARE( metadata.files.count(), parsed.files.count() );
+    for ( int i = 0; i < filesCount; ++i )
+    {
+      QCOMPARE( metadata.files.at( i ).path, parsed.files.at( i ).path );
+      QCOMPARE( metadata.files.at( i ).checksum, parsed.files.at( i ).checksum );
+      QCOMPARE( metadata.files.at( i ).size, parsed.files.at( i ).size );
+      QCOMPARE( metadata.files.at( i ).mtime, parsed.files.at( i ).mtime );
+    }
+  }
+
+  // lookups by path use the index
+  timer.restart();
+  for ( int i = 0; i < filesCount; ++i )
+  {
+    const QString path = QStringLiteral( "dir%1/file%2.txt" ).arg( i % 100 ).arg( i );
+    QCOMPARE( fromCacheFile.fileIndex( path ), i );
+    QCOMPARE( fromCacheFile.fileInfo( path ).size, static_cast<qint64>( i ) );
+  }
+  qDebug() << "lookup of" << filesCount << "files:" << timer.elapsed() << "ms";
+  QCOMPARE( fromCacheFile.fileIndex( "missing.txt" ), -1 );
+
+  // changed files are searched until the index is built again
+  MerginProjectMetadata changed = fromCacheFile;
+  MerginFile added;
+  added.path = QStringLiteral( "added.txt" );
+  changed.files << added;
+  QCOMPARE( changed.fileIndex( "added.txt" ), filesCount );
+  changed.files.removeFirst();
+  QCOMPARE( changed.fileIndex( "added.txt" ), filesCount - 1 );
+  QCOMPARE( changed.fileIndex( parsed.files.at( 0 ).path ), -1 );
+  QCOMPARE( fromCacheFile.fileIndex( "added.txt" ), -1 );
+  changed.files.replace( 0, added );
+  QCOMPARE( changed.fileIndex( parsed.files.at( 1 ).path ), -1 );
+  changed.buildFilesIndex();
+  QCOMPARE( changed.fileIndex( "added.txt" ), 0 );
+  QCOMPARE( changed.fileIndex( parsed.files.at( 2 ).path ), 1 );
+
+  // rewritten metadata file is read again
+  writeMetadata( 2, QDateTime::currentDateTimeUtc().addSecs( -30 ) );
+  QCOMPARE( store.metadata( metadataFilePath ).version, 2 );
+  QCOMPARE( store.jsonLoads(), 2 );
+  store.clear();
+  QCOMPARE( store.metadata( metadataFilePath ).version, 2 );
+  QCOMPARE( store.cacheFileLoads(), 2 );
+
+  // recently modified file is always parsed and its cache file is not used
+  writeMetadata( 3, QDateTime() );
+  QCOMPARE( store.metadata( metadataFilePath ).version, 3 );
+  QCOMPARE( store.metadata( metadataFilePath ).version, 3 );
+  QCOMPARE( store.jsonLoads(), 4 );
+
+  // missing metadata file
+  QVERIFY( QFile::remove( metadataFilePath ) );
+  QVERIFY( !store.metadata( metadataFilePath ).isValid() );
+  QVERIFY( !MerginProjectMetadata::fromCachedJson( metadataFilePath ).isValid() );
+}
+
+void TestMerginApi::testLargeFileTransfer()
+{
+  // sizes over 4 GB survive the whole pull path - chunks are written in place into a sparse preallocated file
+
+  const qint64 fileSize = Q_INT64_C( 5 ) * 1024 * 1024 * 1024 + 12345;
+  const qint64 diffSize = Q_INT64_C( 3 ) * 1024 * 1024 * 1024;
+
+  QJsonObject diff;
+  diff.insert( QStringLiteral( "size" ), diffSize );
+  QJsonObject historyEntry;
+  historyEntry.insert( QStringLiteral( "diff" ), diff );
+  QJsonObject history;
+  history.insert( QStringLiteral( "v2" ), historyEntry );
+  QJsonObject fileObject;
+  fileObject.insert( QStringLiteral( "path" ), QStringLiteral( "big.dat" ) );
+  fileObject.insert( QStringLiteral( "size" ), fileSize );
+  fileObject.insert( QStringLiteral( "history" ), history );
+  MerginFile file = MerginFile::fromJsonObject( fileObject );
+  QCOMPARE( file.size, fileSize );
+  QCOMPARE( file.pullDiffFiles.count(), 1 );
+  QCOMPARE( file.pullDiffFiles.first().second, diffSize );
+  QCOMPARE( MerginApi::itemsForFileDiffs( file ).first().size, diffSize );
+
+  // chunks cover the whole file and share one temp file
+  QList<DownloadQueueItem> items = MerginApi::itemsForFileChunks( file, 2 );
+  QCOMPARE( items.count(), static_cast<int>( ( fileSize + MerginApi::UPLOAD_CHUNK_SIZE - 1 ) / MerginApi::UPLOAD_CHUNK_SIZE ) );
+  qint64 expectedFrom = 0;
+  for ( const DownloadQueueItem &item : qAsConst( items ) )
+  {
+    QCOMPARE( item.rangeFrom, expectedFrom );
+    QCOMPARE( item.rangeTo - item.rangeFrom + 1, item.size );
+    QCOMPARE( item.fileSize, fileSize );
+    QCOMPARE( item.tempFileName, items.first().tempFileName );
+    expectedFrom = item.rangeTo + 1;
+  }
+  QCOMPARE( expectedFrom, fileSize );
+
+  // progress does not overflow nor get truncated to whole numbers
+  TransactionStatus transaction;
+  transaction.totalSize = fileSize;
+  transaction.transferedSize = fileSize / 2;
+  QVERIFY( qAbs( transaction.progress() - 0.5 ) < 0.001 );
+
+  // chunks arriving in any order are written at their positions, the first one preallocates the file
+  QString projectDir = mApi->projectsPath() + "/testLargeFileTransfer";
+  QString tempDir = projectDir + "/.temp";
+  QVERIFY( QDir().mkpath( tempDir ) );
+  QString tempFilePath = tempDir + "/" + items.first().tempFileName;
+
+  QList<int> writtenChunks = { items.count() - 1, 0, items.count() / 2 };
+  for ( int chunkNo : writtenChunks )
+  {
+    const DownloadQueueItem &item = items.at( chunkNo );
+    QFile tempFile( tempFilePath );
+    if ( !MerginApi::openDownloadTempFile( tempFile, item ) )
+      QSKIP( "the file system does not support big (sparse) files" );
+    QCOMPARE( tempFile.size(), fileSize );
+    QCOMPARE( tempFile.pos(), item.rangeFrom );
+    QVERIFY( tempFile.write( QByteArray::number( chunkNo ) ) > 0 );
+    tempFile.close();
+  }
+
+  // a diff (not a chunk) gets its own file
+  DownloadQueueItem diffItem = MerginApi::itemsForFileDiffs( file ).first();
+  diffItem.tempFileName = QStringLiteral( "diff" );
+  QFile diffFile( tempDir + "/diff" );
+  QVERIFY( MerginApi::openDownloadTempFile( diffFile, diffItem ) );
+  QCOMPARE( diffFile.size(), 0 );
+  diffFile.close();
+
+  // the shared temp file becomes the pulled file as it is
+  QString assembledFile = MerginApi::assembleDownloadedFile( QStringLiteral( "testLargeFileTransfer" ), tempDir, items );
+  QCOMPARE( assembledFile, tempFilePath );
+  MerginApi::installDownloadedFile( QStringLiteral( "testLargeFileTransfer" ), projectDir, file.path, assembledFile );
+  QVERIFY( !QFile::exists( tempFilePath ) );
+  QFile pulledFile( projectDir + "/" + file.path );
+  QVERIFY( pulledFile.open( QIODevice::ReadOnly ) );
+  QCOMPARE( pulledFile.size(), fileSize );
+  for ( int chunkNo : writtenChunks )
+  {
+    QByteArray marker = QByteArray::number( chunkNo );
+    QVERIFY( pulledFile.seek( items.at( chunkNo ).rangeFrom ) );
+    QCOMPARE( pulledFile.read( marker.size() ), marker );
+  }
+  pulledFile.close();
+  QVERIFY( QDir( projectDir ).removeRecursively() );
+
+  // pull of a three chunk file through the local stand-in server, all chunks in flight at once
+  std::shared_ptr<TestingMerginServer> server = startStandInServer();
+  QVERIFY( server );
+
+  QByteArray content;
+  for ( int i = 0; i < 25; ++i )
+    content += QByteArray( 1024 * 1024, static_cast<char>( 'a' + i ) );
+  server->setFile( "data.bin", content );
+
+  QString projectName = "testLargeFileTransfer";
+  QString projectFullName = MerginApi::getFullProjectName( "standin", projectName );
+  int downloadWindow = mApi->downloadWindow();
+  mApi->setDownloadWindow( 3 );
+
+  // queued, so that the items requested right after the signal are counted before any of them finishes
+  int itemsInFlight = 0;
+  QMetaObject::Connection connection = connect( mApi, &MerginApi::pullFilesStarted, this, [this, projectFullName, &itemsInFlight]()
+  {
+    itemsInFlight = mApi->transactions().value( projectFullName ).replyDownloadItems.count();
+  }, Qt::QueuedConnection );
+
+  QSignalSpy spyProgress( mApi, &MerginApi::syncProjectStatusChanged );
+  downloadRemoteProject( mApi, "standin", projectName );
+  disconnect( connection );
+  mApi->setDownloadWindow( downloadWindow );
+  QCOMPARE( itemsInFlight, 3 );
+
+  QString pullDir = mApi->getLocalProject( projectFullName ).projectDir;
+  QVERIFY( !pullDir.isEmpty() );
+  QCOMPARE( MerginApi::getChecksum( pullDir + "/data.bin" ), QCryptographicHash::hash( content, QCryptographicHash::Sha1 ).toHex() );
+  QVERIFY( !spyProgress.isEmpty() );
+  qreal lastProgress = 0;
+  for ( const QList<QVariant> &args : qAsConst( spyProgress ) )
+  {
+    qreal progress = args.at( 1 ).toReal();
+    if ( progress < 0 )
+      continue;  // the sync has finished
+    QVERIFY( progress >= lastProgress && progress <= 1 );
+    lastProgress = progress;
+  }
+  QCOMPARE( lastProgress, 1.0 );
+
+  deleteLocalProject( mApi, "standin", projectName );
+}
+
+void TestMerginApi::testLocalProjectsManagerReload()
+{
+  // lookups use indexes and a reload of the data dir only reads folders that have changed
+
+  const int projectsCount = 300;
+  QString dataDir = mApi->projectsPath() + "/testLocalProjectsManagerReload";
+  for ( int i = 0; i < projectsCount; ++i )
+  {
+    QString projectDir = dataDir + QStringLiteral( "/project%1" ).arg( i );
+    QVERIFY( QDir().mkpath( projectDir + "/data" ) );
+    writeFileContent( projectDir + QStringLiteral( "/project%1.qgs" ).arg( i ), QByteArray( "<qgis/>" ) );
+  }
+
+  // changes within the last moments are never trusted - let the folders get old enough
+  QTest::qWait( 2100 );
+
+  LocalProjectsManager manager( dataDir );
+  QCOMPARE( manager.projects().count(), projectsCount );
+  QCOMPARE( manager.reloadedProjectsCount(), projectsCount );
+
+  manager.reloadDataDir();
+  QCOMPARE( manager.projects().count(), projectsCount );
+  QCOMPARE( manager.reloadedProjectsCount(), 0 );
+
+  QElapsedTimer timer;
+  timer.start();
+  for ( int i = 0; i < projectsCount; ++i )
+  {
+    QString projectDir = dataDir + QStringLiteral( "/project%1" ).arg( i );
+    QString projectFilePath = projectDir + QStringLiteral( "/project%1.qgs" ).arg( i );
+    QCOMPARE( manager.projectFromMerginName( QStringLiteral( "project%1" ).arg( i ) ).projectDir, projectDir );
+    QCOMPARE( manager.projectFromDirectory( projectDir ).qgisProjectFilePath, projectFilePath );
+    QCOMPARE( manager.projectFromProjectFilePath( projectFilePath ).projectDir, projectDir );
+    QCOMPARE( manager.projectId( projectFilePath ), QStringLiteral( "project%1" ).arg( i ) );
+    QVERIFY( manager.projectIsValid( projectFilePath ) );
+  }
+  qDebug() << "lookups in" << projectsCount << "projects:" << timer.elapsed() << "ms";
+  QVERIFY( manager.projectFromMerginName( "missing" ).projectDir.isEmpty() );
+  QVERIFY( manager.projectFromDirectory( dataDir + "/missing" ).projectDir.isEmpty() );
+  QVERIFY( !manager.projectIsValid( dataDir + "/missing.qgs" ) );
+
+  // a project becomes a Mergin project, another one is added and another one removed
+  QString changedDir = dataDir + "/project1";
+  QVERIFY( QDir().mkpath( changedDir + "/.mergin" ) );
+  writeFileContent( changedDir + "/" + MerginApi::sMetadataFile, QByteArray( "{\"name\": \"renamed\", \"namespace\": \"testns\", \"version\": \"v3\", \"files\": []}" ) );
+  QString addedDir = dataDir + "/added";
+  QVERIFY( QDir().mkpath( addedDir ) );
+  writeFileContent( addedDir + "/added.qgz", QByteArray( "qgz" ) );
+  QVERIFY( QDir( dataDir + "/project2" ).removeRecursively() );
+
+  manager.reloadDataDir();
+  QCOMPARE( manager.reloadedProjectsCount(), 2 );
+  QCOMPARE( manager.projects().count(), projectsCount );
+  QVERIFY( manager.projectFromDirectory( dataDir + "/project2" ).projectDir.isEmpty() );
+  QCOMPARE( manager.projectFromMerginName( "added" ).qgisProjectFilePath, addedDir + "/added.qgz" );
+  QVERIFY( manager.projectFromMerginName( "project1" ).projectDir.isEmpty() );
+  LocalProject changed = manager.projectFromMerginName( "testns", "renamed" );
+  QCOMPARE( changed.projectDir, changedDir );
+  QCOMPARE( changed.localVersion, 3 );
+
+  // a second project file deeper in a project is only noticed once the folder has changed,
+  // but projects with an error are always read again
+  writeFileContent( dataDir + "/project3/data/other.qgs", QByteArray( "<qgis/>" ) );
+  writeFileContent( dataDir + "/project3/touch.txt", QByteArray( "x" ) );
+  manager.reloadDataDir();
+  QVERIFY( !manager.projectFromDirectory( dataDir + "/project3" ).projectError.isEmpty() );
+  QVERIFY( QFile::remove( dataDir + "/project3/data/other.qgs" ) );
+  manager.reloadDataDir();
+  QVERIFY( manager.projectFromDirectory( dataDir + "/project3" ).projectError.isEmpty() );
+
+  // the index follows changes made through the manager
+  manager.updateNamespace( changedDir, QStringLiteral( "otherns" ) );
+  QVERIFY( manager.projectFromMerginName( "testns", "renamed" ).projectDir.isEmpty() );
+  QCOMPARE( manager.projectFromMerginName( "otherns", "renamed" ).projectDir, changedDir );
+  manager.updateLocalVersion( changedDir, 4 );
+  QCOMPARE( manager.projectFromDirectory( changedDir ).localVersion, 4 );
+
+  manager.removeLocalProject( QStringLiteral( "project0" ) );
+  QVERIFY( !QFileInfo::exists( dataDir + "/project0" ) );
+  QVERIFY( manager.projectFromMerginName( "project0" ).projectDir.isEmpty() );
+  QCOMPARE( manager.projectFromMerginName( "project10" ).projectDir, dataDir + "/project10" );
+  QCOMPARE( manager.projects().count(), projectsCount - 1 );
+
+  manager.addLocalProject( dataDir + "/project0", QStringLiteral( "project0" ) );
+  QCOMPARE( manager.projectFromDirectory( dataDir + "/project0" ).projectName, QStringLiteral( "project0" ) );
+}
+
+void TestMerginApi::testProjectsModelMerge()
+{
+  // merged projects only update rows that differ, statuses needing a scan of the whole project arrive later
+
+  QString dataDir = mApi->projectsPath() + "/testProjectsModelMerge";
+  for ( int i = 0; i < 3; ++i )
+  {
+    QString projectDir = dataDir + QStringLiteral( "/p%1" ).arg( i );
+    QVERIFY( QDir().mkpath( projectDir + "/.mergin" ) );
+    writeFileContent( projectDir + QStringLiteral( "/p%1.qgs" ).arg( i ), QByteArray( "<qgis/>" ) );
+    // the project file is not in the metadata - it is a local change
+    writeFileContent( projectDir + "/" + MerginApi::sMetadataFile,
+                      QStringLiteral( "{\"name\": \"p%1\", \"namespace\": \"testns\", \"version\": \"v1\", \"files\": []}" ).arg( i ).toUtf8() );
+  }
+
+  LocalProjectsManager manager( dataDir );
+  ProjectsModel model;
+  model.setModelType( ProjectsModel::CreatedProjectsModel );
+  model.setMerginApi( mApi );
+  model.setLocalProjectsManager( &manager );
+
+  auto remoteProjects = []( const QList<int> &projectNumbers, int changedVersionOf = -1 )
+  {
+    MerginProjectsList projects;
+    for ( int i : projectNumbers )
+    {
+      MerginProject project;
+      project.projectName = QStringLiteral( "p%1" ).arg( i );
+      project.projectNamespace = QStringLiteral( "testns" );
+      project.serverVersion = i == changedVersionOf ? 2 : 1;
+      project.serverUpdated = QDateTime( QDate( 2021, 1, 1 ), QTime( 0, 0 ), Qt::UTC );
+      projects << project;
+    }
+    return projects;
+  };
+  auto rowIds = [&model]()
+  {
+    QStringList ids;
+    for ( int row = 0; row < model.rowCount(); ++row )
+      ids << model.data( model.index( row ), ProjectsModel::ProjectId ).toString();
+    return ids;
+  };
+  auto rowStatus = [&model]( int row )
+  {
+    return model.data( model.index( row ), ProjectsModel::ProjectSyncStatus ).toInt();
+  };
+  auto rowChecking = [&model]( int row )
+  {
+    return model.data( model.index( row ), ProjectsModel::ProjectCheckingChanges ).toBool();
+  };
+
+  QSignalSpy spyReset( &model, &ProjectsModel::modelReset );
+  QSignalSpy spyInserted( &model, &ProjectsModel::rowsInserted );
+  QSignalSpy spyRemoved( &model, &ProjectsModel::rowsRemoved );
+  QSignalSpy spyMoved( &model, &ProjectsModel::rowsMoved );
+  QSignalSpy spyChanged( &model, &ProjectsModel::dataChanged );
+
+  // local changes are not known yet - the projects get scanned in the background
+  model.mergeProjects( remoteProjects( { 0, 1, 2, 3, 4 } ), Transactions() );
+  QCOMPARE( model.rowCount(), 5 );
+  QCOMPARE( spyInserted.count(), 1 );
+  QVERIFY( model.hasPendingStatusScans() );
+  QVERIFY( rowChecking( 0 ) );
+  QVERIFY( !rowChecking( 3 ) );
+  QCOMPARE( rowStatus( 3 ), static_cast<int>( ProjectStatus::NoVersion ) );
+
+  QTRY_VERIFY( !model.hasPendingStatusScans() );
+  for ( int row = 0; row < 3; ++row )
+  {
+    QCOMPARE( rowStatus( row ), static_cast<int>( ProjectStatus::Modified ) );
+    QVERIFY( !rowChecking( row ) );
+  }
+  QCOMPARE( spyChanged.count(), 3 );
+  QCOMPARE( spyChanged.first().at( 2 ).value< QVector<int> >(), QVector<int>() << ProjectsModel::ProjectSyncStatus << ProjectsModel::ProjectCheckingChanges );
+  QVERIFY( manager.changeTracker().isBaselineKnown( dataDir + "/p0" ) );
+
+  // the same projects again - nothing to report, statuses come from the tracker right away
+  spyInserted.clear();
+  spyChanged.clear();
+  model.mergeProjects( remoteProjects( { 0, 1, 2, 3, 4 } ), Transactions() );
+  QVERIFY( !model.hasPendingStatusScans() );
+  QCOMPARE( spyInserted.count(), 0 );
+  QCOMPARE( spyChanged.count(), 0 );
+  QCOMPARE( rowStatus( 1 ), static_cast<int>( ProjectStatus::Modified ) );
+
+  // a project scanned again keeps its last known status meanwhile
+  manager.changeTracker().forgetProject( dataDir + "/p1" );
+  model.mergeProjects( remoteProjects( { 0, 1, 2, 3, 4 } ), Transactions() );
+  QVERIFY( model.hasPendingStatusScans() );
+  QCOMPARE( rowStatus( 1 ), static_cast<int>( ProjectStatus::Modified ) );
+  QVERIFY( !rowChecking( 1 ) );
+  QTRY_VERIFY( !model.hasPendingStatusScans() );
+  QCOMPARE( rowStatus( 1 ), static_cast<int>( ProjectStatus::Modified ) );
+  QCOMPARE( spyChanged.count(), 0 );
+
+  // removed, moved and changed projects
+  model.mergeProjects( remoteProjects( { 4, 0, 1, 3 }, 0 ), Transactions() );
+  QCOMPARE( rowIds(), QStringList() << "testns/p4" << "testns/p0" << "testns/p1" << "testns/p3" );
+  QCOMPARE( spyRemoved.count(), 1 );
+  QCOMPARE( spyMoved.count(), 1 );
+  QCOMPARE( spyInserted.count(), 0 );
+  QCOMPARE( spyChanged.count(), 1 );
+  QCOMPARE( spyChanged.first().at( 0 ).value<QModelIndex>().row(), 1 );
+  QCOMPARE( model.projectFromId( "testns/p0" )->mergin->serverVersion, 2 );
+
+  // next page is appended
+  model.mergeProjects( remoteProjects( { 5, 6 } ), Transactions(), true );
+  QCOMPARE( model.rowCount(), 6 );
+  QCOMPARE( spyInserted.count(), 1 );
+  QCOMPARE( spyReset.count(), 0 );
+
+  // lists of many projects are joined by their names
+  const int manyCount = 5000;
+  QList<int> manyNumbers;
+  for ( int i = 0; i < manyCount; ++i )
+    manyNumbers << i;
+  MerginProjectsList manyProjects = remoteProjects( manyNumbers );
+  QElapsedTimer timer;
+  timer.start();
+  model.mergeProjects( manyProjects, Transactions() );
+  qDebug() << "merge of" << manyCount << "projects:" << timer.elapsed() << "ms";
+  QCOMPARE( model.rowCount(), manyCount );
+  QVERIFY( model.projectFromId( "testns/p2" )->isLocal() );
+  QVERIFY( !model.projectFromId( "testns/p3" )->isLocal() );
+  QCOMPARE( spyReset.count(), 0 );
+
+  // a list in another order is reset rather than reordered row by row
+  std::reverse( manyProjects.begin(), manyProjects.end() );
+  timer.restart();
+  model.mergeProjects( manyProjects, Transactions() );
+  qDebug() << "merge of" << manyCount << "reversed projects:" << timer.elapsed() << "ms";
+  QCOMPARE( spyReset.count(), 1 );
+  QCOMPARE( model.rowCount(), manyCount );
+  QCOMPARE( model.data( model.index( 0 ), ProjectsModel::ProjectId ).toString(), QStringLiteral( "testns/p%1" ).arg( manyCount - 1 ) );
+  QVERIFY( model.projectFromId( "testns/p2" )->isLocal() );
+
+  // local projects model keeps local projects and finds their remote part
+  ProjectsModel localModel;
+  localModel.setModelType( ProjectsModel::LocalProjectsModel );
+  localModel.setMerginApi( mApi );
+  localModel.setLocalProjectsManager( &manager );
+  QCOMPARE( localModel.rowCount(), 3 );
+  localModel.mergeProjects( remoteProjects( { 1, 7 }, 1 ), Transactions() );
+  QCOMPARE( localModel.rowCount(), 3 );
+  QCOMPARE( localModel.projectFromId( "testns/p1" )->mergin->serverVersion, 2 );
+  QVERIFY( localModel.projectFromId( "testns/p0" )->isMergin() );
+  QVERIFY( !localModel.projectFromId( "testns/p7" ) );
+  QTRY_VERIFY( !localModel.hasPendingStatusScans() );
+}
+
+void TestMerginApi::testLocalProjectFilesParallel()
+{
+  // compares serial and parallel scan of projects - results must be the same, timing is printed
+
+  auto compareScans = [this]( const QString & projectPath )
+  {
+    QElapsedTimer timer;
+    timer.start();
+    QList<MerginFile> serialFiles = MerginApi::getLocalProjectFiles( projectPath, false );
+    qint64 serialMs = timer.restart();
+    QList<MerginFile> parallelFiles = MerginApi::getLocalProjectFiles( projectPath, true );
+    qint64 parallelMs = timer.elapsed();
+
+    qDebug() << "getLocalProjectFiles" << projectPath << serialFiles.count() << "files:"
+             << "serial" << serialMs << "ms, parallel" << parallelMs << "ms";
+
+    QCOMPARE( parallelFiles.count(), serialFiles.count() );
+    for ( int i = 0; i < serialFiles.count(); ++i )
+    {
+      QCOMPARE( parallelFiles.at( i ).path, serialFiles.at( i ).path );
+      QCOMPARE( parallelFiles.at( i ).checksum, serialFiles.at( i ).checksum );
+      QCOMPARE( parallelFiles.at( i ).size, serialFiles.at( i ).size );
+      QCOMPARE( parallelFiles.at( i ).mtime, serialFiles.at( i ).mtime );
+    }
+  };
+
+  // projects from test data (these have no .mergin dir, so nothing gets cached)
+  compareScans( mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+  compareScans( mTestDataPath + "/planes/" );
+  compareScans( mTestDataPath + "/" );
+
+  // synthetic tree with 5000 files in 50 folders
+  QString projectDir = mApi->projectsPath() + "/testLocalProjectFilesParallel";
+  for ( int d = 0; d < 50; ++d )
+  {
+    QString subDir = QStringLiteral( "%1/dir%2" ).arg( projectDir ).arg( d );
+    QVERIFY( QDir().mkpath( subDir ) );
+    for ( int f = 0; f < 100; ++f )
+    {
+      QByteArray content( 4096 + f, static_cast<char>( 'a' + ( d + f ) % 26 ) );
+      writeFileContent( QStringLiteral( "%1/file%2.dat" ).arg( subDir ).arg( f ), content );
+    }
+  }
+  compareScans( projectDir + "/" );
+}
+
+//! Parses project info by reading the whole document first - like before there was MerginProjectMetadataReader
+static MerginProjectMetadata metadataFromDocument( const QByteArray &data )
+{
+  MerginProjectMetadata project;
+  QJsonDocument doc = QJsonDocument::fromJson( data );
+  if ( !doc.isObject() )
+    return project;
+
+  QJsonObject docObj = doc.object();
+  const QJsonArray files = docObj.value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &file : files )
+    project.files << MerginFile::fromJsonObject( file.toObject() );
+
+  project.name = docObj.value( QStringLiteral( "name" ) ).toString();
+  project.projectNamespace = docObj.value( QStringLiteral( "namespace" ) ).toString();
+  const QJsonArray writersnames = docObj.value( QStringLiteral( "access" ) ).toObject().value( QStringLiteral( "writersnames" ) ).toArray();
+  for ( const QJsonValue &name : writersnames )
+    project.writersnames << name.toString();
+
+  QString versionStr = docObj.value( QStringLiteral( "version" ) ).toString();
+  project.version = versionStr.isEmpty() ? 0 : versionStr.mid( 1 ).toInt();
+  return project;
+}
+
+//! Parses project info passed to the reader in parts of given size
+static MerginProjectMetadata metadataFromParts( const QByteArray &data, int partSize )
+{
+  MerginProjectMetadataReader reader;
+  for ( int pos = 0; pos < data.size(); pos += partSize )
+    reader.addData( data.mid( pos, partSize ) );
+  return reader.metadata();
+}
+
+static void compareMetadata( const MerginProjectMetadata &metadata, const MerginProjectMetadata &expected )
+{
+  QCOMPARE( metadata.name, expected.name );
+  QCOMPARE( metadata.projectNamespace, expected.projectNamespace );
+  QCOMPARE( metadata.version, expected.version );
+  QCOMPARE( metadata.writersnames, expected.writersnames );
+  QCOMPARE( metadata.files.count(), expected.files.count() );
+  for ( int i = 0; i < expected.files.count(); ++i )
+  {
+    const MerginFile &file = metadata.files.at( i );
+    const MerginFile &expectedFile = expected.files.at( i );
+    QCOMPARE( file.path, expectedFile.path );
+    QCOMPARE( file.checksum, expectedFile.checksum );
+    QCOMPARE( file.size, expectedFile.size );
+    QCOMPARE( file.mtime, expectedFile.mtime );
+    QCOMPARE( file.pullCanUseDiff, expectedFile.pullCanUseDiff );
+    QCOMPARE( file.pullDiffFiles, expectedFile.pullDiffFiles );
+  }
+}
+
+void TestMerginApi::testStreamingJsonParser()
+{
+  // project info and project lists read in parts (as they arrive) must give the same result as parsing the whole document
+
+  QByteArray info = R"({
+    "name": "stream\u00e9d \"project\"",
+    "namespace": "test\/ns",
+    "version": "v12",
+    "created": "2021-03-01T10:20:30.123Z",
+    "access": { "ownersnames": [ "alice" ], "writersnames": [ "alice", "b\u00f6b", "\ud83d\ude00" ], "public": false },
+    "files": [
+      {
+        "path": "data.gpkg", "checksum": "89bd0c2b", "size": 5368721579, "mtime": "2021-03-01T10:20:30.123Z",
+        "history": {
+          "v11": { "diff": { "path": "data.gpkg-diff-1", "size": 10 }, "change": "updated" },
+          "v10": { "diff": { "path": "data.gpkg-diff-0", "size": 20 }, "change": "updated" },
+          "v12": { "diff": { "path": "data.gpkg-diff-2", "size": 3000000000 }, "change": "updated" }
+        }
+      },
+      { "path": "full.gpkg", "size": 1, "history": { "v9": { "diff": { "size": 5 } }, "v10": { "change": "updated" } } },
+      { "path": "empty history.txt", "size": 0, "history": {} },
+      { "path": "dir\\sub/\u00fcn\u00efcode\ttab.txt", "size": 7.0, "extra": [ 1, -2.5e3, true, false, null, { "a": [] } ] }
+    ]
+  })";
+
+  MerginProjectMetadata expected = metadataFromDocument( info );
+  QCOMPARE( expected.files.count(), 4 );
+  QCOMPARE( expected.writersnames.count(), 3 );
+  QVERIFY( expected.files.at( 0 ).pullCanUseDiff );
+  QVERIFY( !expected.files.at( 1 ).pullCanUseDiff );
+
+  compareMetadata( MerginProjectMetadata::fromJson( info ), expected );
+  for ( int partSize : { 1, 2, 7, 64 } )
+    compareMetadata( metadataFromParts( info, partSize ), expected );
+
+  // history sent out of order is still applied from the oldest version
+  QList< QPair<int, qint64> > expectedDiffs;
+  expectedDiffs << qMakePair( 10, qint64( 20 ) ) << qMakePair( 11, qint64( 10 ) ) << qMakePair( 12, Q_INT64_C( 3000000000 ) );
+  QCOMPARE( MerginProjectMetadata::fromJson( info ).files.at( 0 ).pullDiffFiles, expectedDiffs );
+
+  // invalid content gives invalid metadata
+  QVERIFY( !MerginProjectMetadata::fromJson( info.left( info.size() - 3 ) ).isValid() );
+  QVERIFY( !MerginProjectMetadata::fromJson( "[ { \"name\": \"a\", \"namespace\": \"b\" } ]" ).isValid() );
+  QCOMPARE( MerginProjectMetadata::fromJson( "not json" ).version, -1 );
+  QVERIFY( !MerginProjectMetadata::fromJson( "{ \"name\": \"a\" \"namespace\": \"b\" }" ).isValid() );
+  QVERIFY( !MerginProjectMetadata::fromJson( "{ \"name\": \"a\", \"namespace\": \"b\" } }" ).isValid() );
+  QVERIFY( !MerginProjectMetadata::fromJson( "{ \"name\": \"a\", \"namespace\": \"b\", \"files\": [ tru ] }" ).isValid() );
+  QVERIFY( MerginProjectMetadata::fromJson( "{ \"name\": \"a\", \"namespace\": \"b\" }" ).isValid() );
+
+  // listProjects reply (one page of the projects)
+  QByteArray listReply = R"({ "count": 42, "projects": [
+    { "name": "p1", "namespace": "ns", "version": "v3", "updated": "2021-01-01T10:00:00Z", "access": { "public": true }, "tags": [ "valid_qgis" ] },
+    { "name": "p2", "namespace": "ns", "version": "", "created": "2020-01-01T10:00:00Z" }
+  ] })";
+  for ( int partSize : { 1, 5, listReply.size() } )
+  {
+    MerginProjectsListReader reader;
+    for ( int pos = 0; pos < listReply.size(); pos += partSize )
+      QVERIFY( reader.addData( listReply.mid( pos, partSize ) ) );
+    QVERIFY( reader.finish() );
+    QCOMPARE( reader.count(), 42 );
+
+    MerginProjectsList projects = mApi->parseProjectsList( reader );
+    QCOMPARE( projects.count(), 2 );
+    QCOMPARE( projects.at( 0 ).id(), QStringLiteral( "ns/p1" ) );
+    QCOMPARE( projects.at( 0 ).serverVersion, 3 );
+    QCOMPARE( projects.at( 0 ).serverUpdated, QDateTime( QDate( 2021, 1, 1 ), QTime( 10, 0 ), Qt::UTC ) );
+    QCOMPARE( projects.at( 1 ).id(), QStringLiteral( "ns/p2" ) );
+    QCOMPARE( projects.at( 1 ).serverVersion, 0 );
+    QCOMPARE( projects.at( 1 ).serverUpdated, QDateTime( QDate( 2020, 1, 1 ), QTime( 10, 0 ), Qt::UTC ) );
+  }
+
+  // listProjectsByName reply - projects are ordered by names, failed ones get their names from the reply
+  QByteArray byNameReply = R"({ "ns/b": { "name": "b", "namespace": "ns", "version": "v1" }, "ns/a": { "error": 403 } })";
+  MerginProjectsListReader byNameReader;
+  QVERIFY( byNameReader.addData( byNameReply ) );
+  QVERIFY( byNameReader.finish() );
+  MerginProjectsList byNameProjects = mApi->parseProjectsList( byNameReader );
+  QCOMPARE( byNameProjects.count(), 2 );
+  QCOMPARE( byNameProjects.at( 0 ).id(), QStringLiteral( "ns/a" ) );
+  QVERIFY( !byNameProjects.at( 0 ).remoteError.isEmpty() );
+  QCOMPARE( byNameProjects.at( 1 ).id(), QStringLiteral( "ns/b" ) );
+  QCOMPARE( byNameProjects.at( 1 ).serverVersion, 1 );
+
+  MerginProjectsListReader invalidReader;
+  invalidReader.addData( "{ \"count\": 1, \"projects\": [ {} " );
+  QVERIFY( !invalidReader.finish() );
+
+  // project info of a real project, as stored to .mergin/mergin.json
+  QString projectName = "testStreamingJsonParser";
+  createRemoteProject( mApiExtra, mUsername, projectName, mTestDataPath + "/" + TEST_PROJECT_NAME + "/" );
+  downloadRemoteProject( mApi, mUsername, projectName );
+
+  QFile metadataFile( mApi->projectsPath() + "/" + projectName + "/" + MerginApi::sMetadataFile );
+  QVERIFY( metadataFile.open( QIODevice::ReadOnly ) );
+  QByteArray serverInfo = metadataFile.readAll();
+  MerginProjectMetadata expectedServer = metadataFromDocument( serverInfo );
+  QVERIFY( expectedServer.isValid() );
+  QVERIFY( !expectedServer.files.isEmpty() );
+  compareMetadata( MerginProjectMetadata::fromJson( serverInfo ), expectedServer );
+  compareMetadata( metadataFromParts( serverInfo, 3 ), expectedServer );
+
+  // synthetic project info of 50k files, each with a history of diffs - timing is printed
+  QJsonArray filesArray;
+  for ( int i = 0; i < 50000; ++i )
+  {
+    QJsonObject history;
+    for ( int v = 1; v <= 3; ++v )
+    {
+      QJsonObject diff;
+      diff.insert( QStringLiteral( "path" ), QStringLiteral( "file%1.gpkg-diff-%2" ).arg( i ).arg( v ) );
+      diff.insert( QStringLiteral( "size" ), 1000 + i + v );
+      QJsonObject entry;
+      entry.insert( QStringLiteral( "diff" ), diff );
+      entry.insert( QStringLiteral( "change" ), QStringLiteral( "updated" ) );
+      history.insert( QStringLiteral( "v%1" ).arg( v ), entry );
+    }
+    QJsonObject fileObject;
+    fileObject.insert( QStringLiteral( "path" ), QStringLiteral( "dir%1/file%2.gpkg" ).arg( i % 100 ).arg( i ) );
+    fileObject.insert( QStringLiteral( "checksum" ), QString::number( qHash( i ), 16 ) );
+    fileObject.insert( QStringLiteral( "size" ), 4096 + i );
+    fileObject.insert( QStringLiteral( "mtime" ), QStringLiteral( "2021-03-01T10:20:30.123Z" ) );
+    fileObject.insert( QStringLiteral( "history" ), history );
+    filesArray.append( fileObject );
+  }
+  QJsonObject manifest;
+  manifest.insert( QStringLiteral( "name" ), QStringLiteral( "large" ) );
+  manifest.insert( QStringLiteral( "namespace" ), mUsername );
+  manifest.insert( QStringLiteral( "version" ), QStringLiteral( "v3" ) );
+  manifest.insert( QStringLiteral( "files" ), filesArray );
+  QByteArray manifestData = QJsonDocument( manifest ).toJson( QJsonDocument::Compact );
+
+  QElapsedTimer timer;
+  timer.start();
+  MerginProjectMetadata documentMetadata = metadataFromDocument( manifestData );
+  qint64 documentMs = timer.restart();
+  MerginProjectMetadata streamedMetadata = MerginProjectMetadata::fromJson( manifestData );
+  qint64 streamedMs = timer.restart();
+  MerginProjectMetadata partsMetadata = metadataFromParts( manifestData, 16 * 1024 );
+  qint64 partsMs = timer.elapsed();
+
+  qDebug() << "project info of" << documentMetadata.files.count() << "files (" << manifestData.size() / 1024 << "kB ):"
+           << "whole document" << documentMs << "ms, streamed" << streamedMs << "ms, in 16 kB parts" << partsMs << "ms";
+
+  QCOMPARE( documentMetadata.files.count(), 50000 );
+  QCOMPARE( documentMetadata.files.at( 12345 ).pullDiffFiles.count(), 3 );
+  compareMetadata( streamedMetadata, documentMetadata );
+  compareMetadata( partsMetadata, documentMetadata );
+}
+
 //////// HELPER FUNCTIONS ////////
 
 MerginProjectsList TestMerginApi::getProjectList( QString tag )
@@ -2396,6 +4049,22 @@ void TestMerginApi::uploadRemoteProject( MerginApi *api, const QString &projectN
   serverVersion = serverVersionFromSpy( spy );
 }
 
+std::shared_ptr<TestingMerginServer> TestMerginApi::startStandInServer()
+{
+  QString apiRoot = mApi->mApiRoot;
+  std::shared_ptr<TestingMerginServer> server( new TestingMerginServer, [this, apiRoot]( TestingMerginServer * server )
+  {
+    mApi->mApiRoot = apiRoot;
+    delete server;
+  } );
+
+  if ( !server->start() )
+    return nullptr;
+
+  mApi->mApiRoot = server->apiRoot();
+  return server;
+}
+
 void TestMerginApi::writeFileContent( const QString &filename, const QByteArray &data )
 {
   QFile f( filename );
@@ -2443,6 +4112,7 @@ void TestMerginApi::refreshProjectsModel( const ProjectsModel::ProjectModelTypes
     mLocalProjectsModel->listProjects();
     QVERIFY( spy.wait( TestUtils::SHORT_REPLY ) );
     QCOMPARE( spy.count(), 1 );
+    QTRY_VERIFY( !mLocalProjectsModel->hasPendingStatusScans() );
   }
   else if ( modelType == ProjectsModel::CreatedProjectsModel )
   {
@@ -2450,5 +4120,6 @@ void TestMerginApi::refreshProjectsModel( const ProjectsModel::ProjectModelTypes
     mCreatedProjectsModel->listProjects();
     QVERIFY( spy.wait( TestUtils::SHORT_REPLY ) );
     QCOMPARE( spy.count(), 1 );
+    QTRY_VERIFY( !mCreatedProjectsModel->hasPendingStatusScans() );
   }
 }
@@ -20,6 +20,8 @@
 
 #include <qgsapplication.h>
 
+class TestingMerginServer;
+
 class TestMerginApi: public QObject
 {
     Q_OBJECT
@@ -45,6 +47,13 @@ class TestMerginApi: public QObject
     void testCreateDeleteProject();
     void testUploadProject();
     void testMultiChunkUploadDownload();
+    void testParallelChunkPull();
+    void testParallelChunkPush();
+    void testResumePull();
+    void testResumePush();
+    void testSyncQueue();
+    void testCompressedTransfer();
+    void testChunkDedupPush();
     void testEmptyFileUploadDownload();
     void testPushAddedFile();
     void testPushRemovedFile();
@@ -78,6 +87,20 @@ class TestMerginApi: public QObject
 
     // mergin functions
     void testExcludeFromSync();
+    void testChecksumCache();
+    void testSyncJournal();
+    void testSyncScheduler();
+    void testTransferCompression();
+    void testUploadRetryDelay();
+    void testContentChunker();
+    void testProjectChangeTracker();
+    void testChangesetSession();
+    void testProjectMetadataStore();
+    void testLargeFileTransfer();
+    void testLocalProjectsManagerReload();
+    void testProjectsModelMerge();
+    void testLocalProjectFilesParallel();
+    void testStreamingJsonParser();
 
   private:
     MerginApi *mApi;
@@ -106,6 +129,9 @@ class TestMerginApi: public QObject
     void uploadRemoteProject( MerginApi *api, const QString &projectNamespace, const QString &projectName, int &serverVersion );
     void uploadRemoteProject( MerginApi *api, const QString &projectNamespace, const QString &projectName );
 
+    //! Starts a local stand-in server (null if it fails), mApi syncs with it instead of the test server until the server is destroyed
+    std::shared_ptr<TestingMerginServer> startStandInServer();
+
     //! Deletes a project from the local drive
     void deleteLocalProject( MerginApi *api, const QString &projectNamespace, const QString &projectName );
 
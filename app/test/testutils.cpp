@@ -8,6 +8,7 @@
  ***************************************************************************/
 
 #include "QtDebug"
+#include <QFile>
 
 #include "testutils.h"
 #include "merginapi.h"
@@ -35,3 +36,30 @@ QString TestUtils::testDataDir()
   QString dataDir( TEST_DATA_DIR );
   return dataDir;
 }
+
+qint64 TestUtils::memoryUsage( bool peak )
+{
+  QFile file( QStringLiteral( "/proc/self/status" ) );
+  if ( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    return -1;
+
+  const QByteArray key = peak ? "VmHWM:" : "VmRSS:";
+  while ( !file.atEnd() )
+  {
+    QByteArray line = file.readLine();
+    if ( line.startsWith( key ) )
+    {
+      // e.g. "VmRSS:     12345 kB"
+      return line.mid( key.size() ).trimmed().split( ' ' ).first().toLongLong() * 1024;
+    }
+  }
+  return -1;
+}
+
+void TestUtils::resetPeakMemoryUsage()
+{
+  // writing "5" to clear_refs resets the peak RSS (Linux >= 4.0)
+  QFile file( QStringLiteral( "/proc/self/clear_refs" ) );
+  if ( file.open( QIODevice::WriteOnly ) )
+    file.write( "5" );
+}
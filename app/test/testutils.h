@@ -20,6 +20,15 @@ namespace TestUtils
 
   void mergin_auth( QString &apiRoot, QString &username, QString &password );
   QString testDataDir();
+
+  /**
+   * Returns resident set size of the process in bytes (peak since the last resetPeakMemoryUsage() call
+   * if \a peak is true). Returns -1 where this information is not available (only Linux is supported).
+   */
+  qint64 memoryUsage( bool peak = false );
+
+  //! Resets the peak resident set size of the process (if supported)
+  void resetPeakMemoryUsage();
 }
 
 #define COMPARENEAR(actual, expected, epsilon) \
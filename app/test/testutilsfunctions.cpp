@@ -8,6 +8,9 @@
  ***************************************************************************/
 
 #include "testutilsfunctions.h"
+
+#include <atomic>
+
 #include <QApplication>
 #include <QDesktopWidget>
 
@@ -19,11 +22,17 @@
 #include "qgspointxy.h"
 #include "qgis.h"
 #include "qgsunittypes.h"
+#include "qgsvectorfilewriter.h"
+#include "qgsvectorlayer.h"
 
 #include "testutils.h"
+#include "coreutils.h"
+#include "logsink.h"
+#include "merginapi.h"
 
 #include <QtTest/QtTest>
 #include <QtCore/QObject>
+#include <QtConcurrent>
 
 const int DAY_IN_SECS = 60 * 60 * 24;
 const int MONTH_IN_SECS = 60 * 60 * 24 * 31;
@@ -268,3 +277,271 @@ void TestUtilsFunctions::resolveTargetDir()
   QString resultDir3 = mUtils->resolveTargetDir( homePath, config, pair, QgsProject::instance() );
   QCOMPARE( resultDir3, QStringLiteral( "%1/photos" ).arg( projectDir ) );
 }
+
+//! Returns lines of the file without trailing new lines
+static QStringList readLines( const QString &path )
+{
+  QFile file( path );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return QStringList();
+  return QString::fromUtf8( file.readAll() ).split( '\n', QString::SkipEmptyParts );
+}
+
+void TestUtilsFunctions::logFormat()
+{
+  QTemporaryDir dir;
+  const QString logPath = dir.filePath( QStringLiteral( ".logs" ) );
+  const QString previousLogPath = CoreUtils::logFilename();
+  CoreUtils::setLogFilename( logPath );
+
+  const QDateTime before = QDateTime::currentDateTimeUtc();
+  CoreUtils::log( QStringLiteral( "pull test" ), QStringLiteral( "Finished: 2 files, 100 bytes" ) );
+  CoreUtils::log( QStringLiteral( "push test" ), QStringLiteral( "Failed" ), LogSink::Warning );
+  CoreUtils::flushLog();
+
+  CoreUtils::setLogFilename( previousLogPath );
+
+  QStringList lines = readLines( logPath );
+  QCOMPARE( lines.count(), 2 );
+
+  // "<UTC timestamp with ms> <topic>: <message>"
+  QRegularExpression re( QStringLiteral( "^(\\S+) pull test: Finished: 2 files, 100 bytes$" ) );
+  QRegularExpressionMatch match = re.match( lines.at( 0 ) );
+  QVERIFY( match.hasMatch() );
+  QDateTime timestamp = QDateTime::fromString( match.captured( 1 ), Qt::ISODateWithMs );
+  QVERIFY( timestamp.isValid() );
+  QCOMPARE( timestamp.timeSpec(), Qt::UTC );
+  QVERIFY( qAbs( timestamp.msecsTo( before ) ) < 60000 );
+  QCOMPARE( QString::fromUtf8( LogSink::formatLine( timestamp.toMSecsSinceEpoch(), QStringLiteral( "pull test" ), QStringLiteral( "Finished: 2 files, 100 bytes" ) ) ).trimmed(), lines.at( 0 ) );
+
+  QVERIFY( lines.at( 1 ).endsWith( QStringLiteral( " push test: WARNING: Failed" ) ) );
+}
+
+void TestUtilsFunctions::logLevels()
+{
+  QTemporaryDir dir;
+  const QString logPath = dir.filePath( QStringLiteral( ".logs" ) );
+
+  LogSink sink;
+  sink.setPath( logPath );
+
+  QVERIFY( !sink.log( QStringLiteral( "topic" ), QStringLiteral( "debug" ), LogSink::Debug ) );
+  QVERIFY( sink.log( QStringLiteral( "topic" ), QStringLiteral( "info" ) ) );
+
+  sink.setTopicLevel( QStringLiteral( "noisy" ), LogSink::Error );
+  sink.setTopicLevel( QStringLiteral( "verbose" ), LogSink::Debug );
+  QVERIFY( !sink.log( QStringLiteral( "noisy" ), QStringLiteral( "info" ) ) );
+  QVERIFY( sink.log( QStringLiteral( "noisy" ), QStringLiteral( "error" ), LogSink::Error ) );
+  QVERIFY( sink.log( QStringLiteral( "verbose" ), QStringLiteral( "debug" ), LogSink::Debug ) );
+
+  sink.clearTopicLevel( QStringLiteral( "noisy" ) );
+  QVERIFY( sink.log( QStringLiteral( "noisy" ), QStringLiteral( "info" ) ) );
+  sink.flush();
+
+  QStringList lines = readLines( logPath );
+  QCOMPARE( lines.count(), 4 );
+  QVERIFY( lines.at( 0 ).endsWith( QStringLiteral( " topic: info" ) ) );
+  QVERIFY( lines.at( 1 ).endsWith( QStringLiteral( " noisy: ERROR: error" ) ) );
+  QVERIFY( lines.at( 2 ).endsWith( QStringLiteral( " verbose: DEBUG: debug" ) ) );
+  QVERIFY( lines.at( 3 ).endsWith( QStringLiteral( " noisy: info" ) ) );
+
+  // nothing is written to "dev null"
+  sink.setPath( CoreUtils::LOG_TO_DEVNULL );
+  QVERIFY( !sink.log( QStringLiteral( "topic" ), QStringLiteral( "info" ) ) );
+}
+
+void TestUtilsFunctions::logRotation()
+{
+  QTemporaryDir dir;
+  const QString logPath = dir.filePath( QStringLiteral( ".logs" ) );
+
+  LogSink sink;
+  sink.setPath( logPath );
+  sink.setMaxFileSize( 1000 );
+  sink.setMaxRotatedFiles( 2 );
+
+  const QString message( 100, 'x' );
+  for ( int i = 0; i < 30; ++i )
+  {
+    sink.log( QStringLiteral( "topic" ), message );
+    sink.flush(); // one batch per entry
+  }
+
+  QVERIFY( QFileInfo( logPath ).size() <= 1000 );
+  QVERIFY( QFileInfo::exists( LogSink::rotatedFilePath( logPath, 1 ) ) );
+  QVERIFY( QFileInfo::exists( LogSink::rotatedFilePath( logPath, 2 ) ) );
+  QVERIFY( !QFileInfo::exists( LogSink::rotatedFilePath( logPath, 3 ) ) );
+  QVERIFY( QFileInfo( LogSink::rotatedFilePath( logPath, 1 ) ).size() > 1000 );
+}
+
+void TestUtilsFunctions::logBeforePath()
+{
+  QTemporaryDir dir;
+  const QString logPath = dir.filePath( QStringLiteral( ".logs" ) );
+
+  LogSink sink;
+  QVERIFY( sink.log( QStringLiteral( "topic" ), QStringLiteral( "early" ) ) );
+  sink.flush(); // there is nowhere to write yet
+
+  sink.setPath( logPath );
+  QVERIFY( sink.log( QStringLiteral( "topic" ), QStringLiteral( "late" ) ) );
+  sink.flush();
+
+  QStringList lines = readLines( logPath );
+  QCOMPARE( lines.count(), 2 );
+  QVERIFY( lines.at( 0 ).endsWith( QStringLiteral( " topic: early" ) ) );
+  QVERIFY( lines.at( 1 ).endsWith( QStringLiteral( " topic: late" ) ) );
+}
+
+void TestUtilsFunctions::benchmarkLog()
+{
+  const int threadsCount = 4;
+  const int entriesCount = 20000;
+
+  QTemporaryDir dir;
+  const QString logPath = dir.filePath( QStringLiteral( ".logs" ) );
+
+  LogSink sink( 1 << 16 );
+  sink.setPath( logPath );
+  sink.setMaxFileSize( 0 );
+
+  std::atomic<int> dropped( 0 );
+  QBENCHMARK_ONCE
+  {
+    QList<QFuture<void>> futures;
+    for ( int t = 0; t < threadsCount; ++t )
+    {
+      futures << QtConcurrent::run( [&sink, &dropped, t]
+      {
+        for ( int i = 0; i < entriesCount; ++i )
+        {
+          if ( !sink.log( QStringLiteral( "pull test" ), QStringLiteral( "Downloaded item %1 of thread %2" ).arg( i ).arg( t ) ) )
+            ++dropped;
+        }
+      } );
+    }
+    for ( QFuture<void> &future : futures )
+      future.waitForFinished();
+    sink.flush();
+  }
+
+  // entries of each thread are written in order, a note is written for dropped entries
+  QStringList lines = readLines( logPath );
+  QCOMPARE( lines.count() - ( dropped > 0 ? lines.filter( QStringLiteral( "entries were dropped" ) ).count() : 0 ), threadsCount * entriesCount - dropped );
+  qDebug() << "dropped" << dropped << "of" << threadsCount * entriesCount << "entries";
+}
+
+//! Creates an empty GeoPackage with "points" layer, journal mode is taken from OGR_SQLITE_JOURNAL
+static bool createPointsGeoPackage( const QString &path )
+{
+  QgsFields fields;
+  fields.append( QgsField( QStringLiteral( "name" ), QVariant::String ) );
+
+  QgsVectorFileWriter::SaveVectorOptions options;
+  options.driverName = QStringLiteral( "GPKG" );
+  options.layerName = QStringLiteral( "points" );
+  std::unique_ptr< QgsVectorFileWriter > writer( QgsVectorFileWriter::create( path, fields, QgsWkbTypes::Point, QgsCoordinateReferenceSystem( QStringLiteral( "EPSG:4326" ) ), QgsCoordinateTransformContext(), options ) );
+  return writer->hasError() == QgsVectorFileWriter::NoError;
+}
+
+//! Saves features one by one - the same way as the feature form does it (see AttributeController::commit())
+static bool saveFeatures( QgsVectorLayer *layer, int count )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    QgsFeature f( layer->fields() );
+    f.setAttribute( 0, QStringLiteral( "point %1" ).arg( i ) );
+    f.setGeometry( QgsGeometry( new QgsPoint( i % 360 - 180, i % 180 - 90 ) ) );
+
+    layer->startEditing();
+    layer->addFeature( f );
+    if ( !layer->commitChanges() )
+      return false;
+  }
+  return true;
+}
+
+void TestUtilsFunctions::checkpointGeoPackages()
+{
+  QTemporaryDir dir;
+  const QString path = dir.filePath( QStringLiteral( "points.gpkg" ) );
+
+  const QByteArray journalMode = qgetenv( "OGR_SQLITE_JOURNAL" );
+  qputenv( "OGR_SQLITE_JOURNAL", "WAL" );
+  QVERIFY( createPointsGeoPackage( path ) );
+
+  {
+    QgsVectorLayer layer( path + QStringLiteral( "|layername=points" ), QStringLiteral( "points" ), QStringLiteral( "ogr" ) );
+    QVERIFY( layer.isValid() );
+    QVERIFY( saveFeatures( &layer, 10 ) );
+
+    // the connection of the layer is still open, saved features are only in the -wal file
+    QVERIFY( QFileInfo( path + QStringLiteral( "-wal" ) ).size() > 0 );
+
+    QVERIFY( InputUtils::checkpointGeoPackages( dir.path() ) );
+    QCOMPARE( QFileInfo( path + QStringLiteral( "-wal" ) ).size(), 0 );
+
+    // the database file alone (as it would be hashed and uploaded) contains all the features
+    const QString copyPath = dir.filePath( QStringLiteral( "copy/points.gpkg" ) );
+    QVERIFY( QDir().mkpath( dir.filePath( QStringLiteral( "copy" ) ) ) );
+    QVERIFY( QFile::copy( path, copyPath ) );
+
+    QgsVectorLayer copy( copyPath + QStringLiteral( "|layername=points" ), QStringLiteral( "copy" ), QStringLiteral( "ogr" ) );
+    QVERIFY( copy.isValid() );
+    QCOMPARE( copy.featureCount(), 10 );
+
+    // nothing left to checkpoint
+    QVERIFY( InputUtils::checkpointGeoPackages( dir.path() ) );
+
+    // status checks compare the files with the metadata, they must not checkpoint (write) them
+    QVERIFY( saveFeatures( &layer, 1 ) );
+    const qint64 walSize = QFileInfo( path + QStringLiteral( "-wal" ) ).size();
+    QVERIFY( walSize > 0 );
+    ProjectDiff diff = MerginApi::localProjectChanges( dir.path() );
+    QVERIFY( diff.localAdded.contains( QStringLiteral( "points.gpkg" ) ) );
+    QCOMPARE( QFileInfo( path + QStringLiteral( "-wal" ) ).size(), walSize );
+  }
+
+  qputenv( "OGR_SQLITE_JOURNAL", journalMode );
+}
+
+void TestUtilsFunctions::benchmarkFeatureSavesDeleteJournal()
+{
+  benchmarkFeatureSaves( "DELETE" );
+}
+
+void TestUtilsFunctions::benchmarkFeatureSavesWalJournal()
+{
+  benchmarkFeatureSaves( "WAL" );
+}
+
+void TestUtilsFunctions::benchmarkFeatureSaves( const QByteArray &journalMode )
+{
+  const int featuresCount = 200;
+
+  QTemporaryDir dir;
+  const QString path = dir.filePath( QStringLiteral( "points.gpkg" ) );
+
+  const QByteArray originalJournalMode = qgetenv( "OGR_SQLITE_JOURNAL" );
+  qputenv( "OGR_SQLITE_JOURNAL", journalMode );
+  QVERIFY( createPointsGeoPackage( path ) );
+
+  {
+    QgsVectorLayer layer( path + QStringLiteral( "|layername=points" ), QStringLiteral( "points" ), QStringLiteral( "ogr" ) );
+    QVERIFY( layer.isValid() );
+
+    QBENCHMARK_ONCE
+    {
+      QVERIFY( saveFeatures( &layer, featuresCount ) );
+    }
+    QCOMPARE( layer.featureCount(), featuresCount );
+
+    // in WAL mode the cost of the checkpoint is paid once, when the project gets synced
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY( InputUtils::checkpointGeoPackages( dir.path() ) );
+    qDebug() << journalMode << "journal: checkpoint took" << timer.elapsed() << "ms";
+  }
+
+  qputenv( "OGR_SQLITE_JOURNAL", originalJournalMode );
+}
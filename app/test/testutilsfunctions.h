@@ -33,9 +33,18 @@ class TestUtilsFunctions: public QObject
     void getRelativePath();
     void resolvePhotoPath();
     void resolveTargetDir();
+    void logFormat(); // old-style log entries keep the format of the log file
+    void logLevels(); // entries below the level of their topic are not written
+    void logRotation(); // log file is rotated once it is over the size limit
+    void logBeforePath(); // entries logged before the path is set are not lost
+    void benchmarkLog(); // many entries logged from several threads
+    void checkpointGeoPackages(); // changes of a gpkg in WAL mode are moved to the database file
+    void benchmarkFeatureSavesDeleteJournal(); // features saved one by one to a gpkg with rollback journal
+    void benchmarkFeatureSavesWalJournal(); // features saved one by one to a gpkg in WAL mode
 
   private:
     void testFormatDuration( const QDateTime &t0, qint64 diffSecs, const QString &expectedResult );
+    void benchmarkFeatureSaves( const QByteArray &journalMode );
 
     InputUtils *mUtils;
 };
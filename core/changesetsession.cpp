@@ -0,0 +1,104 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "changesetsession.h"
+
+#include <QFile>
+#include <QtConcurrent>
+
+#include "coreutils.h"
+
+ChangesetSession::ChangesetSession( const QString &projectDir )
+  : mProjectDir( projectDir )
+{
+}
+
+ChangesetSession::~ChangesetSession()
+{
+  for ( auto it = mChangesets.constBegin(); it != mChangesets.constEnd(); ++it )
+  {
+    if ( !it->diffName.isEmpty() && !mTakenDiffs.contains( it.key() ) )
+      QFile::remove( mProjectDir + "/.mergin/" + it->diffName );
+  }
+}
+
+void ChangesetSession::prepare( const QStringList &filePaths )
+{
+  QStringList missing;
+  for ( const QString &filePath : filePaths )
+  {
+    if ( !mChangesets.contains( filePath ) && !missing.contains( filePath ) )
+      missing << filePath;
+  }
+  if ( missing.isEmpty() )
+    return;
+
+  // each GeoPackage is diffed against its own base file, they do not share anything
+  const QString projectDir = mProjectDir;
+  std::function<Changeset( const QString & )> create = [projectDir]( const QString & filePath )
+  {
+    return createChangeset( projectDir, filePath );
+  };
+
+  QList<Changeset> changesets;
+  if ( missing.count() > 1 )
+    changesets = QtConcurrent::blockingMapped< QList<Changeset> >( missing, create );
+  else
+    changesets << create( missing.first() );
+
+  for ( int i = 0; i < missing.count(); ++i )
+    mChangesets.insert( missing.at( i ), changesets.at( i ) );
+  mCreatedCount += missing.count();
+}
+
+ChangesetSession::Changeset ChangesetSession::changeset( const QString &filePath )
+{
+  auto it = mChangesets.constFind( filePath );
+  if ( it != mChangesets.constEnd() )
+    return *it;
+
+  prepare( QStringList() << filePath );
+  return mChangesets.value( filePath );
+}
+
+bool ChangesetSession::hasPendingChanges( const QString &filePath )
+{
+  Changeset fileChangeset = changeset( filePath );
+  if ( !fileChangeset.isValid() )
+    return true;  // something went wrong - let's assume the file has changed
+
+  return !fileChangeset.summary.isEmpty();
+}
+
+QString ChangesetSession::takeDiff( const QString &filePath )
+{
+  Changeset fileChangeset = changeset( filePath );
+  if ( fileChangeset.result != GEODIFF_SUCCESS || mTakenDiffs.contains( filePath ) )
+    return QString();
+
+  mTakenDiffs.insert( filePath );
+  return fileChangeset.diffName;
+}
+
+ChangesetSession::Changeset ChangesetSession::createChangeset( const QString &projectDir, const QString &filePath )
+{
+  Changeset fileChangeset;
+  fileChangeset.result = GeodiffUtils::createChangeset( projectDir, filePath, fileChangeset.diffName );
+  if ( fileChangeset.result == GEODIFF_SUCCESS )
+  {
+    fileChangeset.summaryValid = GeodiffUtils::readChangesetSummary( projectDir + "/.mergin/" + fileChangeset.diffName, fileChangeset.summary );
+    if ( !fileChangeset.summaryValid )
+      CoreUtils::log( "changeset session", QStringLiteral( "Failed to read changeset summary of %1 in %2" ).arg( filePath, projectDir ) );
+  }
+  else
+  {
+    CoreUtils::log( "changeset session", QStringLiteral( "Geodiff create changeset on %1 in %2 FAILED with error %3" ).arg( filePath, projectDir ).arg( fileChangeset.result ) );
+  }
+  return fileChangeset;
+}
@@ -0,0 +1,77 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHANGESETSESSION_H
+#define CHANGESETSESSION_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "geodiffutils.h"
+
+/**
+ * Changesets of local GeoPackages of a project against their base files (in .mergin directory),
+ * each created at most once during the session's lifetime - e.g. one sync. The same changeset is used
+ * to find out whether the file has pending changes, for its summary and as the diff to upload.
+ *
+ * Changeset files are kept in the project's .mergin directory and removed when the session is destroyed,
+ * unless they have been taken with takeDiff(). The session is meant to be short lived, it does not
+ * notice further changes of the files.
+ */
+class ChangesetSession
+{
+  public:
+    struct Changeset
+    {
+      int result = GEODIFF_ERROR;  //!< geodiff result of the changeset creation
+      QString diffName;            //!< path of the changeset file, relative to .mergin directory
+      bool summaryValid = false;   //!< whether the summary has been read from the changeset
+      GeodiffUtils::ChangesetSummary summary;
+
+      bool isValid() const { return result == GEODIFF_SUCCESS && summaryValid; }
+    };
+
+    explicit ChangesetSession( const QString &projectDir );
+    ~ChangesetSession();
+
+    ChangesetSession( const ChangesetSession & ) = delete;
+    ChangesetSession &operator=( const ChangesetSession & ) = delete;
+
+    QString projectDir() const { return mProjectDir; }
+
+    //! Creates changesets of the files (paths relative to the project dir) that do not have one yet, in parallel
+    void prepare( const QStringList &filePaths );
+
+    //! Returns changeset of the file, it is created if it does not exist yet
+    Changeset changeset( const QString &filePath );
+
+    //! Returns whether the file has pending changes - also if the changeset could not be created
+    bool hasPendingChanges( const QString &filePath );
+
+    /**
+     * Hands the changeset file over to the caller (e.g. to upload it), it is not removed by the session.
+     * Returns its path relative to .mergin directory or empty string if there is no valid changeset.
+     */
+    QString takeDiff( const QString &filePath );
+
+    //! Returns how many changesets have been created by the session
+    int createdCount() const { return mCreatedCount; }
+
+  private:
+    static Changeset createChangeset( const QString &projectDir, const QString &filePath );
+
+    QString mProjectDir;
+    QHash<QString, Changeset> mChangesets;  //!< file path -> its changeset
+    QSet<QString> mTakenDiffs;  //!< files whose changeset files are not owned by the session anymore
+    int mCreatedCount = 0;
+};
+
+#endif // CHANGESETSESSION_H
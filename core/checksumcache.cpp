@@ -0,0 +1,279 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "checksumcache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "coreutils.h"
+
+bool ChecksumCache::sVerificationEnabled = false;
+
+ChecksumCache::ChecksumCache( const QString &projectDir )
+  : mProjectDir( projectDir )
+{
+  load();
+}
+
+ChecksumCache::FileStamp ChecksumCache::fileStamp( const QString &filePath )
+{
+  FileStamp stamp;
+#ifdef Q_OS_UNIX
+  struct stat st;
+  if ( ::stat( QFile::encodeName( filePath ).constData(), &st ) == 0 )
+  {
+    stamp.size = static_cast<qint64>( st.st_size );
+#if defined( Q_OS_DARWIN )
+    stamp.mtime = static_cast<qint64>( st.st_mtimespec.tv_sec ) * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+    stamp.mtime = static_cast<qint64>( st.st_mtim.tv_sec ) * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+    stamp.inode = static_cast<quint64>( st.st_ino );
+  }
+#else
+  QFileInfo info( filePath );
+  if ( info.exists() )
+  {
+    stamp.size = info.size();
+    stamp.mtime = info.lastModified().toMSecsSinceEpoch();
+  }
+#endif
+  return stamp;
+}
+
+bool ChecksumCache::lookup( const QString &path, const FileStamp &stamp, QByteArray &checksum )
+{
+  auto it = mEntries.constFind( path );
+  if ( it != mEntries.constEnd() && stamp.isValid() && it->stamp == stamp )
+  {
+    checksum = it->checksum;
+    ++mHits;
+    return true;
+  }
+  ++mMisses;
+  return false;
+}
+
+void ChecksumCache::insert( const QString &path, const FileStamp &stamp, const QByteArray &checksum )
+{
+  if ( !stamp.isValid() || checksum.isEmpty() )
+    return;
+
+  // the file could be written again within the resolution of the timestamp without us noticing it
+  if ( stamp.mtime > QDateTime::currentMSecsSinceEpoch() - RACY_INTERVAL_MS )
+  {
+    invalidate( path );
+    return;
+  }
+
+  Entry entry;
+  entry.stamp = stamp;
+  entry.checksum = checksum;
+  mEntries.insert( path, entry );
+  mInserted.insert( path, entry );
+  mRemoved.remove( path );
+  mDirty = true;
+}
+
+void ChecksumCache::verify( const QString &path, const FileStamp &stamp, const QByteArray &cachedChecksum, const QByteArray &checksum )
+{
+  if ( cachedChecksum == checksum )
+    return;
+
+  ++mVerificationFailures;
+  CoreUtils::log( "checksum cache", QStringLiteral( "Stale checksum of %1 in %2 (cached %3, actual %4)" )
+                  .arg( path, mProjectDir, QString::fromLatin1( cachedChecksum ), QString::fromLatin1( checksum ) ) );
+  insert( path, stamp, checksum );
+}
+
+void ChecksumCache::invalidate( const QString &path )
+{
+  // another cache of the project may have saved the entry in the meantime, it is removed from the file as well
+  mInserted.remove( path );
+  mRemoved.insert( path );
+  if ( mEntries.remove( path ) )
+    mDirty = true;
+}
+
+void ChecksumCache::invalidateAll()
+{
+  mDirty = true;
+  mEntries.clear();
+  mInserted.clear();
+  mRemoved.clear();
+  mRemovedAll = true;
+}
+
+void ChecksumCache::retainOnly( const QStringList &paths )
+{
+  const QSet<QString> keep( paths.begin(), paths.end() );
+  for ( auto it = mEntries.begin(); it != mEntries.end(); )
+  {
+    if ( !keep.contains( it.key() ) )
+    {
+      mInserted.remove( it.key() );
+      mRemoved.insert( it.key() );
+      it = mEntries.erase( it );
+      mDirty = true;
+    }
+    else
+      ++it;
+  }
+}
+
+bool ChecksumCache::save()
+{
+  if ( !mDirty )
+    return true;
+
+  // do not turn a local project into a mergin one just because of the cache
+  if ( !QDir( mProjectDir + "/.mergin" ).exists() )
+    return false;
+
+  // the file is read again and written while no other cache of the project can do the same, so their changes are not lost
+  std::shared_ptr<QMutex> mutex = projectMutex( mProjectDir );
+  QMutexLocker locker( mutex.get() );
+
+  QHash<QString, Entry> entries;
+  if ( !mRemovedAll )
+    readEntries( cacheFilePath( mProjectDir ), entries );
+  for ( const QString &path : qAsConst( mRemoved ) )
+    entries.remove( path );
+  for ( auto it = mInserted.constBegin(); it != mInserted.constEnd(); ++it )
+    entries.insert( it.key(), it.value() );
+
+  QSaveFile file( cacheFilePath( mProjectDir ) );
+  if ( !file.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "checksum cache", "Failed to open for writing: " + file.fileName() );
+    return false;
+  }
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+  stream << CACHE_FILE_VERSION << static_cast<quint32>( entries.count() );
+  for ( auto it = entries.constBegin(); it != entries.constEnd(); ++it )
+  {
+    stream << it.key() << it->stamp.size << it->stamp.mtime << it->stamp.inode << it->checksum;
+  }
+
+  if ( !file.commit() )
+  {
+    CoreUtils::log( "checksum cache", "Failed to write: " + file.fileName() );
+    return false;
+  }
+
+  mEntries = entries;
+  mInserted.clear();
+  mRemoved.clear();
+  mRemovedAll = false;
+  mDirty = false;
+  return true;
+}
+
+void ChecksumCache::invalidate( const QString &projectDir, const QStringList &paths )
+{
+  ChecksumCache cache( projectDir );
+  if ( paths.isEmpty() )
+  {
+    cache.invalidateAll();
+  }
+  else
+  {
+    for ( const QString &path : paths )
+      cache.invalidate( path );
+  }
+  cache.save();
+}
+
+QString ChecksumCache::cacheFilePath( const QString &projectDir )
+{
+  return projectDir + "/.mergin/checksums.cache";
+}
+
+void ChecksumCache::setVerificationEnabled( bool enabled )
+{
+  sVerificationEnabled = enabled;
+}
+
+bool ChecksumCache::verificationEnabled()
+{
+  return sVerificationEnabled;
+}
+
+void ChecksumCache::load()
+{
+  std::shared_ptr<QMutex> mutex = projectMutex( mProjectDir );
+  QMutexLocker locker( mutex.get() );
+
+  // an unsupported or corrupted file is rewritten on next save
+  if ( !readEntries( cacheFilePath( mProjectDir ), mEntries ) && QFile::exists( cacheFilePath( mProjectDir ) ) )
+    mDirty = true;
+}
+
+bool ChecksumCache::readEntries( const QString &filePath, QHash<QString, Entry> &entries )
+{
+  entries.clear();
+
+  QFile file( filePath );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+
+  quint32 version = 0, count = 0;
+  stream >> version >> count;
+  if ( version != CACHE_FILE_VERSION )
+  {
+    CoreUtils::log( "checksum cache", QStringLiteral( "Unsupported cache version %1, ignoring " ).arg( version ) + file.fileName() );
+    return false;
+  }
+
+  // the count comes from the file - it cannot have more entries than fit into it
+  entries.reserve( static_cast<int>( qMin<qint64>( count, file.size() / MIN_ENTRY_SIZE ) ) );
+  for ( quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i )
+  {
+    QString path;
+    Entry entry;
+    stream >> path >> entry.stamp.size >> entry.stamp.mtime >> entry.stamp.inode >> entry.checksum;
+    entries.insert( path, entry );
+  }
+
+  if ( stream.status() != QDataStream::Ok )
+  {
+    CoreUtils::log( "checksum cache", "Corrupted cache, ignoring " + file.fileName() );
+    entries.clear();
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<QMutex> ChecksumCache::projectMutex( const QString &projectDir )
+{
+  // one mutex per project for the whole lifetime of the app, there are only few projects
+  static QMutex sMutexesLock;
+  static QHash<QString, std::shared_ptr<QMutex>> sMutexes;
+
+  QMutexLocker locker( &sMutexesLock );
+  std::shared_ptr<QMutex> &mutex = sMutexes[QDir::cleanPath( projectDir )];
+  if ( !mutex )
+    mutex = std::make_shared<QMutex>();
+  return mutex;
+}
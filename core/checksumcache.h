@@ -0,0 +1,137 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHECKSUMCACHE_H
+#define CHECKSUMCACHE_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Persistent index of checksums of project files, stored in the project's .mergin directory.
+ *
+ * An entry is keyed by the file path (relative to the project dir) and it is only reused
+ * while file's size, modification time and inode stay the same. Files modified very recently
+ * are never stored, because a later write within the timestamp resolution would not be noticed.
+ *
+ * The cache is only written to the disk if the project has .mergin directory (i.e. it is a Mergin project).
+ * Several caches of the same project may be used at once (e.g. by status scans on worker threads) - access
+ * to the file is serialized per project and save() merges the changes with entries saved by the others.
+ */
+class ChecksumCache
+{
+  public:
+
+    //! File attributes that need to match to reuse a cached checksum
+    struct FileStamp
+    {
+      qint64 size = -1;
+      qint64 mtime = -1;   //!< milliseconds since epoch
+      quint64 inode = 0;   //!< zero on platforms where inode is not available
+
+      bool isValid() const { return size >= 0; }
+
+      bool operator==( const FileStamp &other ) const
+      {
+        return size == other.size && mtime == other.mtime && inode == other.inode;
+      }
+    };
+
+    //! Creates cache for the project in given directory and loads existing entries
+    explicit ChecksumCache( const QString &projectDir );
+
+    //! Returns current attributes of the file at the absolute path (invalid stamp if the file does not exist)
+    static FileStamp fileStamp( const QString &filePath );
+
+    /**
+     * Looks up the checksum of the file. Returns true and sets the checksum if there is an entry
+     * matching the current file stamp, false otherwise.
+     */
+    bool lookup( const QString &path, const FileStamp &stamp, QByteArray &checksum );
+
+    //! Stores the checksum of the file computed for the given stamp
+    void insert( const QString &path, const FileStamp &stamp, const QByteArray &checksum );
+
+    /**
+     * In verification mode (only meant for tests) the caller recomputes checksums also on cache hits
+     * and reports them through this method. A mismatch is logged, counted and the entry is replaced.
+     */
+    void verify( const QString &path, const FileStamp &stamp, const QByteArray &cachedChecksum, const QByteArray &checksum );
+
+    //! Forgets the entry for given path (e.g. the file has been rewritten by the app)
+    void invalidate( const QString &path );
+
+    //! Forgets all entries of the project
+    void invalidateAll();
+
+    //! Removes entries of files that are not in the list anymore
+    void retainOnly( const QStringList &paths );
+
+    /**
+     * Writes the cache to the disk if it has been changed. Entries saved by other caches of the project
+     * since this one was loaded are kept, unless this cache has removed them. Returns false on failure.
+     */
+    bool save();
+
+    int hits() const { return mHits; }
+    int misses() const { return mMisses; }
+    int verificationFailures() const { return mVerificationFailures; }
+
+    //! Removes cached checksums of given files (or of all files if the list is empty) of the project
+    static void invalidate( const QString &projectDir, const QStringList &paths );
+
+    //! Returns path of the cache file for the project in given directory
+    static QString cacheFilePath( const QString &projectDir );
+
+    //! Enables/disables verification mode - see verify()
+    static void setVerificationEnabled( bool enabled );
+    static bool verificationEnabled();
+
+  private:
+    struct Entry
+    {
+      FileStamp stamp;
+      QByteArray checksum;
+    };
+
+    void load();
+
+    //! Reads entries of the cache file, returns false if it is missing or not valid (\a entries are empty then)
+    static bool readEntries( const QString &filePath, QHash<QString, Entry> &entries );
+
+    //! Returns the mutex serializing reads and writes of the cache file of the project
+    static std::shared_ptr<QMutex> projectMutex( const QString &projectDir );
+
+    QString mProjectDir;
+    QHash<QString, Entry> mEntries;
+    bool mDirty = false;
+
+    // changes since the cache was loaded, they are applied over the entries on the disk by save()
+    QHash<QString, Entry> mInserted;
+    QSet<QString> mRemoved;
+    bool mRemovedAll = false;
+
+    int mHits = 0;
+    int mMisses = 0;
+    int mVerificationFailures = 0;
+
+    static bool sVerificationEnabled;
+    static const quint32 CACHE_FILE_VERSION = 1;
+    static const qint64 RACY_INTERVAL_MS = 2000;
+    //! Size of an entry in the cache file with empty path and checksum (the count of entries is never trusted beyond it)
+    static const qint64 MIN_ENTRY_SIZE = 32;
+};
+
+#endif // CHECKSUMCACHE_H
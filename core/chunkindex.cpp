@@ -0,0 +1,119 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "chunkindex.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include "coreutils.h"
+
+ChunkIndex::ChunkIndex( const QString &projectDir )
+  : mProjectDir( projectDir )
+{
+  load();
+}
+
+bool ChunkIndex::contains( const QString &chunkId ) const
+{
+  return mChunks.contains( chunkId );
+}
+
+void ChunkIndex::insert( const QStringList &chunkIds )
+{
+  for ( const QString &chunkId : chunkIds )
+  {
+    if ( mChunks.contains( chunkId ) )
+      continue;
+
+    mChunks.insert( chunkId );
+    mOrder.append( chunkId );
+    mDirty = true;
+  }
+
+  while ( mOrder.count() > MAX_CHUNKS )
+    mChunks.remove( mOrder.takeFirst() );
+}
+
+void ChunkIndex::clear()
+{
+  if ( !mChunks.isEmpty() )
+    mDirty = true;
+  mChunks.clear();
+  mOrder.clear();
+}
+
+bool ChunkIndex::save()
+{
+  if ( !mDirty )
+    return true;
+
+  // do not turn a local project into a mergin one just because of the index
+  if ( !QDir( mProjectDir + "/.mergin" ).exists() )
+    return false;
+
+  QSaveFile file( indexFilePath( mProjectDir ) );
+  if ( !file.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "chunk index", "Failed to open for writing: " + file.fileName() );
+    return false;
+  }
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+  stream << INDEX_FILE_VERSION << mOrder;
+
+  if ( !file.commit() )
+  {
+    CoreUtils::log( "chunk index", "Failed to write: " + file.fileName() );
+    return false;
+  }
+
+  mDirty = false;
+  return true;
+}
+
+QString ChunkIndex::indexFilePath( const QString &projectDir )
+{
+  return projectDir + "/.mergin/chunks.index";
+}
+
+void ChunkIndex::load()
+{
+  QFile file( indexFilePath( mProjectDir ) );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return;
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+
+  quint32 version = 0;
+  stream >> version;
+  if ( version != INDEX_FILE_VERSION )
+  {
+    CoreUtils::log( "chunk index", QStringLiteral( "Unsupported index version %1, ignoring " ).arg( version ) + file.fileName() );
+    mDirty = true;  // rewrite on next save
+    return;
+  }
+
+  QList<QString> order;
+  stream >> order;
+  if ( stream.status() != QDataStream::Ok )
+  {
+    // a chunk missing in the index only costs its upload, a corrupted one is not worth the risk
+    CoreUtils::log( "chunk index", "Corrupted index, ignoring " + file.fileName() );
+    mDirty = true;
+    return;
+  }
+
+  mOrder = order;
+  mChunks = QSet<QString>( mOrder.begin(), mOrder.end() );
+}
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CHUNKINDEX_H
+#define CHUNKINDEX_H
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Persistent index of content-defined chunks (see ContentChunker) the server has of the project,
+ * stored in the project's .mergin directory. Chunks get recorded once a push including them is finished,
+ * later pushes do not upload them again.
+ *
+ * The index keeps at most MAX_CHUNKS of the most recently recorded chunks. It is only written
+ * to the disk if the project has .mergin directory (i.e. it is a Mergin project).
+ */
+class ChunkIndex
+{
+  public:
+    //! Creates index for the project in given directory and loads existing entries
+    explicit ChunkIndex( const QString &projectDir );
+
+    //! Returns whether the chunk is known to be on the server
+    bool contains( const QString &chunkId ) const;
+
+    //! Records chunks that are on the server
+    void insert( const QStringList &chunkIds );
+
+    //! Forgets all chunks (e.g. the server has refused a push relying on them)
+    void clear();
+
+    int count() const { return mChunks.count(); }
+
+    //! Writes the index to the disk if it has been changed. Returns false on failure
+    bool save();
+
+    //! Returns path of the index file for the project in given directory
+    static QString indexFilePath( const QString &projectDir );
+
+    static const int MAX_CHUNKS = 100000;
+
+  private:
+    void load();
+
+    QString mProjectDir;
+    QSet<QString> mChunks;
+    QList<QString> mOrder;  //!< chunks in the order they have been recorded (oldest first)
+    bool mDirty = false;
+
+    static const quint32 INDEX_FILE_VERSION = 1;
+};
+
+#endif // CHUNKINDEX_H
@@ -0,0 +1,140 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "contentchunker.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QUuid>
+
+#include "coreutils.h"
+
+//! Namespace of the UUIDs of chunks - must never change, the IDs are shared with the server and other clients
+static const QUuid CHUNK_ID_NAMESPACE( QStringLiteral( "{8f1b6c5e-2d3a-4b7e-9c41-5a6f0e2d7b13}" ) );
+
+//! Returns random (but fixed) values for each byte value used by the gear hash - must never change too
+static const quint64 *gearTable()
+{
+  static const quint64 *table = []()
+  {
+    static quint64 values[256];
+    quint64 state = 0x6d657267696e2121ULL;
+    for ( quint64 &value : values )
+    {
+      // splitmix64
+      quint64 z = ( state += 0x9e3779b97f4a7c15ULL );
+      z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+      z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+      value = z ^ ( z >> 31 );
+    }
+    return values;
+  }();
+  return table;
+}
+
+static QString chunkIdFromDigest( const QByteArray &sha1 )
+{
+  return CoreUtils::uuidWithoutBraces( QUuid::createUuidV5( CHUNK_ID_NAMESPACE, sha1 ) );
+}
+
+ContentChunker::ContentChunker( int minSize, int avgSize, int maxSize )
+  : mMinSize( qMax( 64, minSize ) )
+  , mMaxSize( qMax( mMinSize, maxSize ) )
+{
+  int bits = 0;
+  while ( bits < 62 && ( Q_INT64_C( 2 ) << bits ) <= avgSize )
+    ++bits;
+  // the highest bits of the hash are influenced by all of the last 64 bytes
+  mMask = bits > 0 ? ~0ULL << ( 64 - bits ) : 0;
+}
+
+QList<ContentChunker::Chunk> ContentChunker::chunkFile( const QString &filePath ) const
+{
+  QFile file( filePath );
+  if ( !file.open( QIODevice::ReadOnly ) )
+  {
+    CoreUtils::log( "chunker", "Failed to open " + filePath );
+    return QList<Chunk>();
+  }
+  return chunkDevice( file );
+}
+
+QList<ContentChunker::Chunk> ContentChunker::chunkData( const QByteArray &data ) const
+{
+  QBuffer buffer;
+  buffer.setData( data );
+  buffer.open( QIODevice::ReadOnly );
+  return chunkDevice( buffer );
+}
+
+QString ContentChunker::chunkId( const QByteArray &data )
+{
+  return chunkIdFromDigest( QCryptographicHash::hash( data, QCryptographicHash::Sha1 ) );
+}
+
+QList<ContentChunker::Chunk> ContentChunker::chunkDevice( QIODevice &device ) const
+{
+  const quint64 *table = gearTable();
+
+  QList<Chunk> chunks;
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  quint64 gear = 0;
+  qint64 chunkStart = 0;
+  qint64 bufferStart = 0;
+
+  auto addChunk = [&]( qint64 end )
+  {
+    Chunk chunk;
+    chunk.offset = chunkStart;
+    chunk.size = end - chunkStart;
+    chunk.id = chunkIdFromDigest( hash.result() );
+    chunks << chunk;
+    hash.reset();
+    chunkStart = end;
+  };
+
+  while ( true )
+  {
+    QByteArray buffer = device.read( READ_BUFFER_SIZE );
+    if ( buffer.isEmpty() )
+    {
+      if ( !device.atEnd() )
+      {
+        CoreUtils::log( "chunker", "Failed to read: " + device.errorString() );
+        return QList<Chunk>();
+      }
+      break;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>( buffer.constData() );
+    const int count = buffer.size();
+    int segmentStart = 0;  // start of the part of the buffer not added to the hash yet
+    for ( int i = 0; i < count; ++i )
+    {
+      gear = ( gear << 1 ) + table[data[i]];
+
+      qint64 size = bufferStart + i + 1 - chunkStart;
+      if ( size >= mMaxSize || ( size >= mMinSize && ( gear & mMask ) == 0 ) )
+      {
+        hash.addData( buffer.constData() + segmentStart, i + 1 - segmentStart );
+        segmentStart = i + 1;
+        addChunk( bufferStart + i + 1 );
+      }
+    }
+    hash.addData( buffer.constData() + segmentStart, count - segmentStart );
+    bufferStart += count;
+  }
+
+  // the rest of the content (or the only chunk of empty content)
+  if ( bufferStart > chunkStart || chunks.isEmpty() )
+    addChunk( bufferStart );
+
+  return chunks;
+}
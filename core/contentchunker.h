@@ -0,0 +1,74 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CONTENTCHUNKER_H
+#define CONTENTCHUNKER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * Splits content into chunks at positions given by the content itself (content-defined chunking),
+ * so that an insertion or a removal of bytes only changes the chunks around it - the other chunks
+ * keep their boundaries even if they move within the file.
+ *
+ * A boundary is placed where a rolling "gear" hash of the last 64 bytes matches a mask. Past the minimum size,
+ * the mask matches once per average size bytes on average. Chunks are never smaller than the minimum size
+ * (apart from the last one) and never bigger than the maximum size.
+ *
+ * Chunk IDs are derived from the SHA-1 of the chunk content (formatted as UUID), so the same content
+ * always gets the same ID - on any device and in any file.
+ */
+class ContentChunker
+{
+  public:
+    struct Chunk
+    {
+      qint64 offset = 0;  //!< position of the chunk within the content
+      qint64 size = 0;    //!< size of the chunk in bytes
+      QString id;         //!< ID derived from the chunk content
+    };
+
+    /**
+     * Creates chunker with given chunk sizes in bytes. The average size is rounded down to a power of two,
+     * the maximum must not exceed MerginApi's upload chunk size for the chunks to be accepted by the server.
+     */
+    explicit ContentChunker( int minSize = DEFAULT_MIN_SIZE, int avgSize = DEFAULT_AVG_SIZE, int maxSize = DEFAULT_MAX_SIZE );
+
+    /**
+     * Returns chunks of the file at the absolute path, empty list if the file cannot be read.
+     * An empty file has a single chunk of zero size.
+     */
+    QList<Chunk> chunkFile( const QString &filePath ) const;
+
+    //! Returns chunks of the data
+    QList<Chunk> chunkData( const QByteArray &data ) const;
+
+    //! Returns ID of a chunk with given content
+    static QString chunkId( const QByteArray &data );
+
+    static const int DEFAULT_MIN_SIZE = 512 * 1024;
+    static const int DEFAULT_AVG_SIZE = 2 * 1024 * 1024;
+    static const int DEFAULT_MAX_SIZE = 8 * 1024 * 1024;
+
+  private:
+    //! Reads the device to its end and returns its chunks, empty list on a read error
+    QList<Chunk> chunkDevice( QIODevice &device ) const;
+
+    int mMinSize;
+    int mMaxSize;
+    quint64 mMask;
+
+    static const int READ_BUFFER_SIZE = 1024 * 1024;
+};
+
+#endif // CONTENTCHUNKER_H
@@ -1,6 +1,12 @@
 
 SOURCES += \
+  $$PWD/changesetsession.cpp \
+  $$PWD/checksumcache.cpp \
+  $$PWD/chunkindex.cpp \
+  $$PWD/contentchunker.cpp \
   $$PWD/coreutils.cpp \
+  $$PWD/jsonstreamreader.cpp \
+  $$PWD/logsink.cpp \
   $$PWD/merginapi.cpp \
   $$PWD/merginapistatus.cpp \
   $$PWD/merginsubscriptioninfo.cpp \
@@ -12,10 +18,21 @@ SOURCES += \
   $$PWD/localprojectsmanager.cpp \
   $$PWD/merginprojectmetadata.cpp \
   $$PWD/project.cpp \
+  $$PWD/projectchangetracker.cpp \
+  $$PWD/projectmetadatastore.cpp \
+  $$PWD/syncjournal.cpp \
+  $$PWD/syncscheduler.cpp \
+  $$PWD/transfercompression.cpp \
   $$PWD/geodiffutils.cpp
 
 HEADERS += \
+  $$PWD/changesetsession.h \
+  $$PWD/checksumcache.h \
+  $$PWD/chunkindex.h \
+  $$PWD/contentchunker.h \
   $$PWD/coreutils.h \
+  $$PWD/jsonstreamreader.h \
+  $$PWD/logsink.h \
   $$PWD/merginapi.h \
   $$PWD/merginapistatus.h \
   $$PWD/merginsubscriptioninfo.h \
@@ -27,6 +44,11 @@ HEADERS += \
   $$PWD/localprojectsmanager.h \
   $$PWD/merginprojectmetadata.h \
   $$PWD/project.h \
+  $$PWD/projectchangetracker.h \
+  $$PWD/projectmetadatastore.h \
+  $$PWD/syncjournal.h \
+  $$PWD/syncscheduler.h \
+  $$PWD/transfercompression.h \
   $$PWD/geodiffutils.h
 
 exists($$PWD/merginsecrets.cpp) {
@@ -14,7 +14,6 @@
 #include <QDir>
 #include <QFile>
 #include <QDirIterator>
-#include <QTextStream>
 
 #include "qcoreapplication.h"
 #include "merginapi.h"
@@ -84,6 +83,7 @@ QString CoreUtils::downloadInProgressFilePath( const QString &projectDir )
 void CoreUtils::setLogFilename( const QString &value )
 {
   sLogFile = value;
+  LogSink::instance().setPath( value );
 }
 
 QString CoreUtils::logFilename()
@@ -91,36 +91,14 @@ QString CoreUtils::logFilename()
   return sLogFile;
 }
 
-void CoreUtils::log( const QString &topic, const QString &info )
+void CoreUtils::log( const QString &topic, const QString &info, LogSink::Level level )
 {
-  QString logFilePath;
-  QByteArray data;
-  data.append( QString( "%1 %2: %3\n" ).arg( QDateTime().currentDateTimeUtc().toString( Qt::ISODateWithMs ) ).arg( topic ).arg( info ) );
-  appendLog( data, sLogFile );
+  LogSink::instance().log( topic, info, level );
 }
 
-void CoreUtils::appendLog( const QByteArray &data, const QString &path )
+void CoreUtils::flushLog()
 {
-  if ( path != LOG_TO_DEVNULL )
-  {
-    if ( path == LOG_TO_STDOUT )
-    {
-      QTextStream out( stdout );
-      out << data;
-    }
-    else
-    {
-      qDebug() << data;
-      QFile file( path );
-      if ( path.isEmpty() || !file.open( QIODevice::Append ) )
-      {
-        qDebug() << "ERROR: Invalid log file";
-        return;
-      }
-      file.write( data );
-      file.close();
-    }
-  }
+  LogSink::instance().flush();
 }
 
 QDateTime CoreUtils::getLastModifiedFileDateTime( const QString &path )
@@ -17,6 +17,7 @@
 #include <QtGlobal>
 #include <QUuid>
 
+#include "logsink.h"
 
 class CoreUtils
 {
@@ -68,13 +69,18 @@ class CoreUtils
     /**
      * Add a log entry to internal log text file
      *
+     * The entry is written by a background thread (see LogSink), so the call does not block on file access.
+     * Entries below the log level of the topic are ignored.
+     *
      * \see setLogFilename()
      */
-    static void log( const QString &topic, const QString &info );
+    static void log( const QString &topic, const QString &info, LogSink::Level level = LogSink::Info );
+
+    //! Blocks until all log entries are written to the log file
+    static void flushLog();
 
   private:
     static QString sLogFile;
-    static void appendLog( const QByteArray &data, const QString &path );
 };
 
 #endif // COREUTILS_H
@@ -66,11 +66,18 @@ int GeodiffUtils::createChangeset( const QString &projectDir, const QString &fil
 
 bool GeodiffUtils::hasPendingChanges( const QString &projectDir, const QString &filePath )
 {
-  QString summaryJson = GeodiffUtils::diffableFilePendingChanges( projectDir, filePath, true );
-  if ( summaryJson.startsWith( "ERROR" ) )
+  QString diffName;
+  int res = createChangeset( projectDir, filePath, diffName );
+  QString diffPath = projectDir + "/.mergin/" + diffName;
+
+  ChangesetSummary summary;
+  bool summaryRead = res == GEODIFF_SUCCESS && readChangesetSummary( diffPath, summary );
+  QFile::remove( diffPath );  // we don't need the temporary diff file anymore
+
+  if ( !summaryRead )
     return true;  // something went wrong - let's assume the file has changed
 
-  return !GeodiffUtils::parseChangesetSummary( summaryJson ).isEmpty();
+  return !summary.isEmpty();
 }
 
 GeodiffUtils::ChangesetSummary GeodiffUtils::parseChangesetSummary( const QString &json )
@@ -91,6 +98,143 @@ GeodiffUtils::ChangesetSummary GeodiffUtils::parseChangesetSummary( const QStrin
   return summary;
 }
 
+// Changesets created by geodiff use the binary format of SQLite session extension:
+// a table header ('T', number of columns, primary key flags, NUL terminated name) is followed
+// by its changes (operation, "indirect" flag, old and/or new values of all columns).
+static const uchar CHANGESET_TABLE = 'T';
+static const uchar CHANGESET_INSERT = 18;  // SQLITE_INSERT
+static const uchar CHANGESET_UPDATE = 23;  // SQLITE_UPDATE
+static const uchar CHANGESET_DELETE = 9;   // SQLITE_DELETE
+
+//! Reads SQLite varint at the position and moves the position after it. Returns false at the end of data
+static bool readChangesetVarint( const uchar *data, qint64 size, qint64 &pos, quint64 &value )
+{
+  value = 0;
+  for ( int i = 0; i < 9; ++i )
+  {
+    if ( pos >= size )
+      return false;
+
+    uchar byte = data[pos++];
+    if ( i == 8 )
+    {
+      value = ( value << 8 ) | byte;  // the ninth byte has all eight bits
+      return true;
+    }
+
+    value = ( value << 7 ) | ( byte & 0x7f );
+    if ( !( byte & 0x80 ) )
+      return true;
+  }
+  return true;
+}
+
+//! Moves the position after given number of values of a record. Returns false if they are not valid
+static bool skipChangesetValues( const uchar *data, qint64 size, qint64 &pos, quint64 count )
+{
+  for ( quint64 i = 0; i < count; ++i )
+  {
+    if ( pos >= size )
+      return false;
+
+    quint64 length = 0;
+    switch ( data[pos++] )
+    {
+      case 0:  // undefined (unchanged column of an update)
+      case 5:  // NULL
+        break;
+      case 1:  // integer
+      case 2:  // real
+        pos += 8;
+        break;
+      case 3:  // text
+      case 4:  // blob
+        if ( !readChangesetVarint( data, size, pos, length ) || length > static_cast<quint64>( size - pos ) )
+          return false;
+        pos += static_cast<qint64>( length );
+        break;
+      default:
+        return false;
+    }
+
+    if ( pos > size )
+      return false;
+  }
+  return true;
+}
+
+bool GeodiffUtils::readChangesetSummary( const QString &changesetPath, ChangesetSummary &summary )
+{
+  summary.clear();
+
+  QFile file( changesetPath );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  const qint64 size = file.size();
+  if ( size == 0 )
+    return true;  // no changes
+
+  // the changeset is only mapped, it may be big for large edits
+  QByteArray content;
+  const uchar *data = file.map( 0, size );
+  if ( !data )
+  {
+    content = file.readAll();
+    if ( content.size() != size )
+      return false;
+    data = reinterpret_cast<const uchar *>( content.constData() );
+  }
+
+  QString tableName;
+  quint64 columns = 0;
+  qint64 pos = 0;
+  while ( pos < size )
+  {
+    uchar operation = data[pos++];
+    if ( operation == CHANGESET_TABLE )
+    {
+      if ( !readChangesetVarint( data, size, pos, columns ) || columns == 0 || columns > static_cast<quint64>( size - pos ) )
+        return false;
+      pos += static_cast<qint64>( columns );  // primary key flags
+
+      const qint64 nameStart = pos;
+      while ( pos < size && data[pos] )
+        ++pos;
+      if ( pos >= size )
+        return false;
+      tableName = QString::fromUtf8( reinterpret_cast<const char *>( data + nameStart ), static_cast<int>( pos - nameStart ) );
+      ++pos;
+      continue;
+    }
+
+    if ( tableName.isEmpty() || pos >= size )
+      return false;
+    ++pos;  // "indirect" flag
+
+    TableSummary &tableSummary = summary[tableName];
+    switch ( operation )
+    {
+      case CHANGESET_INSERT:
+        ++tableSummary.inserts;
+        break;
+      case CHANGESET_UPDATE:
+        ++tableSummary.updates;
+        break;
+      case CHANGESET_DELETE:
+        ++tableSummary.deletes;
+        break;
+      default:
+        return false;
+    }
+
+    // updates have old and new values, inserts only new and deletes only old ones
+    if ( !skipChangesetValues( data, size, pos, operation == CHANGESET_UPDATE ? 2 * columns : columns ) )
+      return false;
+  }
+  return true;
+}
+
 
 bool GeodiffUtils::applyDiffs( const QString &src, const QStringList &diffFiles )
 {
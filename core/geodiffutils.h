@@ -45,6 +45,12 @@ class GeodiffUtils
     //! Takes JSON changeset summary string and parses it
     static ChangesetSummary parseChangesetSummary( const QString &json );
 
+    /**
+     * Reads summary of the changeset file directly (without geodiff writing JSON to a temporary file).
+     * \returns false if the file cannot be read or it is not a valid changeset
+     */
+    static bool readChangesetSummary( const QString &changesetPath, ChangesetSummary &summary );
+
     //! Returns JSON with local pending changes o a diffable file
     static QString diffableFilePendingChanges( const QString &projectDir, const QString &filePath, bool onlySummary );
 
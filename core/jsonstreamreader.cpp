@@ -0,0 +1,399 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "jsonstreamreader.h"
+
+static bool isNumberCharacter( char c )
+{
+  return ( c >= '0' && c <= '9' ) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+JsonStreamReader::JsonStreamReader( Handler &handler )
+  : mHandler( handler )
+{
+  // keeps the capacity when the buffer is emptied for the next token
+  mBuffer.reserve( 64 );
+}
+
+bool JsonStreamReader::addData( const QByteArray &data )
+{
+  const char *chars = data.constData();
+  const int size = data.size();
+  const qint64 start = mOffset;
+
+  int pos = 0;
+  while ( pos < size && mError.isEmpty() )
+  {
+    mOffset = start + pos;
+    switch ( mToken )
+    {
+      case StringToken:
+        pos = readString( chars, pos, size );
+        if ( !mError.isEmpty() )
+          mOffset = start + pos;
+        break;
+
+      case NumberToken:
+        if ( isNumberCharacter( chars[pos] ) )
+        {
+          mBuffer.append( chars[pos] );
+          ++pos;
+        }
+        else
+        {
+          // the character is read again once the number is complete
+          finishNumber();
+        }
+        break;
+
+      case LiteralToken:
+        mBuffer.append( chars[pos] );
+        readLiteral();
+        ++pos;
+        break;
+
+      case NoToken:
+        readStructure( chars[pos] );
+        ++pos;
+        break;
+    }
+  }
+
+  if ( mError.isEmpty() )
+    mOffset = start + size;
+  return mError.isEmpty();
+}
+
+bool JsonStreamReader::finish()
+{
+  // a number is only complete once something else follows
+  if ( mError.isEmpty() && mToken == NumberToken )
+    finishNumber();
+
+  if ( mError.isEmpty() && ( mToken != NoToken || mState != Finished ) )
+    setError( QStringLiteral( "Unexpected end of content" ) );
+
+  return mError.isEmpty();
+}
+
+QString JsonStreamReader::errorString() const
+{
+  if ( mError.isEmpty() )
+    return QString();
+  return QStringLiteral( "%1 at offset %2" ).arg( mError ).arg( mOffset );
+}
+
+bool JsonStreamReader::readStructure( char c )
+{
+  if ( c == ' ' || c == '\n' || c == '\r' || c == '\t' )
+    return true;
+
+  switch ( mState )
+  {
+    case ExpectValue:
+    case ExpectValueOrArrayEnd:
+      if ( c == '{' )
+      {
+        mContainers.append( '{' );
+        mState = ExpectKeyOrObjectEnd;
+        mHandler.startObject();
+        return true;
+      }
+      if ( c == '[' )
+      {
+        mContainers.append( '[' );
+        mState = ExpectValueOrArrayEnd;
+        mHandler.startArray();
+        return true;
+      }
+      if ( c == ']' && mState == ExpectValueOrArrayEnd )
+        return endContainer( '[' );
+
+      mBuffer.resize( 0 );
+      if ( c == '"' )
+      {
+        mToken = StringToken;
+        mTokenIsKey = false;
+        return true;
+      }
+      if ( c == '-' || ( c >= '0' && c <= '9' ) )
+      {
+        mToken = NumberToken;
+        mBuffer.append( c );
+        return true;
+      }
+      if ( c == 't' || c == 'f' || c == 'n' )
+      {
+        mToken = LiteralToken;
+        mBuffer.append( c );
+        return true;
+      }
+      break;
+
+    case ExpectKeyOrObjectEnd:
+      if ( c == '}' )
+        return endContainer( '{' );
+      Q_FALLTHROUGH();
+
+    case ExpectKey:
+      if ( c == '"' )
+      {
+        mBuffer.resize( 0 );
+        mToken = StringToken;
+        mTokenIsKey = true;
+        return true;
+      }
+      break;
+
+    case ExpectColon:
+      if ( c == ':' )
+      {
+        mState = ExpectValue;
+        return true;
+      }
+      break;
+
+    case ExpectCommaOrEnd:
+      if ( c == ',' )
+      {
+        mState = mContainers.last() == '{' ? ExpectKey : ExpectValue;
+        return true;
+      }
+      if ( c == '}' || c == ']' )
+        return endContainer( c == '}' ? '{' : '[' );
+      break;
+
+    case Finished:
+      break;
+  }
+
+  setError( QStringLiteral( "Unexpected character '%1'" ).arg( QLatin1Char( c ) ) );
+  return false;
+}
+
+int JsonStreamReader::readString( const char *data, int pos, int size )
+{
+  while ( pos < size )
+  {
+    if ( mEscape )
+    {
+      if ( !readEscape( data[pos] ) )
+        return pos;
+      ++pos;
+      continue;
+    }
+
+    // plain characters are copied at once
+    const int start = pos;
+    while ( pos < size && data[pos] != '"' && data[pos] != '\\' && static_cast<uchar>( data[pos] ) >= 0x20 )
+      ++pos;
+    if ( pos > start )
+    {
+      flushHighSurrogate();
+      mBuffer.append( data + start, pos - start );
+    }
+
+    if ( pos == size )
+      break;
+
+    if ( data[pos] == '"' )
+    {
+      finishString();
+      return pos + 1;
+    }
+    if ( data[pos] == '\\' )
+    {
+      mEscape = 1;
+      ++pos;
+      continue;
+    }
+
+    setError( QStringLiteral( "Control character in string" ) );
+    return pos;
+  }
+  return pos;
+}
+
+bool JsonStreamReader::readEscape( char c )
+{
+  if ( mEscape == 1 )
+  {
+    char unescaped = 0;
+    switch ( c )
+    {
+      case '"':
+      case '\\':
+      case '/':
+        unescaped = c;
+        break;
+      case 'b':
+        unescaped = '\b';
+        break;
+      case 'f':
+        unescaped = '\f';
+        break;
+      case 'n':
+        unescaped = '\n';
+        break;
+      case 'r':
+        unescaped = '\r';
+        break;
+      case 't':
+        unescaped = '\t';
+        break;
+      case 'u':
+        mEscape = 2;
+        mCodeUnit = 0;
+        return true;
+      default:
+        setError( QStringLiteral( "Invalid escape sequence" ) );
+        return false;
+    }
+    flushHighSurrogate();
+    mBuffer.append( unescaped );
+    mEscape = 0;
+    return true;
+  }
+
+  int digit = 0;
+  if ( c >= '0' && c <= '9' )
+    digit = c - '0';
+  else if ( c >= 'a' && c <= 'f' )
+    digit = c - 'a' + 10;
+  else if ( c >= 'A' && c <= 'F' )
+    digit = c - 'A' + 10;
+  else
+  {
+    setError( QStringLiteral( "Invalid \\u escape sequence" ) );
+    return false;
+  }
+
+  mCodeUnit = static_cast<ushort>( mCodeUnit * 16 + digit );
+  if ( ++mEscape == 6 )
+  {
+    mEscape = 0;
+    appendCodeUnit( mCodeUnit );
+  }
+  return true;
+}
+
+void JsonStreamReader::appendCodeUnit( ushort unit )
+{
+  if ( QChar::isHighSurrogate( unit ) )
+  {
+    flushHighSurrogate();
+    mHighSurrogate = unit;
+    return;
+  }
+
+  if ( QChar::isLowSurrogate( unit ) && mHighSurrogate )
+  {
+    const QChar pair[2] = { QChar( mHighSurrogate ), QChar( unit ) };
+    mBuffer.append( QString( pair, 2 ).toUtf8() );
+    mHighSurrogate = 0;
+    return;
+  }
+
+  flushHighSurrogate();
+  const QChar character( unit );
+  mBuffer.append( QString( &character, 1 ).toUtf8() );
+}
+
+void JsonStreamReader::flushHighSurrogate()
+{
+  if ( !mHighSurrogate )
+    return;
+
+  // not followed by its second half - written like QJsonDocument would
+  const QChar character( mHighSurrogate );
+  mBuffer.append( QString( &character, 1 ).toUtf8() );
+  mHighSurrogate = 0;
+}
+
+void JsonStreamReader::finishString()
+{
+  flushHighSurrogate();
+  mToken = NoToken;
+
+  const QString string = QString::fromUtf8( mBuffer );
+  if ( mTokenIsKey )
+  {
+    mState = ExpectColon;
+    mHandler.key( string );
+  }
+  else
+  {
+    valueRead();
+    mHandler.value( QJsonValue( string ) );
+  }
+}
+
+bool JsonStreamReader::finishNumber()
+{
+  bool ok = false;
+  const double number = mBuffer.toDouble( &ok );
+  if ( !ok )
+  {
+    setError( QStringLiteral( "Invalid number" ) );
+    return false;
+  }
+
+  mToken = NoToken;
+  valueRead();
+  mHandler.value( QJsonValue( number ) );
+  return true;
+}
+
+bool JsonStreamReader::readLiteral()
+{
+  const char first = mBuffer.at( 0 );
+  const char *literal = first == 't' ? "true" : ( first == 'f' ? "false" : "null" );
+  const int length = static_cast<int>( qstrlen( literal ) );
+
+  if ( qstrncmp( mBuffer.constData(), literal, static_cast<uint>( mBuffer.size() ) ) != 0 )
+  {
+    setError( QStringLiteral( "Invalid literal" ) );
+    return false;
+  }
+  if ( mBuffer.size() < length )
+    return true;
+
+  mToken = NoToken;
+  valueRead();
+  mHandler.value( first == 'n' ? QJsonValue( QJsonValue::Null ) : QJsonValue( first == 't' ) );
+  return true;
+}
+
+bool JsonStreamReader::endContainer( char open )
+{
+  if ( mContainers.isEmpty() || mContainers.last() != open )
+  {
+    setError( QStringLiteral( "Unexpected character '%1'" ).arg( QLatin1Char( open == '{' ? '}' : ']' ) ) );
+    return false;
+  }
+
+  mContainers.removeLast();
+  valueRead();
+  if ( open == '{' )
+    mHandler.endObject();
+  else
+    mHandler.endArray();
+  return true;
+}
+
+void JsonStreamReader::valueRead()
+{
+  mState = mContainers.isEmpty() ? Finished : ExpectCommaOrEnd;
+}
+
+void JsonStreamReader::setError( const QString &message )
+{
+  if ( mError.isEmpty() )
+    mError = message;
+}
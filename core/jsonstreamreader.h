@@ -0,0 +1,113 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef JSONSTREAMREADER_H
+#define JSONSTREAMREADER_H
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QString>
+#include <QVector>
+
+/**
+ * Incremental (SAX-style) JSON reader. The content is passed in parts as it arrives (e.g. from a network reply)
+ * and reported to the handler as a sequence of events, the document of the whole content is never built.
+ * Handlers keep only what they need - e.g. MerginProjectMetadataReader builds project metadata directly.
+ *
+ * Values are reported like QJsonDocument would read them - numbers as doubles. Unlike QJsonDocument,
+ * the top-level value does not need to be an object or an array.
+ */
+class JsonStreamReader
+{
+  public:
+    //! Receives the content read by JsonStreamReader
+    class Handler
+    {
+      public:
+        virtual ~Handler() = default;
+
+        virtual void startObject() = 0;
+        virtual void endObject() = 0;
+        virtual void startArray() = 0;
+        virtual void endArray() = 0;
+
+        //! Key of the next value (or object or array) of the current object
+        virtual void key( const QString &name ) = 0;
+
+        //! Plain value - string, number, bool or null
+        virtual void value( const QJsonValue &value ) = 0;
+    };
+
+    explicit JsonStreamReader( Handler &handler );
+
+    //! Reads the next part of the content. Returns false if the content is not valid JSON (further data are ignored then)
+    bool addData( const QByteArray &data );
+
+    //! Marks the end of the content. Returns true if it has been a single valid JSON value
+    bool finish();
+
+    bool hasError() const { return !mError.isEmpty(); }
+
+    //! Returns description of the first error found (including its offset), empty if there is none
+    QString errorString() const;
+
+  private:
+    enum State
+    {
+      ExpectValue,
+      ExpectValueOrArrayEnd,
+      ExpectKeyOrObjectEnd,
+      ExpectKey,
+      ExpectColon,
+      ExpectCommaOrEnd,
+      Finished,
+    };
+
+    enum Token
+    {
+      NoToken,
+      StringToken,
+      NumberToken,
+      LiteralToken,  //!< true, false or null
+    };
+
+    //! Handles a character outside of tokens, returns false on error
+    bool readStructure( char c );
+
+    //! Reads string token from given position, returns position after the part read
+    int readString( const char *data, int pos, int size );
+    bool readEscape( char c );
+    void appendCodeUnit( ushort unit );
+    void flushHighSurrogate();
+    void finishString();
+
+    bool finishNumber();
+    bool readLiteral();
+
+    //! Closes the current object or array (opened by \a open character)
+    bool endContainer( char open );
+    //! Moves to the state after a complete value
+    void valueRead();
+
+    void setError( const QString &message );
+
+    Handler &mHandler;
+    State mState = ExpectValue;
+    Token mToken = NoToken;
+    bool mTokenIsKey = false;
+    QByteArray mBuffer;       //!< content of the token being read (strings already unescaped, in UTF-8)
+    int mEscape = 0;          //!< 0 outside of escape sequence, 1 after backslash, 2-5 while reading hex digits of \uXXXX
+    ushort mCodeUnit = 0;     //!< \uXXXX being read
+    ushort mHighSurrogate = 0;  //!< first half of a surrogate pair waiting for the second one
+    QVector<char> mContainers;  //!< opening characters of objects and arrays being read
+    qint64 mOffset = 0;       //!< offset of the current character in the whole content (of the error once there is one)
+    QString mError;
+};
+
+#endif // JSONSTREAMREADER_H
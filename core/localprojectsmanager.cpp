@@ -13,8 +13,11 @@
 #include "merginprojectmetadata.h"
 #include "coreutils.h"
 
+#include <QDateTime>
 #include <QDir>
 #include <QDirIterator>
+#include <QFileInfo>
+#include <QSet>
 
 LocalProjectsManager::LocalProjectsManager( const QString &dataDir )
   : mDataDir( dataDir )
@@ -24,62 +27,129 @@ LocalProjectsManager::LocalProjectsManager( const QString &dataDir )
 
 void LocalProjectsManager::reloadDataDir()
 {
-  mProjects.clear();
   QStringList entryList = QDir( mDataDir ).entryList( QDir::NoDotAndDotDot | QDir::Dirs );
+
+  LocalProjectsList projects;
+  QHash<QString, FolderStamps> stamps;
+  QSet<QString> projectDirs;
+  mReloadedProjectsCount = 0;
   for ( const QString &folderName : entryList )
   {
-    LocalProject info;
-    info.projectDir = mDataDir + "/" + folderName;
-    info.qgisProjectFilePath = findQgisProjectFile( info.projectDir, info.projectError );
+    QString projectDir = mDataDir + "/" + folderName;
+    projectDirs.insert( projectDir );
 
-    MerginProjectMetadata metadata = MerginProjectMetadata::fromCachedJson( info.projectDir + "/" + MerginApi::sMetadataFile );
-    if ( metadata.isValid() )
-    {
-      info.projectName = metadata.name;
-      info.projectNamespace = metadata.projectNamespace;
-      info.localVersion = metadata.version;
-    }
-    else
+    // unchanged folders keep their projects - there is no need to look for the project file or parse the metadata
+    int index = mIndexByDir.value( projectDir, -1 );
+    auto stampsIt = mFolderStamps.constFind( projectDir );
+    if ( index >= 0 && stampsIt != mFolderStamps.constEnd() && stampsIt->isValid )
     {
-      info.projectName = folderName;
+      FolderStamps currentStamps = folderStamps( mProjects.at( index ) );
+      if ( currentStamps.isValid && currentStamps == *stampsIt )
+      {
+        projects << mProjects.at( index );
+        stamps.insert( projectDir, currentStamps );
+        continue;
+      }
     }
 
-    mProjects << info;
+    LocalProject info = loadProject( projectDir, folderName );
+    ++mReloadedProjectsCount;
+
+    // whatever has been recorded about the project may not apply anymore
+    mChangeTracker.forgetProject( projectDir );
+
+    projects << info;
+    stamps.insert( projectDir, folderStamps( info ) );
+  }
+
+  for ( const LocalProject &project : qAsConst( mProjects ) )
+  {
+    if ( !projectDirs.contains( project.projectDir ) )
+      mChangeTracker.forgetProject( project.projectDir );
   }
 
-  QString msg = QString( "Found %1 local projects in %2" ).arg( mProjects.size() ).arg( mDataDir );
+  mProjects = projects;
+  mFolderStamps = stamps;
+  rebuildIndexes();
+
+  QString msg = QString( "Found %1 local projects in %2 (%3 read again)" ).arg( mProjects.size() ).arg( mDataDir ).arg( mReloadedProjectsCount );
   CoreUtils::log( "Local projects", msg );
   emit dataDirReloaded();
 }
 
-LocalProject LocalProjectsManager::projectFromDirectory( const QString &projectDir ) const
+LocalProject LocalProjectsManager::loadProject( const QString &projectDir, const QString &folderName )
 {
-  for ( const LocalProject &info : mProjects )
+  LocalProject info;
+  info.projectDir = projectDir;
+  info.qgisProjectFilePath = findQgisProjectFile( info.projectDir, info.projectError );
+
+  MerginProjectMetadata metadata = MerginProjectMetadata::fromCachedJson( info.projectDir + "/" + MerginApi::sMetadataFile );
+  if ( metadata.isValid() )
   {
-    if ( info.projectDir == projectDir )
-      return info;
+    info.projectName = metadata.name;
+    info.projectNamespace = metadata.projectNamespace;
+    info.localVersion = metadata.version;
   }
-  return LocalProject();
+  else
+  {
+    info.projectName = folderName;
+  }
+  return info;
+}
+
+LocalProjectsManager::FolderStamps LocalProjectsManager::folderStamps( const LocalProject &project )
+{
+  FolderStamps stamps;
+  stamps.projectDir = ChecksumCache::fileStamp( project.projectDir );
+  stamps.merginDir = ChecksumCache::fileStamp( project.projectDir + "/.mergin" );
+  stamps.metadataFile = ChecksumCache::fileStamp( project.projectDir + "/" + MerginApi::sMetadataFile );
+  if ( !project.qgisProjectFilePath.isEmpty() )
+    stamps.qgisProjectDir = ChecksumCache::fileStamp( QFileInfo( project.qgisProjectFilePath ).absolutePath() );
+
+  // a change within the same time unit as the last one would not be noticed
+  qint64 racyTime = QDateTime::currentMSecsSinceEpoch() - RACY_INTERVAL_MS;
+  bool racy = false;
+  for ( const ChecksumCache::FileStamp &stamp : { stamps.projectDir, stamps.merginDir, stamps.metadataFile, stamps.qgisProjectDir } )
+    racy = racy || stamp.mtime > racyTime;
+
+  stamps.isValid = project.projectError.isEmpty() && stamps.projectDir.isValid() && stamps.qgisProjectDir.isValid() && !racy;
+  return stamps;
+}
+
+void LocalProjectsManager::rebuildIndexes()
+{
+  mIndexById.clear();
+  mIndexByDir.clear();
+  mIndexByProjectFile.clear();
+  for ( int i = 0; i < mProjects.count(); ++i )
+    addToIndexes( i );
+}
+
+void LocalProjectsManager::addToIndexes( int index )
+{
+  const LocalProject &project = mProjects.at( index );
+  QString id = project.id();
+  if ( !mIndexById.contains( id ) )
+    mIndexById.insert( id, index );
+  if ( !mIndexByDir.contains( project.projectDir ) )
+    mIndexByDir.insert( project.projectDir, index );
+  if ( !project.qgisProjectFilePath.isEmpty() && !mIndexByProjectFile.contains( project.qgisProjectFilePath ) )
+    mIndexByProjectFile.insert( project.qgisProjectFilePath, index );
+}
+
+LocalProject LocalProjectsManager::projectFromDirectory( const QString &projectDir ) const
+{
+  return mProjects.value( mIndexByDir.value( projectDir, -1 ) );
 }
 
 LocalProject LocalProjectsManager::projectFromProjectFilePath( const QString &projectFilePath ) const
 {
-  for ( const LocalProject &info : mProjects )
-  {
-    if ( info.qgisProjectFilePath == projectFilePath )
-      return info;
-  }
-  return LocalProject();
+  return mProjects.value( mIndexByProjectFile.value( projectFilePath, -1 ) );
 }
 
 LocalProject LocalProjectsManager::projectFromMerginName( const QString &projectFullName ) const
 {
-  for ( const LocalProject &info : mProjects )
-  {
-    if ( info.id() == projectFullName )
-      return info;
-  }
-  return LocalProject();
+  return mProjects.value( mIndexById.value( projectFullName, -1 ) );
 }
 
 LocalProject LocalProjectsManager::projectFromMerginName( const QString &projectNamespace, const QString &projectName ) const
@@ -99,71 +169,52 @@ void LocalProjectsManager::addMerginProject( const QString &projectDir, const QS
 
 void LocalProjectsManager::removeLocalProject( const QString &projectId )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].id() == projectId )
-    {
-      emit aboutToRemoveLocalProject( mProjects[i] );
+  int i = mIndexById.value( projectId, -1 );
+  if ( i < 0 )
+    return;
 
-      CoreUtils::removeDir( mProjects[i].projectDir );
-      mProjects.removeAt( i );
+  emit aboutToRemoveLocalProject( mProjects[i] );
 
-      return;
-    }
-  }
+  mChangeTracker.forgetProject( mProjects[i].projectDir );
+  mFolderStamps.remove( mProjects[i].projectDir );
+  CoreUtils::removeDir( mProjects[i].projectDir );
+  mProjects.removeAt( i );
+  rebuildIndexes();
 }
 
 bool LocalProjectsManager::projectIsValid( const QString &path ) const
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].qgisProjectFilePath == path )
-    {
-      return mProjects[i].projectError.isEmpty();
-    }
-  }
-  return false;
+  int i = mIndexByProjectFile.value( path, -1 );
+  return i >= 0 && mProjects[i].projectError.isEmpty();
 }
 
 QString LocalProjectsManager::projectId( const QString &path ) const
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].qgisProjectFilePath == path )
-    {
-      return mProjects[i].id();
-    }
-  }
-  return QString();
+  int i = mIndexByProjectFile.value( path, -1 );
+  return i >= 0 ? mProjects[i].id() : QString();
 }
 
 void LocalProjectsManager::updateLocalVersion( const QString &projectDir, int version )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].projectDir == projectDir )
-    {
-      mProjects[i].localVersion = version;
+  int i = mIndexByDir.value( projectDir, -1 );
+  Q_ASSERT( i >= 0 );  // should not happen
+  if ( i < 0 )
+    return;
 
-      emit localProjectDataChanged( mProjects[i] );
-      return;
-    }
-  }
-  Q_ASSERT( false );  // should not happen
+  mProjects[i].localVersion = version;
+  emit localProjectDataChanged( mProjects[i] );
 }
 
 void LocalProjectsManager::updateNamespace( const QString &projectDir, const QString &projectNamespace )
 {
-  for ( int i = 0; i < mProjects.count(); ++i )
-  {
-    if ( mProjects[i].projectDir == projectDir )
-    {
-      mProjects[i].projectNamespace = projectNamespace;
+  int i = mIndexByDir.value( projectDir, -1 );
+  if ( i < 0 )
+    return;
 
-      emit localProjectDataChanged( mProjects[i] );
-      return;
-    }
-  }
+  mProjects[i].projectNamespace = projectNamespace;
+  rebuildIndexes();  // the id has changed
+
+  emit localProjectDataChanged( mProjects[i] );
 }
 
 QString LocalProjectsManager::findQgisProjectFile( const QString &projectDir, QString &err )
@@ -213,5 +264,6 @@ void LocalProjectsManager::addProject( const QString &projectDir, const QString
   project.projectNamespace = projectNamespace;
 
   mProjects << project;
+  addToIndexes( mProjects.count() - 1 );
   emit localProjectAdded( project );
 }
@@ -10,18 +10,28 @@
 #ifndef LOCALPROJECTSMANAGER_H
 #define LOCALPROJECTSMANAGER_H
 
+#include <QHash>
 #include <QObject>
 #include <project.h>
 
+#include "checksumcache.h"
+#include "projectchangetracker.h"
+
 class LocalProjectsManager : public QObject
 {
     Q_OBJECT
   public:
     explicit LocalProjectsManager( const QString &dataDir );
 
-    //! Loads all projects from mDataDir, removes all old projects
+    /**
+     * Loads all projects from mDataDir, removes projects whose folders are gone. Folders that have not changed
+     * since they have been read (see FolderStamps) keep their projects, others are read again.
+     */
     void reloadDataDir();
 
+    //! Returns number of project folders read by the last reloadDataDir()
+    int reloadedProjectsCount() const { return mReloadedProjectsCount; }
+
     QString dataDir() const { return mDataDir; }
 
     LocalProjectsList projects() const { return mProjects; }
@@ -54,6 +64,9 @@ class LocalProjectsManager : public QObject
     //! Finds all QGIS project files and set the err variable if any occured.
     QString findQgisProjectFile( const QString &projectDir, QString &err );
 
+    //! Returns tracker of local changes of the projects
+    ProjectChangeTracker &changeTracker() { return mChangeTracker; }
+
   signals:
     void projectMetadataChanged( const QString &projectDir );
     void localMerginProjectAdded( const QString &projectDir );
@@ -63,10 +76,50 @@ class LocalProjectsManager : public QObject
     void dataDirReloaded();
 
   private:
+    /**
+     * Attributes of the paths in a project folder whose changes may change the project read from it.
+     * A second QGIS project file added deeper in the project is not noticed - projects of folders with
+     * an error or of folders changed too recently to tell are always read again.
+     */
+    struct FolderStamps
+    {
+      ChecksumCache::FileStamp projectDir;
+      ChecksumCache::FileStamp merginDir;       //!< metadata and the download marker are there
+      ChecksumCache::FileStamp metadataFile;
+      ChecksumCache::FileStamp qgisProjectDir;  //!< directory with the QGIS project file
+      bool isValid = false;
+
+      bool operator==( const FolderStamps &other ) const
+      {
+        return projectDir == other.projectDir && merginDir == other.merginDir &&
+               metadataFile == other.metadataFile && qgisProjectDir == other.qgisProjectDir;
+      }
+    };
+
     void addProject( const QString &projectDir, const QString &projectNamespace, const QString &projectName );
 
+    //! Reads the project from the folder of the data dir
+    LocalProject loadProject( const QString &projectDir, const QString &folderName );
+
+    //! Returns current stamps of the project folder (invalid if the project needs to be read on every reload)
+    static FolderStamps folderStamps( const LocalProject &project );
+
+    //! Rebuilds the lookup indexes (after projects have been removed or their ids changed)
+    void rebuildIndexes();
+
+    //! Adds the project at given position to the lookup indexes, the first project wins on duplicates
+    void addToIndexes( int index );
+
     QString mDataDir;   //!< directory with all local projects
     LocalProjectsList mProjects;
+    QHash<QString, int> mIndexById;           //!< project id -> position in mProjects
+    QHash<QString, int> mIndexByDir;          //!< project dir -> position in mProjects
+    QHash<QString, int> mIndexByProjectFile;  //!< QGIS project file path -> position in mProjects
+    QHash<QString, FolderStamps> mFolderStamps;  //!< project dir -> stamps of the folder when it has been read
+    int mReloadedProjectsCount = 0;
+    ProjectChangeTracker mChangeTracker;
+
+    static const qint64 RACY_INTERVAL_MS = 2000;
 };
 
 
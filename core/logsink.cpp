@@ -0,0 +1,368 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "logsink.h"
+
+#include <chrono>
+#include <cstdint>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include "coreutils.h"
+
+LogSink &LogSink::instance()
+{
+  static LogSink sInstance;
+  return sInstance;
+}
+
+LogSink::LogSink( int capacity )
+  : mEnqueuePos( 0 )
+  , mQueued( 0 )
+  , mDropped( 0 )
+  , mLevel( Info )
+  , mHasTopicLevels( false )
+  , mDiscard( false )
+{
+  size_t size = 2;
+  while ( size < static_cast<size_t>( capacity ) )
+    size <<= 1;
+
+  mCells.reset( new Cell[size] );
+  for ( size_t i = 0; i < size; ++i )
+    mCells[i].sequence.store( i, std::memory_order_relaxed );
+  mMask = size - 1;
+}
+
+LogSink::~LogSink()
+{
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mStop = true;
+  }
+  mWakeUp.notify_one();
+
+  if ( mThread.joinable() )
+    mThread.join();
+}
+
+void LogSink::setPath( const QString &path )
+{
+  flush();
+
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mPath = path;
+    mDiscard = ( path == CoreUtils::LOG_TO_DEVNULL );
+  }
+  // entries buffered before the first path was set are written there now
+  mWakeUp.notify_one();
+}
+
+QString LogSink::path() const
+{
+  std::lock_guard<std::mutex> lock( mMutex );
+  return mPath;
+}
+
+void LogSink::setLevel( LogSink::Level level )
+{
+  mLevel = level;
+}
+
+LogSink::Level LogSink::level() const
+{
+  return static_cast<Level>( mLevel.load() );
+}
+
+void LogSink::setTopicLevel( const QString &topic, LogSink::Level level )
+{
+  QWriteLocker locker( &mTopicLevelsLock );
+  mTopicLevels.insert( topic, level );
+  mHasTopicLevels = true;
+}
+
+void LogSink::clearTopicLevel( const QString &topic )
+{
+  QWriteLocker locker( &mTopicLevelsLock );
+  mTopicLevels.remove( topic );
+  mHasTopicLevels = !mTopicLevels.isEmpty();
+}
+
+bool LogSink::isEnabled( const QString &topic, LogSink::Level level ) const
+{
+  if ( mDiscard )
+    return false;
+
+  // most of the time there are no per-topic levels, the lock is not taken then
+  if ( mHasTopicLevels )
+  {
+    QReadLocker locker( &mTopicLevelsLock );
+    auto it = mTopicLevels.constFind( topic );
+    if ( it != mTopicLevels.constEnd() )
+      return level >= it.value();
+  }
+
+  return level >= mLevel.load( std::memory_order_relaxed );
+}
+
+void LogSink::setMaxFileSize( qint64 bytes )
+{
+  std::lock_guard<std::mutex> lock( mMutex );
+  mMaxFileSize = bytes;
+}
+
+void LogSink::setMaxRotatedFiles( int count )
+{
+  std::lock_guard<std::mutex> lock( mMutex );
+  mMaxRotatedFiles = count;
+}
+
+bool LogSink::log( const QString &topic, const QString &message, LogSink::Level level )
+{
+  if ( !isEnabled( topic, level ) )
+    return false;
+
+  startWorker();
+
+  Entry entry;
+  entry.msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+  entry.level = level;
+  entry.topic = topic;
+  entry.message = message;
+
+  if ( !push( entry ) )
+  {
+    ++mDropped;
+    mWakeUp.notify_one();
+    return false;
+  }
+
+  // do not wait for the next regular write when the queue is getting full
+  const qint64 queued = ++mQueued;
+  if ( ( static_cast<size_t>( queued ) & ( mMask >> 1 ) ) == 0 )
+    mWakeUp.notify_one();
+
+  return true;
+}
+
+void LogSink::flush()
+{
+  if ( mQueued == 0 && mDropped == 0 )
+    return;
+
+  startWorker();
+
+  const qint64 target = mQueued;
+  std::unique_lock<std::mutex> lock( mMutex );
+  if ( mPath.isEmpty() )
+    return;  // entries stay buffered until there is a path to write them to
+
+  mFlushRequested = true;
+  mWakeUp.notify_one();
+  mWrittenCondition.wait( lock, [this, target] { return mWritten >= target || mStop; } );
+}
+
+QByteArray LogSink::formatLine( qint64 msecsSinceEpoch, const QString &topic, const QString &message, LogSink::Level level )
+{
+  QString text = message;
+  switch ( level )
+  {
+    case Debug:
+      text.prepend( QStringLiteral( "DEBUG: " ) );
+      break;
+    case Warning:
+      text.prepend( QStringLiteral( "WARNING: " ) );
+      break;
+    case Error:
+      text.prepend( QStringLiteral( "ERROR: " ) );
+      break;
+    case Info:
+      break;
+  }
+
+  QByteArray data;
+  data.append( QString( "%1 %2: %3\n" ).arg( QDateTime::fromMSecsSinceEpoch( msecsSinceEpoch, Qt::UTC ).toString( Qt::ISODateWithMs ) ).arg( topic ).arg( text ) );
+  return data;
+}
+
+QString LogSink::rotatedFilePath( const QString &path, int index )
+{
+  return QStringLiteral( "%1.%2" ).arg( path ).arg( index );
+}
+
+bool LogSink::push( LogSink::Entry &entry )
+{
+  // bounded queue of D. Vyukov - a slot is claimed by moving the enqueue position,
+  // its sequence number then publishes the entry to the consumer
+  Cell *cell = nullptr;
+  size_t pos = mEnqueuePos.load( std::memory_order_relaxed );
+  while ( true )
+  {
+    cell = &mCells[pos & mMask];
+    const size_t seq = cell->sequence.load( std::memory_order_acquire );
+    const intptr_t diff = static_cast<intptr_t>( seq ) - static_cast<intptr_t>( pos );
+    if ( diff == 0 )
+    {
+      if ( mEnqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+        break;
+    }
+    else if ( diff < 0 )
+    {
+      return false; // full
+    }
+    else
+    {
+      pos = mEnqueuePos.load( std::memory_order_relaxed );
+    }
+  }
+
+  cell->entry = std::move( entry );
+  cell->sequence.store( pos + 1, std::memory_order_release );
+  return true;
+}
+
+bool LogSink::pop( LogSink::Entry &entry )
+{
+  Cell &cell = mCells[mDequeuePos & mMask];
+  const size_t seq = cell.sequence.load( std::memory_order_acquire );
+  if ( static_cast<intptr_t>( seq ) - static_cast<intptr_t>( mDequeuePos + 1 ) < 0 )
+    return false; // empty (or the producer has not finished writing the entry yet)
+
+  entry = std::move( cell.entry );
+  cell.entry = Entry();
+  cell.sequence.store( mDequeuePos + mMask + 1, std::memory_order_release );
+  ++mDequeuePos;
+  return true;
+}
+
+void LogSink::startWorker()
+{
+  std::call_once( mWorkerStarted, [this]
+  {
+    mThread = std::thread( &LogSink::run, this );
+  } );
+}
+
+void LogSink::run()
+{
+  while ( true )
+  {
+    bool stop = false;
+    {
+      std::unique_lock<std::mutex> lock( mMutex );
+      if ( !mStop && !mFlushRequested )
+        mWakeUp.wait_for( lock, std::chrono::milliseconds( FLUSH_INTERVAL_MS ) );
+      stop = mStop;
+      mFlushRequested = false;
+    }
+
+    if ( stop )
+    {
+      while ( writePending() ) {}
+      return;
+    }
+
+    writePending();
+  }
+}
+
+bool LogSink::writePending()
+{
+  QString path;
+  qint64 maxFileSize = 0;
+  int maxRotatedFiles = 0;
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    path = mPath;
+    maxFileSize = mMaxFileSize;
+    maxRotatedFiles = mMaxRotatedFiles;
+
+    // keep entries logged before the path is set in the queue (unless the sink is being destroyed)
+    if ( path.isEmpty() && !mStop )
+      return false;
+  }
+
+  QByteArray batch;
+  qint64 count = 0;
+  Entry entry;
+  while ( pop( entry ) )
+  {
+    batch.append( formatLine( entry.msecsSinceEpoch, entry.topic, entry.message, entry.level ) );
+    ++count;
+  }
+
+  const qint64 dropped = mDropped.exchange( 0 );
+  if ( dropped > 0 )
+  {
+    batch.append( formatLine( QDateTime::currentMSecsSinceEpoch(), QStringLiteral( "log" ),
+                              QStringLiteral( "%1 entries were dropped, the log queue was full" ).arg( dropped ), Warning ) );
+  }
+
+  if ( !batch.isEmpty() )
+    writeBatch( batch, path, maxFileSize, maxRotatedFiles );
+
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mWritten += count;
+  }
+  mWrittenCondition.notify_all();
+
+  return count > 0 || dropped > 0;
+}
+
+void LogSink::writeBatch( const QByteArray &batch, const QString &path, qint64 maxFileSize, int maxRotatedFiles )
+{
+  if ( path == CoreUtils::LOG_TO_DEVNULL )
+    return;
+
+  if ( path == CoreUtils::LOG_TO_STDOUT )
+  {
+    QTextStream out( stdout );
+    out << batch;
+    return;
+  }
+
+  qDebug().noquote() << batch.trimmed();
+
+  // the path has never been set - entries have been passed to the debug output at least
+  if ( path.isEmpty() )
+    return;
+
+  // the file is opened once per batch, not per entry
+  QFile file( path );
+  if ( !file.open( QIODevice::Append ) )
+  {
+    qDebug() << "ERROR: Invalid log file";
+    return;
+  }
+  file.write( batch );
+  const qint64 size = file.size();
+  file.close();
+
+  if ( maxFileSize > 0 && size > maxFileSize )
+    rotate( path, maxRotatedFiles );
+}
+
+void LogSink::rotate( const QString &path, int maxRotatedFiles )
+{
+  if ( maxRotatedFiles <= 0 )
+  {
+    QFile::remove( path );
+    return;
+  }
+
+  QFile::remove( rotatedFilePath( path, maxRotatedFiles ) );
+  for ( int i = maxRotatedFiles - 1; i >= 1; --i )
+    QFile::rename( rotatedFilePath( path, i ), rotatedFilePath( path, i + 1 ) );
+  QFile::rename( path, rotatedFilePath( path, 1 ) );
+}
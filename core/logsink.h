@@ -0,0 +1,152 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+
+/**
+ * Background writer of the internal text log (see CoreUtils::log()).
+ *
+ * Entries are put to a bounded lock-free queue by any thread and written by a worker thread in batches,
+ * so logging does not open, write and close the log file on the calling thread. Each entry is written
+ * as "<UTC timestamp> <topic>: <message>" line. When the log file grows over the size limit, it is
+ * rotated to "<file>.1" (older files are shifted up to the number of kept files).
+ *
+ * Entries below the log level (global, or set for the topic) are dropped already in the calling thread.
+ * When the queue is full, entries are dropped too and a note with the number of lost entries is written.
+ * Entries logged before the path is set are kept in the queue and written once it is set.
+ */
+class LogSink
+{
+  public:
+    enum Level
+    {
+      Debug = 0,
+      Info,
+      Warning,
+      Error
+    };
+
+    //! Returns the sink used by CoreUtils::log()
+    static LogSink &instance();
+
+    //! Creates sink with given capacity of the queue (rounded up to a power of two)
+    explicit LogSink( int capacity = DEFAULT_CAPACITY );
+    //! Writes pending entries and stops the worker thread
+    ~LogSink();
+
+    /**
+     * Sets the destination of the log - a file path, CoreUtils::LOG_TO_STDOUT or CoreUtils::LOG_TO_DEVNULL.
+     * Pending entries are written to the previous destination first (if there was one, otherwise to this one).
+     */
+    void setPath( const QString &path );
+    QString path() const;
+
+    //! Sets the lowest level of entries that are written (Info by default)
+    void setLevel( Level level );
+    Level level() const;
+
+    //! Sets the lowest level of entries of the topic that are written, overrides level()
+    void setTopicLevel( const QString &topic, Level level );
+    //! Removes the level of the topic, level() is used for the topic again
+    void clearTopicLevel( const QString &topic );
+
+    //! Returns whether an entry of the topic with given level would be written
+    bool isEnabled( const QString &topic, Level level ) const;
+
+    //! Sets the size of the log file (in bytes) that triggers its rotation, zero or negative to never rotate
+    void setMaxFileSize( qint64 bytes );
+    //! Sets how many rotated files are kept next to the log file
+    void setMaxRotatedFiles( int count );
+
+    //! Queues the entry for writing (does not block). Returns false if it has been dropped
+    bool log( const QString &topic, const QString &message, Level level = Info );
+
+    //! Blocks until all entries queued so far are written, does nothing while no path is set
+    void flush();
+
+    //! Returns the log line for the entry - the same format as written by CoreUtils::log() ever before
+    static QByteArray formatLine( qint64 msecsSinceEpoch, const QString &topic, const QString &message, Level level = Info );
+
+    //! Returns path of the rotated log file with given index (1 is the newest)
+    static QString rotatedFilePath( const QString &path, int index );
+
+    static const int DEFAULT_CAPACITY = 4096;
+    static const qint64 DEFAULT_MAX_FILE_SIZE = 5 * 1024 * 1024;
+    static const int DEFAULT_MAX_ROTATED_FILES = 1;
+
+  private:
+    struct Entry
+    {
+      qint64 msecsSinceEpoch = 0;
+      Level level = Info;
+      QString topic;
+      QString message;
+    };
+
+    //! Slot of the bounded multi-producer/single-consumer queue
+    struct Cell
+    {
+      std::atomic<size_t> sequence;
+      Entry entry;
+    };
+
+    bool push( Entry &entry );
+    bool pop( Entry &entry );
+
+    void startWorker();
+    void run();
+    //! Takes all queued entries and writes them in one batch, returns false if there was nothing to write
+    bool writePending();
+    void writeBatch( const QByteArray &batch, const QString &path, qint64 maxFileSize, int maxRotatedFiles );
+    static void rotate( const QString &path, int maxRotatedFiles );
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask = 0;
+    std::atomic<size_t> mEnqueuePos;
+    size_t mDequeuePos = 0; //!< only used by the worker thread
+
+    std::atomic<qint64> mQueued;
+    std::atomic<qint64> mDropped;
+    qint64 mWritten = 0; //!< guarded by mMutex
+
+    std::atomic<int> mLevel;
+    mutable QReadWriteLock mTopicLevelsLock;
+    QHash<QString, Level> mTopicLevels;
+    std::atomic<bool> mHasTopicLevels;
+
+    // std primitives, the sink may outlive QCoreApplication (it is destroyed with static objects)
+    mutable std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::condition_variable mWrittenCondition;
+    QString mPath;
+    std::atomic<bool> mDiscard; //!< the path is CoreUtils::LOG_TO_DEVNULL
+    qint64 mMaxFileSize = DEFAULT_MAX_FILE_SIZE;
+    int mMaxRotatedFiles = DEFAULT_MAX_ROTATED_FILES;
+    bool mStop = false;
+    bool mFlushRequested = false;
+    std::once_flag mWorkerStarted;
+    std::thread mThread;
+
+    //! Entries are written at least this often
+    static const int FLUSH_INTERVAL_MS = 200;
+};
+
+#endif // LOGSINK_H
@@ -17,14 +17,23 @@
 #include <QByteArray>
 #include <QSet>
 #include <QUuid>
+#include <QRandomGenerator>
 #include <QtMath>
+#include <QtConcurrent>
 
+#include "changesetsession.h"
+#include "checksumcache.h"
+#include "chunkindex.h"
+#include "contentchunker.h"
 #include "coreutils.h"
 #include "geodiffutils.h"
 #include "localprojectsmanager.h"
 #include "merginuserauth.h"
 #include "merginuserinfo.h"
 #include "merginsubscriptioninfo.h"
+#include "projectmetadatastore.h"
+#include "syncjournal.h"
+#include "transfercompression.h"
 
 #include <geodiff.h>
 
@@ -34,6 +43,7 @@ const QString MerginApi::sDefaultApiRoot = QStringLiteral( "https://public.cloud
 const QSet<QString> MerginApi::sIgnoreExtensions = QSet<QString>() << "gpkg-shm" << "gpkg-wal" << "qgs~" << "qgz~" << "pyc" << "swap";
 const QSet<QString> MerginApi::sIgnoreImageExtensions = QSet<QString>() << "jpg" << "jpeg" << "png";
 const QSet<QString> MerginApi::sIgnoreFiles = QSet<QString>() << "mergin.json" << ".DS_Store";
+std::function<bool( const QString & )> MerginApi::sGeoPackagesCheckpoint;
 const int MerginApi::UPLOAD_CHUNK_SIZE = 10 * 1024 * 1024; // Should be the same as on Mergin server
 
 
@@ -55,12 +65,28 @@ MerginApi::MerginApi( LocalProjectsManager &localProjects, QObject *parent )
   QObject::connect( mSubscriptionInfo, &MerginSubscriptionInfo::planProductIdChanged, this, &MerginApi::onPlanProductIdChanged );
   QObject::connect( mUserAuth, &MerginUserAuth::authChanged, this, &MerginApi::authChanged );
 
+  mTransferTimer.setSingleShot( true );
+  QObject::connect( &mTransferTimer, &QTimer::timeout, this, &MerginApi::resumeTransfers );
+
   loadAuthData();
   GEODIFF_init();
   GEODIFF_setLoggerCallback( &GeodiffUtils::log );
   GEODIFF_setMaximumLoggerLevel( GEODIFF_LoggerLevel::LevelDebug );
 }
 
+MerginApi::~MerginApi()
+{
+  // update tasks running on worker threads still emit signals of this object
+  for ( const TransactionStatus &transaction : qAsConst( mTransactionalStatus ) )
+  {
+    if ( transaction.finalizeWatcher )
+    {
+      *transaction.finalizeCanceled = true;
+      transaction.finalizeWatcher->waitForFinished();
+    }
+  }
+}
+
 MerginUserAuth *MerginApi::userAuth() const
 {
   return mUserAuth;
@@ -114,7 +140,9 @@ QString MerginApi::listProjects( const QString &searchExpression, const QString
 
   QNetworkReply *reply = mManager.get( request );
   CoreUtils::log( "list projects", QStringLiteral( "Requesting: " ) + url.toString() );
-  connect( reply, &QNetworkReply::finished, this, [this, requestId]() {this->listProjectsReplyFinished( requestId );} );
+  std::shared_ptr<MerginProjectsListReader> reader = std::make_shared<MerginProjectsListReader>();
+  readReplyData( reply, [reader]( const QByteArray & data ) { reader->addData( data ); } );
+  connect( reply, &QNetworkReply::finished, this, [this, requestId, reader]() {this->listProjectsReplyFinished( requestId, reader );} );
 
   return requestId;
 }
@@ -139,12 +167,37 @@ QString MerginApi::listProjectsByName( const QStringList &projectNames )
 
   QNetworkReply *reply = mManager.post( request, body.toJson() );
   CoreUtils::log( "list projects by name", QStringLiteral( "Requesting: " ) + url.toString() );
-  connect( reply, &QNetworkReply::finished, this, [this, requestId]() {this->listProjectsByNameReplyFinished( requestId );} );
+  std::shared_ptr<MerginProjectsListReader> reader = std::make_shared<MerginProjectsListReader>();
+  readReplyData( reply, [reader]( const QByteArray & data ) { reader->addData( data ); } );
+  connect( reply, &QNetworkReply::finished, this, [this, requestId, reader]() {this->listProjectsByNameReplyFinished( requestId, reader );} );
 
   return requestId;
 }
 
 
+//! Identifies the item in the pull journal - an item of another pull to the same version downloads the same data
+static QString downloadItemKey( const DownloadQueueItem &item )
+{
+  return QStringLiteral( "%1|%2|%3|%4|%5" ).arg( item.filePath ).arg( item.version )
+         .arg( item.rangeFrom ).arg( item.rangeTo ).arg( item.downloadDiff ? 1 : 0 );
+}
+
+bool MerginApi::openDownloadTempFile( QFile &tempFile, const DownloadQueueItem &item )
+{
+  if ( item.fileSize < 0 )
+    return tempFile.open( QIODevice::WriteOnly );
+
+  // chunks of a file are written straight to their position in the file - there is no need to assemble them later
+  if ( !tempFile.open( QIODevice::ReadWrite ) )
+    return false;
+
+  // the first chunk preallocates the file (sparse where supported), the others must not truncate it
+  if ( tempFile.size() < item.fileSize && !tempFile.resize( item.fileSize ) )
+    return false;
+
+  return tempFile.seek( item.rangeFrom );
+}
+
 void MerginApi::downloadNextItem( const QString &projectFullName )
 {
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
@@ -152,40 +205,97 @@ void MerginApi::downloadNextItem( const QString &projectFullName )
 
   if ( transaction.downloadQueue.isEmpty() )
   {
-    // there's nothing to download so just finalize the update
-    finalizeProjectUpdate( projectFullName );
+    if ( transaction.replyDownloadItems.isEmpty() )
+    {
+      // there's nothing to download so just finalize the update
+      finalizeProjectUpdate( projectFullName );
+    }
+    // otherwise wait for the pending items to arrive
     return;
   }
 
-  DownloadQueueItem item = transaction.downloadQueue.takeFirst();
+  while ( !transaction.downloadQueue.isEmpty() && transaction.replyDownloadItems.count() < mDownloadWindow &&
+          canSendTransferRequest( transaction.downloadQueue.first().size ) )
+  {
+    DownloadQueueItem item = transaction.downloadQueue.takeFirst();
 
-  QUrl url( mApiRoot + QStringLiteral( "/v1/project/raw/" ) + projectFullName );
-  QUrlQuery query;
-  // Handles special chars in a filePath (e.g prevents to convert "+" sign into a space)
-  query.addQueryItem( "file", item.filePath.toUtf8().toPercentEncoding() );
-  query.addQueryItem( "version", QStringLiteral( "v%1" ).arg( item.version ) );
-  if ( item.downloadDiff )
-    query.addQueryItem( "diff", "true" );
-  url.setQuery( query );
+    QUrl url( mApiRoot + QStringLiteral( "/v1/project/raw/" ) + projectFullName );
+    QUrlQuery query;
+    // Handles special chars in a filePath (e.g prevents to convert "+" sign into a space)
+    query.addQueryItem( "file", item.filePath.toUtf8().toPercentEncoding() );
+    query.addQueryItem( "version", QStringLiteral( "v%1" ).arg( item.version ) );
+    if ( item.downloadDiff )
+      query.addQueryItem( "diff", "true" );
+    url.setQuery( query );
 
-  QNetworkRequest request = getDefaultRequest();
-  request.setUrl( url );
-  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
-  request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ), item.tempFileName );
+    QNetworkRequest request = getDefaultRequest();
+    request.setUrl( url );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrDownloadItemKey ), downloadItemKey( item ) );
 
-  QString range;
-  if ( item.rangeFrom != -1 && item.rangeTo != -1 )
-  {
-    range = QStringLiteral( "bytes=%1-%2" ).arg( item.rangeFrom ).arg( item.rangeTo );
-    request.setRawHeader( "Range", range.toUtf8() );
+    // the only chunk of a small file is the whole file, it may come compressed then
+    QString range;
+    bool wholeFile = item.rangeFrom == 0 && item.rangeTo == item.fileSize - 1;
+    if ( item.rangeFrom != -1 && item.rangeTo != -1 && !wholeFile )
+    {
+      range = QStringLiteral( "bytes=%1-%2" ).arg( item.rangeFrom ).arg( item.rangeTo );
+      request.setRawHeader( "Range", range.toUtf8() );
+    }
+
+    // without the header, the network access manager accepts compressed data and inflates them as they arrive.
+    // A range of compressed data would be a range of the compressed stream, not of the file - ranges are never compressed
+    if ( !mTransferCompression || !TransferCompression::isCompressible( item.filePath ) || !range.isEmpty() )
+      request.setRawHeader( "Accept-Encoding", "identity" );
+
+    QNetworkReply *reply = mManager.get( request );
+    transaction.replyDownloadItems << reply;
+    transaction.downloadItemsInFlight.insert( downloadItemKey( item ), item );
+
+    // data are streamed to the temp file as they arrive, the reply only keeps a small buffer
+    QString tempFilePath = getTempProjectDir( projectFullName ) + "/" + item.tempFileName;
+    createPathIfNotExists( tempFilePath );
+    QFile *tempFile = new QFile( tempFilePath, reply );
+    if ( !openDownloadTempFile( *tempFile, item ) )
+    {
+      CoreUtils::log( "pull " + projectFullName, "Failed to open for writing: " + tempFilePath );
+      tempFile->close();
+    }
+    reply->setReadBufferSize( CHUNK_SIZE );
+
+    connect( reply, &QNetworkReply::readyRead, this, &MerginApi::downloadItemReplyReadyRead );
+    connect( reply, &QNetworkReply::finished, this, &MerginApi::downloadItemReplyFinished );
+
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Requesting item: " ) + url.toString() +
+                    ( !range.isEmpty() ? " Range: " + range : QString() ) );
   }
+}
 
-  Q_ASSERT( !transaction.replyDownloadItem );
-  transaction.replyDownloadItem = mManager.get( request );
-  connect( transaction.replyDownloadItem, &QNetworkReply::finished, this, &MerginApi::downloadItemReplyFinished );
+void MerginApi::abortDownloadItems( TransactionStatus &transaction )
+{
+  // take the list first - abort() emits finished() synchronously and we do not want to get back to the slot
+  const QList< QPointer<QNetworkReply> > replies = transaction.replyDownloadItems;
+  const QHash<QString, DownloadQueueItem> items = transaction.downloadItemsInFlight;
+  transaction.replyDownloadItems.clear();
+  transaction.downloadItemsInFlight.clear();
+
+  for ( const QPointer<QNetworkReply> &reply : replies )
+  {
+    if ( !reply )
+      continue;
+
+    disconnect( reply, &QNetworkReply::finished, this, &MerginApi::downloadItemReplyFinished );
+    reply->abort();
+    reply->deleteLater();
 
-  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Requesting item: " ) + url.toString() +
-                  ( !range.isEmpty() ? " Range: " + range : QString() ) );
+    // partially downloaded items are never reused (a partial chunk gets overwritten by the next download of it)
+    if ( QFile *tempFile = reply->findChild<QFile *>() )
+    {
+      tempFile->close();
+      QString key = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrDownloadItemKey ) ).toString();
+      if ( items.value( key ).fileSize < 0 )
+        tempFile->remove();
+    }
+  }
 }
 
 void MerginApi::removeProjectsTempFolder( const QString &projectNamespace, const QString &projectName )
@@ -240,6 +350,137 @@ void MerginApi::setSupportsSelectiveSync( bool supportsSelectiveSync )
   mSupportsSelectiveSync = supportsSelectiveSync;
 }
 
+int MerginApi::downloadWindow() const
+{
+  return mDownloadWindow;
+}
+
+void MerginApi::setDownloadWindow( int downloadWindow )
+{
+  mDownloadWindow = qMax( 1, downloadWindow );
+}
+
+int MerginApi::uploadWindow() const
+{
+  return mUploadWindow;
+}
+
+void MerginApi::setUploadWindow( int uploadWindow )
+{
+  mUploadWindow = qMax( 1, uploadWindow );
+}
+
+bool MerginApi::transferCompression() const
+{
+  return mTransferCompression;
+}
+
+void MerginApi::setTransferCompression( bool enabled )
+{
+  mTransferCompression = enabled;
+}
+
+bool MerginApi::serverSupportsChunkDedup() const
+{
+  return mServerSupportsChunkDedup;
+}
+
+void MerginApi::setServerSupportsChunkDedup( bool supported )
+{
+  mServerSupportsChunkDedup = supported;
+}
+
+int MerginApi::maxActiveTransfers() const
+{
+  return mSyncScheduler.maxActiveTransfers();
+}
+
+void MerginApi::setMaxActiveTransfers( int count )
+{
+  mSyncScheduler.setMaxActiveTransfers( count );
+}
+
+int MerginApi::maxTransferRequests() const
+{
+  return mMaxTransferRequests;
+}
+
+void MerginApi::setMaxTransferRequests( int count )
+{
+  mMaxTransferRequests = qMax( 1, count );
+  resumeTransfers();
+}
+
+qint64 MerginApi::bandwidthLimit() const
+{
+  return mSyncScheduler.bandwidthLimit();
+}
+
+void MerginApi::setBandwidthLimit( qint64 bytesPerSecond )
+{
+  mSyncScheduler.setBandwidthLimit( bytesPerSecond );
+  mTransferTimer.stop();
+  resumeTransfers();
+}
+
+void MerginApi::setActiveProject( const QString &projectFilePath )
+{
+  LocalProject project = mLocalProjects.projectFromProjectFilePath( projectFilePath );
+  if ( project.isValid() && !project.projectName.isEmpty() )
+    mSyncScheduler.setPreferredProject( getFullProjectName( project.projectNamespace, project.projectName ) );
+  else
+    mSyncScheduler.setPreferredProject( QString() );
+}
+
+void MerginApi::requestTransfer( const QString &projectFullName, qint64 size, const std::function<void()> &start )
+{
+  if ( !mSyncScheduler.requestTransfer( projectFullName, size, start ) )
+  {
+    CoreUtils::log( "sync " + projectFullName, QStringLiteral( "Waiting for other projects to finish transfers (%1 queued)" )
+                    .arg( mSyncScheduler.queuedProjects().count() ) );
+  }
+}
+
+int MerginApi::transferRequestsCount() const
+{
+  int count = 0;
+  for ( const TransactionStatus &transaction : mTransactionalStatus )
+    count += transaction.replyDownloadItems.count() + transaction.replyUploadFiles.count();
+  return count;
+}
+
+bool MerginApi::canSendTransferRequest( qint64 size )
+{
+  if ( transferRequestsCount() >= mMaxTransferRequests )
+    return false;  // resumed once one of the requests finishes
+
+  int delay = mSyncScheduler.reserveBandwidth( size );
+  if ( delay > 0 )
+  {
+    if ( !mTransferTimer.isActive() )
+      mTransferTimer.start( delay );
+    return false;
+  }
+  return true;
+}
+
+void MerginApi::resumeTransfers()
+{
+  const QStringList projects = mSyncScheduler.activeProjects();
+  for ( const QString &projectFullName : projects )
+  {
+    if ( !mTransactionalStatus.contains( projectFullName ) )
+      continue;
+
+    // only syncs in the middle of a transfer, the others send their requests once they get there
+    const TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+    if ( !transaction.downloadQueue.isEmpty() )
+      downloadNextItem( projectFullName );
+    else if ( !transaction.uploadChunkQueue.isEmpty() )
+      uploadNextChunks( projectFullName );
+  }
+}
+
 bool MerginApi::apiSupportsSubscriptions() const
 {
   return mApiSupportsSubscriptions;
@@ -270,69 +511,153 @@ QString MerginApi::getApiKey( const QString &serverName )
   return "not-secret-key";
 }
 
-void MerginApi::downloadItemReplyFinished()
+qint64 MerginApi::writeDownloadedData( QNetworkReply *reply )
+{
+  // keep error responses in the reply - the message is extracted once it has finished
+  int httpStatus = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+  if ( httpStatus < 200 || httpStatus >= 300 )
+    return 0;
+
+  QFile *tempFile = reply->findChild<QFile *>();
+  Q_ASSERT( tempFile );
+
+  char buffer[CHUNK_SIZE];
+  qint64 written = 0;
+  while ( reply->bytesAvailable() > 0 )
+  {
+    if ( !tempFile->isOpen() )
+      return -1;  // failed to open or to write before
+
+    qint64 bytesRead = reply->read( buffer, CHUNK_SIZE );
+    if ( bytesRead <= 0 )
+      break;
+    if ( tempFile->write( buffer, bytesRead ) != bytesRead )
+    {
+      CoreUtils::log( "pull", "Failed to write to: " + tempFile->fileName() );
+      tempFile->close();
+      return -1;
+    }
+    written += bytesRead;
+  }
+  return written;
+}
+
+void MerginApi::downloadItemReplyReadyRead()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
 
   QString projectFullName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ) ).toString();
-  QString tempFileName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrTempFileName ) ).toString();
 
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
-  Q_ASSERT( r == transaction.replyDownloadItem );
 
-  if ( r->error() == QNetworkReply::NoError )
+  qint64 written = writeDownloadedData( r );
+  if ( written < 0 )
   {
-    QByteArray data = r->readAll();
+    // there is no point in downloading the rest - downloadItemReplyFinished() fails the item
+    r->abort();
+  }
+  else if ( written )
+  {
+    transaction.transferedSize += written;
+    emit syncProjectStatusChanged( projectFullName, transaction.progress() );
+  }
+}
 
-    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded item (%1 bytes)" ).arg( data.size() ) );
+void MerginApi::downloadItemReplyFinished()
+{
+  QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
+  Q_ASSERT( r );
 
-    QString tempFolder = getTempProjectDir( projectFullName );
-    QString tempFilePath = tempFolder + "/" + tempFileName;
-    createPathIfNotExists( tempFilePath );
+  QString projectFullName = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ) ).toString();
+  QString itemKey = r->request().attribute( static_cast<QNetworkRequest::Attribute>( AttrDownloadItemKey ) ).toString();
 
-    // save to a tmp file, assemble at the end
-    QFile file( tempFilePath );
-    if ( file.open( QIODevice::WriteOnly ) )
-    {
-      file.write( data );
-      file.close();
-    }
-    else
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+  Q_ASSERT( transaction.replyDownloadItems.contains( r ) );
+
+  transaction.replyDownloadItems.removeAll( r );
+  r->deleteLater();
+
+  DownloadQueueItem item = transaction.downloadItemsInFlight.take( itemKey );
+  QString tempFileName = item.tempFileName;
+  QFile *tempFile = r->findChild<QFile *>();
+  Q_ASSERT( tempFile );
+
+  // the size of (inflated) data is the only check of the item before the file is assembled and its checksum known
+  bool wrongSize = false;
+  bool writeFailed = !tempFile->isOpen();  // closed when it could not be opened or written
+  qint64 itemSize = 0;
+  if ( r->error() == QNetworkReply::NoError && !writeFailed )
+  {
+    // write whatever has not been handled in readyRead yet
+    qint64 written = writeDownloadedData( r );
+    writeFailed = written < 0;
+    if ( !writeFailed )
     {
-      CoreUtils::log( "pull " + projectFullName, "Failed to open for writing: " + file.fileName() );
+      transaction.transferedSize += written;
+      itemSize = item.fileSize >= 0 ? tempFile->pos() - item.rangeFrom : tempFile->size();
+      wrongSize = itemSize != item.size;
     }
+  }
+
+  if ( r->error() == QNetworkReply::NoError && !writeFailed && !wrongSize )
+  {
+    emit syncProjectStatusChanged( projectFullName, transaction.progress() );
 
-    transaction.transferedSize += data.size();
-    emit syncProjectStatusChanged( projectFullName, transaction.transferedSize / transaction.totalSize );
+    tempFile->close();
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded item %1 (%2 bytes)" ).arg( itemKey ).arg( itemSize ) );
+
+    if ( !transaction.firstTimeDownload )
+    {
+      QJsonObject entry;
+      entry.insert( QStringLiteral( "item" ), downloadItemKey( item ) );
+      entry.insert( QStringLiteral( "temp" ), tempFileName );
+      SyncJournal::append( transaction.projectDir, SyncJournal::Pull, entry );
+    }
 
-    // Send another request (or finish)
+    // Send more requests (or finish), other syncs may have been waiting for the request to finish
     downloadNextItem( projectFullName );
+    resumeTransfers();
   }
   else
   {
     QString serverMsg = extractServerErrorMsg( r->readAll() );
-    if ( serverMsg.isEmpty() )
+    if ( writeFailed )
+    {
+      serverMsg = QStringLiteral( "Failed to write item %1 to %2" ).arg( itemKey, tempFile->fileName() );
+    }
+    else if ( wrongSize )
+    {
+      serverMsg = QStringLiteral( "Item %1 has %2 bytes, expected %3" ).arg( itemKey ).arg( itemSize ).arg( item.size );
+    }
+    else if ( serverMsg.isEmpty() )
     {
       serverMsg = r->errorString();
     }
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "FAILED - %1. %2" ).arg( r->errorString(), serverMsg ) );
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
-
-    // get rid of the temporary download dir where we may have left some downloaded files
-    QDir( getTempProjectDir( projectFullName ) ).removeRecursively();
+    // the whole pull fails - there is no point in waiting for other items
+    abortDownloadItems( transaction );
+    tempFile->close();
+    if ( item.fileSize < 0 )
+      tempFile->remove();  // a chunk in the shared temp file gets overwritten by the next download of it
 
     if ( transaction.firstTimeDownload )
     {
+      // get rid of the temporary download dir where we may have left some downloaded files
+      QDir( getTempProjectDir( projectFullName ) ).removeRecursively();
+
       Q_ASSERT( !transaction.projectDir.isEmpty() );
       QDir( transaction.projectDir ).removeRecursively();
     }
+    else
+    {
+      // items downloaded so far are journaled, the next pull of the same version continues from there
+      CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Keeping downloaded items to resume the pull" ) );
+    }
 
     finishProjectSync( projectFullName, false );
 
@@ -349,7 +674,7 @@ void MerginApi::cacheServerConfig()
 
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
-  Q_ASSERT( r == transaction.replyDownloadItem );
+  Q_ASSERT( r == transaction.replyDownloadConfig );
 
   if ( r->error() == QNetworkReply::NoError )
   {
@@ -358,8 +683,8 @@ void MerginApi::cacheServerConfig()
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded mergin config (%1 bytes)" ).arg( data.size() ) );
     transaction.config = MerginConfig::fromJson( data );
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
+    transaction.replyDownloadConfig->deleteLater();
+    transaction.replyDownloadConfig = nullptr;
 
     prepareDownloadConfig( projectFullName, true );
   }
@@ -372,8 +697,8 @@ void MerginApi::cacheServerConfig()
     }
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Failed to cache mergin config - %1. %2" ).arg( r->errorString(), serverMsg ) );
 
-    transaction.replyDownloadItem->deleteLater();
-    transaction.replyDownloadItem = nullptr;
+    transaction.replyDownloadConfig->deleteLater();
+    transaction.replyDownloadConfig = nullptr;
 
     // get rid of the temporary download dir where we may have left some downloaded files
     CoreUtils::removeDir( getTempProjectDir( projectFullName ) );
@@ -390,7 +715,7 @@ void MerginApi::cacheServerConfig()
 }
 
 
-void MerginApi::uploadFile( const QString &projectFullName, const QString &transactionUUID, MerginFile file, int chunkNo )
+void MerginApi::uploadFile( const QString &projectFullName, const QString &transactionUUID, const UploadQueueItem &chunk )
 {
   if ( !validateAuthAndContinute() || mApiVersionStatus != MerginApiStatus::OK )
   {
@@ -400,36 +725,182 @@ void MerginApi::uploadFile( const QString &projectFullName, const QString &trans
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
-  QString chunkID = file.chunks.at( chunkNo );
-
-  QString filePath;
-  if ( file.diffName.isEmpty() )
-    filePath = transaction.projectDir + "/" + file.path;
-  else  // use diff file instead of full file
-    filePath = transaction.projectDir + "/.mergin/" + file.diffName;
-
-  QFile f( filePath );
+  QFile f( chunk.sourcePath );
   QByteArray data;
 
   if ( f.open( QIODevice::ReadOnly ) )
   {
-    f.seek( chunkNo * UPLOAD_CHUNK_SIZE );
-    data = f.read( UPLOAD_CHUNK_SIZE );
+    f.seek( chunk.offset );
+    data = f.read( chunk.size );
   }
 
   QNetworkRequest request = getDefaultRequest();
-  QUrl url( mApiRoot + QStringLiteral( "/v1/project/push/chunk/%1/%2" ).arg( transactionUUID ).arg( chunkID ) );
+  QUrl url( mApiRoot + QStringLiteral( "/v1/project/push/chunk/%1/%2" ).arg( transactionUUID ).arg( chunk.chunkId ) );
   request.setUrl( url );
   request.setRawHeader( "Content-Type", "application/octet-stream" );
   request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
 
-  Q_ASSERT( !transaction.replyUploadFile );
-  transaction.replyUploadFile = mManager.post( request, data );
-  connect( transaction.replyUploadFile, &QNetworkReply::finished, this, &MerginApi::uploadFileReplyFinished );
+  // the server checks the chunk (and later the whole file) against checksums of the uncompressed data
+  if ( mTransferCompression && TransferCompression::isCompressible( chunk.filePath ) )
+  {
+    QByteArray compressed = TransferCompression::deflate( data );
+    if ( compressed.size() < data.size() )
+    {
+      data = compressed;
+      request.setRawHeader( "Content-Encoding", "deflate" );
+    }
+  }
+
+  QNetworkReply *reply = mManager.post( request, data );
+  transaction.replyUploadFiles << reply;
+  transaction.uploadChunksInFlight.insert( chunk.chunkId, chunk );
+  connect( reply, &QNetworkReply::finished, this, &MerginApi::uploadFileReplyFinished );
 
   CoreUtils::log( "push " + projectFullName, QStringLiteral( "Uploading item: " ) + url.toString() );
 }
 
+int MerginApi::uploadRetryDelay( int retries )
+{
+  // exponential backoff, the random part keeps chunks that failed together from being retried at once
+  int delay = UPLOAD_CHUNK_RETRY_DELAY_MS << qBound( 0, retries - 1, 10 );
+  return delay + static_cast<int>( QRandomGenerator::global()->bounded( delay / 2 + 1 ) );
+}
+
+void MerginApi::uploadNextChunks( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( transaction.uploadChunkQueue.isEmpty() )
+  {
+    // finish may be only requested once the server has acknowledged every single chunk
+    if ( transaction.replyUploadFiles.isEmpty() && transaction.uploadChunksRetrying.isEmpty() )
+    {
+      uploadFinish( projectFullName, transaction.transactionUUID );
+    }
+    return;
+  }
+
+  while ( !transaction.uploadChunkQueue.isEmpty() && transaction.replyUploadFiles.count() < mUploadWindow &&
+          canSendTransferRequest( transaction.uploadChunkQueue.first().size ) )
+  {
+    UploadQueueItem chunk = transaction.uploadChunkQueue.takeFirst();
+    uploadFile( projectFullName, transaction.transactionUUID, chunk );
+  }
+}
+
+void MerginApi::abortUploadFiles( TransactionStatus &transaction )
+{
+  // take the list first - abort() emits finished() synchronously and we do not want to get back to the slot
+  const QList< QPointer<QNetworkReply> > replies = transaction.replyUploadFiles;
+  transaction.replyUploadFiles.clear();
+  transaction.uploadChunksInFlight.clear();
+  transaction.uploadChunksRetrying.clear();  // their timers find nothing to send
+
+  for ( const QPointer<QNetworkReply> &reply : replies )
+  {
+    if ( !reply )
+      continue;
+
+    disconnect( reply, &QNetworkReply::finished, this, &MerginApi::uploadFileReplyFinished );
+    reply->abort();
+    reply->deleteLater();
+  }
+}
+
+QList<UploadQueueItem> MerginApi::itemsForUploadChunks( const QString &projectDir, const QList<MerginFile> &files )
+{
+  QList<UploadQueueItem> lst;
+  for ( const MerginFile &file : files )
+  {
+    QString sourcePath;
+    qint64 fileSize;
+    if ( file.diffName.isEmpty() )
+    {
+      sourcePath = projectDir + "/" + file.path;
+      fileSize = file.size;
+    }
+    else  // use diff file instead of full file
+    {
+      sourcePath = projectDir + "/.mergin/" + file.diffName;
+      fileSize = file.diffSize;
+    }
+
+    // content-defined chunks of a full file have their own sizes, other chunks are of fixed size
+    bool contentDefined = file.diffName.isEmpty() && file.chunkSizes.size() == file.chunks.size();
+    qint64 from = 0;
+    for ( int chunkNo = 0; chunkNo < file.chunks.size(); ++chunkNo )
+    {
+      qint64 size;
+      if ( contentDefined )
+        size = file.chunkSizes.at( chunkNo );
+      else
+        size = qBound( static_cast<qint64>( 0 ), fileSize - from, static_cast<qint64>( UPLOAD_CHUNK_SIZE ) );
+      lst << UploadQueueItem( file.path, sourcePath, file.chunks.at( chunkNo ), chunkNo, from, size );
+      from += size;
+    }
+  }
+  return lst;
+}
+
+void MerginApi::setChunksForFullUpload( const QString &projectDir, MerginFile &file, bool contentDefined )
+{
+  file.chunkSizes.clear();
+
+  if ( contentDefined )
+  {
+    const QList<ContentChunker::Chunk> chunks = ContentChunker().chunkFile( projectDir + "/" + file.path );
+    if ( !chunks.isEmpty() )
+    {
+      file.chunks.clear();
+      for ( const ContentChunker::Chunk &chunk : chunks )
+      {
+        file.chunks << chunk.id;
+        file.chunkSizes << chunk.size;
+      }
+      return;
+    }
+  }
+
+  file.chunks = generateChunkIdsForSize( file.size );
+}
+
+void MerginApi::skipKnownChunks( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( !mServerSupportsChunkDedup )
+    return;
+
+  ChunkIndex index( transaction.projectDir );
+  QSet<QString> queued;
+  QList<UploadQueueItem> chunks;
+  qint64 skippedSize = 0;
+  for ( const UploadQueueItem &chunk : qAsConst( transaction.uploadChunkQueue ) )
+  {
+    // the same content may be in several files (or several times in a file), it is enough to upload it once
+    if ( index.contains( chunk.chunkId ) || queued.contains( chunk.chunkId ) )
+    {
+      skippedSize += chunk.size;
+      continue;
+    }
+    queued.insert( chunk.chunkId );
+    chunks << chunk;
+  }
+
+  int skippedCount = transaction.uploadChunkQueue.count() - chunks.count();
+  if ( skippedCount == 0 )
+    return;
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Skipping %1 of %2 chunks the server has already (%3 bytes)" )
+                  .arg( skippedCount ).arg( transaction.uploadChunkQueue.count() ).arg( skippedSize ) );
+
+  transaction.uploadChunkQueue = chunks;
+  transaction.transferedSize += skippedSize;
+  transaction.uploadSkippedKnownChunks = true;
+}
+
 void MerginApi::uploadStart( const QString &projectFullName, const QByteArray &json )
 {
   if ( !validateAuthAndContinute() || mApiVersionStatus != MerginApiStatus::OK )
@@ -478,11 +949,16 @@ void MerginApi::uploadCancel( const QString &projectFullName )
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting upload start" ) );
     transaction.replyUploadStart->abort();  // will trigger uploadStartReplyFinished slot and emit sync finished
   }
-  else if ( transaction.replyUploadFile )
+  else if ( !transaction.replyUploadFiles.isEmpty() )
   {
     QString transactionUUID = transaction.transactionUUID;  // copy transaction uuid as the transaction object will be gone after abort
-    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting upload file" ) );
-    transaction.replyUploadFile->abort();  // will trigger uploadFileReplyFinished slot and emit sync finished
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting %1 pending file uploads" ).arg( transaction.replyUploadFiles.count() ) );
+    // the transaction is canceled on the server, there is nothing to resume
+    discardPushJournal( transaction.projectDir );
+
+    // abort of the first reply will trigger uploadFileReplyFinished slot which aborts all the other replies and emits sync finished
+    QPointer<QNetworkReply> reply = transaction.replyUploadFiles.first();
+    reply->abort();
 
     // also need to cancel the transaction
     sendUploadCancelRequest( projectFullName, transactionUUID );
@@ -491,10 +967,33 @@ void MerginApi::uploadCancel( const QString &projectFullName )
   {
     QString transactionUUID = transaction.transactionUUID;  // copy transaction uuid as the transaction object will be gone after abort
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Aborting upload finish" ) );
+    discardPushJournal( transaction.projectDir );
     transaction.replyUploadFinish->abort();  // will trigger uploadFinishReplyFinished slot and emit sync finished
 
     sendUploadCancelRequest( projectFullName, transactionUUID );
   }
+  else if ( transaction.chunkingWatcher )
+  {
+    // chunks of the files are being computed, nothing has been sent to the server yet - the result gets dropped
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Canceling push while files are split to chunks" ) );
+    finishProjectSync( projectFullName, false );
+  }
+  else if ( mSyncScheduler.isQueued( projectFullName ) )
+  {
+    // the push is waiting for a transfer slot, nothing has been sent to the server yet
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Removing push from the transfer queue" ) );
+    finishProjectSync( projectFullName, false );
+  }
+  else if ( !transaction.uploadChunkQueue.isEmpty() || !transaction.uploadChunksRetrying.isEmpty() )
+  {
+    // chunks are held back by the limits shared by all syncs or wait to be retried, none of them is in flight
+    QString transactionUUID = transaction.transactionUUID;
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Canceling push waiting to upload chunks" ) );
+    discardPushJournal( transaction.projectDir );
+    finishProjectSync( projectFullName, false );
+
+    sendUploadCancelRequest( projectFullName, transactionUUID );
+  }
   else
   {
     Q_ASSERT( false );  // unexpected state
@@ -530,11 +1029,41 @@ void MerginApi::updateCancel( const QString &projectFullName )
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting project info request" ) );
     transaction.replyProjectInfo->abort();  // abort will trigger updateInfoReplyFinished() slot
   }
-  else if ( transaction.replyDownloadItem )
+  else if ( transaction.replyDownloadConfig )
+  {
+    // we're fetching mergin config
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting mergin config download" ) );
+    transaction.replyDownloadConfig->abort();  // abort will trigger cacheServerConfig slot
+  }
+  else if ( transaction.finalizeWatcher )
+  {
+    // everything has been downloaded and update tasks are running
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Canceling update tasks" ) );
+    // only takes effect until the worker starts to change the project directory - it is never left half-updated
+    *transaction.finalizeCanceled = true;  // finalizeProjectUpdateFinished() will be called once the worker stops
+  }
+  else if ( !transaction.replyDownloadItems.isEmpty() )
   {
     // we're already downloading some files
-    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting pending download" ) );
-    transaction.replyDownloadItem->abort();  // abort will trigger downloadItemReplyFinished slot
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Aborting %1 pending downloads" ).arg( transaction.replyDownloadItems.count() ) );
+    // abort of the first reply will trigger downloadItemReplyFinished slot which aborts all the other replies too
+    QPointer<QNetworkReply> reply = transaction.replyDownloadItems.first();
+    reply->abort();
+  }
+  else if ( mSyncScheduler.isQueued( projectFullName ) || !transaction.downloadQueue.isEmpty() )
+  {
+    // waiting for a transfer slot or held back by the limits shared by all syncs - nothing is in flight
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Canceling pull waiting for transfer" ) );
+
+    if ( transaction.firstTimeDownload )
+    {
+      QDir( getTempProjectDir( projectFullName ) ).removeRecursively();
+
+      Q_ASSERT( !transaction.projectDir.isEmpty() );
+      QDir( transaction.projectDir ).removeRecursively();
+    }
+
+    finishProjectSync( projectFullName, false );
   }
   else
   {
@@ -581,6 +1110,11 @@ void MerginApi::updateProject( const QString &projectNamespace, const QString &p
     mTransactionalStatus[projectFullName].replyProjectInfo = reply;
     mTransactionalStatus[projectFullName].configAllowed = mSupportsSelectiveSync;
 
+    // project info of large projects is parsed while it is being received, not all at once when finished
+    std::shared_ptr<MerginProjectMetadataReader> reader = std::make_shared<MerginProjectMetadataReader>();
+    mTransactionalStatus[projectFullName].projectInfoReader = reader;
+    readReplyData( reply, [reader]( const QByteArray & data ) { reader->addData( data ); } );
+
     emit syncProjectStatusChanged( projectFullName, 0 );
 
     connect( reply, &QNetworkReply::finished, this, &MerginApi::updateInfoReplyFinished );
@@ -609,6 +1143,10 @@ void MerginApi::uploadProject( const QString &projectNamespace, const QString &p
     mTransactionalStatus[projectFullName].isInitialUpload = isInitialUpload;
     mTransactionalStatus[projectFullName].configAllowed = mSupportsSelectiveSync;
 
+    std::shared_ptr<MerginProjectMetadataReader> reader = std::make_shared<MerginProjectMetadataReader>();
+    mTransactionalStatus[projectFullName].projectInfoReader = reader;
+    readReplyData( reply, [reader]( const QByteArray & data ) { reader->addData( data ); } );
+
     emit syncProjectStatusChanged( projectFullName, 0 );
 
     connect( reply, &QNetworkReply::finished, this, &MerginApi::uploadInfoReplyFinished );
@@ -1009,6 +1547,7 @@ void MerginApi::pingMerginReplyFinished()
   QString apiVersion;
   QString serverMsg;
   bool serverSupportsSubscriptions = false;
+  bool serverSupportsChunkDedup = false;
 
   if ( r->error() == QNetworkReply::NoError )
   {
@@ -1019,6 +1558,7 @@ void MerginApi::pingMerginReplyFinished()
       QJsonObject obj = doc.object();
       apiVersion = obj.value( QStringLiteral( "version" ) ).toString();
       serverSupportsSubscriptions = obj.value( QStringLiteral( "subscriptions_enabled" ) ).toBool();
+      serverSupportsChunkDedup = obj.value( QStringLiteral( "chunk_dedup_enabled" ) ).toBool();
     }
   }
   else
@@ -1027,6 +1567,7 @@ void MerginApi::pingMerginReplyFinished()
     CoreUtils::log( "ping", QStringLiteral( "FAILED - %1. %2" ).arg( r->errorString(), serverMsg ) );
   }
   r->deleteLater();
+  setServerSupportsChunkDedup( serverSupportsChunkDedup );
   emit pingMerginFinished( apiVersion, serverSupportsSubscriptions, serverMsg );
 }
 
@@ -1177,14 +1718,50 @@ LocalProject MerginApi::getLocalProject( const QString &projectFullName )
   return mLocalProjects.projectFromMerginName( projectFullName );
 }
 
-ProjectDiff MerginApi::localProjectChanges( const QString &projectDir )
+void MerginApi::setGeoPackagesCheckpoint( const std::function<bool( const QString & )> &checkpoint )
+{
+  sGeoPackagesCheckpoint = checkpoint;
+}
+
+bool MerginApi::checkpointGeoPackages( const QString &projectDir )
+{
+  return !sGeoPackagesCheckpoint || sGeoPackagesCheckpoint( projectDir );
+}
+
+bool MerginApi::checkpointBeforeSync( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  if ( checkpointGeoPackages( transaction.projectDir ) )
+    return true;
+
+  // changes left in "-wal" files would be lost by the pull or missing in the push
+  CoreUtils::log( "sync " + projectFullName, QStringLiteral( "GeoPackages are busy and could not be checkpointed, sync postponed" ) );
+  emit notify( tr( "Project data are being saved, please synchronise the project again later" ) );
+
+  // a push waiting for this pull must not start another one right away
+  transaction.updateBeforeUpload = false;
+  finishProjectSync( projectFullName, false );
+  return false;
+}
+
+ProjectDiff MerginApi::localProjectChanges( const QString &projectDir, ChangesetSession *changesets )
 {
   MerginProjectMetadata projectMetadata = MerginProjectMetadata::fromCachedJson( projectDir + "/" + sMetadataFile );
   QList<MerginFile> localFiles = getLocalProjectFiles( projectDir + "/" );
 
+  // the files are not checkpointed here (status checks must not write), a GeoPackage with changes
+  // in its "-wal" file gets compared by the diff, which reads the changes from the "-wal" file too
+  for ( MerginFile &file : localFiles )
+  {
+    if ( isFileDiffable( file.path ) && QFileInfo( projectDir + "/" + file.path + "-wal" ).size() > 0 )
+      file.checksum.clear();
+  }
+
   MerginConfig config = MerginConfig::fromFile( projectDir + "/" + sMerginConfigFile );
 
-  return compareProjectFiles( projectMetadata.files, projectMetadata.files, localFiles, projectDir, config.isValid, config );
+  return compareProjectFiles( projectMetadata.files, projectMetadata.files, localFiles, projectDir, config.isValid, config, MerginConfig(), changesets );
 }
 
 QString MerginApi::getTempProjectDir( const QString &projectFullName )
@@ -1192,9 +1769,9 @@ QString MerginApi::getTempProjectDir( const QString &projectFullName )
   return mDataDir + "/" + TEMP_FOLDER + projectFullName;
 }
 
-QString MerginApi::generateConflictFileName( const QString &path, int version )
+QString MerginApi::generateConflictFileName( const QString &path, const QString &username, int version )
 {
-  return QString( "%1_conflict_%2_v%3" ).arg( path, mUserAuth->username(), QString::number( version ) );
+  return QString( "%1_conflict_%2_v%3" ).arg( path, username, QString::number( version ) );
 }
 
 QString MerginApi::getFullProjectName( QString projectNamespace, QString projectName ) // TODO: move to inpututils?
@@ -1299,27 +1876,98 @@ QString MerginApi::merginUserName() const
   return userAuth()->username();
 }
 
-QList<MerginFile> MerginApi::getLocalProjectFiles( const QString &projectPath )
+//! Result of the scan of a single local file in getLocalProjectFiles()
+struct ScannedFile
 {
-  QList<MerginFile> merginFiles;
-  QSet<QString> localFiles = listFiles( projectPath );
-  for ( QString p : localFiles )
+  MerginFile file;
+  ChecksumCache::FileStamp stamp;
+};
+
+//! Applies the function to all items - either on the global thread pool or sequentially, the order of results is kept
+template <typename Result, typename Item>
+static QList<Result> mapItems( const QList<Item> &items, const std::function<Result( const Item & )> &func, bool parallel )
+{
+  if ( parallel && items.count() > 1 )
+    return QtConcurrent::blockingMapped< QList<Result> >( items, func );
+
+  QList<Result> results;
+  results.reserve( items.count() );
+  for ( const Item &item : items )
+    results << func( item );
+  return results;
+}
+
+QList<MerginFile> MerginApi::getLocalProjectFiles( const QString &projectPath, bool parallel )
+{
+  QStringList localFiles = listFiles( projectPath ).values();
+  std::sort( localFiles.begin(), localFiles.end() );
+
+  // stat all files
+  std::function<ScannedFile( const QString & )> scanFile = [projectPath]( const QString & p )
   {
+    ScannedFile scanned;
+    QString filePath = projectPath + p;
+    scanned.stamp = ChecksumCache::fileStamp( filePath );
+    scanned.file.path = p;
+    QFileInfo info( filePath );
+    scanned.file.size = info.size();
+    scanned.file.mtime = info.lastModified();
+    return scanned;
+  };
+  QList<ScannedFile> scannedFiles = mapItems( localFiles, scanFile, parallel );
+
+  // reuse checksums of files that have not changed since the last time we have seen them
+  ChecksumCache cache( projectPath );
+  bool verify = ChecksumCache::verificationEnabled();
+
+  QList<int> filesToHash;
+  QList<QByteArray> cachedChecksums;
+  for ( int i = 0; i < scannedFiles.count(); ++i )
+  {
+    ScannedFile &scanned = scannedFiles[i];
+    QByteArray checksum;
+    bool found = cache.lookup( scanned.file.path, scanned.stamp, checksum );
+    if ( found )
+      scanned.file.checksum = QString::fromLatin1( checksum.data(), checksum.size() );
+
+    if ( !found || verify )
+    {
+      filesToHash << i;
+      cachedChecksums << checksum;
+    }
+  }
+
+  // hash the rest
+  std::function<QByteArray( const int & )> hashFile = [projectPath, &scannedFiles]( const int &i )
+  {
+    return getChecksum( projectPath + scannedFiles.at( i ).file.path );
+  };
+  QList<QByteArray> checksums = mapItems( filesToHash, hashFile, parallel );
+
+  for ( int j = 0; j < filesToHash.count(); ++j )
+  {
+    ScannedFile &scanned = scannedFiles[filesToHash.at( j )];
+    const QByteArray &checksum = checksums.at( j );
+
+    if ( cachedChecksums.at( j ).isEmpty() )
+      cache.insert( scanned.file.path, scanned.stamp, checksum );
+    else
+      cache.verify( scanned.file.path, scanned.stamp, cachedChecksums.at( j ), checksum );
 
-    MerginFile file;
-    QByteArray localChecksumBytes = getChecksum( projectPath + p );
-    QString localChecksum = QString::fromLatin1( localChecksumBytes.data(), localChecksumBytes.size() );
-    file.checksum = localChecksum;
-    file.path = p;
-    QFileInfo info( projectPath + p );
-    file.size = info.size();
-    file.mtime = info.lastModified();
-    merginFiles.append( file );
+    scanned.file.checksum = QString::fromLatin1( checksum.data(), checksum.size() );
   }
+
+  cache.retainOnly( localFiles );
+  cache.save();
+
+  QList<MerginFile> merginFiles;
+  merginFiles.reserve( scannedFiles.count() );
+  for ( const ScannedFile &scanned : qAsConst( scannedFiles ) )
+    merginFiles.append( scanned.file );
   return merginFiles;
 }
 
-void MerginApi::listProjectsReplyFinished( QString requestId )
+void MerginApi::listProjectsReplyFinished( QString requestId, std::shared_ptr<MerginProjectsListReader> reader )
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
@@ -1333,13 +1981,12 @@ void MerginApi::listProjectsReplyFinished( QString requestId )
     QUrlQuery query( r->request().url().query() );
     requestedPage = query.queryItemValue( "page" ).toInt();
 
-    QByteArray data = r->readAll();
-    QJsonDocument doc = QJsonDocument::fromJson( data );
-
-    if ( doc.isObject() )
+    // most of the reply has been read as it arrived
+    reader->addData( r->readAll() );
+    if ( reader->finish() )
     {
-      projectCount = doc.object().value( "count" ).toInt();
-      projectList = parseProjectsFromJson( doc );
+      projectCount = reader->count();
+      projectList = parseProjectsList( *reader );
     }
 
     CoreUtils::log( "list projects", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
@@ -1359,7 +2006,7 @@ void MerginApi::listProjectsReplyFinished( QString requestId )
   emit listProjectsFinished( projectList, mTransactionalStatus, projectCount, requestedPage, requestId );
 }
 
-void MerginApi::listProjectsByNameReplyFinished( QString requestId )
+void MerginApi::listProjectsByNameReplyFinished( QString requestId, std::shared_ptr<MerginProjectsListReader> reader )
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
   Q_ASSERT( r );
@@ -1368,9 +2015,9 @@ void MerginApi::listProjectsByNameReplyFinished( QString requestId )
 
   if ( r->error() == QNetworkReply::NoError )
   {
-    QByteArray data = r->readAll();
-    QJsonDocument json = QJsonDocument::fromJson( data );
-    projectList = parseProjectsFromJson( json );
+    reader->addData( r->readAll() );
+    if ( reader->finish() )
+      projectList = parseProjectsList( *reader );
     CoreUtils::log( "list projects by name", QStringLiteral( "Success - got %1 projects" ).arg( projectList.count() ) );
   }
   else
@@ -1389,39 +2036,92 @@ void MerginApi::listProjectsByNameReplyFinished( QString requestId )
 }
 
 
-void MerginApi::finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
+//! Creates parent directory of the file - unlike createPathIfNotExists() safe to use from worker threads
+static void createParentDir( const QString &filePath )
 {
-  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Copying new content of " ) + filePath );
+  QFileInfo fileInfo( filePath );
+  if ( !fileInfo.absoluteDir().exists() && !QDir().mkpath( fileInfo.absolutePath() ) )
+  {
+    CoreUtils::log( "create path", QString( "Creating a folder failed for path: %1" ).arg( filePath ) );
+  }
+}
 
-  QString dest = projectDir + "/" + filePath;
-  createPathIfNotExists( dest );
+//! Appends content of the source file to the opened destination using a small buffer
+static bool appendFileContent( QFile &dest, const QString &srcPath )
+{
+  QFile src( srcPath );
+  if ( !src.open( QIODevice::ReadOnly ) )
+    return false;
 
-  QFile f( dest );
-  if ( !f.open( QIODevice::WriteOnly ) )
+  QByteArray buffer( 65536, Qt::Uninitialized );
+  while ( !src.atEnd() )
   {
-    CoreUtils::log( "pull " + projectFullName, "Failed to open file for writing " + dest );
-    return;
+    qint64 bytesRead = src.read( buffer.data(), buffer.size() );
+    if ( bytesRead < 0 || dest.write( buffer.constData(), bytesRead ) != bytesRead )
+      return false;
   }
+  return true;
+}
 
-  // assemble file from tmp files
-  for ( const auto &item : items )
+QString MerginApi::assembleDownloadedFile( const QString &projectFullName, const QString &tempDir, const QList<DownloadQueueItem> &items )
+{
+  // chunks of a file are written in place into one shared temp file, which is then the complete file
+  QStringList tempFileNames;
+  for ( const DownloadQueueItem &item : items )
+  {
+    if ( tempFileNames.isEmpty() || tempFileNames.last() != item.tempFileName )
+      tempFileNames << item.tempFileName;
+  }
+
+  // the first temp file becomes the complete file, other temp files are appended to it using a small buffer
+  QString assembledFile = tempDir + "/" + ( tempFileNames.isEmpty() ? CoreUtils::uuidWithoutBraces( QUuid::createUuid() ) : tempFileNames.first() );
+  QFile f( assembledFile );
+  if ( !f.open( tempFileNames.isEmpty() ? QIODevice::WriteOnly : QIODevice::Append ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to open file for writing " + assembledFile );
+    return QString();
+  }
+
+  for ( int i = 1; i < tempFileNames.count(); ++i )
   {
-    QFile fTmp( tempDir + "/" + item.tempFileName );
-    if ( !fTmp.open( QIODevice::ReadOnly ) )
+    if ( !appendFileContent( f, tempDir + "/" + tempFileNames.at( i ) ) )
     {
-      CoreUtils::log( "pull " + projectFullName, "Failed to open temp file for reading " + item.tempFileName );
-      return;
+      CoreUtils::log( "pull " + projectFullName, "Failed to open temp file for reading " + tempFileNames.at( i ) );
+      return QString();
     }
-    f.write( fTmp.readAll() );
   }
 
   f.close();
+  return assembledFile;
+}
+
+void MerginApi::installDownloadedFile( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &assembledFile )
+{
+  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Copying new content of " ) + filePath );
+
+  QString dest = projectDir + "/" + filePath;
+  createParentDir( dest );
+
+  // the replaced GeoPackage has been checkpointed, its "-wal" and "-shm" files must not be applied to the new one
+  if ( MerginApi::isFileDiffable( filePath ) )
+  {
+    QFile::remove( dest + QStringLiteral( "-wal" ) );
+    QFile::remove( dest + QStringLiteral( "-shm" ) );
+  }
+
+  // whenever possible the assembled file is moved (no copying on the same volume)
+  QFile::remove( dest );
+  if ( assembledFile.isEmpty() || ( !QFile::rename( assembledFile, dest ) && !QFile::copy( assembledFile, dest ) ) )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Failed to write new content to " + dest );
+    return;
+  }
 
   // if diffable, copy to .mergin dir so we have a basefile
   if ( MerginApi::isFileDiffable( filePath ) )
   {
     QString basefile = projectDir + "/.mergin/" + filePath;
-    createPathIfNotExists( basefile );
+    createParentDir( basefile );
 
     if ( !QFile::remove( basefile ) )
     {
@@ -1435,24 +2135,14 @@ void MerginApi::finalizeProjectUpdateCopy( const QString &projectFullName, const
 }
 
 
-void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
+QString MerginApi::assembleServerFile( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items )
 {
   CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Applying diff to " ) + filePath );
 
-  // update diffable files that have been modified on the server
-  // - if they were not modified locally, the server changes will be simply applied
-  // - if they were modified locally, local changes will be rebased on top of server changes
-
   QString src = tempDir + "/" + CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
-  QString dest = projectDir + "/" + filePath;
   QString basefile = projectDir + "/.mergin/" + filePath;
 
-  // TODO where the conflict file should be located?
-  QString conflictfile = projectDir + "/.mergin/" + filePath + ".conflict";
-
-  createPathIfNotExists( src );
-  createPathIfNotExists( dest );
-  createPathIfNotExists( basefile );
+  createParentDir( src );
 
   QStringList diffFiles;
   for ( const auto &item : items )
@@ -1481,6 +2171,26 @@ void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName,
     CoreUtils::log( "pull " + projectFullName, "server file assembly successful: " + filePath );
   }
 
+  return src;
+}
+
+void MerginApi::rebaseLocalFile( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &serverFile,
+                                 const QString &username, int localVersion )
+{
+  // update diffable files that have been modified on the server
+  // - if they were not modified locally, the server changes will be simply applied
+  // - if they were modified locally, local changes will be rebased on top of server changes
+
+  QString src = serverFile;
+  QString dest = projectDir + "/" + filePath;
+  QString basefile = projectDir + "/.mergin/" + filePath;
+
+  // TODO where the conflict file should be located?
+  QString conflictfile = projectDir + "/.mergin/" + filePath + ".conflict";
+
+  createParentDir( dest );
+  createParentDir( basefile );
+
   //
   // now we are ready for the update of our local file
   //
@@ -1500,8 +2210,7 @@ void MerginApi::finalizeProjectUpdateApplyDiff( const QString &projectFullName,
 
     // not good... something went wrong in rebase - we need to save the local changes
     // let's put them into a conflict file and use the server version
-    LocalProject info = mLocalProjects.projectFromMerginName( projectFullName );
-    QString newDest = CoreUtils::findUniquePath( generateConflictFileName( dest, info.localVersion ), false );
+    QString newDest = CoreUtils::findUniquePath( generateConflictFileName( dest, username, localVersion ), false );
     if ( !QFile::rename( dest, newDest ) )
     {
       CoreUtils::log( "pull " + projectFullName, "failed rename of conflicting file after failed geodiff rebase: " + filePath );
@@ -1534,19 +2243,84 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
 {
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+  Q_ASSERT( !transaction.finalizeWatcher );
 
   QString projectDir = transaction.projectDir;
   QString tempProjectDir = getTempProjectDir( projectFullName );
+  QList<UpdateTask> tasks = transaction.updateTasks;
 
-  CoreUtils::log( "pull " + projectFullName, "Running update tasks" );
+  // conflict files are named after the user and the local version - resolve them here,
+  // local projects and user auth must only be used from this thread
+  QString username = mUserAuth->username();
+  int localVersion = mLocalProjects.projectFromMerginName( projectFullName ).localVersion;
 
-  for ( const UpdateTask &finalizationItem : transaction.updateTasks )
+  // the project could have been edited while the data were downloaded
+  if ( !checkpointBeforeSync( projectFullName ) )
+    return;
+
+  // downloaded items are consumed by the update tasks - they cannot be reused by another pull
+  SyncJournal::remove( projectDir, SyncJournal::Pull );
+
+  std::shared_ptr< std::atomic<bool> > canceled = std::make_shared< std::atomic<bool> >( false );
+  transaction.finalizeCanceled = canceled;
+
+  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Running %1 update tasks" ).arg( tasks.count() ) );
+
+  QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>( this );
+  transaction.finalizeWatcher = watcher;
+  connect( watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, projectFullName]()
+  {
+    watcher->deleteLater();
+    finalizeProjectUpdateFinished( projectFullName, watcher->result() );
+  } );
+
+  watcher->setFuture( QtConcurrent::run( [ = ]()
+  {
+    return runProjectUpdateTasks( projectFullName, projectDir, tempProjectDir, tasks, username, localVersion, canceled );
+  } ) );
+}
+
+bool MerginApi::runProjectUpdateTasks( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QList<UpdateTask> &tasks,
+                                       const QString &username, int localVersion, std::shared_ptr< std::atomic<bool> > canceled )
+{
+  // the files of the new version are assembled in the temp dir first - the project directory is not touched
+  // yet, so the pull can still be canceled before each of them
+  QHash<int, QString> assembledFiles;
+  for ( int i = 0; i < tasks.count(); ++i )
+  {
+    if ( *canceled )
+    {
+      CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Update tasks canceled, the project has not been changed" ) );
+      return false;
+    }
+
+    const UpdateTask &task = tasks.at( i );
+    if ( task.method == UpdateTask::Copy || task.method == UpdateTask::CopyConflict )
+      assembledFiles.insert( i, assembleDownloadedFile( projectFullName, tempDir, task.data ) );
+    else if ( task.method == UpdateTask::ApplyDiff )
+      assembledFiles.insert( i, assembleServerFile( projectFullName, projectDir, tempDir, task.filePath, task.data ) );
+
+    emit syncProjectFinalizationProgress( projectFullName, static_cast<qreal>( i + 1 ) / ( 2 * tasks.count() ) );
+  }
+
+  if ( *canceled )
   {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Update tasks canceled, the project has not been changed" ) );
+    return false;
+  }
+
+  // once some files have been overwritten or rebased, all the remaining tasks must run too, otherwise
+  // the project would be left half-updated while its old metadata are kept
+  QStringList updatedFiles;
+
+  for ( int i = 0; i < tasks.count(); ++i )
+  {
+    const UpdateTask &finalizationItem = tasks.at( i );
     switch ( finalizationItem.method )
     {
       case UpdateTask::Copy:
       {
-        finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        installDownloadedFile( projectFullName, projectDir, finalizationItem.filePath, assembledFiles.value( i ) );
         break;
       }
 
@@ -1554,8 +2328,7 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
       {
         // move local file to conflict file
         QString origPath = projectDir + "/" + finalizationItem.filePath;
-        LocalProject info = mLocalProjects.projectFromMerginName( projectFullName );
-        QString newPath = CoreUtils::findUniquePath( generateConflictFileName( origPath, info.localVersion ), false );
+        QString newPath = CoreUtils::findUniquePath( generateConflictFileName( origPath, username, localVersion ), false );
         if ( !QFile::rename( origPath, newPath ) )
         {
           CoreUtils::log( "pull " + projectFullName, "failed rename of conflicting file: " + finalizationItem.filePath );
@@ -1564,13 +2337,13 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
         {
           CoreUtils::log( "pull " + projectFullName, "Local file renamed due to conflict with server: " + finalizationItem.filePath );
         }
-        finalizeProjectUpdateCopy( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        installDownloadedFile( projectFullName, projectDir, finalizationItem.filePath, assembledFiles.value( i ) );
         break;
       }
 
       case UpdateTask::ApplyDiff:
       {
-        finalizeProjectUpdateApplyDiff( projectFullName, projectDir, tempProjectDir, finalizationItem.filePath, finalizationItem.data );
+        rebaseLocalFile( projectFullName, projectDir, finalizationItem.filePath, assembledFiles.value( i ), username, localVersion );
         break;
       }
 
@@ -1583,23 +2356,62 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
       }
     }
 
-    // remove tmp files associated with this item
-    for ( const auto &downloadItem : finalizationItem.data )
+    updatedFiles << finalizationItem.filePath;
+
+    // remove tmp files associated with this item (the first one of a copied file has been moved already)
+    for ( const auto &downloadItem : finalizationItem.data )
+    {
+      QString tempFilePath = tempDir + "/" + downloadItem.tempFileName;
+      if ( QFile::exists( tempFilePath ) && !QFile::remove( tempFilePath ) )
+        CoreUtils::log( "pull " + projectFullName, "Failed to remove temporary file " + downloadItem.tempFileName );
+    }
+
+    emit syncProjectFinalizationProgress( projectFullName, static_cast<qreal>( tasks.count() + i + 1 ) / ( 2 * tasks.count() ) );
+  }
+
+  // files have been rewritten - make sure we never reuse their old checksums
+  if ( !updatedFiles.isEmpty() )
+    ChecksumCache::invalidate( projectDir, updatedFiles );
+
+  // check there are no files left
+  int tmpFilesLeft = QDir( tempDir ).entryList( QDir::NoDotAndDotDot ).count();
+  if ( tmpFilesLeft )
+  {
+    CoreUtils::log( "pull " + projectFullName, "Some temporary files were left - this should not happen..." );
+  }
+
+  QDir( tempDir ).removeRecursively();
+  return true;
+}
+
+void MerginApi::finalizeProjectUpdateFinished( const QString &projectFullName, bool successful )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  transaction.finalizeWatcher = nullptr;
+  transaction.finalizeCanceled.reset();
+
+  QString projectDir = transaction.projectDir;
+
+  // the written files get compared on the next status check, even before the file system watcher reports them
+  for ( const UpdateTask &task : qAsConst( transaction.updateTasks ) )
+    mLocalProjects.changeTracker().notifyFileChanged( projectDir + "/" + task.filePath );
+
+  if ( !successful )
+  {
+    // get rid of the temporary download dir with the files of tasks that have not been run
+    CoreUtils::removeDir( getTempProjectDir( projectFullName ) );
+
+    if ( transaction.firstTimeDownload )
     {
-      if ( !QFile::remove( tempProjectDir + "/" + downloadItem.tempFileName ) )
-        CoreUtils::log( "pull " + projectFullName, "Failed to remove temporary file " + downloadItem.tempFileName );
+      CoreUtils::removeDir( projectDir );
     }
-  }
 
-  // check there are no files left
-  int tmpFilesLeft = QDir( tempProjectDir ).entryList( QDir::NoDotAndDotDot ).count();
-  if ( tmpFilesLeft )
-  {
-    CoreUtils::log( "pull " + projectFullName, "Some temporary files were left - this should not happen..." );
+    finishProjectSync( projectFullName, false );
+    return;
   }
 
-  QDir( tempProjectDir ).removeRecursively();
-
   // add the local project if not there yet
   if ( !mLocalProjects.projectFromMerginName( projectFullName ).isValid() )
   {
@@ -1607,7 +2419,7 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
     extractProjectName( projectFullName, projectNamespace, projectName );
 
     // remove download in progress file
-    if ( !QFile::remove( CoreUtils::downloadInProgressFilePath( transaction.projectDir ) ) )
+    if ( !QFile::remove( CoreUtils::downloadInProgressFilePath( projectDir ) ) )
       CoreUtils::log( QStringLiteral( "sync %1" ).arg( projectFullName ), QStringLiteral( "Failed to remove download in progress file for project name %1" ).arg( projectName ) );
 
     mLocalProjects.addMerginProject( projectDir, projectNamespace, projectName );
@@ -1617,6 +2429,53 @@ void MerginApi::finalizeProjectUpdate( const QString &projectFullName )
 }
 
 
+//! Serializes file of a push to the push journal (including the members only used for upload)
+static QJsonObject merginFileToJson( const MerginFile &file )
+{
+  QJsonObject obj;
+  obj.insert( QStringLiteral( "path" ), file.path );
+  obj.insert( QStringLiteral( "checksum" ), file.checksum );
+  obj.insert( QStringLiteral( "size" ), file.size );
+  obj.insert( QStringLiteral( "mtime" ), file.mtime.toString( Qt::ISODateWithMs ) );
+  obj.insert( QStringLiteral( "chunks" ), QJsonArray::fromStringList( file.chunks ) );
+  if ( !file.chunkSizes.isEmpty() )
+  {
+    QJsonArray chunkSizes;
+    for ( qint64 size : file.chunkSizes )
+      chunkSizes.append( size );
+    obj.insert( QStringLiteral( "chunk_sizes" ), chunkSizes );
+  }
+  if ( !file.diffName.isEmpty() )
+  {
+    obj.insert( QStringLiteral( "diff_name" ), file.diffName );
+    obj.insert( QStringLiteral( "diff_checksum" ), file.diffChecksum );
+    obj.insert( QStringLiteral( "diff_base_checksum" ), file.diffBaseChecksum );
+    obj.insert( QStringLiteral( "diff_size" ), file.diffSize );
+  }
+  return obj;
+}
+
+//! Reads file of a push from the push journal, see merginFileToJson()
+static MerginFile merginFileFromJson( const QJsonObject &obj )
+{
+  MerginFile file;
+  file.path = obj.value( QStringLiteral( "path" ) ).toString();
+  file.checksum = obj.value( QStringLiteral( "checksum" ) ).toString();
+  file.size = obj.value( QStringLiteral( "size" ) ).toVariant().toLongLong();
+  file.mtime = QDateTime::fromString( obj.value( QStringLiteral( "mtime" ) ).toString(), Qt::ISODateWithMs );
+  const QJsonArray chunks = obj.value( QStringLiteral( "chunks" ) ).toArray();
+  for ( const QJsonValue &chunk : chunks )
+    file.chunks << chunk.toString();
+  const QJsonArray chunkSizes = obj.value( QStringLiteral( "chunk_sizes" ) ).toArray();
+  for ( const QJsonValue &size : chunkSizes )
+    file.chunkSizes << size.toVariant().toLongLong();
+  file.diffName = obj.value( QStringLiteral( "diff_name" ) ).toString();
+  file.diffChecksum = obj.value( QStringLiteral( "diff_checksum" ) ).toString();
+  file.diffBaseChecksum = obj.value( QStringLiteral( "diff_base_checksum" ) ).toString();
+  file.diffSize = obj.value( QStringLiteral( "diff_size" ) ).toVariant().toLongLong();
+  return file;
+}
+
 void MerginApi::uploadStartReplyFinished()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
@@ -1649,8 +2508,23 @@ void MerginApi::uploadStartReplyFinished()
 
       CoreUtils::log( "push " + projectFullName, QStringLiteral( "Push request accepted. Transaction ID: " ) + transactionUUID );
 
-      MerginFile file = files.first();
-      uploadFile( projectFullName, transactionUUID, file );
+      // chunks acknowledged by the server get journaled, an interrupted push continues within this transaction
+      QJsonArray filesJson;
+      for ( const MerginFile &file : files )
+        filesJson.append( merginFileToJson( file ) );
+      QJsonArray deletedJson;
+      for ( const QString &filePath : qAsConst( transaction.diff.localDeleted ) )
+        deletedJson.append( filePath );
+
+      QJsonObject header;
+      header.insert( QStringLiteral( "transaction" ), transactionUUID );
+      header.insert( QStringLiteral( "files" ), filesJson );
+      header.insert( QStringLiteral( "deleted" ), deletedJson );
+      SyncJournal::start( transaction.projectDir, SyncJournal::Push, transaction.baseVersion, header );
+
+      transaction.uploadChunkQueue = itemsForUploadChunks( transaction.projectDir, files );
+      skipKnownChunks( projectFullName );
+      uploadNextChunks( projectFullName );
       emit pushFilesStarted();
     }
     else  // pushing only files to be removed
@@ -1717,43 +2591,59 @@ void MerginApi::uploadFileReplyFinished()
 
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
-  Q_ASSERT( r == transaction.replyUploadFile );
+  Q_ASSERT( transaction.replyUploadFiles.contains( r ) );
 
   QStringList params = ( r->url().toString().split( "/" ) );
   QString transactionUUID = params.at( params.length() - 2 );
   QString chunkID = params.at( params.length() - 1 );
   Q_ASSERT( transactionUUID == transaction.transactionUUID );
 
+  transaction.replyUploadFiles.removeAll( r );
+  r->deleteLater();
+
+  UploadQueueItem chunk = transaction.uploadChunksInFlight.take( chunkID );
+
+  // network errors and server errors may be temporary, the server refuses a chunk with 4xx for good
+  QVariant statusCode = r->attribute( QNetworkRequest::HttpStatusCodeAttribute );
+  bool canRetry = r->error() != QNetworkReply::OperationCanceledError && ( !statusCode.isValid() || statusCode.toInt() >= 500 );
+
   if ( r->error() == QNetworkReply::NoError )
   {
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Uploaded successfully: " ) + chunkID );
 
-    transaction.replyUploadFile->deleteLater();
-    transaction.replyUploadFile = nullptr;
+    QJsonObject entry;
+    entry.insert( QStringLiteral( "chunk" ), chunkID );
+    SyncJournal::append( transaction.projectDir, SyncJournal::Push, entry );
 
-    MerginFile currentFile = transaction.uploadQueue.first();
-    int chunkNo = currentFile.chunks.indexOf( chunkID );
-    if ( chunkNo < currentFile.chunks.size() - 1 )
-    {
-      uploadFile( projectFullName, transactionUUID, currentFile, chunkNo + 1 );
-    }
-    else
-    {
-      transaction.transferedSize += currentFile.size;
+    transaction.transferedSize += chunk.size;
+    emit syncProjectStatusChanged( projectFullName, transaction.progress() );
 
-      emit syncProjectStatusChanged( projectFullName, transaction.transferedSize / transaction.totalSize );
-      transaction.uploadQueue.removeFirst();
+    // Send more chunks (or finish), other syncs may have been waiting for the request to finish
+    uploadNextChunks( projectFullName );
+    resumeTransfers();
+  }
+  else if ( canRetry && chunk.retries < UPLOAD_CHUNK_RETRIES )
+  {
+    // only this chunk failed - try to send it again later, other chunks are not affected
+    chunk.retries++;
+    int delay = uploadRetryDelay( chunk.retries );
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Chunk upload failed - %1. Retrying (%2/%3) in %4 ms: %5" )
+                    .arg( r->errorString() ).arg( chunk.retries ).arg( UPLOAD_CHUNK_RETRIES ).arg( delay ).arg( chunkID ) );
 
-      if ( !transaction.uploadQueue.isEmpty() )
-      {
-        MerginFile nextFile = transaction.uploadQueue.first();
-        uploadFile( projectFullName, transactionUUID, nextFile );
-      }
-      else
-      {
-        uploadFinish( projectFullName, transactionUUID );
-      }
-    }
+    transaction.uploadChunksRetrying.insert( chunkID, chunk );
+    QTimer::singleShot( delay, this, [this, projectFullName, transactionUUID, chunkID]()
+    {
+      // the push may have failed or been canceled in the meantime
+      if ( !mTransactionalStatus.contains( projectFullName ) )
+        return;
+      TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+      if ( transaction.transactionUUID != transactionUUID || !transaction.uploadChunksRetrying.contains( chunkID ) )
+        return;
+
+      // the chunk goes first, but it is sent within the upload window and the limits shared by all syncs
+      transaction.uploadChunkQueue.prepend( transaction.uploadChunksRetrying.take( chunkID ) );
+      uploadNextChunks( projectFullName );
+    } );
   }
   else
   {
@@ -1761,8 +2651,18 @@ void MerginApi::uploadFileReplyFinished()
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1. %2" ).arg( r->errorString(), serverMsg ) );
     emit networkErrorOccurred( serverMsg, QStringLiteral( "Mergin API error: uploadFile" ) );
 
-    transaction.replyUploadFile->deleteLater();
-    transaction.replyUploadFile = nullptr;
+    // the whole push fails - there is no point in waiting for other chunks
+    abortUploadFiles( transaction );
+
+    if ( statusCode.isValid() )
+    {
+      // the server has refused the chunk (e.g. the transaction is not valid anymore), do not try to continue it
+      discardPushJournal( transaction.projectDir );
+    }
+    else if ( QFile::exists( SyncJournal::journalFilePath( transaction.projectDir, SyncJournal::Push ) ) )
+    {
+      CoreUtils::log( "push " + projectFullName, QStringLiteral( "Keeping uploaded chunks to resume the push" ) );
+    }
 
     finishProjectSync( projectFullName, false );
   }
@@ -1781,13 +2681,16 @@ void MerginApi::updateInfoReplyFinished()
 
   if ( r->error() == QNetworkReply::NoError )
   {
-    QByteArray data = r->readAll();
+    // most of the reply has been parsed as it arrived
+    std::shared_ptr<MerginProjectMetadataReader> reader = transaction.projectInfoReader;
+    transaction.projectInfoReader.reset();
+    reader->addData( r->readAll() );
     CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Downloaded project info." ) );
 
     transaction.replyProjectInfo->deleteLater();
     transaction.replyProjectInfo = nullptr;
 
-    prepareProjectUpdate( projectFullName, data );
+    prepareProjectUpdate( projectFullName, reader->data(), reader->metadata() );
   }
   else
   {
@@ -1801,7 +2704,7 @@ void MerginApi::updateInfoReplyFinished()
   }
 }
 
-void MerginApi::prepareProjectUpdate( const QString &projectFullName, const QByteArray &data )
+void MerginApi::prepareProjectUpdate( const QString &projectFullName, const QByteArray &data, const MerginProjectMetadata &serverProject )
 {
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
@@ -1835,10 +2738,8 @@ void MerginApi::prepareProjectUpdate( const QString &projectFullName, const QByt
 
   Q_ASSERT( !transaction.projectDir.isEmpty() );  // that would mean we do not have entry -> fail getting local files
 
-  MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
-  MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
-
   transaction.projectMetadata = data;
+  transaction.serverMetadata = serverProject;
   transaction.version = serverProject.version;
 
   if ( transaction.configAllowed )
@@ -1856,8 +2757,12 @@ void MerginApi::startProjectUpdate( const QString &projectFullName )
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
+  // local GeoPackages may be rebased or replaced by the pull, all their changes need to be in the files
+  if ( !checkpointBeforeSync( projectFullName ) )
+    return;
+
   QList<MerginFile> localFiles = getLocalProjectFiles( transaction.projectDir + "/" );
-  MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( transaction.projectMetadata );
+  const MerginProjectMetadata serverProject = transaction.serverMetadata;
   MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
   MerginConfig oldTransactionConfig = MerginConfig::fromFile( transaction.projectDir + "/" + sMerginConfigFile );
 
@@ -1931,26 +2836,98 @@ void MerginApi::startProjectUpdate( const QString &projectFullName )
     transaction.updateTasks << UpdateTask( UpdateTask::Delete, filePath, QList<DownloadQueueItem>() );
   }
 
-  // prepare the download queue
-  for ( const UpdateTask &item : transaction.updateTasks )
+  prepareDownloadQueue( projectFullName );
+
+  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 update tasks, %2 items to download (total size %3 bytes)" )
+                  .arg( transaction.updateTasks.count() )
+                  .arg( transaction.downloadQueue.count() )
+                  .arg( transaction.totalSize ) );
+
+  qint64 remainingSize = transaction.totalSize - transaction.transferedSize;
+  requestTransfer( projectFullName, remainingSize, [this, projectFullName]()
+  {
+    emit pullFilesStarted();
+    downloadNextItem( projectFullName );
+  } );
+}
+
+void MerginApi::prepareDownloadQueue( const QString &projectFullName )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  QString tempDir = getTempProjectDir( projectFullName );
+
+  // temp files of items downloaded by an interrupted pull (item key -> temp file name)
+  QHash<QString, QString> downloadedItems;
+  if ( !transaction.firstTimeDownload )
   {
-    transaction.downloadQueue << item.data;
+    SyncJournal journal = SyncJournal::read( transaction.projectDir, SyncJournal::Pull );
+    if ( journal.isValid() && journal.version() == transaction.version )
+    {
+      const QList<QJsonObject> entries = journal.entries();
+      for ( const QJsonObject &entry : entries )
+        downloadedItems.insert( entry.value( QStringLiteral( "item" ) ).toString(), entry.value( QStringLiteral( "temp" ) ).toString() );
+    }
+    else
+    {
+      // items of a pull to another version are of no use
+      QDir( tempDir ).removeRecursively();
+      SyncJournal::start( transaction.projectDir, SyncJournal::Pull, transaction.version );
+    }
   }
 
   qint64 totalSize = 0;
-  for ( const DownloadQueueItem &item : transaction.downloadQueue )
+  qint64 resumedSize = 0;
+  int resumedCount = 0;
+  for ( UpdateTask &task : transaction.updateTasks )
   {
-    totalSize += item.size;
+    // chunks of a file share one preallocated temp file - keep writing to the one of the interrupted pull
+    for ( const DownloadQueueItem &item : qAsConst( task.data ) )
+    {
+      auto it = downloadedItems.constFind( downloadItemKey( item ) );
+      if ( item.fileSize >= 0 && it != downloadedItems.constEnd() && !it->isEmpty() && QFileInfo( tempDir + "/" + *it ).size() == item.fileSize )
+      {
+        const QString sharedTempFileName = *it;
+        for ( DownloadQueueItem &chunkItem : task.data )
+          chunkItem.tempFileName = sharedTempFileName;
+        break;
+      }
+    }
+
+    for ( DownloadQueueItem &item : task.data )
+    {
+      totalSize += item.size;
+
+      auto it = downloadedItems.constFind( downloadItemKey( item ) );
+      bool downloaded = false;
+      if ( it != downloadedItems.constEnd() && !it->isEmpty() )
+      {
+        if ( item.fileSize >= 0 )
+          downloaded = *it == item.tempFileName;
+        else
+          downloaded = QFileInfo( tempDir + "/" + *it ).size() == item.size;
+      }
+
+      if ( downloaded )
+      {
+        item.tempFileName = *it;
+        resumedSize += item.size;
+        ++resumedCount;
+        continue;
+      }
+
+      transaction.downloadQueue << item;
+    }
   }
   transaction.totalSize = totalSize;
+  transaction.transferedSize = resumedSize;
 
-  CoreUtils::log( "pull " + projectFullName, QStringLiteral( "%1 update tasks, %2 items to download (total size %3 bytes)" )
-                  .arg( transaction.updateTasks.count() )
-                  .arg( transaction.downloadQueue.count() )
-                  .arg( transaction.totalSize ) );
-
-  emit pullFilesStarted();
-  downloadNextItem( projectFullName );
+  if ( resumedCount )
+  {
+    CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Resuming interrupted pull: %1 items (%2 bytes) downloaded already" )
+                    .arg( resumedCount ).arg( resumedSize ) );
+  }
 }
 
 void MerginApi::prepareDownloadConfig( const QString &projectFullName, bool downloaded )
@@ -1958,7 +2935,7 @@ void MerginApi::prepareDownloadConfig( const QString &projectFullName, bool down
   Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
   TransactionStatus &transaction = mTransactionalStatus[projectFullName];
 
-  MerginProjectMetadata newServerVersion = MerginProjectMetadata::fromJson( transaction.projectMetadata );
+  const MerginProjectMetadata newServerVersion = transaction.serverMetadata;
 
   const auto res = std::find_if( newServerVersion.files.begin(), newServerVersion.files.end(), []( const MerginFile & file )
   {
@@ -2066,21 +3043,27 @@ void MerginApi::requestServerConfig( const QString &projectFullName )
   request.setUrl( url );
   request.setAttribute( static_cast<QNetworkRequest::Attribute>( AttrProjectFullName ), projectFullName );
 
-  Q_ASSERT( !transaction.replyDownloadItem );
-  transaction.replyDownloadItem = mManager.get( request );
-  connect( transaction.replyDownloadItem, &QNetworkReply::finished, this, &MerginApi::cacheServerConfig );
+  Q_ASSERT( !transaction.replyDownloadConfig );
+  transaction.replyDownloadConfig = mManager.get( request );
+  connect( transaction.replyDownloadConfig, &QNetworkReply::finished, this, &MerginApi::cacheServerConfig );
 
   CoreUtils::log( "pull " + projectFullName, QStringLiteral( "Requesting mergin config: " ) + url.toString() );
 }
 
 QList<DownloadQueueItem> MerginApi::itemsForFileChunks( const MerginFile &file, int version )
 {
+  // all chunks are written to the same temporary file, each one to its position
+  QString tempFileName = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
+
   QList<DownloadQueueItem> lst;
-  int from = 0;
+  qint64 from = 0;
   while ( from < file.size )
   {
-    int size = qMin( MerginApi::UPLOAD_CHUNK_SIZE, static_cast<int>( file.size ) - from );
-    lst << DownloadQueueItem( file.path, size, version, from, from + size - 1 );
+    qint64 size = qMin( static_cast<qint64>( MerginApi::UPLOAD_CHUNK_SIZE ), file.size - from );
+    DownloadQueueItem item( file.path, size, version, from, from + size - 1 );
+    item.tempFileName = tempFileName;
+    item.fileSize = file.size;
+    lst << item;
     from += size;
   }
   return lst;
@@ -2098,17 +3081,124 @@ QList<DownloadQueueItem> MerginApi::itemsForFileDiffs( const MerginFile &file )
 }
 
 
-static MerginFile findFile( const QString &filePath, const QList<MerginFile> &files )
+//! Returns files keyed by their paths, so that looking up many of them is not quadratic
+static QHash<QString, MerginFile> filesByPath( const QList<MerginFile> &files )
 {
+  QHash<QString, MerginFile> map;
+  map.reserve( files.count() );
   for ( const MerginFile &merginFile : files )
   {
-    if ( merginFile.path == filePath )
-      return merginFile;
+    if ( !map.contains( merginFile.path ) )
+      map.insert( merginFile.path, merginFile );
   }
+  return map;
+}
+
+static MerginFile findFile( const QString &filePath, const QHash<QString, MerginFile> &files )
+{
+  auto it = files.constFind( filePath );
+  if ( it != files.constEnd() )
+    return it.value();
+
   qDebug() << "requested findFile() for non-existant file! " << filePath;
   return MerginFile();
 }
 
+bool MerginApi::resumePush( const QString &projectFullName, const QList<MerginFile> &localFiles )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  SyncJournal journal = SyncJournal::read( transaction.projectDir, SyncJournal::Push );
+  if ( !journal.isValid() )
+    return false;
+
+  QJsonObject header = journal.header();
+  QString transactionUUID = header.value( QStringLiteral( "transaction" ) ).toString();
+
+  QList<MerginFile> files;
+  const QJsonArray filesJson = header.value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &fileJson : filesJson )
+    files << merginFileFromJson( fileJson.toObject() );
+
+  QSet<QString> deleted;
+  const QJsonArray deletedJson = header.value( QStringLiteral( "deleted" ) ).toArray();
+  for ( const QJsonValue &filePath : deletedJson )
+    deleted << filePath.toString();
+
+  // the journaled push must upload exactly the current local changes on top of the same server version
+  QSet<QString> changed = transaction.diff.localAdded + transaction.diff.localUpdated;
+  bool matches = journal.version() == transaction.baseVersion && !transactionUUID.isEmpty() &&
+                 deleted == transaction.diff.localDeleted && files.count() == changed.count();
+  const QHash<QString, MerginFile> localFilesByPath = filesByPath( localFiles );
+  for ( int i = 0; matches && i < files.count(); ++i )
+  {
+    const MerginFile &file = files.at( i );
+    matches = changed.contains( file.path ) && findFile( file.path, localFilesByPath ).checksum == file.checksum;
+    if ( matches && !file.diffName.isEmpty() )
+      matches = QFileInfo( transaction.projectDir + "/.mergin/" + file.diffName ).size() == file.diffSize;
+  }
+
+  if ( !matches )
+  {
+    CoreUtils::log( "push " + projectFullName, QStringLiteral( "Discarding journal of an interrupted push - local changes or server version differ" ) );
+    discardPushJournal( transaction.projectDir );
+    return false;
+  }
+
+  QSet<QString> uploadedChunks;
+  const QList<QJsonObject> entries = journal.entries();
+  for ( const QJsonObject &entry : entries )
+    uploadedChunks << entry.value( QStringLiteral( "chunk" ) ).toString();
+
+  qint64 totalSize = 0;
+  for ( const MerginFile &file : qAsConst( files ) )
+  {
+    totalSize += file.diffName.isEmpty() ? file.size : file.diffSize;
+    if ( !file.diffName.isEmpty() )
+      transaction.uploadDiffFiles << file;
+  }
+
+  qint64 uploadedSize = 0;
+  const QList<UploadQueueItem> chunks = itemsForUploadChunks( transaction.projectDir, files );
+  for ( const UploadQueueItem &chunk : chunks )
+  {
+    if ( uploadedChunks.contains( chunk.chunkId ) )
+      uploadedSize += chunk.size;
+    else
+      transaction.uploadChunkQueue << chunk;
+  }
+
+  transaction.transactionUUID = transactionUUID;
+  transaction.uploadQueue = files;
+  transaction.totalSize = totalSize;
+  transaction.transferedSize = uploadedSize;
+  skipKnownChunks( projectFullName );
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "Resuming interrupted push of transaction %1: %2 of %3 chunks uploaded already" )
+                  .arg( transactionUUID ).arg( chunks.count() - transaction.uploadChunkQueue.count() ).arg( chunks.count() ) );
+
+  requestTransfer( projectFullName, totalSize - transaction.transferedSize, [this, projectFullName]()
+  {
+    uploadNextChunks( projectFullName );
+    emit pushFilesStarted();
+  } );
+  return true;
+}
+
+void MerginApi::discardPushJournal( const QString &projectDir )
+{
+  SyncJournal journal = SyncJournal::read( projectDir, SyncJournal::Push );
+  const QJsonArray filesJson = journal.header().value( QStringLiteral( "files" ) ).toArray();
+  for ( const QJsonValue &fileJson : filesJson )
+  {
+    QString diffName = fileJson.toObject().value( QStringLiteral( "diff_name" ) ).toString();
+    if ( !diffName.isEmpty() )
+      QFile::remove( projectDir + "/.mergin/" + diffName );
+  }
+  SyncJournal::remove( projectDir, SyncJournal::Push );
+}
+
 
 void MerginApi::uploadInfoReplyFinished()
 {
@@ -2125,7 +3215,12 @@ void MerginApi::uploadInfoReplyFinished()
   {
     QString url = r->url().toString();
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "Downloaded project info." ) );
-    QByteArray data = r->readAll();
+
+    // most of the reply has been parsed as it arrived
+    std::shared_ptr<MerginProjectMetadataReader> reader = transaction.projectInfoReader;
+    transaction.projectInfoReader.reset();
+    reader->addData( r->readAll() );
+    QByteArray data = reader->data();
 
     transaction.replyUploadProjectInfo->deleteLater();
     transaction.replyUploadProjectInfo = nullptr;
@@ -2135,7 +3230,7 @@ void MerginApi::uploadInfoReplyFinished()
     Q_ASSERT( !transaction.projectDir.isEmpty() );
 
     // get the latest server version from our reply (we do not update it in LocalProjectsManager though... I guess we don't need to)
-    MerginProjectMetadata serverProject = MerginProjectMetadata::fromJson( data );
+    MerginProjectMetadata serverProject = reader->metadata();
 
     // now let's figure a key question: are we on the most recent version of the project
     // if we're about to do upload? because if not, we need to do local update first
@@ -2144,10 +3239,15 @@ void MerginApi::uploadInfoReplyFinished()
       CoreUtils::log( "push " + projectFullName, QStringLiteral( "Need pull first: local version %1 | server version %2" )
                       .arg( projectInfo.localVersion ).arg( serverProject.version ) );
       transaction.updateBeforeUpload = true;
-      prepareProjectUpdate( projectFullName, data );
+      prepareProjectUpdate( projectFullName, data, serverProject );
       return;
     }
 
+    // checksums, diffs and uploaded chunks are all taken from the files - changes must not be left in "-wal" files
+    if ( !checkpointBeforeSync( projectFullName ) )
+      return;
+    transaction.changeSnapshot = static_cast<qint64>( mLocalProjects.changeTracker().snapshot() );
+
     QList<MerginFile> localFiles = getLocalProjectFiles( transaction.projectDir + "/" );
     MerginProjectMetadata oldServerProject = MerginProjectMetadata::fromCachedJson( transaction.projectDir + "/" + sMetadataFile );
 
@@ -2157,43 +3257,48 @@ void MerginApi::uploadInfoReplyFinished()
       transaction.config = MerginConfig::fromFile( transaction.projectDir + "/" + MerginApi::sMerginConfigFile );
     }
 
+    // changesets of GeoPackages are created once - to find out whether they have changed and to be uploaded
+    ChangesetSession changesets( transaction.projectDir );
     transaction.diff = compareProjectFiles(
                          oldServerProject.files,
                          serverProject.files,
                          localFiles,
                          transaction.projectDir,
                          transaction.configAllowed,
-                         transaction.config
+                         transaction.config,
+                         MerginConfig(),
+                         &changesets
                        );
 
     CoreUtils::log( "push " + projectFullName, transaction.diff.dump() );
 
+    transaction.baseVersion = serverProject.version;
+    if ( resumePush( projectFullName, localFiles ) )
+      return;
+
     // TODO: make sure there are no remote files to add/update/remove nor conflicts
 
-    QList<MerginFile> filesToUpload;
     QList<MerginFile> addedMerginFiles, updatedMerginFiles, deletedMerginFiles;
     QList<MerginFile> diffFiles;
+    const QHash<QString, MerginFile> localFilesByPath = filesByPath( localFiles );
     for ( QString filePath : transaction.diff.localAdded )
     {
-      MerginFile merginFile = findFile( filePath, localFiles );
-      merginFile.chunks = generateChunkIdsForSize( merginFile.size );
+      MerginFile merginFile = findFile( filePath, localFilesByPath );
       addedMerginFiles.append( merginFile );
     }
 
     for ( QString filePath : transaction.diff.localUpdated )
     {
-      MerginFile merginFile = findFile( filePath, localFiles );
-      merginFile.chunks = generateChunkIdsForSize( merginFile.size );
+      MerginFile merginFile = findFile( filePath, localFilesByPath );
 
       if ( MerginApi::isFileDiffable( filePath ) )
       {
-        // try to create a diff
-        QString diffName;
-        int geodiffRes = GeodiffUtils::createChangeset( transaction.projectDir, filePath, diffName );
+        // use the diff created when comparing the files
+        int geodiffRes = changesets.changeset( filePath ).result;
+        QString diffName = changesets.takeDiff( filePath );
         QString diffPath = transaction.projectDir + "/.mergin/" + diffName;
-        QString basePath = transaction.projectDir + "/.mergin/" + filePath;
 
-        if ( geodiffRes == GEODIFF_SUCCESS )
+        if ( !diffName.isEmpty() )
         {
           QByteArray checksumDiff = getChecksum( diffPath );
 
@@ -2213,7 +3318,7 @@ void MerginApi::uploadInfoReplyFinished()
         }
         else
         {
-          // TODO: remove the diff file (if exists)
+          // the session removes the diff file (if exists)
           CoreUtils::log( "push " + projectFullName, QString( "Geodiff create changeset on %1 FAILED with error %2 (will do full upload)" ).arg( filePath ).arg( geodiffRes ) );
         }
       }
@@ -2223,7 +3328,7 @@ void MerginApi::uploadInfoReplyFinished()
 
     for ( QString filePath : transaction.diff.localDeleted )
     {
-      MerginFile merginFile = findFile( filePath, serverProject.files );
+      MerginFile merginFile = serverProject.fileInfo( filePath );
       deletedMerginFiles.append( merginFile );
     }
 
@@ -2231,50 +3336,58 @@ void MerginApi::uploadInfoReplyFinished()
     {
       // if nothing has changed, there is no point to even start upload transaction
       transaction.projectMetadata = data;
-      transaction.version = MerginProjectMetadata::fromJson( data ).version;
+      transaction.version = serverProject.version;
 
       finishProjectSync( projectFullName, true );
       return;
     }
 
-    QJsonArray added = prepareUploadChangesJSON( addedMerginFiles );
-    filesToUpload.append( addedMerginFiles );
-
-    QJsonArray modified = prepareUploadChangesJSON( updatedMerginFiles );
-    filesToUpload.append( updatedMerginFiles );
-
-    QJsonArray removed = prepareUploadChangesJSON( deletedMerginFiles );
-    // removed not in filesToUpload
-
-    QJsonObject changes;
-    changes.insert( "added", added );
-    changes.insert( "removed", removed );
-    changes.insert( "updated", modified );
-    changes.insert( "renamed", QJsonArray() );
+    transaction.uploadDiffFiles = diffFiles;
 
-    qint64 totalSize = 0;
-    for ( MerginFile file : filesToUpload )
+    // chunks of files that are uploaded whole (not as diffs) are not set yet
+    QList<MerginFile> filesToUpload = addedMerginFiles + updatedMerginFiles;
+    if ( !mServerSupportsChunkDedup )
     {
-      if ( !file.diffName.isEmpty() )
-        totalSize += file.diffSize;
-      else
-        totalSize += file.size;
+      // chunks of fixed size only need the size of the file
+      for ( MerginFile &merginFile : filesToUpload )
+      {
+        if ( merginFile.diffName.isEmpty() )
+          setChunksForFullUpload( transaction.projectDir, merginFile, false );
+      }
+      prepareUploadStart( projectFullName, filesToUpload.mid( 0, addedMerginFiles.count() ), filesToUpload.mid( addedMerginFiles.count() ),
+                          deletedMerginFiles, serverProject.version );
+      return;
     }
 
-    CoreUtils::log( "push " + projectFullName, QStringLiteral( "%1 items to upload (total size %2 bytes)" )
-                    .arg( filesToUpload.count() ).arg( totalSize ) );
+    // content-defined chunks need the whole files to be read - it is done on a worker thread, the push continues once they are known
+    QFutureWatcher< QList<MerginFile> > *watcher = new QFutureWatcher< QList<MerginFile> >( this );
+    transaction.chunkingWatcher = watcher;
+    int addedCount = addedMerginFiles.count();
+    int serverVersion = serverProject.version;
+    connect( watcher, &QFutureWatcher< QList<MerginFile> >::finished, this, [ = ]()
+    {
+      watcher->deleteLater();
 
-    transaction.totalSize = totalSize;
-    transaction.uploadQueue = filesToUpload;
-    transaction.uploadDiffFiles = diffFiles;
+      // the push may have been canceled in the meantime
+      if ( !mTransactionalStatus.contains( projectFullName ) || mTransactionalStatus[projectFullName].chunkingWatcher != watcher )
+        return;
+      mTransactionalStatus[projectFullName].chunkingWatcher = nullptr;
 
-    QJsonObject json;
-    json.insert( QStringLiteral( "changes" ), changes );
-    json.insert( QStringLiteral( "version" ), QString( "v%1" ).arg( serverProject.version ) );
-    QJsonDocument jsonDoc;
-    jsonDoc.setObject( json );
+      const QList<MerginFile> files = watcher->result();
+      prepareUploadStart( projectFullName, files.mid( 0, addedCount ), files.mid( addedCount ), deletedMerginFiles, serverVersion );
+    } );
 
-    uploadStart( projectFullName, jsonDoc.toJson( QJsonDocument::Compact ) );
+    QString projectDir = transaction.projectDir;
+    watcher->setFuture( QtConcurrent::run( [projectDir, filesToUpload]()
+    {
+      QList<MerginFile> files = filesToUpload;
+      for ( MerginFile &merginFile : files )
+      {
+        if ( merginFile.diffName.isEmpty() )
+          setChunksForFullUpload( projectDir, merginFile, true );
+      }
+      return files;
+    } ) );
   }
   else
   {
@@ -2288,6 +3401,57 @@ void MerginApi::uploadInfoReplyFinished()
   }
 }
 
+void MerginApi::prepareUploadStart( const QString &projectFullName, const QList<MerginFile> &addedMerginFiles, const QList<MerginFile> &updatedMerginFiles,
+                                    const QList<MerginFile> &deletedMerginFiles, int serverVersion )
+{
+  Q_ASSERT( mTransactionalStatus.contains( projectFullName ) );
+  TransactionStatus &transaction = mTransactionalStatus[projectFullName];
+
+  QList<MerginFile> filesToUpload;
+  QJsonArray added = prepareUploadChangesJSON( addedMerginFiles );
+  filesToUpload.append( addedMerginFiles );
+
+  QJsonArray modified = prepareUploadChangesJSON( updatedMerginFiles );
+  filesToUpload.append( updatedMerginFiles );
+
+  QJsonArray removed = prepareUploadChangesJSON( deletedMerginFiles );
+  // removed not in filesToUpload
+
+  QJsonObject changes;
+  changes.insert( "added", added );
+  changes.insert( "removed", removed );
+  changes.insert( "updated", modified );
+  changes.insert( "renamed", QJsonArray() );
+
+  qint64 totalSize = 0;
+  for ( MerginFile file : filesToUpload )
+  {
+    if ( !file.diffName.isEmpty() )
+      totalSize += file.diffSize;
+    else
+      totalSize += file.size;
+  }
+
+  CoreUtils::log( "push " + projectFullName, QStringLiteral( "%1 items to upload (total size %2 bytes)" )
+                  .arg( filesToUpload.count() ).arg( totalSize ) );
+
+  transaction.totalSize = totalSize;
+  transaction.uploadQueue = filesToUpload;
+
+  QJsonObject json;
+  json.insert( QStringLiteral( "changes" ), changes );
+  json.insert( QStringLiteral( "version" ), QString( "v%1" ).arg( serverVersion ) );
+  QJsonDocument jsonDoc;
+  jsonDoc.setObject( json );
+  QByteArray pushJson = jsonDoc.toJson( QJsonDocument::Compact );
+
+  // the server transaction is only started once the push may transfer data, so that it does not expire in the queue
+  requestTransfer( projectFullName, totalSize, [this, projectFullName, pushJson]()
+  {
+    uploadStart( projectFullName, pushJson );
+  } );
+}
+
 void MerginApi::uploadFinishReplyFinished()
 {
   QNetworkReply *r = qobject_cast<QNetworkReply *>( sender() );
@@ -2308,6 +3472,17 @@ void MerginApi::uploadFinishReplyFinished()
     transaction.replyUploadFinish->deleteLater();
     transaction.replyUploadFinish = nullptr;
 
+    SyncJournal::remove( transaction.projectDir, SyncJournal::Push );
+
+    // content-defined chunks of the pushed files are on the server now, later pushes do not need to upload them
+    ChunkIndex chunkIndex( transaction.projectDir );
+    for ( const MerginFile &file : qAsConst( transaction.uploadQueue ) )
+    {
+      if ( file.diffName.isEmpty() && !file.chunkSizes.isEmpty() )
+        chunkIndex.insert( file.chunks );
+    }
+    chunkIndex.save();
+
     transaction.projectMetadata = data;
     transaction.version = MerginProjectMetadata::fromJson( data ).version;
 
@@ -2358,6 +3533,21 @@ void MerginApi::uploadFinishReplyFinished()
     QString message = QStringLiteral( "Network API error: %1(): %2. %3" ).arg( QStringLiteral( "uploadFinish" ), r->errorString(), serverMsg );
     CoreUtils::log( "push " + projectFullName, QStringLiteral( "FAILED - %1" ).arg( message ) );
 
+    // all chunks have been uploaded - unless the server has refused the finish, only the finish request is repeated on resume
+    if ( r->attribute( QNetworkRequest::HttpStatusCodeAttribute ).isValid() )
+    {
+      discardPushJournal( transaction.projectDir );
+
+      // the server may not have some of the chunks we have left out anymore, the next push uploads all of them
+      if ( transaction.uploadSkippedKnownChunks )
+      {
+        CoreUtils::log( "push " + projectFullName, QStringLiteral( "Forgetting chunks known to be on the server" ) );
+        ChunkIndex chunkIndex( transaction.projectDir );
+        chunkIndex.clear();
+        chunkIndex.save();
+      }
+    }
+
     transaction.replyUploadFinish->deleteLater();
     transaction.replyUploadFinish = nullptr;
 
@@ -2449,7 +3639,8 @@ ProjectDiff MerginApi::compareProjectFiles(
   const QString &projectDir,
   bool allowConfig,
   const MerginConfig &config,
-  const MerginConfig &lastSyncConfig
+  const MerginConfig &lastSyncConfig,
+  ChangesetSession *changesets
 )
 {
   ProjectDiff diff;
@@ -2464,6 +3655,25 @@ ProjectDiff MerginApi::compareProjectFiles(
     oldServerFilesMap.insert( file.path, file );
   }
 
+  // diffable files changed locally need a diff to tell whether their content has changed - create all of them at once
+  std::unique_ptr<ChangesetSession> ownChangesets;
+  if ( !changesets )
+  {
+    ownChangesets.reset( new ChangesetSession( projectDir ) );
+    changesets = ownChangesets.get();
+  }
+  QStringList diffableChanged;
+  for ( const MerginFile &localFile : localFiles )
+  {
+    // the same conditions as for the diffs done below (L-U, C/R-U/L-U)
+    auto oldIt = oldServerFilesMap.constFind( localFile.path );
+    auto newIt = newServerFilesMap.constFind( localFile.path );
+    if ( isFileDiffable( localFile.path ) && oldIt != oldServerFilesMap.constEnd() && newIt != newServerFilesMap.constEnd() &&
+         oldIt->checksum != localFile.checksum && newIt->checksum != localFile.checksum )
+      diffableChanged << localFile.path;
+  }
+  changesets->prepare( diffableChanged );
+
   for ( MerginFile localFile : localFiles )
   {
     QString filePath = localFile.path;
@@ -2516,7 +3726,7 @@ ProjectDiff MerginApi::compareProjectFiles(
           {
             // we need to do a diff here to figure out whether the file is actually changed or not
             // because the real content may be the same although the checksums do not match
-            if ( GeodiffUtils::hasPendingChanges( projectDir, filePath ) )
+            if ( changesets->hasPendingChanges( filePath ) )
               diff.localUpdated << filePath;
           }
           else
@@ -2536,7 +3746,7 @@ ProjectDiff MerginApi::compareProjectFiles(
           {
             // we need to do a diff here to figure out whether the file is actually changed or not
             // because the real content may be the same although the checksums do not match
-            if ( GeodiffUtils::hasPendingChanges( projectDir, filePath ) )
+            if ( changesets->hasPendingChanges( filePath ) )
               diff.conflictRemoteUpdatedLocalUpdated << filePath;
             else
               diff.remoteUpdated << filePath;
@@ -2672,39 +3882,37 @@ MerginProject MerginApi::parseProjectMetadata( const QJsonObject &proj )
 }
 
 
-MerginProjectsList MerginApi::parseProjectsFromJson( const QJsonDocument &doc )
+MerginProjectsList MerginApi::parseProjectsList( const MerginProjectsListReader &reader )
 {
-  if ( !doc.isObject() )
-    return MerginProjectsList();
-
-  QJsonObject object = doc.object();
   MerginProjectsList result;
 
-  if ( object.contains( "projects" ) && object.value( "projects" ).isArray() ) // listProjects API
-  {
-    QJsonArray vArray = object.value( "projects" ).toArray();
-
-    for ( auto it = vArray.constBegin(); it != vArray.constEnd(); ++it )
-    {
-      result << parseProjectMetadata( it->toObject() );
-    }
-  }
-  else if ( !object.isEmpty() ) // listProjectsbyName API returns projects as separate objects not in array
+  const QList< QPair<QString, QJsonObject> > projects = reader.projects();
+  for ( const QPair<QString, QJsonObject> &entry : projects )
   {
-    for ( auto it = object.begin(); it != object.end(); ++it )
+    MerginProject project = parseProjectMetadata( entry.second );
+    if ( !entry.first.isEmpty() && !project.remoteError.isEmpty() )
     {
-      MerginProject project = parseProjectMetadata( it->toObject() );
-      if ( !project.remoteError.isEmpty() )
-      {
-        // add project namespace/name from object name in case of error
-        MerginApi::extractProjectName( it.key(), project.projectNamespace, project.projectName );
-      }
-      result << project;
+      // add project namespace/name from object name in case of error (listProjectsByName API)
+      MerginApi::extractProjectName( entry.first, project.projectNamespace, project.projectName );
     }
+    result << project;
   }
   return result;
 }
 
+void MerginApi::readReplyData( QNetworkReply *reply, std::function<void( const QByteArray & )> consumer )
+{
+  connect( reply, &QNetworkReply::readyRead, this, [reply, consumer]()
+  {
+    // keep error responses in the reply - the message is extracted once it has finished
+    int httpStatus = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    if ( httpStatus < 200 || httpStatus >= 300 )
+      return;
+
+    consumer( reply->readAll() );
+  } );
+}
+
 
 QStringList MerginApi::generateChunkIdsForSize( qint64 fileSize )
 {
@@ -2775,6 +3983,11 @@ void MerginApi::finishProjectSync( const QString &projectFullName, bool syncSucc
   {
     // update the local metadata file
     writeData( transaction.projectMetadata, transaction.projectDir + "/" + MerginApi::sMetadataFile );
+    ProjectMetadataStore::instance().invalidate( transaction.projectDir + "/" + MerginApi::sMetadataFile );
+
+    // the server has the local files read by the push now - there are no local changes but those made since then
+    if ( transaction.changeSnapshot >= 0 )
+      mLocalProjects.changeTracker().setBaseline( transaction.projectDir, static_cast<quint64>( transaction.changeSnapshot ) );
 
     // update info of local projects
     mLocalProjects.updateLocalVersion( transaction.projectDir, transaction.version );
@@ -2792,6 +4005,10 @@ void MerginApi::finishProjectSync( const QString &projectFullName, bool syncSucc
   int newVersion = syncSuccessful ? transaction.version : -1;
   mTransactionalStatus.remove( projectFullName );
 
+  // let queued syncs transfer their data and the others use the requests of this one
+  mSyncScheduler.release( projectFullName );
+  resumeTransfers();
+
   if ( updateBeforeUpload )
   {
     CoreUtils::log( "sync " + projectFullName, QStringLiteral( "Continue with push after pull" ) );
@@ -2912,8 +4129,113 @@ QSet<QString> MerginApi::listFiles( const QString &path )
   return files;
 }
 
-DownloadQueueItem::DownloadQueueItem( const QString &fp, int s, int v, int rf, int rt, bool diff )
+DownloadQueueItem::DownloadQueueItem( const QString &fp, qint64 s, int v, qint64 rf, qint64 rt, bool diff )
   : filePath( fp ), size( s ), version( v ), rangeFrom( rf ), rangeTo( rt ), downloadDiff( diff )
 {
   tempFileName = CoreUtils::uuidWithoutBraces( QUuid::createUuid() );
 }
+
+MerginProjectsListReader::MerginProjectsListReader()
+  : mReader( *this )
+{
+}
+
+bool MerginProjectsListReader::addData( const QByteArray &data )
+{
+  return mReader.addData( data );
+}
+
+bool MerginProjectsListReader::finish()
+{
+  return mReader.finish() && mIsObject;
+}
+
+QList< QPair<QString, QJsonObject> > MerginProjectsListReader::projects() const
+{
+  if ( mHasProjectsArray )
+    return mArrayProjects;
+
+  QList< QPair<QString, QJsonObject> > projects = mNamedProjects;
+  std::stable_sort( projects.begin(), projects.end(), []( const QPair<QString, QJsonObject> &a, const QPair<QString, QJsonObject> &b )
+  {
+    return a.first < b.first;
+  } );
+  return projects;
+}
+
+void MerginProjectsListReader::startObject()
+{
+  Context context = Other;
+  if ( mContexts.isEmpty() )
+  {
+    context = Root;
+    mIsObject = true;
+  }
+  else if ( mContexts.last() == Root || mContexts.last() == ProjectsArray )
+  {
+    context = Project;
+    mProjectName = mContexts.last() == Root ? mKey : QString();
+    mProject = QJsonObject();
+  }
+  mContexts.append( context );
+}
+
+void MerginProjectsListReader::endObject()
+{
+  if ( mContexts.takeLast() != Project )
+    return;
+
+  if ( mContexts.last() == Root )
+    mNamedProjects << qMakePair( mProjectName, mProject );
+  else
+    mArrayProjects << qMakePair( QString(), mProject );
+}
+
+void MerginProjectsListReader::startArray()
+{
+  Context context = Other;
+  if ( !mContexts.isEmpty() && mContexts.last() == Root && mKey == QLatin1String( "projects" ) )
+  {
+    context = ProjectsArray;
+    mHasProjectsArray = true;
+  }
+  else if ( !mContexts.isEmpty() && ( mContexts.last() == Root || mContexts.last() == ProjectsArray ) )
+  {
+    // not a project object - still listed (as an empty project) like when the whole document was parsed
+    value( QJsonValue() );
+  }
+  mContexts.append( context );
+}
+
+void MerginProjectsListReader::endArray()
+{
+  mContexts.removeLast();
+}
+
+void MerginProjectsListReader::key( const QString &name )
+{
+  mKey = name;
+}
+
+void MerginProjectsListReader::value( const QJsonValue &value )
+{
+  if ( mContexts.isEmpty() )
+    return;
+
+  switch ( mContexts.last() )
+  {
+    case Root:
+      if ( mKey == QLatin1String( "count" ) )
+        mCount = value.toInt();
+      mNamedProjects << qMakePair( mKey, QJsonObject() );
+      break;
+    case ProjectsArray:
+      mArrayProjects << qMakePair( QString(), QJsonObject() );
+      break;
+    case Project:
+      mProject.insert( mKey, value );
+      break;
+    default:
+      break;
+  }
+}
@@ -10,9 +10,12 @@
 #ifndef MERGINAPI_H
 #define MERGINAPI_H
 
+#include <atomic>
+#include <functional>
 #include <memory>
 
 #include <QObject>
+#include <QFutureWatcher>
 #include <QNetworkAccessManager>
 #include <QEventLoop>
 #include <QFile>
@@ -22,13 +25,17 @@
 #include <QSet>
 #include <QByteArray>
 #include <QDateTime>
+#include <QTimer>
 
 #include "merginapistatus.h"
 #include "merginsubscriptionstatus.h"
+#include "jsonstreamreader.h"
 #include "merginprojectmetadata.h"
 #include "localprojectsmanager.h"
 #include "project.h"
+#include "syncscheduler.h"
 
+class ChangesetSession;
 class MerginUserAuth;
 class MerginUserInfo;
 class MerginSubscriptionInfo;
@@ -98,15 +105,42 @@ struct ProjectDiff
  */
 struct DownloadQueueItem
 {
-  DownloadQueueItem( const QString &fp, int s, int v, int rf = -1, int rt = -1, bool diff = false );
+  DownloadQueueItem() = default;
+  DownloadQueueItem( const QString &fp, qint64 s, int v, qint64 rf = -1, qint64 rt = -1, bool diff = false );
 
   QString filePath;          //!< path within the project
-  int size;                  //!< size of the item in bytes
+  qint64 size = 0;           //!< size of the item in bytes
   int version = -1;          //!< what version to download  (for ordinary files it will be the target version, for diffs it can be different version)
-  int rangeFrom = -1;        //!< what range of bytes to download (-1 if downloading the whole file)
-  int rangeTo = -1;          //!< what range of bytes to download (-1 if downloading the whole file)
+  qint64 rangeFrom = -1;     //!< what range of bytes to download (-1 if downloading the whole file)
+  qint64 rangeTo = -1;       //!< what range of bytes to download (-1 if downloading the whole file)
   bool downloadDiff = false; //!< whether to download just the diff between the previous version and the current one
   QString tempFileName;      //!< relative filename of the temporary file where the downloaded content will be stored
+
+  /**
+   * Size of the whole file if the item is a chunk of it, -1 otherwise. Chunks of a file share the temporary file,
+   * which is preallocated to the size of the file, and each chunk is written to its position (rangeFrom) in it.
+   */
+  qint64 fileSize = -1;
+};
+
+
+/**
+ * A unit of upload during project push - a single chunk of a full file or of a diff file.
+ * Chunks of all files are scheduled together, so that several of them can be in flight at once.
+ */
+struct UploadQueueItem
+{
+  UploadQueueItem() = default;
+  UploadQueueItem( const QString &fp, const QString &sp, const QString &id, int no, qint64 o, qint64 s )
+    : filePath( fp ), sourcePath( sp ), chunkId( id ), chunkNo( no ), offset( o ), size( s ) {}
+
+  QString filePath;    //!< path within the project
+  QString sourcePath;  //!< absolute path of the file the chunk is read from (project file or diff file in .mergin dir)
+  QString chunkId;     //!< chunk ID as announced to the server in the push request
+  int chunkNo = 0;     //!< index of the chunk within the file
+  qint64 offset = 0;   //!< position of the chunk within the source file
+  qint64 size = 0;     //!< size of the chunk in bytes
+  int retries = 0;     //!< how many times the upload of this chunk has been retried
 };
 
 
@@ -132,37 +166,107 @@ struct UpdateTask
   QList<DownloadQueueItem> data;  //!< list of chunks / list of diffs to apply
 };
 
+/**
+ * Reads reply of listProjects or listProjectsByName API as it arrives (see JsonStreamReader). Only plain values
+ * of the project objects are kept, the document of the whole reply is never built.
+ */
+class MerginProjectsListReader : private JsonStreamReader::Handler
+{
+  public:
+    MerginProjectsListReader();
+    Q_DISABLE_COPY( MerginProjectsListReader )
+
+    //! Reads the next part of the reply. Returns false if the content is not valid JSON
+    bool addData( const QByteArray &data );
+
+    //! Finishes reading. Returns false if the reply has not been a valid JSON object
+    bool finish();
+
+    //! Returns "count" of listProjects reply (the total number of projects, not only of this page)
+    int count() const { return mCount; }
+
+    /**
+     * Returns objects of the projects (with plain values only) - items of "projects" array of listProjects reply
+     * (with empty names), or members of listProjectsByName reply with their names (ordered by names like in QJsonObject)
+     */
+    QList< QPair<QString, QJsonObject> > projects() const;
+
+  private:
+    enum Context
+    {
+      Other,
+      Root,
+      ProjectsArray,
+      Project,
+    };
+
+    void startObject() override;
+    void endObject() override;
+    void startArray() override;
+    void endArray() override;
+    void key( const QString &name ) override;
+    void value( const QJsonValue &value ) override;
+
+    JsonStreamReader mReader;
+    QVector<Context> mContexts;  //!< contexts of the objects and arrays being read
+    QString mKey;                //!< key of the next value of the current object
+    bool mIsObject = false;      //!< the reply is an object
+    bool mHasProjectsArray = false;  //!< the reply has "projects" array (listProjects API)
+    int mCount = 0;
+
+    QString mProjectName;        //!< name of the project object being read (empty for items of the array)
+    QJsonObject mProject;        //!< project object being read
+    QList< QPair<QString, QJsonObject> > mArrayProjects;
+    QList< QPair<QString, QJsonObject> > mNamedProjects;
+};
+
 struct TransactionStatus
 {
-  qreal totalSize = 0;     //!< total size (in bytes) of files to be uploaded or downloaded
-  int transferedSize = 0;  //!< size (in bytes) of amount of data transferred so far
+  qint64 totalSize = 0;       //!< total size (in bytes) of files to be uploaded or downloaded
+  qint64 transferedSize = 0;  //!< size (in bytes) of amount of data transferred so far
   QString transactionUUID; //!< only for upload. Initially dummy non-empty string, after server confirms a valid UUID, on finish/cancel it is empty
 
+  //! Returns the transferred part of the data (0 to 1)
+  qreal progress() const { return totalSize > 0 ? static_cast<qreal>( transferedSize ) / totalSize : 0; }
+
   // download replies
   QPointer<QNetworkReply> replyProjectInfo;
-  QPointer<QNetworkReply> replyDownloadItem;
+  QPointer<QNetworkReply> replyDownloadConfig;
+  QList< QPointer<QNetworkReply> > replyDownloadItems;  //!< in-flight requests for items of the download queue (at most MerginApi::downloadWindow() of them)
+  QHash<QString, DownloadQueueItem> downloadItemsInFlight;  //!< items of the in-flight requests (item key -> item)
 
   // upload replies
   QPointer<QNetworkReply> replyUploadProjectInfo;
   QPointer<QNetworkReply> replyUploadStart;
-  QPointer<QNetworkReply> replyUploadFile;
+  QList< QPointer<QNetworkReply> > replyUploadFiles;  //!< in-flight chunk uploads (at most MerginApi::uploadWindow() of them)
   QPointer<QNetworkReply> replyUploadFinish;
 
   // download-related data
   QList<DownloadQueueItem> downloadQueue;  //!< pending list of stuff to download - chunks of project files or diff files (at the end of transaction it is empty)
   QList<UpdateTask> updateTasks;  //!< tasks to do at the end of update (pull) when everything has been downloaded
+  QPointer< QFutureWatcher<bool> > finalizeWatcher;  //!< set while update tasks are executed on a worker thread
+  QPointer< QFutureWatcher< QList<MerginFile> > > chunkingWatcher;  //!< only for upload. Set while chunks of files to upload are computed on a worker thread
+  std::shared_ptr< std::atomic<bool> > finalizeCanceled;  //!< set on cancel, the worker stops if it has not changed the project directory yet
 
   // upload-related data
-  QList<MerginFile> uploadQueue; //!< pending list of files to upload (at the end of transaction it is empty)
+  QList<MerginFile> uploadQueue; //!< list of files to upload
+  QList<UploadQueueItem> uploadChunkQueue;  //!< pending list of chunks to upload (at the end of transaction it is empty)
+  QHash<QString, UploadQueueItem> uploadChunksInFlight;  //!< chunks that have been sent but not acknowledged yet (chunk ID -> chunk)
+  QHash<QString, UploadQueueItem> uploadChunksRetrying;  //!< failed chunks waiting for their retry delay, then they go back to the front of uploadChunkQueue (chunk ID -> chunk)
   QList<MerginFile> uploadDiffFiles;  //!< these are just diff files for upload - we don't remove them when uploading chunks (needed for finalization)
+  bool uploadSkippedKnownChunks = false;  //!< whether some chunks have not been uploaded because the server has them already (see ChunkIndex)
+  qint64 changeSnapshot = -1;  //!< only for upload. ProjectChangeTracker::snapshot() taken when local files have been read (-1 if not yet)
 
   QString projectDir;
   QByteArray projectMetadata;  //!< metadata of the new project (not parsed)
+  MerginProjectMetadata serverMetadata;  //!< only for update. projectMetadata parsed once they have been received
+  std::shared_ptr<MerginProjectMetadataReader> projectInfoReader;  //!< parses project info reply while it is being received
   bool firstTimeDownload = false;   //!< only for update. whether this is first time to download the project (on failure we would also remove the project folder)
   bool updateBeforeUpload = false; //!< true when we're first doing update before doing actual upload. Used in sync finalization to figure out whether restart with upload or finish.
   bool isInitialUpload = false; //! true when we are first time uploading the project - migration to Mergin
 
   int version = -1;  //!< version to which we are updating / the version which we have uploaded
+  int baseVersion = -1;  //!< only for upload. Server version of the project the pushed changes are based on
 
   ProjectDiff diff;
 
@@ -188,7 +292,7 @@ class MerginApi: public QObject
 
   public:
     explicit MerginApi( LocalProjectsManager &localProjects, QObject *parent = nullptr );
-    ~MerginApi() = default;
+    ~MerginApi() override;
 
     MerginUserAuth *userAuth() const;
     MerginUserInfo *userInfo() const;
@@ -330,7 +434,22 @@ class MerginApi: public QObject
     //! Get a list of all files that can be used with geodiff
     QStringList projectDiffableFiles( const QString &projectFullName );
 
-    static ProjectDiff localProjectChanges( const QString &projectDir );
+    /**
+     * Compares local files of the project with its metadata. Changesets of GeoPackages created
+     * to find out whether they have been really changed are kept in \a changesets if passed.
+     * Nothing is written to the files, GeoPackages with changes in their "-wal" files are diffed.
+     */
+    static ProjectDiff localProjectChanges( const QString &projectDir, ChangesetSession *changesets = nullptr );
+
+    /**
+     * Sets the function that checkpoints GeoPackages of a project edited in WAL journal mode (core cannot do it itself,
+     * the app uses InputUtils::checkpointGeoPackages()). It is called (from the main thread) right before sync reads
+     * local files of the project or a pull starts to modify them. If it fails, the sync is postponed. Set it once at startup.
+     */
+    static void setGeoPackagesCheckpoint( const std::function<bool( const QString &projectDir )> &checkpoint );
+
+    //! Checkpoints GeoPackages of the project with the function set by setGeoPackagesCheckpoint(), returns false if it failed
+    static bool checkpointGeoPackages( const QString &projectDir );
 
     /**
     * Finds project in merginProjects list according its full name.
@@ -373,6 +492,9 @@ class MerginApi: public QObject
      *  after changes in "config"
      *
      * Without the three sources it is possible to miss some of the updates that need to be handled (e.g. conflicts)
+     *
+     * Locally changed GeoPackages are diffed (in parallel) to find out whether their content has really changed.
+     * The changesets are kept in \a changesets if passed (e.g. to be uploaded), otherwise they are thrown away.
      */
     static ProjectDiff compareProjectFiles(
       const QList<MerginFile> &oldServerFiles,
@@ -381,10 +503,17 @@ class MerginApi: public QObject
       const QString &projectDir,
       bool allowConfig = false,
       const MerginConfig &config = MerginConfig(),
-      const MerginConfig &lastSyncConfig = MerginConfig()
+      const MerginConfig &lastSyncConfig = MerginConfig(),
+      ChangesetSession *changesets = nullptr
     );
 
-    static QList<MerginFile> getLocalProjectFiles( const QString &projectPath );
+    /**
+     * Scans the project directory and returns list of its files with their checksums, sorted by path.
+     * Checksums of unchanged files are taken from ChecksumCache, the rest is hashed.
+     * \param projectPath path of the project directory (with trailing slash)
+     * \param parallel if true, files are scanned and hashed on the global thread pool
+     */
+    static QList<MerginFile> getLocalProjectFiles( const QString &projectPath, bool parallel = true );
 
     QString apiRoot() const;
     void setApiRoot( const QString &apiRoot );
@@ -426,6 +555,66 @@ class MerginApi: public QObject
     bool supportsSelectiveSync() const;
     void setSupportsSelectiveSync( bool supportsSelectiveSync );
 
+    /**
+     * Returns maximum number of download queue items that are requested in parallel during a pull of a single project.
+     * Keeping several ranged requests in flight hides the latency of slow links.
+     */
+    int downloadWindow() const;
+    //! Sets maximum number of parallel item requests during a pull (values lower than 1 are clamped to 1)
+    void setDownloadWindow( int downloadWindow );
+
+    /**
+     * Returns maximum number of chunks that are uploaded in parallel during a push of a single project.
+     * Chunks are scheduled across all files of the push, not only within a single file.
+     */
+    int uploadWindow() const;
+    //! Sets maximum number of parallel chunk uploads during a push (values lower than 1 are clamped to 1)
+    void setUploadWindow( int uploadWindow );
+
+    /**
+     * Returns whether chunks of pushed files and items of pulls are transferred compressed (see TransferCompression).
+     * Pushed chunks of compressible files are sent with "deflate" content coding, pulls of such files accept it.
+     * Disabled by default - the server needs to support compressed chunks.
+     */
+    bool transferCompression() const;
+    void setTransferCompression( bool enabled );
+
+    /**
+     * Returns whether the server deduplicates chunks of full files (negotiated by pingMergin()).
+     * If it does, full files get split to content-defined chunks with IDs derived from their content (see ContentChunker)
+     * and chunks the server has of the project already (see ChunkIndex) are not uploaded again.
+     * Otherwise files are split to chunks of fixed size with random IDs.
+     */
+    bool serverSupportsChunkDedup() const;
+    void setServerSupportsChunkDedup( bool supported );
+
+    /**
+     * Returns maximum number of projects that transfer data at once. Syncs of other projects wait
+     * for a free slot once their project info is fetched (see SyncScheduler).
+     */
+    int maxActiveTransfers() const;
+    //! Sets maximum number of projects that transfer data at once (values lower than 1 are clamped to 1)
+    void setMaxActiveTransfers( int count );
+
+    /**
+     * Returns maximum number of item and chunk requests in flight across all syncs,
+     * on top of the download and upload windows of each sync.
+     */
+    int maxTransferRequests() const;
+    //! Sets maximum number of item and chunk requests in flight across all syncs (values lower than 1 are clamped to 1)
+    void setMaxTransferRequests( int count );
+
+    //! Returns limit of the transfer rate of all syncs in bytes per second (zero if not limited)
+    qint64 bandwidthLimit() const;
+    //! Sets limit of the transfer rate of all syncs in bytes per second, zero or negative for no limit
+    void setBandwidthLimit( qint64 bytesPerSecond );
+
+    /**
+     * Sets the project open in the app, its sync gets a transfer slot before syncs of other projects.
+     * \param projectFilePath path of the QGIS project file (empty if no project is open)
+     */
+    void setActiveProject( const QString &projectFilePath );
+
   signals:
     void apiSupportsSubscriptionsChanged();
     void supportsSelectiveSyncChanged();
@@ -437,9 +626,15 @@ class MerginApi: public QObject
     /**
      * Emitted when sync starts/finishes or the progress changes - useful to give a clue in the GUI about the status.
      * Normally progress is in interval [0, 1] as data get uploaded or downloaded.
-     * With no pending sync, progress is set to -1
+     * With no pending sync, progress is set to -1. While the sync waits for a transfer slot (see SyncScheduler), progress stays at 0
      */
     void syncProjectStatusChanged( const QString &projectFullName, qreal progress );
+    /**
+     * Emitted while update tasks of a pull (assembly of files, applying of diffs) are being executed
+     * after all data have been downloaded. Progress is in interval [0, 1].
+     * \note emitted from a worker thread
+     */
+    void syncProjectFinalizationProgress( const QString &projectFullName, qreal progress );
     void reloadProject( const QString &projectDir );
     void networkErrorOccurred( const QString &message, const QString &additionalInfo, bool showAsDialog = false );
     void storageLimitReached( qreal uploadSize );
@@ -467,11 +662,12 @@ class MerginApi: public QObject
     void projectAttachedToMergin( const QString &projectFullName );
 
   private slots:
-    void listProjectsReplyFinished( QString requestId );
-    void listProjectsByNameReplyFinished( QString requestId );
+    void listProjectsReplyFinished( QString requestId, std::shared_ptr<MerginProjectsListReader> reader );
+    void listProjectsByNameReplyFinished( QString requestId, std::shared_ptr<MerginProjectsListReader> reader );
 
     // Pull slots
     void updateInfoReplyFinished();
+    void downloadItemReplyReadyRead();
     void downloadItemReplyFinished();
     void cacheServerConfig();
 
@@ -498,7 +694,13 @@ class MerginApi: public QObject
 
   private:
     MerginProject parseProjectMetadata( const QJsonObject &project );
-    MerginProjectsList parseProjectsFromJson( const QJsonDocument &object );
+    MerginProjectsList parseProjectsList( const MerginProjectsListReader &reader );
+
+    /**
+     * Passes data of a successful reply to \a consumer as they arrive, so that the reply can be parsed while it is being
+     * received. Data of failed replies are left in the reply (for the error message), so is the rest once the reply finishes.
+     */
+    void readReplyData( QNetworkReply *reply, std::function<void( const QByteArray & )> consumer );
     static QStringList generateChunkIdsForSize( qint64 fileSize );
     QJsonArray prepareUploadChangesJSON( const QList<MerginFile> &files );
     static QString getApiKey( const QString &serverName );
@@ -511,13 +713,75 @@ class MerginApi: public QObject
     void uploadStart( const QString &projectFullName, const QByteArray &json );
 
     /**
-     * Sends non-blocking POST request to the server to upload a file (chunk).
+     * Sends non-blocking POST request to the server to upload a file chunk.
      * \param projectFullName Namespace/name
      * \param transactionUUID Transaction ID which servers sends on uploadStart
-     * \param file Mergin file to upload
-     * \param chunkNo Chunk number of given file to be uploaded
+     * \param chunk Chunk of a file to be uploaded
+     */
+    void uploadFile( const QString &projectFullName, const QString &transactionUUID, const UploadQueueItem &chunk );
+
+    /**
+     * Starts upload of further chunks until the upload window is full.
+     * When all chunks have been acknowledged by the server, requests the transaction finish.
+     */
+    void uploadNextChunks( const QString &projectFullName );
+
+    //! Returns how long (in ms) to wait before sending a failed chunk again for the given retry - grows exponentially, with random jitter
+    static int uploadRetryDelay( int retries );
+
+    //! Aborts and discards all pending chunk uploads of the transaction without triggering their finished slots
+    void abortUploadFiles( TransactionStatus &transaction );
+
+    //! Splits files to upload into the list of chunks in the order they should be sent
+    static QList<UploadQueueItem> itemsForUploadChunks( const QString &projectDir, const QList<MerginFile> &files );
+
+    /**
+     * Sets chunks of the file for its full upload - content-defined ones if \a contentDefined is set (the server
+     * deduplicates chunks), otherwise (or if the file cannot be read) chunks of fixed size.
+     * Content-defined chunks need the whole file to be read, so they are computed on a worker thread.
+     */
+    static void setChunksForFullUpload( const QString &projectDir, MerginFile &file, bool contentDefined );
+
+    /**
+     * Builds the list of changes of the push once chunks of all files to upload are known
+     * and asks for a transfer slot to start the upload transaction.
      */
-    void uploadFile( const QString &projectFullName, const QString &transactionUUID, MerginFile file, int chunkNo = 0 );
+    void prepareUploadStart( const QString &projectFullName, const QList<MerginFile> &addedMerginFiles, const QList<MerginFile> &updatedMerginFiles,
+                             const QList<MerginFile> &deletedMerginFiles, int serverVersion );
+
+    /**
+     * Removes chunks the server has already from the upload queue of the transaction - chunks recorded in the project's
+     * chunk index and repeated chunks of the push. Size of the removed chunks is counted as transferred.
+     */
+    void skipKnownChunks( const QString &projectFullName );
+
+    /**
+     * Continues the push interrupted earlier (see SyncJournal) if its journal matches current local changes
+     * and the server version - only the chunks not acknowledged by the server yet get uploaded within the original
+     * transaction. Returns false if there is nothing to resume (a stale journal is discarded).
+     */
+    bool resumePush( const QString &projectFullName, const QList<MerginFile> &localFiles );
+
+    //! Removes the push journal of the project together with the diff files it refers to
+    static void discardPushJournal( const QString &projectDir );
+
+    /**
+     * Asks the scheduler for a transfer slot for the sync of the project, \a start gets called once it is granted.
+     * \param size number of bytes the sync is about to transfer
+     */
+    void requestTransfer( const QString &projectFullName, qint64 size, const std::function<void()> &start );
+
+    //! Returns number of item and chunk requests in flight across all syncs
+    int transferRequestsCount() const;
+
+    /**
+     * Returns whether another item or chunk request of given size may be sent now with respect to the limits
+     * shared by all syncs. If the bandwidth limit holds it back, transfers are resumed later by a timer.
+     */
+    bool canSendTransferRequest( qint64 size );
+
+    //! Sends further requests of all transferring syncs that have been held back by the shared limits
+    void resumeTransfers();
 
     /**
      * Closing request after successful upload.
@@ -551,26 +815,65 @@ class MerginApi: public QObject
     QString getTempProjectDir( const QString &projectFullName );
     /**
     * Returns modified path for a conflict file in following form: <path>_conflict_<username>_<version>
-    * where username is taken from currently logged in user in mergin.
+    * where username is the currently logged in user in mergin.
     * \param QString path
+    * \param QString username
     * \param int version
     */
-    QString generateConflictFileName( const QString &path, int version );
+    static QString generateConflictFileName( const QString &path, const QString &username, int version );
 
     /** Creates a request to get project details (list of project files).
      */
     QNetworkReply *getProjectInfo( const QString &projectFullName, bool withoutAuth = false );
 
-    //! Called when download/update of project data has finished to finalize things and emit sync finished signal
+    /**
+     * Called when download/update of project data has finished. Starts the update tasks on a worker thread,
+     * finalizeProjectUpdateFinished() gets called on this thread once they are done.
+     */
     void finalizeProjectUpdate( const QString &projectFullName );
 
-    void finalizeProjectUpdateCopy( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
-    void finalizeProjectUpdateApplyDiff( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
+    /**
+     * Executes update tasks of a pull. Runs on a worker thread, so it must not touch any members
+     * (only syncProjectFinalizationProgress() is emitted). Files of the new version are assembled in \a tempDir first,
+     * the tasks may be canceled before each of them (false is returned). Once the project directory has been touched,
+     * all the tasks are run.
+     */
+    bool runProjectUpdateTasks( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QList<UpdateTask> &tasks,
+                                const QString &username, int localVersion, std::shared_ptr< std::atomic<bool> > canceled );
+
+    //! Registers the new local project (if needed) and emits sync finished signal
+    void finalizeProjectUpdateFinished( const QString &projectFullName, bool successful );
+
+    /**
+     * Assembles a pulled file from its downloaded temp files in \a tempDir. Returns the path of the complete file
+     * (in \a tempDir) or an empty string if it failed. The project directory is not touched.
+     */
+    static QString assembleDownloadedFile( const QString &projectFullName, const QString &tempDir, const QList<DownloadQueueItem> &items );
+
+    //! Replaces the project file with the file assembled by assembleDownloadedFile() (and its basefile if diffable)
+    static void installDownloadedFile( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &assembledFile );
+
+    /**
+     * Assembles the server version of a diffable file from its basefile and the downloaded diffs in \a tempDir.
+     * Returns the path of the file (in \a tempDir), the project directory is not modified.
+     */
+    static QString assembleServerFile( const QString &projectFullName, const QString &projectDir, const QString &tempDir, const QString &filePath, const QList<DownloadQueueItem> &items );
+
+    //! Rebases local changes of the file on top of the server file assembled by assembleServerFile(), which becomes the new basefile
+    static void rebaseLocalFile( const QString &projectFullName, const QString &projectDir, const QString &filePath, const QString &serverFile,
+                                 const QString &username, int localVersion );
 
     //! Takes care of removal of the transaction, writing new metadata and emits syncProjectFinished()
     void finishProjectSync( const QString &projectFullName, bool syncSuccessful );
 
-    void prepareProjectUpdate( const QString &projectFullName, const QByteArray &data );
+    /**
+     * Checkpoints GeoPackages of the synced project. If they are busy, the sync is finished as failed
+     * (the user is asked to sync again later) and false is returned - the transaction is gone then.
+     */
+    bool checkpointBeforeSync( const QString &projectFullName );
+
+    //! Prepares update of the project to the version of project info (\a data parsed to \a serverProject)
+    void prepareProjectUpdate( const QString &projectFullName, const QByteArray &data, const MerginProjectMetadata &serverProject );
 
     void startProjectUpdate( const QString &projectFullName );
 
@@ -578,9 +881,34 @@ class MerginApi: public QObject
     void prepareDownloadConfig( const QString &projectFullName, bool downloaded = false );
     void requestServerConfig( const QString &projectFullName );
 
-    //! Starts download request of another item
+    /**
+     * Starts download requests of further items until the download window is full.
+     * When nothing is left to download and no request is pending, finalizes the update.
+     */
     void downloadNextItem( const QString &projectFullName );
 
+    //! Aborts and discards all pending item requests of the transaction without triggering their finished slots
+    void abortDownloadItems( TransactionStatus &transaction );
+
+    /**
+     * Builds the download queue from items of the update tasks. Items already downloaded by an interrupted pull
+     * of the same version (see SyncJournal) are not downloaded again, their temp files are used instead.
+     * Otherwise a new pull journal is started.
+     */
+    void prepareDownloadQueue( const QString &projectFullName );
+
+    /**
+     * Moves data received so far by the item request to its temporary file (owned by the reply)
+     * and returns the number of bytes written, or -1 if the file could not be written (it is closed then).
+     */
+    qint64 writeDownloadedData( QNetworkReply *reply );
+
+    /**
+     * Opens the temporary file of the item for writing. A chunk of a file is written at its position
+     * in the file shared by all chunks, which gets preallocated to the full size of the file.
+     */
+    static bool openDownloadTempFile( QFile &tempFile, const DownloadQueueItem &item );
+
     //! Removes temp folder for project
     void removeProjectsTempFolder( const QString &projectNamespace, const QString &projectName );
 
@@ -602,19 +930,32 @@ class MerginApi: public QObject
     enum CustomAttribute
     {
       AttrProjectFullName = QNetworkRequest::User,
-      AttrTempFileName    = QNetworkRequest::User + 1,
+      AttrDownloadItemKey = QNetworkRequest::User + 1,
     };
 
     Transactions mTransactionalStatus; //projectFullname -> transactionStatus
     static const QSet<QString> sIgnoreExtensions;
     static const QSet<QString> sIgnoreImageExtensions;
     static const QSet<QString> sIgnoreFiles;
+    static std::function<bool( const QString & )> sGeoPackagesCheckpoint;
     QEventLoop mAuthLoopEvent;
     MerginApiStatus::VersionStatus mApiVersionStatus = MerginApiStatus::VersionStatus::UNKNOWN;
     bool mApiSupportsSubscriptions = false;
     bool mSupportsSelectiveSync = true;
-
-    static const int CHUNK_SIZE = 65536;
+    int mDownloadWindow = DEFAULT_DOWNLOAD_WINDOW;
+    int mUploadWindow = DEFAULT_UPLOAD_WINDOW;
+    int mMaxTransferRequests = DEFAULT_MAX_TRANSFER_REQUESTS;
+    bool mTransferCompression = false;
+    bool mServerSupportsChunkDedup = false;
+    SyncScheduler mSyncScheduler;
+    QTimer mTransferTimer;  //!< resumes transfers held back by the bandwidth limit
+
+    static const int CHUNK_SIZE = 65536;  //!< size of buffers used for reading/writing of files and replies
+    static const int DEFAULT_DOWNLOAD_WINDOW = 4;
+    static const int DEFAULT_UPLOAD_WINDOW = 4;
+    static const int DEFAULT_MAX_TRANSFER_REQUESTS = 8;
+    static const int UPLOAD_CHUNK_RETRIES = 2;  //!< how many times a failed chunk upload is retried before the push fails
+    static const int UPLOAD_CHUNK_RETRY_DELAY_MS = 1000;  //!< delay before the first retry of a chunk upload, doubled with each next one
     static const int UPLOAD_CHUNK_SIZE;
     const int PROJECT_PER_PAGE = 50;
     const QString TEMP_FOLDER = QStringLiteral( ".temp/" );
@@ -623,6 +964,7 @@ class MerginApi: public QObject
     static QList<DownloadQueueItem> itemsForFileDiffs( const MerginFile &file );
 
     friend class TestMerginApi;
+    friend class ProjectChangeTracker;
     friend class Purchasing;
     friend class PurchasingTransaction;
 };
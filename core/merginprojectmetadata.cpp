@@ -9,11 +9,12 @@
 
 #include "merginprojectmetadata.h"
 #include "coreutils.h"
+#include "projectmetadatastore.h"
 
 #include <QDebug>
-#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QVariant>
 #include <algorithm>
 #include <QFile>
 
@@ -22,7 +23,8 @@ MerginFile MerginFile::fromJsonObject( const QJsonObject &merginFileInfo )
   MerginFile merginFile;
   merginFile.checksum = merginFileInfo.value( QStringLiteral( "checksum" ) ).toString();
   merginFile.path = merginFileInfo.value( QStringLiteral( "path" ) ).toString();
-  merginFile.size = merginFileInfo.value( QStringLiteral( "size" ) ).toInt();
+  // toInt() would give zero for files of 2 GB and more
+  merginFile.size = merginFileInfo.value( QStringLiteral( "size" ) ).toVariant().toLongLong();
   merginFile.mtime =  QDateTime::fromString( merginFileInfo.value( QStringLiteral( "mtime" ) ).toString(), Qt::ISODateWithMs ).toUTC();
 
   if ( merginFileInfo.contains( QStringLiteral( "history" ) ) )
@@ -52,7 +54,7 @@ MerginFile MerginFile::fromJsonObject( const QJsonObject &merginFileInfo )
         if ( obj.contains( "diff" ) )
         {
           QJsonObject diffObj = obj["diff"].toObject();
-          int fileSize = diffObj["size"].toInt();
+          qint64 fileSize = diffObj["size"].toVariant().toLongLong();
           merginFile.pullDiffFiles << qMakePair( key, fileSize );
         }
         else
@@ -76,72 +78,51 @@ MerginFile MerginFile::fromJsonObject( const QJsonObject &merginFileInfo )
 
 MerginProjectMetadata MerginProjectMetadata::fromJson( const QByteArray &data )
 {
-  MerginProjectMetadata project;
-
-  QJsonDocument doc = QJsonDocument::fromJson( data );
-  if ( !doc.isObject() )
-  {
-    qDebug() << "MerginProjectMetadata::fromJson: invalid content!";
-    return project;
-  }
-
-  QJsonObject docObj = doc.object();
-
-  // read metadata about project files
-  QJsonValue vFiles = docObj.value( QStringLiteral( "files" ) );
-  Q_ASSERT( vFiles.isArray() );
-  QJsonArray vFilesArray = vFiles.toArray();
-  for ( auto it = vFilesArray.constBegin(); it != vFilesArray.constEnd(); ++it )
-  {
-    project.files << MerginFile::fromJsonObject( it->toObject() );
-  }
-
-  project.name = docObj.value( QStringLiteral( "name" ) ).toString();
-  project.projectNamespace = docObj.value( QStringLiteral( "namespace" ) ).toString();
+  MerginProjectMetadataReader reader;
+  reader.addData( data );
+  return reader.metadata();
+}
 
-  QJsonValue access = docObj.value( QStringLiteral( "access" ) );
-  if ( access.isObject() )
-  {
-    QJsonArray writersnames = access.toObject().value( "writersnames" ).toArray();
-    for ( QJsonValueRef tag : writersnames )
-    {
-      project.writersnames.append( tag.toString() );
-    }
-  }
+MerginProjectMetadata MerginProjectMetadata::fromCachedJson( const QString &metadataFilePath )
+{
+  return ProjectMetadataStore::instance().metadata( metadataFilePath );
+}
 
-  QString versionStr = docObj.value( QStringLiteral( "version" ) ).toString();
-  if ( versionStr.isEmpty() )
-  {
-    project.version = 0;
-  }
-  else if ( versionStr.startsWith( "v" ) ) // cut off 'v' part from v123
-  {
-    versionStr = versionStr.mid( 1 );
-    project.version = versionStr.toInt();
-  }
+MerginFile MerginProjectMetadata::fileInfo( const QString &filePath ) const
+{
+  int index = fileIndex( filePath );
+  if ( index >= 0 )
+    return files.at( index );
 
-  return project;
+  qDebug() << "requested fileInfo() for non-existant file! " << filePath;
+  return MerginFile();
 }
 
-MerginProjectMetadata MerginProjectMetadata::fromCachedJson( const QString &metadataFilePath )
+int MerginProjectMetadata::fileIndex( const QString &filePath ) const
 {
-  QFile file( metadataFilePath );
-  if ( file.open( QIODevice::ReadOnly ) )
+  // any change of files detaches them from the indexed list
+  if ( files.isSharedWith( mIndexedFiles ) )
+    return mFilesIndex.value( filePath, -1 );
+
+  for ( int i = 0; i < files.count(); ++i )
   {
-    return fromJson( file.readAll() );
+    if ( files.at( i ).path == filePath )
+      return i;
   }
-  return MerginProjectMetadata();
+  return -1;
 }
 
-MerginFile MerginProjectMetadata::fileInfo( const QString &filePath ) const
+void MerginProjectMetadata::buildFilesIndex()
 {
-  for ( const MerginFile &merginFile : files )
+  mFilesIndex.clear();
+  mFilesIndex.reserve( files.count() );
+  for ( int i = 0; i < files.count(); ++i )
   {
-    if ( merginFile.path == filePath )
-      return merginFile;
+    // keep the first one of duplicate paths, like the linear search does
+    if ( !mFilesIndex.contains( files.at( i ).path ) )
+      mFilesIndex.insert( files.at( i ).path, i );
   }
-  qDebug() << "requested fileInfo() for non-existant file! " << filePath;
-  return MerginFile();
+  mIndexedFiles = files;
 }
 
 MerginConfig MerginConfig::fromJson( const QByteArray &data )
@@ -177,3 +158,205 @@ MerginConfig MerginConfig::fromFile( const QString &filePath )
 
   return config;
 }
+
+MerginProjectMetadataReader::MerginProjectMetadataReader()
+  : mReader( *this )
+{
+}
+
+bool MerginProjectMetadataReader::addData( const QByteArray &data )
+{
+  mData.append( data );
+  return mReader.addData( data );
+}
+
+MerginProjectMetadata MerginProjectMetadataReader::metadata()
+{
+  if ( !mFinished )
+  {
+    mReader.finish();
+    mFinished = true;
+  }
+
+  if ( mReader.hasError() || !mIsObject )
+  {
+    qDebug() << "MerginProjectMetadata::fromJson: invalid content!" << mReader.errorString();
+    return MerginProjectMetadata();
+  }
+
+  MerginProjectMetadata project = mMetadata;
+  QString versionStr = mVersion;
+  if ( versionStr.isEmpty() )
+  {
+    project.version = 0;
+  }
+  else if ( versionStr.startsWith( "v" ) ) // cut off 'v' part from v123
+  {
+    versionStr = versionStr.mid( 1 );
+    project.version = versionStr.toInt();
+  }
+  project.buildFilesIndex();
+  return project;
+}
+
+void MerginProjectMetadataReader::startObject()
+{
+  const Context context = childContext( true );
+  mContexts.append( context );
+
+  if ( context == Root )
+  {
+    mIsObject = true;
+  }
+  else if ( context == File )
+  {
+    mFile = MerginFile();
+    mFile.size = 0;
+    mFile.diffSize = 0;
+    mHistory.clear();
+  }
+}
+
+void MerginProjectMetadataReader::endObject()
+{
+  if ( mContexts.takeLast() == File )
+    finishFile();
+}
+
+void MerginProjectMetadataReader::startArray()
+{
+  mContexts.append( childContext( false ) );
+}
+
+void MerginProjectMetadataReader::endArray()
+{
+  mContexts.removeLast();
+}
+
+void MerginProjectMetadataReader::key( const QString &name )
+{
+  mKey = name;
+
+  if ( mContexts.last() == History )
+  {
+    // every version in the history counts, the ones without a diff too
+    HistoryEntry entry;
+    entry.version = name.mid( 1 ).toInt();
+    mHistory.append( entry );
+  }
+  else if ( mContexts.last() == HistoryItem && name == QLatin1String( "diff" ) )
+  {
+    mHistory.last().hasDiff = true;
+  }
+}
+
+void MerginProjectMetadataReader::value( const QJsonValue &value )
+{
+  if ( mContexts.isEmpty() )
+    return;
+
+  switch ( mContexts.last() )
+  {
+    case Root:
+      if ( mKey == QLatin1String( "name" ) )
+        mMetadata.name = value.toString();
+      else if ( mKey == QLatin1String( "namespace" ) )
+        mMetadata.projectNamespace = value.toString();
+      else if ( mKey == QLatin1String( "version" ) )
+        mVersion = value.toString();
+      break;
+
+    case File:
+      if ( mKey == QLatin1String( "path" ) )
+        mFile.path = value.toString();
+      else if ( mKey == QLatin1String( "checksum" ) )
+        mFile.checksum = value.toString();
+      else if ( mKey == QLatin1String( "size" ) )
+        mFile.size = value.toVariant().toLongLong();  // toInt() would give zero for files of 2 GB and more
+      else if ( mKey == QLatin1String( "mtime" ) )
+        mFile.mtime = QDateTime::fromString( value.toString(), Qt::ISODateWithMs ).toUTC();
+      break;
+
+    case Diff:
+      if ( mKey == QLatin1String( "size" ) )
+        mHistory.last().diffSize = value.toVariant().toLongLong();
+      break;
+
+    case WritersNames:
+      mMetadata.writersnames.append( value.toString() );
+      break;
+
+    default:
+      break;
+  }
+}
+
+MerginProjectMetadataReader::Context MerginProjectMetadataReader::childContext( bool isObject ) const
+{
+  if ( mContexts.isEmpty() )
+    return isObject ? Root : Other;
+
+  // keys are only meaningful in objects - contexts of arrays do not look at them
+  switch ( mContexts.last() )
+  {
+    case Root:
+      if ( !isObject && mKey == QLatin1String( "files" ) )
+        return Files;
+      if ( isObject && mKey == QLatin1String( "access" ) )
+        return Access;
+      break;
+    case Files:
+      if ( isObject )
+        return File;
+      break;
+    case File:
+      if ( isObject && mKey == QLatin1String( "history" ) )
+        return History;
+      break;
+    case History:
+      if ( isObject )
+        return HistoryItem;
+      break;
+    case HistoryItem:
+      if ( isObject && mKey == QLatin1String( "diff" ) )
+        return Diff;
+      break;
+    case Access:
+      if ( !isObject && mKey == QLatin1String( "writersnames" ) )
+        return WritersNames;
+      break;
+    default:
+      break;
+  }
+  return Other;
+}
+
+void MerginProjectMetadataReader::finishFile()
+{
+  // see MerginFile::fromJsonObject() - diffs can be used if the whole history since our version has them
+  if ( !mHistory.isEmpty() )
+  {
+    // the server sends the history ordered by versions, it only needs to be sorted if it is not
+    auto byVersion = []( const HistoryEntry & a, const HistoryEntry & b ) { return a.version < b.version; };
+    if ( !std::is_sorted( mHistory.constBegin(), mHistory.constEnd(), byVersion ) )
+      std::sort( mHistory.begin(), mHistory.end(), byVersion );
+
+    mFile.pullCanUseDiff = true;
+    for ( const HistoryEntry &entry : qAsConst( mHistory ) )
+    {
+      if ( entry.hasDiff )
+      {
+        mFile.pullDiffFiles << qMakePair( entry.version, entry.diffSize );
+      }
+      else
+      {
+        // bad luck - a full file upload was done - we can't apply diffs
+        mFile.pullDiffFiles.clear();
+        mFile.pullCanUseDiff = false;
+        break;
+      }
+    }
+  }
+
+  mMetadata.files << mFile;
+}
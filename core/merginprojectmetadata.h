@@ -11,8 +11,12 @@
 #define MERGINPROJECTMETADATA_H
 
 #include <QDateTime>
+#include <QHash>
 #include <QList>
 #include <QJsonObject>
+#include <QVector>
+
+#include "jsonstreamreader.h"
 
 struct MerginFile
 {
@@ -21,6 +25,7 @@ struct MerginFile
   qint64 size;
   QDateTime mtime;
   QStringList chunks; // used only for upload otherwise suppose to be empty
+  QList<qint64> chunkSizes; //!< sizes of content-defined chunks (see ContentChunker), empty if the chunks are of MerginApi's upload chunk size
 
   //
   // these are members only used for upload of changed file through a geo-diff
@@ -37,7 +42,7 @@ struct MerginFile
   //
 
   bool pullCanUseDiff = false;  //!< whether or not we can update the local file by downloading and applying diffs
-  QList< QPair<int, int> > pullDiffFiles;   //!< list of diffs that will need to be fetched: the version and their sizes
+  QList< QPair<int, qint64> > pullDiffFiles;   //!< list of diffs that will need to be fetched: the version and their sizes
 
   static MerginFile fromJsonObject( const QJsonObject &merginFileInfo );
 };
@@ -67,11 +72,97 @@ struct MerginProjectMetadata
 
   bool isValid() const { return !name.isEmpty() && !projectNamespace.isEmpty(); }
 
+  //! Parses metadata of the project (see MerginProjectMetadataReader), invalid metadata are returned if the content is not valid
   static MerginProjectMetadata fromJson( const QByteArray &data );
 
+  //! Returns metadata of the local file (.mergin/mergin.json), kept by ProjectMetadataStore while the file does not change
   static MerginProjectMetadata fromCachedJson( const QString &metadataFilePath );
 
+  //! Returns file of given path (looked up in the index of files), an empty file if there is no such file
   MerginFile fileInfo( const QString &filePath ) const;
+
+  //! Returns index of the file of given path in files, -1 if there is no such file
+  int fileIndex( const QString &filePath ) const;
+
+  /**
+   * Builds the index of files by their paths. Lookups never modify the metadata, so copies can be
+   * used from several threads. Once files are changed, lookups search them linearly until the index is built again.
+   */
+  void buildFilesIndex();
+
+  private:
+    QHash<QString, int> mFilesIndex;  //!< file path -> index in files
+    QList<MerginFile> mIndexedFiles;  //!< files the index has been built for, shares data with files until they are changed
+};
+
+/**
+ * Builds MerginProjectMetadata from project info JSON passed in parts as it arrives (e.g. from a network reply),
+ * without building the document of the whole content first (see JsonStreamReader). Files are built directly
+ * from the stream, their history is read in the order the server sends it (sorted only if it is not in order).
+ *
+ * The content read is kept too - project info is stored as received to .mergin/mergin.json.
+ */
+class MerginProjectMetadataReader : private JsonStreamReader::Handler
+{
+  public:
+    MerginProjectMetadataReader();
+    Q_DISABLE_COPY( MerginProjectMetadataReader )
+
+    //! Reads the next part of the content. Returns false if the content is not valid JSON
+    bool addData( const QByteArray &data );
+
+    //! Finishes reading and returns the metadata - invalid metadata if the content has not been a valid JSON object
+    MerginProjectMetadata metadata();
+
+    //! Returns the content read so far
+    QByteArray data() const { return mData; }
+
+  private:
+    //! Parts of the content being read
+    enum Context
+    {
+      Other,
+      Root,
+      Files,
+      File,
+      History,
+      HistoryItem,   //!< object of one version in the history
+      Diff,
+      Access,
+      WritersNames,
+    };
+
+    struct HistoryEntry
+    {
+      int version = 0;
+      bool hasDiff = false;
+      qint64 diffSize = 0;
+    };
+
+    void startObject() override;
+    void endObject() override;
+    void startArray() override;
+    void endArray() override;
+    void key( const QString &name ) override;
+    void value( const QJsonValue &value ) override;
+
+    //! Returns context of the object or array that starts in the current context
+    Context childContext( bool isObject ) const;
+
+    //! Sets diffs to be pulled for the file from its history (like MerginFile::fromJsonObject()) and adds the file
+    void finishFile();
+
+    JsonStreamReader mReader;
+    QByteArray mData;
+    QVector<Context> mContexts;  //!< contexts of the objects and arrays being read
+    QString mKey;                //!< key of the next value of the current object
+    bool mIsObject = false;      //!< the content is an object
+    bool mFinished = false;
+
+    MerginProjectMetadata mMetadata;
+    QString mVersion;
+    MerginFile mFile;              //!< file being read
+    QList<HistoryEntry> mHistory;  //!< history of the file being read
 };
 
 
@@ -8,6 +8,7 @@
  ***************************************************************************/
 
 #include "merginprojectstatusmodel.h"
+#include "changesetsession.h"
 #include "geodiffutils.h"
 #include "coreutils.h"
 
@@ -73,7 +74,7 @@ void MerginProjectStatusModel::insertIntoItems( const QSet<QString> &files, cons
   }
 }
 
-void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir )
+void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir, ChangesetSession &changesets )
 {
   beginResetModel();
   mItems.clear();
@@ -82,42 +83,45 @@ void MerginProjectStatusModel::infoProjectUpdated( const ProjectDiff &projectDif
   insertIntoItems( projectDiff.localAdded, ProjectChangelogStatus::Added, projectDir );
   insertIntoItems( projectDiff.localDeleted, ProjectChangelogStatus::Deleted, projectDir );
 
+  QStringList diffableFiles;
   for ( const QString &file : projectDiff.localUpdated )
   {
     if ( MerginApi::isFileDiffable( file ) )
+      diffableFiles << file;
+  }
+  changesets.prepare( diffableFiles );
+
+  for ( const QString &file : qAsConst( diffableFiles ) )
+  {
+    const ChangesetSession::Changeset changeset = changesets.changeset( file );
+    if ( !changeset.isValid() )
     {
-      QString summaryJson = GeodiffUtils::diffableFilePendingChanges( projectDir, file, true );
-      if ( summaryJson.startsWith( "ERROR" ) )
-      {
-        CoreUtils::log( "MerginProjectStatusModel", QString( "Diff summary JSON for %1 in %2 has an error." ).arg( projectDir ).arg( file ) );
+      CoreUtils::log( "MerginProjectStatusModel", QString( "Diff summary for %1 in %2 has an error." ).arg( projectDir ).arg( file ) );
 
+      ProjectStatusItem item;
+      item.status = ProjectChangelogStatus::Message;
+      item.text =  tr( "Failed to determine changes" );
+      item.filename = file;
+      item.section = file;
+
+      mItems.append( item );
+    }
+    else
+    {
+      const GeodiffUtils::ChangesetSummary &summary = changeset.summary;
+      for ( auto it = summary.constBegin(); it != summary.constEnd(); ++it )
+      {
         ProjectStatusItem item;
-        item.status = ProjectChangelogStatus::Message;
-        item.text =  tr( "Failed to determine changes" );
+        item.status = ProjectChangelogStatus::Changelog;
+        item.text =  it.key();
         item.filename = file;
+        item.inserts = it->inserts;
+        item.updates = it->updates;
+        item.deletes = it->deletes;
         item.section = file;
 
         mItems.append( item );
       }
-      else
-      {
-        GeodiffUtils::ChangesetSummary summary = GeodiffUtils::parseChangesetSummary( summaryJson ) ;
-        for ( QString key : summary.keys() )
-        {
-
-          ProjectStatusItem item;
-          item.status = ProjectChangelogStatus::Changelog;
-          item.text =  key;
-          item.filename = file;
-          item.inserts = summary[key].inserts;
-          item.updates = summary[key].updates;
-          item.deletes = summary[key].deletes;
-          item.section = file;
-
-          mItems.append( item );
-        }
-
-      }
     }
   }
   endResetModel();
@@ -128,12 +132,14 @@ bool MerginProjectStatusModel::loadProjectInfo( const QString &projectFullName )
   LocalProject projectInfo = mLocalProjects.projectFromMerginName( projectFullName );
   if ( !projectInfo.projectDir.isEmpty() )
   {
-    ProjectDiff diff = MerginApi::localProjectChanges( projectInfo.projectDir );
+    // GeoPackages are diffed once - to find out whether they have changed and for the summary of their changes
+    ChangesetSession changesets( projectInfo.projectDir );
+    ProjectDiff diff = MerginApi::localProjectChanges( projectInfo.projectDir, &changesets );
 
     bool hasLocalChanges = !diff.localAdded.isEmpty() || !diff.localUpdated.isEmpty() || !diff.localDeleted.isEmpty();
 
     if ( hasLocalChanges )
-      infoProjectUpdated( diff, projectInfo.projectDir );
+      infoProjectUpdated( diff, projectInfo.projectDir, changesets );
 
     return hasLocalChanges;
   }
@@ -14,6 +14,8 @@
 #include <QAbstractListModel>
 #include "merginapi.h"
 
+class ChangesetSession;
+
 class MerginProjectStatusModel : public QAbstractListModel
 {
     Q_OBJECT
@@ -63,7 +65,8 @@ class MerginProjectStatusModel : public QAbstractListModel
 
   private:
     void insertIntoItems( const QSet<QString> &files, const ProjectChangelogStatus &status, const QString &projectDir );
-    void infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir );
+    //! Fills the items with the changes, summaries of GeoPackages are taken from their changesets
+    void infoProjectUpdated( const ProjectDiff &projectDiff, const QString &projectDir, ChangesetSession &changesets );
 
     ProjectDiff mProjectDiff;
     QList<ProjectStatusItem> mItems;
@@ -10,6 +10,7 @@
 #include "project.h"
 #include "merginapi.h"
 #include "coreutils.h"
+#include "projectchangetracker.h"
 
 QString LocalProject::id() const
 {
@@ -51,7 +52,7 @@ MerginProject *MerginProject::clone() const
   return me;
 }
 
-ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Project> project )
+ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Project> project, ProjectChangeTracker *tracker )
 {
   if ( !project || !project->isMergin() || !project->isLocal() ) // This is not a Mergin project or not downloaded project
     return ProjectStatus::NoVersion;
@@ -63,20 +64,18 @@ ProjectStatus::Status ProjectStatus::projectStatus( const std::shared_ptr<Projec
   }
 
   // Something has locally changed after last sync with server
-  QString metadataFilePath = project->local->projectDir + "/" + MerginApi::sMetadataFile;
-  QDateTime lastModified = CoreUtils::getLastModifiedFileDateTime( project->local->projectDir );
-  QDateTime lastSync = QFileInfo( metadataFilePath ).lastModified().toUTC();
-  MerginProjectMetadata meta = MerginProjectMetadata::fromCachedJson( metadataFilePath );
-  int filesCount = CoreUtils::getProjectFilesCount( project->local->projectDir );
-  if ( lastSync < lastModified || meta.files.count() != filesCount )
-  {
-    // When GPKG is opened, its header is updated and therefore lastModified timestamp is updated as well.
-    // Double check if there is really something to upload
-    ProjectDiff diff = MerginApi::localProjectChanges( project->local->projectDir );
+  bool modified = tracker ? tracker->hasLocalChanges( project->local->projectDir )
+                  : ProjectChangeTracker::scanLocalChanges( project->local->projectDir );
+  return projectStatusWithChanges( project, modified );
+}
 
-    if ( !diff.localAdded.isEmpty() || !diff.localUpdated.isEmpty() || !diff.localDeleted.isEmpty() )
-      return ProjectStatus::Modified;
-  }
+ProjectStatus::Status ProjectStatus::projectStatusWithChanges( const std::shared_ptr<Project> project, bool hasLocalChanges )
+{
+  if ( !project || !project->isMergin() || !project->isLocal() || project->local->localVersion < 0 )
+    return ProjectStatus::NoVersion;
+
+  if ( hasLocalChanges )
+    return ProjectStatus::Modified;
 
   // Version is lower than latest one, last sync also before updated
   if ( project->local->localVersion < project->mergin->serverVersion )
@@ -16,6 +16,7 @@
 #include <memory>
 
 struct Project;
+class ProjectChangeTracker;
 
 namespace ProjectStatus
 {
@@ -30,8 +31,14 @@ namespace ProjectStatus
   };
   Q_ENUM_NS( Status )
 
-  //! Returns project state from ProjectStatus::Status enum for the project
-  Status projectStatus( const std::shared_ptr<Project> project );
+  /**
+   * Returns project state from ProjectStatus::Status enum for the project.
+   * Local changes are looked up by the \a tracker if given, otherwise the whole project is scanned.
+   */
+  Status projectStatus( const std::shared_ptr<Project> project, ProjectChangeTracker *tracker = nullptr );
+
+  //! Returns project state for the project whose local changes are known already (e.g. scanned in the background)
+  Status projectStatusWithChanges( const std::shared_ptr<Project> project, bool hasLocalChanges );
 }
 
 /**
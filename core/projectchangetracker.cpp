@@ -0,0 +1,401 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "projectchangetracker.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+
+#include "coreutils.h"
+#include "geodiffutils.h"
+#include "merginapi.h"
+
+ProjectChangeTracker::ProjectChangeTracker( QObject *parent )
+  : QObject( parent )
+{
+  connect( &mWatcher, &QFileSystemWatcher::directoryChanged, this, &ProjectChangeTracker::onDirectoryChanged );
+  connect( &mWatcher, &QFileSystemWatcher::fileChanged, this, &ProjectChangeTracker::onFileChanged );
+}
+
+bool ProjectChangeTracker::hasLocalChanges( const QString &projectDir )
+{
+  ProjectState &state = mProjects[projectDir];
+
+  if ( !state.baselineKnown )
+  {
+    quint64 number = startFullScan( projectDir );
+    QStringList modifiedPaths;
+    bool modified = scanLocalChanges( projectDir, &modifiedPaths );
+    finishFullScan( projectDir, number, modifiedPaths );
+    return modified;
+  }
+
+  if ( state.dirtyFiles.isEmpty() && state.dirtyDirs.isEmpty() )
+    return false;
+
+  quint64 number = snapshot();
+  QStringList modifiedPaths = checkDirtyPaths( projectDir, state );
+  setBaseline( projectDir, number, modifiedPaths );
+  return !modifiedPaths.isEmpty();
+}
+
+quint64 ProjectChangeTracker::startFullScan( const QString &projectDir )
+{
+  ProjectState &state = mProjects[projectDir];
+
+  // watch first - changes made while the project is being scanned must not be missed
+  if ( !state.watched && !state.unwatchable )
+  {
+    if ( watchDirectory( state, projectDir, QString(), false ) )
+    {
+      state.watched = true;
+    }
+    else
+    {
+      CoreUtils::log( "change tracker", QStringLiteral( "Out of file watchers, %1 will be scanned whole" ).arg( projectDir ) );
+      unwatchProject( projectDir, state );
+      state.unwatchable = true;
+    }
+  }
+
+  return snapshot();
+}
+
+void ProjectChangeTracker::finishFullScan( const QString &projectDir, quint64 snapshot, const QStringList &modifiedPaths )
+{
+  ++mFullScans;
+  setBaseline( projectDir, snapshot, modifiedPaths );
+}
+
+void ProjectChangeTracker::setBaseline( const QString &projectDir, quint64 snapshot, const QStringList &modifiedPaths )
+{
+  auto it = mProjects.find( projectDir );
+  if ( it == mProjects.end() || !it->watched )
+    return;
+
+  for ( auto fileIt = it->dirtyFiles.begin(); fileIt != it->dirtyFiles.end(); )
+  {
+    if ( fileIt.value() <= snapshot )
+      fileIt = it->dirtyFiles.erase( fileIt );
+    else
+      ++fileIt;
+  }
+  for ( auto dirIt = it->dirtyDirs.begin(); dirIt != it->dirtyDirs.end(); )
+  {
+    if ( dirIt.value() <= snapshot )
+      dirIt = it->dirtyDirs.erase( dirIt );
+    else
+      ++dirIt;
+  }
+
+  // modified files stay dirty until they match the metadata again
+  for ( const QString &path : modifiedPaths )
+  {
+    if ( !it->dirtyFiles.contains( path ) )
+      it->dirtyFiles.insert( path, snapshot );
+  }
+
+  it->baselineKnown = true;
+}
+
+void ProjectChangeTracker::notifyFileChanged( const QString &filePath )
+{
+  QString projectDir = projectDirForPath( filePath );
+  if ( projectDir.isEmpty() || filePath.size() <= projectDir.size() )
+    return;
+
+  QString path = trackedPath( filePath.mid( projectDir.size() + 1 ) );
+  if ( !path.isEmpty() )
+    markFileDirty( mProjects[projectDir], path );
+}
+
+void ProjectChangeTracker::forgetProject( const QString &projectDir )
+{
+  auto it = mProjects.find( projectDir );
+  if ( it == mProjects.end() )
+    return;
+
+  unwatchProject( projectDir, *it );
+  mProjects.erase( it );
+}
+
+void ProjectChangeTracker::forgetAll()
+{
+  const QStringList paths = mWatcher.files() + mWatcher.directories();
+  if ( !paths.isEmpty() )
+    mWatcher.removePaths( paths );
+  mProjects.clear();
+}
+
+bool ProjectChangeTracker::isBaselineKnown( const QString &projectDir ) const
+{
+  return mProjects.value( projectDir ).baselineKnown;
+}
+
+QStringList ProjectChangeTracker::dirtyFiles( const QString &projectDir ) const
+{
+  return mProjects.value( projectDir ).dirtyFiles.keys();
+}
+
+QStringList ProjectChangeTracker::dirtyDirectories( const QString &projectDir ) const
+{
+  return mProjects.value( projectDir ).dirtyDirs.keys();
+}
+
+int ProjectChangeTracker::watchedPathsCount() const
+{
+  return mWatcher.files().count() + mWatcher.directories().count();
+}
+
+bool ProjectChangeTracker::scanLocalChanges( const QString &projectDir, QStringList *modifiedPaths )
+{
+  // Something has locally changed after last sync with server
+  QString metadataFilePath = projectDir + "/" + MerginApi::sMetadataFile;
+  QDateTime lastModified = CoreUtils::getLastModifiedFileDateTime( projectDir );
+  QDateTime lastSync = QFileInfo( metadataFilePath ).lastModified().toUTC();
+  MerginProjectMetadata meta = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  int filesCount = CoreUtils::getProjectFilesCount( projectDir );
+  if ( lastSync < lastModified || meta.files.count() != filesCount )
+  {
+    // When GPKG is opened, its header is updated and therefore lastModified timestamp is updated as well.
+    // Double check if there is really something to upload
+    ProjectDiff diff = MerginApi::localProjectChanges( projectDir );
+
+    if ( !diff.localAdded.isEmpty() || !diff.localUpdated.isEmpty() || !diff.localDeleted.isEmpty() )
+    {
+      if ( modifiedPaths )
+        *modifiedPaths << diff.localAdded.values() << diff.localUpdated.values() << diff.localDeleted.values();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ProjectChangeTracker::onDirectoryChanged( const QString &path )
+{
+  QString projectDir = projectDirForPath( path );
+  if ( projectDir.isEmpty() )
+    return;
+
+  ProjectState &state = mProjects[projectDir];
+  QString relativePath = path == projectDir ? QString() : path.mid( projectDir.size() + 1 );
+  markDirectoryDirty( state, relativePath );
+
+  // files and subdirectories created in the directory need to be watched too
+  if ( QFileInfo( path ).isDir() && !watchDirectory( state, projectDir, relativePath, true ) )
+  {
+    CoreUtils::log( "change tracker", QStringLiteral( "Out of file watchers, %1 will be scanned whole" ).arg( projectDir ) );
+    unwatchProject( projectDir, state );
+    state.unwatchable = true;
+  }
+}
+
+void ProjectChangeTracker::onFileChanged( const QString &path )
+{
+  QString projectDir = projectDirForPath( path );
+  if ( projectDir.isEmpty() )
+    return;
+
+  QString relativePath = trackedPath( path.mid( projectDir.size() + 1 ) );
+  if ( !relativePath.isEmpty() )
+    markFileDirty( mProjects[projectDir], relativePath );
+
+  // a file replaced by a rename (e.g. saved with QSaveFile) is not watched anymore
+  if ( QFileInfo( path ).isFile() && !mWatcher.files().contains( path ) )
+    mWatcher.addPath( path );
+}
+
+QString ProjectChangeTracker::projectDirForPath( const QString &path ) const
+{
+  for ( auto it = mProjects.constBegin(); it != mProjects.constEnd(); ++it )
+  {
+    if ( !it->watched )
+      continue;
+
+    const QString &projectDir = it.key();
+    if ( path == projectDir || ( path.startsWith( projectDir ) && path.at( projectDir.size() ) == '/' ) )
+      return projectDir;
+  }
+  return QString();
+}
+
+bool ProjectChangeTracker::watchDirectory( ProjectState &state, const QString &projectDir, const QString &relativePath, bool markNewDirty )
+{
+  const QStringList watchedFiles = mWatcher.files();
+  const QStringList watchedDirs = mWatcher.directories();
+  QSet<QString> watched( watchedFiles.begin(), watchedFiles.end() );
+  watched.unite( QSet<QString>( watchedDirs.begin(), watchedDirs.end() ) );
+  int available = mMaxWatchedPaths - watched.count();
+
+  QStringList newPaths;
+  QStringList pending;
+  pending << relativePath;
+  while ( !pending.isEmpty() )
+  {
+    QString dirRelativePath = pending.takeLast();
+    QString dirPath = dirRelativePath.isEmpty() ? projectDir : projectDir + "/" + dirRelativePath;
+    if ( !watched.contains( dirPath ) )
+      newPaths << dirPath;
+
+    // hidden entries (e.g. .mergin directory) are not part of the project, like in MerginApi::listFiles()
+    const QFileInfoList entries = QDir( dirPath ).entryInfoList( QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot );
+    for ( const QFileInfo &info : entries )
+    {
+      QString entryRelativePath = dirRelativePath.isEmpty() ? info.fileName() : dirRelativePath + "/" + info.fileName();
+      if ( info.isDir() )
+      {
+        // watched subdirectories have their own watches, symlinks could make a cycle
+        if ( info.isSymLink() || watched.contains( info.filePath() ) )
+          continue;
+        if ( markNewDirty )
+          markDirectoryDirty( state, entryRelativePath );
+        pending << entryRelativePath;
+      }
+      else if ( !trackedPath( entryRelativePath ).isEmpty() && !watched.contains( info.filePath() ) )
+      {
+        newPaths << info.filePath();
+      }
+    }
+
+    if ( newPaths.count() > available )
+      return false;
+  }
+
+  if ( newPaths.isEmpty() )
+    return true;
+
+  return mWatcher.addPaths( newPaths ).isEmpty();
+}
+
+void ProjectChangeTracker::unwatchProject( const QString &projectDir, ProjectState &state )
+{
+  QStringList paths;
+  const QStringList watchedPaths = mWatcher.files() + mWatcher.directories();
+  for ( const QString &path : watchedPaths )
+  {
+    if ( path == projectDir || path.startsWith( projectDir + "/" ) )
+      paths << path;
+  }
+  if ( !paths.isEmpty() )
+    mWatcher.removePaths( paths );
+
+  state.watched = false;
+  state.baselineKnown = false;
+  state.dirtyFiles.clear();
+  state.dirtyDirs.clear();
+}
+
+void ProjectChangeTracker::markFileDirty( ProjectState &state, const QString &relativePath )
+{
+  if ( state.watched )
+    state.dirtyFiles.insert( relativePath, ++mChangeNumber );
+}
+
+void ProjectChangeTracker::markDirectoryDirty( ProjectState &state, const QString &relativePath )
+{
+  if ( state.watched )
+    state.dirtyDirs.insert( relativePath, ++mChangeNumber );
+}
+
+QStringList ProjectChangeTracker::checkDirtyPaths( const QString &projectDir, ProjectState &state )
+{
+  loadMetadata( projectDir, state );
+  MerginConfig config = MerginConfig::fromFile( projectDir + "/" + MerginApi::sMerginConfigFile );
+
+  QSet<QString> paths;
+  for ( auto it = state.dirtyFiles.constBegin(); it != state.dirtyFiles.constEnd(); ++it )
+    paths << it.key();
+
+  // files added to or removed from the directories
+  for ( auto it = state.dirtyDirs.constBegin(); it != state.dirtyDirs.constEnd(); ++it )
+  {
+    const QString &dirRelativePath = it.key();
+    const QStringList entries = QDir( dirRelativePath.isEmpty() ? projectDir : projectDir + "/" + dirRelativePath ).entryList( QDir::Files );
+    for ( const QString &entry : entries )
+    {
+      QString path = trackedPath( dirRelativePath.isEmpty() ? entry : dirRelativePath + "/" + entry );
+      if ( !path.isEmpty() )
+        paths << path;
+    }
+    for ( const QString &path : state.serverFilesByDir.value( dirRelativePath ) )
+      paths << path;
+  }
+
+  QStringList modifiedPaths;
+  for ( const QString &path : qAsConst( paths ) )
+  {
+    if ( isFileModified( projectDir, path, state.serverFiles, config ) )
+      modifiedPaths << path;
+  }
+  return modifiedPaths;
+}
+
+void ProjectChangeTracker::loadMetadata( const QString &projectDir, ProjectState &state )
+{
+  QString metadataFilePath = projectDir + "/" + MerginApi::sMetadataFile;
+  QFileInfo info( metadataFilePath );
+  qint64 size = info.exists() ? info.size() : -1;
+  qint64 mtime = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+  if ( size == state.metadataSize && mtime == state.metadataMTime )
+    return;
+
+  state.serverFiles.clear();
+  state.serverFilesByDir.clear();
+  const MerginProjectMetadata metadata = MerginProjectMetadata::fromCachedJson( metadataFilePath );
+  for ( const MerginFile &file : metadata.files )
+  {
+    state.serverFiles.insert( file.path, file );
+    state.serverFilesByDir[file.path.section( '/', 0, -2 )] << file.path;
+  }
+  state.metadataSize = size;
+  state.metadataMTime = mtime;
+}
+
+bool ProjectChangeTracker::isFileModified( const QString &projectDir, const QString &relativePath, const QHash<QString, MerginFile> &serverFiles, const MerginConfig &config )
+{
+  if ( config.isValid && MerginApi::excludeFromSync( relativePath, config ) )
+    return false;
+
+  QString filePath = projectDir + "/" + relativePath;
+  QFileInfo info( filePath );
+  auto it = serverFiles.constFind( relativePath );
+
+  if ( !info.isFile() )
+    return it != serverFiles.constEnd();  // removed
+  if ( it == serverFiles.constEnd() )
+    return true;  // added
+
+  // changes of a GeoPackage may be only in its "-wal" file yet, the file itself is not checkpointed here
+  // (status checks must not write) - the diff below reads the changes from the "-wal" file
+  const bool hasWal = QFileInfo( filePath + "-wal" ).size() > 0;
+  if ( !hasWal && info.size() == it->size && MerginApi::getChecksum( filePath ) == it->checksum.toLatin1() )
+    return false;
+
+  // the real content of a GeoPackage may be the same although the checksums do not match
+  if ( MerginApi::isFileDiffable( relativePath ) )
+    return GeodiffUtils::hasPendingChanges( projectDir, relativePath );
+
+  return true;
+}
+
+QString ProjectChangeTracker::trackedPath( const QString &relativePath )
+{
+  // the "-wal" file holds recent changes of its GeoPackage, the "-shm" file changes even on reads
+  if ( relativePath.endsWith( QStringLiteral( "-wal" ) ) )
+    return relativePath.chopped( 4 );
+  if ( relativePath.endsWith( QStringLiteral( "-shm" ) ) )
+    return QString();
+
+  if ( MerginApi::isInIgnore( QFileInfo( relativePath ) ) )
+    return QString();
+
+  return relativePath;
+}
@@ -0,0 +1,160 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PROJECTCHANGETRACKER_H
+#define PROJECTCHANGETRACKER_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "merginprojectmetadata.h"
+
+/**
+ * Keeps track of local changes of Mergin projects, so that finding out whether a project has local changes
+ * does not need to read the whole project directory each time.
+ *
+ * The first check of a project scans the whole project (like before) and sets the baseline - the files
+ * that differ from the project's metadata (mergin.json) at that time. From then on, changes are recorded by
+ * a file system watcher (and by the app for files it writes, see notifyFileChanged()) as dirty files and
+ * directories, and later checks only compare the dirty paths with the metadata.
+ *
+ * Watchers are a limited resource - a project that does not fit into maxWatchedPaths() is not watched and
+ * it is always scanned whole.
+ */
+class ProjectChangeTracker : public QObject
+{
+    Q_OBJECT
+  public:
+    explicit ProjectChangeTracker( QObject *parent = nullptr );
+
+    /**
+     * Returns whether the project has files that differ from its metadata (added, updated or removed files
+     * that would be pushed). Only dirty paths are compared if the baseline of the project is known,
+     * otherwise the whole project is scanned and the baseline is set.
+     */
+    bool hasLocalChanges( const QString &projectDir );
+
+    /**
+     * Returns the number of the last change recorded by the tracker. The number taken before local files are read
+     * is passed to setBaseline() later, so that changes made after the files have been read are not forgotten.
+     */
+    quint64 snapshot() const { return mChangeNumber; }
+
+    /**
+     * Sets the baseline of the project - files in \a modifiedPaths differ from the metadata, other files did not
+     * when \a snapshot was taken. Changes recorded after the snapshot are kept. Called with no paths after a push
+     * (the server has the files read at the time of the snapshot). Ignored for projects that are not watched.
+     */
+    void setBaseline( const QString &projectDir, quint64 snapshot, const QStringList &modifiedPaths = QStringList() );
+
+    /**
+     * Prepares a scan of the whole project that is run by the caller (e.g. on a worker thread, see scanLocalChanges()):
+     * watches the project and returns the snapshot to be passed to finishFullScan() with the result of the scan.
+     */
+    quint64 startFullScan( const QString &projectDir );
+
+    //! Sets the baseline of the project from the result of the scan prepared by startFullScan()
+    void finishFullScan( const QString &projectDir, quint64 snapshot, const QStringList &modifiedPaths );
+
+    //! Records a change of a file (absolute path) written by the app, the watcher may notice it later or not at all
+    void notifyFileChanged( const QString &filePath );
+
+    //! Stops watching the project and forgets its baseline (e.g. the project has been removed)
+    void forgetProject( const QString &projectDir );
+
+    //! Stops watching all projects and forgets their baselines
+    void forgetAll();
+
+    //! Returns whether the baseline of the project is known - only dirty paths get compared on the next check
+    bool isBaselineKnown( const QString &projectDir ) const;
+
+    //! Returns paths of files (relative to the project dir) that need to be compared on the next check
+    QStringList dirtyFiles( const QString &projectDir ) const;
+
+    //! Returns paths of directories (relative to the project dir, empty for the project dir) that need to be compared on the next check
+    QStringList dirtyDirectories( const QString &projectDir ) const;
+
+    //! Returns maximum number of files and directories watched in all projects
+    int maxWatchedPaths() const { return mMaxWatchedPaths; }
+    //! Sets maximum number of files and directories watched in all projects (affects projects watched later)
+    void setMaxWatchedPaths( int count ) { mMaxWatchedPaths = count; }
+
+    //! Returns number of files and directories watched in all projects
+    int watchedPathsCount() const;
+
+    //! Returns number of checks that had to scan the whole project
+    int fullScansCount() const { return mFullScans; }
+
+    /**
+     * Returns whether the project has local changes by scanning the whole project - the check used before
+     * there was the tracker. Paths of files that differ from the metadata are added to \a modifiedPaths
+     * (unless the quick check of modification times and the files count says nothing has changed).
+     */
+    static bool scanLocalChanges( const QString &projectDir, QStringList *modifiedPaths = nullptr );
+
+    static const int DEFAULT_MAX_WATCHED_PATHS = 8192;
+
+  private slots:
+    void onDirectoryChanged( const QString &path );
+    void onFileChanged( const QString &path );
+
+  private:
+    struct ProjectState
+    {
+      bool watched = false;        //!< watches of the project are installed
+      bool unwatchable = false;    //!< the project does not fit into the watchers, it is always scanned whole
+      bool baselineKnown = false;  //!< the project has been checked and its changes are recorded since then
+      QHash<QString, quint64> dirtyFiles;  //!< relative path -> number of the last change
+      QHash<QString, quint64> dirtyDirs;   //!< relative path -> number of the last change
+
+      // metadata of the project, reloaded when mergin.json changes
+      QHash<QString, MerginFile> serverFiles;
+      QHash<QString, QStringList> serverFilesByDir;  //!< relative dir path -> paths of files of the metadata in the dir
+      qint64 metadataSize = -1;
+      qint64 metadataMTime = -1;
+    };
+
+    //! Returns the project directory the absolute path belongs to (empty string if none)
+    QString projectDirForPath( const QString &path ) const;
+
+    /**
+     * Watches the directory (relative to the project dir), its files and subdirectories that are not watched yet.
+     * Subdirectories found are marked dirty if \a markNewDirty is set. Returns false if out of watchers.
+     */
+    bool watchDirectory( ProjectState &state, const QString &projectDir, const QString &relativePath, bool markNewDirty );
+
+    //! Stops watching the project, its changes are not recorded anymore
+    void unwatchProject( const QString &projectDir, ProjectState &state );
+
+    void markFileDirty( ProjectState &state, const QString &relativePath );
+    void markDirectoryDirty( ProjectState &state, const QString &relativePath );
+
+    //! Compares dirty paths with the metadata and returns the paths that differ
+    static QStringList checkDirtyPaths( const QString &projectDir, ProjectState &state );
+
+    //! Reloads the metadata of the project if mergin.json has changed since it has been loaded
+    static void loadMetadata( const QString &projectDir, ProjectState &state );
+
+    //! Returns whether the file differs from its metadata
+    static bool isFileModified( const QString &projectDir, const QString &relativePath, const QHash<QString, MerginFile> &serverFiles, const MerginConfig &config );
+
+    //! Returns path of the file whose changes the file at given relative path stands for (e.g. GeoPackage of a "-wal" file), empty if not tracked
+    static QString trackedPath( const QString &relativePath );
+
+    QFileSystemWatcher mWatcher;
+    QHash<QString, ProjectState> mProjects;  //!< project dir -> state
+    quint64 mChangeNumber = 0;
+    int mMaxWatchedPaths = DEFAULT_MAX_WATCHED_PATHS;
+    int mFullScans = 0;
+};
+
+#endif // PROJECTCHANGETRACKER_H
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "projectmetadatastore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include "coreutils.h"
+
+ProjectMetadataStore &ProjectMetadataStore::instance()
+{
+  static ProjectMetadataStore sInstance;
+  return sInstance;
+}
+
+ProjectMetadataStore::ProjectMetadataStore( int maxCachedFiles )
+{
+  mEntries.setMaxCost( maxCachedFiles );
+}
+
+MerginProjectMetadata ProjectMetadataStore::metadata( const QString &metadataFilePath )
+{
+  const QString key = QDir::cleanPath( metadataFilePath );
+  const ChecksumCache::FileStamp stamp = ChecksumCache::fileStamp( key );
+  if ( !stamp.isValid() )
+  {
+    invalidate( key );
+    return MerginProjectMetadata();
+  }
+
+  {
+    QMutexLocker locker( &mMutex );
+    Entry *entry = mEntries.object( key );
+    if ( entry && entry->stamp == stamp )
+    {
+      ++mMemoryHits;
+      return entry->metadata;
+    }
+  }
+
+  // a file modified within the timestamp resolution could be modified again without changing its stamp
+  const bool racy = QDateTime::currentMSecsSinceEpoch() - stamp.mtime < RACY_INTERVAL_MS;
+
+  MerginProjectMetadata metadata;
+  bool fromCacheFile = !racy && readCacheFile( key, stamp, metadata );
+  if ( !fromCacheFile )
+  {
+    QFile file( key );
+    if ( !file.open( QIODevice::ReadOnly ) )
+      return MerginProjectMetadata();
+    metadata = MerginProjectMetadata::fromJson( file.readAll() );
+
+    if ( !racy && metadata.isValid() )
+      writeCacheFile( key, stamp, metadata );
+  }
+
+  // metadata parsed from JSON are indexed already, the index is then shared by all copies
+  if ( fromCacheFile )
+    metadata.buildFilesIndex();
+
+  QMutexLocker locker( &mMutex );
+  if ( fromCacheFile )
+    ++mCacheFileLoads;
+  else
+    ++mJsonLoads;
+
+  if ( racy )
+  {
+    mEntries.remove( key );
+  }
+  else
+  {
+    Entry *entry = new Entry;
+    entry->stamp = stamp;
+    entry->metadata = metadata;
+    mEntries.insert( key, entry, metadata.files.count() + 1 );
+  }
+  return metadata;
+}
+
+void ProjectMetadataStore::invalidate( const QString &metadataFilePath )
+{
+  QMutexLocker locker( &mMutex );
+  mEntries.remove( QDir::cleanPath( metadataFilePath ) );
+}
+
+void ProjectMetadataStore::clear()
+{
+  QMutexLocker locker( &mMutex );
+  mEntries.clear();
+}
+
+QString ProjectMetadataStore::cacheFilePath( const QString &metadataFilePath )
+{
+  return QDir::cleanPath( metadataFilePath ) + ".cache";
+}
+
+bool ProjectMetadataStore::readCacheFile( const QString &metadataFilePath, const ChecksumCache::FileStamp &stamp, MerginProjectMetadata &metadata )
+{
+  QFile file( cacheFilePath( metadataFilePath ) );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+
+  quint32 version = 0;
+  ChecksumCache::FileStamp cachedStamp;
+  stream >> version;
+  if ( version != CACHE_FILE_VERSION )
+    return false;
+
+  stream >> cachedStamp.size >> cachedStamp.mtime >> cachedStamp.inode;
+  if ( !( cachedStamp == stamp ) )
+    return false;  // the metadata file has been rewritten since
+
+  MerginProjectMetadata cached;
+  qint32 filesCount = 0;
+  stream >> cached.name >> cached.projectNamespace >> cached.writersnames >> cached.version >> filesCount;
+  if ( stream.status() != QDataStream::Ok || filesCount < 0 )
+    return false;
+
+  cached.files.reserve( filesCount );
+  for ( qint32 i = 0; i < filesCount && stream.status() == QDataStream::Ok; ++i )
+  {
+    MerginFile merginFile;
+    bool hasMTime = false;
+    qint64 mtime = 0;
+    stream >> merginFile.path >> merginFile.checksum >> merginFile.size >> hasMTime >> mtime
+           >> merginFile.pullCanUseDiff >> merginFile.pullDiffFiles;
+    if ( hasMTime )
+      merginFile.mtime = QDateTime::fromMSecsSinceEpoch( mtime, Qt::UTC );
+    cached.files << merginFile;
+  }
+
+  if ( stream.status() != QDataStream::Ok )
+  {
+    CoreUtils::log( "metadata store", "Corrupted cache file, ignoring " + file.fileName() );
+    return false;
+  }
+
+  metadata = cached;
+  return true;
+}
+
+bool ProjectMetadataStore::writeCacheFile( const QString &metadataFilePath, const ChecksumCache::FileStamp &stamp, const MerginProjectMetadata &metadata )
+{
+  QSaveFile file( cacheFilePath( metadataFilePath ) );
+  if ( !file.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "metadata store", "Failed to open for writing: " + file.fileName() );
+    return false;
+  }
+
+  QDataStream stream( &file );
+  stream.setVersion( QDataStream::Qt_5_12 );
+  stream << CACHE_FILE_VERSION << stamp.size << stamp.mtime << stamp.inode;
+  stream << metadata.name << metadata.projectNamespace << metadata.writersnames << metadata.version
+         << static_cast<qint32>( metadata.files.count() );
+  for ( const MerginFile &merginFile : metadata.files )
+  {
+    stream << merginFile.path << merginFile.checksum << merginFile.size
+           << merginFile.mtime.isValid() << ( merginFile.mtime.isValid() ? merginFile.mtime.toMSecsSinceEpoch() : Q_INT64_C( 0 ) )
+           << merginFile.pullCanUseDiff << merginFile.pullDiffFiles;
+  }
+
+  if ( !file.commit() )
+  {
+    CoreUtils::log( "metadata store", "Failed to write: " + file.fileName() );
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PROJECTMETADATASTORE_H
+#define PROJECTMETADATASTORE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+#include "checksumcache.h"
+#include "merginprojectmetadata.h"
+
+/**
+ * Shared store of the metadata of local projects (.mergin/mergin.json), used by MerginProjectMetadata::fromCachedJson().
+ *
+ * Metadata are kept in memory while the metadata file stays the same (size, modification time and inode).
+ * The parsed metadata are also written next to the file to a binary cache file, which is much faster to read
+ * than JSON - e.g. when the projects are loaded on start. Files modified very recently are only parsed,
+ * because a later write within the timestamp resolution would not be noticed.
+ *
+ * The store is thread safe. Memory is limited by the total number of files in the cached metadata.
+ */
+class ProjectMetadataStore
+{
+  public:
+    //! Returns the store used by MerginProjectMetadata::fromCachedJson()
+    static ProjectMetadataStore &instance();
+
+    explicit ProjectMetadataStore( int maxCachedFiles = DEFAULT_MAX_CACHED_FILES );
+
+    //! Returns metadata of the file - from memory, from the binary cache file or parsed (invalid metadata if the file cannot be read)
+    MerginProjectMetadata metadata( const QString &metadataFilePath );
+
+    //! Forgets the metadata of the file kept in memory (e.g. the file has been rewritten)
+    void invalidate( const QString &metadataFilePath );
+
+    //! Forgets all metadata kept in memory, the binary cache files stay
+    void clear();
+
+    //! Returns path of the binary cache file of the metadata file
+    static QString cacheFilePath( const QString &metadataFilePath );
+
+    int memoryHits() const { return mMemoryHits; }
+    int cacheFileLoads() const { return mCacheFileLoads; }
+    int jsonLoads() const { return mJsonLoads; }
+
+    static const int DEFAULT_MAX_CACHED_FILES = 200000;
+
+  private:
+    struct Entry
+    {
+      ChecksumCache::FileStamp stamp;
+      MerginProjectMetadata metadata;
+    };
+
+    //! Reads the binary cache file, returns false if it does not exist or it does not belong to the metadata file of the stamp
+    static bool readCacheFile( const QString &metadataFilePath, const ChecksumCache::FileStamp &stamp, MerginProjectMetadata &metadata );
+    static bool writeCacheFile( const QString &metadataFilePath, const ChecksumCache::FileStamp &stamp, const MerginProjectMetadata &metadata );
+
+    QMutex mMutex;
+    QCache<QString, Entry> mEntries;  //!< cleaned metadata file path -> entry, cost is the number of files
+
+    int mMemoryHits = 0;
+    int mCacheFileLoads = 0;
+    int mJsonLoads = 0;
+
+    static const quint32 CACHE_FILE_VERSION = 2;
+    static const qint64 RACY_INTERVAL_MS = 2000;
+};
+
+#endif // PROJECTMETADATASTORE_H
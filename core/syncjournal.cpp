@@ -0,0 +1,104 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "syncjournal.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "coreutils.h"
+
+static const QString VERSION_KEY = QStringLiteral( "journal_version" );
+
+SyncJournal SyncJournal::read( const QString &projectDir, Type type )
+{
+  SyncJournal journal;
+
+  QFile file( journalFilePath( projectDir, type ) );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return journal;
+
+  QJsonDocument headerDoc = QJsonDocument::fromJson( file.readLine() );
+  if ( !headerDoc.isObject() || !headerDoc.object().contains( VERSION_KEY ) )
+  {
+    CoreUtils::log( "sync journal", "Corrupted header, ignoring " + file.fileName() );
+    return journal;
+  }
+
+  qint64 validSize = file.pos();
+  while ( !file.atEnd() )
+  {
+    QByteArray line = file.readLine();
+    QJsonDocument doc = QJsonDocument::fromJson( line );
+    if ( !line.endsWith( '\n' ) || !doc.isObject() )
+      break;  // incomplete last entry - the app has been killed while writing it
+    journal.mEntries << doc.object();
+    validSize = file.pos();
+  }
+
+  // cut off the incomplete entry, entries appended later would be lost otherwise
+  if ( validSize < file.size() )
+  {
+    file.close();
+    QFile::resize( file.fileName(), validSize );
+  }
+
+  journal.mHeader = headerDoc.object();
+  journal.mVersion = journal.mHeader.value( VERSION_KEY ).toInt( -1 );
+  return journal;
+}
+
+bool SyncJournal::start( const QString &projectDir, Type type, int version, const QJsonObject &header )
+{
+  // do not turn a local project into a mergin one just because of the journal
+  if ( !QDir( projectDir + "/.mergin" ).exists() )
+    return false;
+
+  QJsonObject obj = header;
+  obj.insert( VERSION_KEY, version );
+
+  QSaveFile file( journalFilePath( projectDir, type ) );
+  if ( !file.open( QIODevice::WriteOnly ) )
+  {
+    CoreUtils::log( "sync journal", "Failed to open for writing: " + file.fileName() );
+    return false;
+  }
+
+  file.write( QJsonDocument( obj ).toJson( QJsonDocument::Compact ) + '\n' );
+  if ( !file.commit() )
+  {
+    CoreUtils::log( "sync journal", "Failed to write: " + file.fileName() );
+    return false;
+  }
+  return true;
+}
+
+bool SyncJournal::append( const QString &projectDir, Type type, const QJsonObject &entry )
+{
+  QFile file( journalFilePath( projectDir, type ) );
+  if ( !file.exists() || !file.open( QIODevice::Append ) )
+    return false;
+
+  QByteArray line = QJsonDocument( entry ).toJson( QJsonDocument::Compact ) + '\n';
+  return file.write( line ) == line.size();
+}
+
+void SyncJournal::remove( const QString &projectDir, Type type )
+{
+  QString path = journalFilePath( projectDir, type );
+  if ( QFile::exists( path ) && !QFile::remove( path ) )
+    CoreUtils::log( "sync journal", "Failed to remove " + path );
+}
+
+QString SyncJournal::journalFilePath( const QString &projectDir, Type type )
+{
+  return projectDir + ( type == Pull ? "/.mergin/pull.journal" : "/.mergin/push.journal" );
+}
@@ -0,0 +1,67 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCJOURNAL_H
+#define SYNCJOURNAL_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+/**
+ * Persistent journal of a pull or push in progress, stored in the project's .mergin directory,
+ * so that an interrupted transfer (network failure, app killed) can be resumed later.
+ *
+ * The journal is a text file with one JSON object per line. The first line is the header (with the project
+ * version the transfer is based on), each other line is an entry appended once a unit of the transfer
+ * is done - a downloaded item or an acknowledged chunk. Appending keeps the cost of an entry constant
+ * and a partially written last line (app killed while writing it) is cut off when the journal is read.
+ */
+class SyncJournal
+{
+  public:
+    enum Type
+    {
+      Pull,
+      Push
+    };
+
+    //! Reads the journal of the project (invalid journal is returned if there is none or its header is corrupted)
+    static SyncJournal read( const QString &projectDir, Type type );
+
+    //! Starts a new journal of the project based on given version, the previous journal of the type is replaced
+    static bool start( const QString &projectDir, Type type, int version, const QJsonObject &header = QJsonObject() );
+
+    //! Appends entry to the journal of the project. Returns false if there is no journal or it cannot be written
+    static bool append( const QString &projectDir, Type type, const QJsonObject &entry );
+
+    //! Removes the journal of the project
+    static void remove( const QString &projectDir, Type type );
+
+    //! Returns path of the journal file of the project in given directory
+    static QString journalFilePath( const QString &projectDir, Type type );
+
+    bool isValid() const { return mVersion >= 0; }
+
+    //! Project version the journaled transfer is based on (target version of a pull, server version of a push)
+    int version() const { return mVersion; }
+
+    //! Data stored with the journal when it has been started
+    QJsonObject header() const { return mHeader; }
+
+    //! Entries appended to the journal (in order)
+    QList<QJsonObject> entries() const { return mEntries; }
+
+  private:
+    int mVersion = -1;
+    QJsonObject mHeader;
+    QList<QJsonObject> mEntries;
+};
+
+#endif // SYNCJOURNAL_H
@@ -0,0 +1,180 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "syncscheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+SyncScheduler::SyncScheduler()
+{
+  mClock.start();
+}
+
+int SyncScheduler::maxActiveTransfers() const
+{
+  return mMaxActiveTransfers;
+}
+
+void SyncScheduler::setMaxActiveTransfers( int count )
+{
+  mMaxActiveTransfers = qMax( 1, count );
+  startQueued();
+}
+
+QString SyncScheduler::preferredProject() const
+{
+  return mPreferredProject;
+}
+
+void SyncScheduler::setPreferredProject( const QString &projectFullName )
+{
+  mPreferredProject = projectFullName;
+}
+
+int SyncScheduler::maxQueueWait() const
+{
+  return mMaxQueueWait;
+}
+
+void SyncScheduler::setMaxQueueWait( int msecs )
+{
+  mMaxQueueWait = qMax( 0, msecs );
+}
+
+bool SyncScheduler::requestTransfer( const QString &projectFullName, qint64 size, const std::function<void()> &start )
+{
+  Q_ASSERT( !mActive.contains( projectFullName ) && !isQueued( projectFullName ) );
+
+  Entry entry;
+  entry.projectFullName = projectFullName;
+  entry.size = size;
+  entry.order = mNextOrder++;
+  entry.queuedAt = mClock.elapsed();
+  entry.start = start;
+  mQueue << entry;
+
+  startQueued();
+  return !isQueued( projectFullName );
+}
+
+void SyncScheduler::release( const QString &projectFullName )
+{
+  for ( int i = 0; i < mQueue.count(); ++i )
+  {
+    if ( mQueue.at( i ).projectFullName == projectFullName )
+    {
+      mQueue.removeAt( i );
+      break;
+    }
+  }
+
+  if ( mActive.remove( projectFullName ) )
+    startQueued();
+}
+
+bool SyncScheduler::isActive( const QString &projectFullName ) const
+{
+  return mActive.contains( projectFullName );
+}
+
+bool SyncScheduler::isQueued( const QString &projectFullName ) const
+{
+  for ( const Entry &entry : mQueue )
+  {
+    if ( entry.projectFullName == projectFullName )
+      return true;
+  }
+  return false;
+}
+
+QStringList SyncScheduler::activeProjects() const
+{
+  return mActive.values();
+}
+
+QStringList SyncScheduler::queuedProjects() const
+{
+  QList<Entry> queue = mQueue;
+  qint64 now = mClock.elapsed();
+  std::sort( queue.begin(), queue.end(), [this, now]( const Entry & a, const Entry & b ) { return hasPriority( a, b, now ); } );
+
+  QStringList projects;
+  for ( const Entry &entry : qAsConst( queue ) )
+    projects << entry.projectFullName;
+  return projects;
+}
+
+qint64 SyncScheduler::bandwidthLimit() const
+{
+  return mBandwidthLimit;
+}
+
+void SyncScheduler::setBandwidthLimit( qint64 bytesPerSecond )
+{
+  mBandwidthLimit = qMax( static_cast<qint64>( 0 ), bytesPerSecond );
+  mTokens = static_cast<double>( mBandwidthLimit );
+  mTokensUpdated = mClock.elapsed();
+}
+
+int SyncScheduler::reserveBandwidth( qint64 bytes )
+{
+  if ( mBandwidthLimit <= 0 )
+    return 0;
+
+  qint64 now = mClock.elapsed();
+  double limit = static_cast<double>( mBandwidthLimit );
+  mTokens = qMin( limit, mTokens + ( now - mTokensUpdated ) * limit / 1000 );
+  mTokensUpdated = now;
+
+  if ( mTokens < 0 )
+    return static_cast<int>( qBound( 1.0, std::ceil( -mTokens * 1000 / limit ), static_cast<double>( MAX_BANDWIDTH_DELAY_MS ) ) );
+
+  mTokens -= bytes;
+  return 0;
+}
+
+bool SyncScheduler::hasPriority( const Entry &a, const Entry &b, qint64 now ) const
+{
+  bool aPreferred = !mPreferredProject.isEmpty() && a.projectFullName == mPreferredProject;
+  bool bPreferred = !mPreferredProject.isEmpty() && b.projectFullName == mPreferredProject;
+  if ( aPreferred != bPreferred )
+    return aPreferred;
+
+  // projects waiting for too long do not let any smaller deltas go first anymore
+  bool aAged = now - a.queuedAt > mMaxQueueWait;
+  bool bAged = now - b.queuedAt > mMaxQueueWait;
+  if ( aAged != bAged )
+    return aAged;
+  if ( aAged )
+    return a.order < b.order;
+
+  if ( a.size != b.size )
+    return a.size < b.size;
+  return a.order < b.order;
+}
+
+void SyncScheduler::startQueued()
+{
+  while ( mActive.count() < mMaxActiveTransfers && !mQueue.isEmpty() )
+  {
+    qint64 now = mClock.elapsed();
+    int best = 0;
+    for ( int i = 1; i < mQueue.count(); ++i )
+    {
+      if ( hasPriority( mQueue.at( i ), mQueue.at( best ), now ) )
+        best = i;
+    }
+
+    // the start may release the slot right away (e.g. the sync fails) and get back here
+    Entry entry = mQueue.takeAt( best );
+    mActive.insert( entry.projectFullName );
+    entry.start();
+  }
+}
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCSCHEDULER_H
+#define SYNCSCHEDULER_H
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Coordinates data transfers of syncs of several projects (e.g. when all projects are synced at once),
+ * so that they do not compete for the link and the disk.
+ *
+ * A sync first fetches the project info and works out what needs to be transferred, then it asks for a transfer slot.
+ * At most maxActiveTransfers() projects transfer data at once, the others wait in a queue ordered by priority:
+ * the preferred project (the one open in the app) goes first, then projects with smaller deltas, so that quick syncs
+ * are not stuck behind a large one, and then in the order of arrival. A project that has been waiting for longer than
+ * maxQueueWait() is promoted before all smaller deltas (aged projects go in the order of arrival), so that a large sync
+ * is not starved by a steady stream of small ones. The slot is held until the sync finishes.
+ *
+ * Optionally, the rate of transfer requests is limited by a token bucket shared by all projects (see reserveBandwidth()).
+ */
+class SyncScheduler
+{
+  public:
+    SyncScheduler();
+
+    //! Returns how many projects may transfer data at once
+    int maxActiveTransfers() const;
+    //! Sets how many projects may transfer data at once (values lower than 1 are clamped to 1), queued transfers that fit in are started
+    void setMaxActiveTransfers( int count );
+
+    //! Returns full name of the project that is preferred over the others
+    QString preferredProject() const;
+    //! Sets full name of the project that is preferred over the others (empty for none)
+    void setPreferredProject( const QString &projectFullName );
+
+    //! Returns how long (in ms) a project may wait in the queue before it is promoted over smaller deltas
+    int maxQueueWait() const;
+    //! Sets how long (in ms) a project may wait in the queue before it is promoted over smaller deltas
+    void setMaxQueueWait( int msecs );
+
+    /**
+     * Asks for a transfer slot for the project. \a start gets called once the slot is granted - right away if there is a free one
+     * (and no queued project has a higher priority), otherwise from release() of another project.
+     * \param projectFullName project's full name
+     * \param size number of bytes the project is about to transfer
+     * \param start starts the transfer
+     * \returns true if the transfer has been started already
+     */
+    bool requestTransfer( const QString &projectFullName, qint64 size, const std::function<void()> &start );
+
+    //! Releases the slot of the project (or removes it from the queue) and starts queued transfers that fit in
+    void release( const QString &projectFullName );
+
+    //! Returns whether the project holds a transfer slot
+    bool isActive( const QString &projectFullName ) const;
+    //! Returns whether the project waits for a transfer slot
+    bool isQueued( const QString &projectFullName ) const;
+
+    //! Returns projects holding a transfer slot
+    QStringList activeProjects() const;
+    //! Returns projects waiting for a transfer slot in the order they will get it
+    QStringList queuedProjects() const;
+
+    //! Returns limit of the transfer rate in bytes per second (zero if not limited)
+    qint64 bandwidthLimit() const;
+    //! Sets limit of the transfer rate in bytes per second, zero or negative for no limit
+    void setBandwidthLimit( qint64 bytesPerSecond );
+
+    /**
+     * Reserves bandwidth for a transfer request of given size. Returns zero if the request may be sent now
+     * (the size is accounted), otherwise the number of milliseconds to wait before asking again.
+     *
+     * The bucket holds at most one second worth of data. A request is let through whenever the bucket is not in debt,
+     * so requests bigger than the bucket (e.g. upload chunks) are not blocked and the limit still holds on average.
+     */
+    int reserveBandwidth( qint64 bytes );
+
+  private:
+    struct Entry
+    {
+      QString projectFullName;
+      qint64 size = 0;
+      quint64 order = 0;
+      qint64 queuedAt = 0;  //!< when the entry was queued (ms of mClock)
+      std::function<void()> start;
+    };
+
+    //! Whether entry \a a goes before entry \a b at time \a now (ms of mClock)
+    bool hasPriority( const Entry &a, const Entry &b, qint64 now ) const;
+
+    //! Starts queued transfers while there are free slots
+    void startQueued();
+
+    int mMaxActiveTransfers = DEFAULT_MAX_ACTIVE_TRANSFERS;
+    QString mPreferredProject;
+    int mMaxQueueWait = DEFAULT_MAX_QUEUE_WAIT_MS;
+    QSet<QString> mActive;
+    QList<Entry> mQueue;
+    quint64 mNextOrder = 0;
+
+    qint64 mBandwidthLimit = 0;
+    double mTokens = 0;
+    qint64 mTokensUpdated = 0;  //!< time of the last refill of the bucket (ms of mClock)
+    QElapsedTimer mClock;
+
+    static const int DEFAULT_MAX_ACTIVE_TRANSFERS = 2;
+    static const int DEFAULT_MAX_QUEUE_WAIT_MS = 30000;
+    static const int MAX_BANDWIDTH_DELAY_MS = 1000;  //!< longest wait returned by reserveBandwidth(), the caller asks again then
+};
+
+#endif // SYNCSCHEDULER_H
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "transfercompression.h"
+
+#include <QFileInfo>
+#include <QtEndian>
+
+bool TransferCompression::isCompressible( const QString &filePath )
+{
+  static const QSet<QString> suffixes = compressibleSuffixes();
+  return suffixes.contains( QFileInfo( filePath ).suffix().toLower() );
+}
+
+QSet<QString> TransferCompression::compressibleSuffixes()
+{
+  return QSet<QString>()
+         // GeoPackages and other databases (pushed and pulled also as geodiff changesets)
+         << "gpkg" << "sqlite" << "db"
+         // QGIS projects and styles
+         << "qgs" << "qml" << "sld"
+         // vector and tabular data
+         << "csv" << "json" << "geojson" << "gml" << "kml" << "dxf" << "shp" << "shx" << "dbf" << "prj" << "cpg"
+         // other text
+         << "txt" << "xml" << "svg" << "html" << "md";
+}
+
+QByteArray TransferCompression::deflate( const QByteArray &data, int level )
+{
+  // qCompress() prepends 4 bytes with the uncompressed size to the zlib stream
+  return qCompress( data, level ).mid( 4 );
+}
+
+QByteArray TransferCompression::inflate( const QByteArray &data, qint64 expectedSize )
+{
+  if ( data.isEmpty() )
+    return QByteArray();
+
+  // qUncompress() expects the size prefix written by qCompress(), it grows the buffer if the size is not right
+  QByteArray prefixed( 4, 0 );
+  qToBigEndian<quint32>( static_cast<quint32>( qBound( static_cast<qint64>( 0 ), expectedSize, static_cast<qint64>( 0x7fffffff ) ) ),
+                         reinterpret_cast<uchar *>( prefixed.data() ) );
+  prefixed.append( data );
+  return qUncompress( prefixed );
+}
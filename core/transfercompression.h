@@ -0,0 +1,49 @@
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TRANSFERCOMPRESSION_H
+#define TRANSFERCOMPRESSION_H
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+
+/**
+ * Compression of data transferred by sync - chunks of pushed files and items of pulls.
+ *
+ * Data are compressed with deflate in zlib format, i.e. the "deflate" HTTP content coding. Whether data of a file
+ * get compressed depends on the type of the file: text formats, GeoPackages and their geodiff changesets compress
+ * several times, while images or zipped projects (.qgz) do not and compressing them would only waste CPU.
+ *
+ * Compression only applies to the transfer - checksums of files (and of the chunks acknowledged by the server)
+ * are always computed from the uncompressed data.
+ */
+class TransferCompression
+{
+  public:
+    //! Returns whether data of the file (path within the project) are worth compressing
+    static bool isCompressible( const QString &filePath );
+
+    //! Returns suffixes (lower case, without the dot) of files that are worth compressing
+    static QSet<QString> compressibleSuffixes();
+
+    //! Compresses the data to a zlib stream ("deflate" content coding)
+    static QByteArray deflate( const QByteArray &data, int level = DEFAULT_LEVEL );
+
+    /**
+     * Decompresses the zlib stream created by deflate(). Returns a null byte array if the data are corrupted.
+     * \param data compressed data
+     * \param expectedSize size of the uncompressed data if known (only used to allocate the buffer)
+     */
+    static QByteArray inflate( const QByteArray &data, qint64 expectedSize = 0 );
+
+    static const int DEFAULT_LEVEL = 6;  //!< zlib default - good ratio, fast enough for mobile devices
+};
+
+#endif // TRANSFERCOMPRESSION_H
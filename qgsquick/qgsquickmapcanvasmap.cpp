@@ -19,6 +19,7 @@
 #include <QtConcurrent>
 
 #include "qgslabelingresults.h"
+#include "qgsmaprenderercache.h"
 #include "qgsmaprendererparalleljob.h"
 #include "qgsmessagelog.h"
 #include "qgspallabeling.h"
@@ -34,6 +35,7 @@
 QgsQuickMapCanvasMap::QgsQuickMapCanvasMap( QQuickItem *parent )
   : QQuickItem( parent )
   , mMapSettings( new QgsQuickMapSettings() )
+  , mCache( new QgsMapRendererCache() )
 {
   connect( this, &QQuickItem::windowChanged, this, &QgsQuickMapCanvasMap::onWindowChanged );
   connect( &mRefreshTimer, &QTimer::timeout, this, &QgsQuickMapCanvasMap::refreshMap );
@@ -41,6 +43,10 @@ QgsQuickMapCanvasMap::QgsQuickMapCanvasMap( QQuickItem *parent )
 
   connect( mMapSettings.get(), &QgsQuickMapSettings::extentChanged, this, &QgsQuickMapCanvasMap::onExtentChanged );
   connect( mMapSettings.get(), &QgsQuickMapSettings::layersChanged, this, &QgsQuickMapCanvasMap::onLayersChanged );
+  // cached images of layers are only valid for the extent and scale they have been rendered for (checked by the render job),
+  // other changes that affect all layers need to drop them explicitly
+  connect( mMapSettings.get(), &QgsQuickMapSettings::destinationCrsChanged, this, &QgsQuickMapCanvasMap::clearCache );
+  connect( mMapSettings.get(), &QgsQuickMapSettings::projectChanged, this, &QgsQuickMapCanvasMap::clearCache );
 
   connect( this, &QgsQuickMapCanvasMap::renderStarting, this, &QgsQuickMapCanvasMap::isRenderingChanged );
   connect( this, &QgsQuickMapCanvasMap::mapCanvasRefreshed, this, &QgsQuickMapCanvasMap::isRenderingChanged );
@@ -52,6 +58,23 @@ QgsQuickMapCanvasMap::QgsQuickMapCanvasMap( QQuickItem *parent )
   setFlags( QQuickItem::ItemHasContents );
 }
 
+QgsQuickMapCanvasMap::~QgsQuickMapCanvasMap()
+{
+  // jobs must not outlive the cache they write to - neither the current one, nor the canceled ones still running
+  if ( mJob )
+    mDetachedJobs << mJob;
+  mJob = nullptr;
+
+  for ( QgsMapRendererParallelJob *job : qAsConst( mDetachedJobs ) )
+  {
+    disconnect( job, nullptr, this, nullptr );
+    job->cancel();
+    delete job;
+  }
+  mDetachedJobs.clear();
+  delete mLabelingResults;
+}
+
 QgsQuickMapSettings *QgsQuickMapCanvasMap::mapSettings() const
 {
   return mMapSettings.get();
@@ -126,7 +149,7 @@ void QgsQuickMapCanvasMap::refreshMap()
 
   connect( mJob, &QgsMapRendererJob::renderingLayersFinished, this, &QgsQuickMapCanvasMap::renderJobUpdated );
   connect( mJob, &QgsMapRendererJob::finished, this, &QgsQuickMapCanvasMap::renderJobFinished );
-  mJob->setCache( mCache );
+  mJob->setCache( mCache.get() );
 
   mJob->start();
 
@@ -156,6 +179,15 @@ void QgsQuickMapCanvasMap::renderJobFinished()
     QgsMessageLog::logMessage( QStringLiteral( "%1 :: %2" ).arg( error.layerID, error.message ), tr( "Rendering" ) );
   }
 
+  const int layersFromCache = mJob->layersRedrawnFromCache().count();
+  const int layersRendered = mJob->mapSettings().layers().count() - layersFromCache;
+  if ( layersFromCache || layersRendered )
+  {
+    mRenderCacheHits += layersFromCache;
+    mRenderCacheMisses += layersRendered;
+    emit renderCacheStatisticsChanged();
+  }
+
   // take labeling results before emitting renderComplete, so labeling map tools
   // connected to signal work with correct results
   delete mLabelingResults;
@@ -201,6 +233,7 @@ void QgsQuickMapCanvasMap::onScreenChanged( QScreen *screen )
 
 void QgsQuickMapCanvasMap::onExtentChanged()
 {
+  // no need to clear the cache here - the render job drops cached images rendered for another extent or scale
   updateTransform();
 
   // And trigger a new rendering job
@@ -250,6 +283,16 @@ void QgsQuickMapCanvasMap::setIncrementalRendering( bool incrementalRendering )
   emit incrementalRenderingChanged();
 }
 
+int QgsQuickMapCanvasMap::renderCacheHits() const
+{
+  return mRenderCacheHits;
+}
+
+int QgsQuickMapCanvasMap::renderCacheMisses() const
+{
+  return mRenderCacheMisses;
+}
+
 bool QgsQuickMapCanvasMap::freeze() const
 {
   return mFreeze;
@@ -345,12 +388,27 @@ void QgsQuickMapCanvasMap::onLayersChanged()
   const QList<QgsMapLayer *> layers = mMapSettings->layers();
   for ( QgsMapLayer *layer : layers )
   {
-    mLayerConnections << connect( layer, &QgsMapLayer::repaintRequested, this, &QgsQuickMapCanvasMap::refresh );
+    mLayerConnections << connect( layer, &QgsMapLayer::repaintRequested, this, &QgsQuickMapCanvasMap::onLayerRepaintRequested );
   }
 
   refresh();
 }
 
+void QgsQuickMapCanvasMap::onLayerRepaintRequested()
+{
+  // only the layer that has changed needs to be rendered again, others are redrawn from the cache
+  QgsMapLayer *layer = qobject_cast<QgsMapLayer *>( sender() );
+  if ( layer )
+    mCache->invalidateCacheForLayer( layer );
+
+  refresh();
+}
+
+void QgsQuickMapCanvasMap::clearCache()
+{
+  mCache->clear();
+}
+
 void QgsQuickMapCanvasMap::destroyJob( QgsMapRendererJob *job )
 {
   job->cancel();
@@ -364,7 +422,16 @@ void QgsQuickMapCanvasMap::stopRendering()
     disconnect( mJob, &QgsMapRendererJob::renderingLayersFinished, this, &QgsQuickMapCanvasMap::renderJobUpdated );
     disconnect( mJob, &QgsMapRendererJob::finished, this, &QgsQuickMapCanvasMap::renderJobFinished );
 
-    mJob->cancelWithoutBlocking();
+    // the canceled job writes to the cache until it stops, it is kept to be waited for on destruction
+    QgsMapRendererParallelJob *job = mJob;
+    mDetachedJobs << job;
+    connect( job, &QgsMapRendererJob::finished, this, [this, job]()
+    {
+      mDetachedJobs.removeOne( job );
+      job->deleteLater();
+    } );
+
+    job->cancelWithoutBlocking();
     mJob = nullptr;
   }
 }
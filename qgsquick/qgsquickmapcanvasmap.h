@@ -88,10 +88,24 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
      */
     Q_PROPERTY( bool incrementalRendering READ incrementalRendering WRITE setIncrementalRendering NOTIFY incrementalRenderingChanged )
 
+    /**
+     * Number of layers that have been redrawn from the renderer cache (i.e. not rendered again)
+     * since the map canvas map was created.
+     * This is a readonly property.
+     */
+    Q_PROPERTY( int renderCacheHits READ renderCacheHits NOTIFY renderCacheStatisticsChanged )
+
+    /**
+     * Number of layers that had to be rendered because there was no valid image in the renderer cache
+     * since the map canvas map was created.
+     * This is a readonly property.
+     */
+    Q_PROPERTY( int renderCacheMisses READ renderCacheMisses NOTIFY renderCacheStatisticsChanged )
+
   public:
     //! Create map canvas map
     QgsQuickMapCanvasMap( QQuickItem *parent = nullptr );
-    ~QgsQuickMapCanvasMap() = default;
+    ~QgsQuickMapCanvasMap();
 
     QSGNode *updatePaintNode( QSGNode *oldNode, QQuickItem::UpdatePaintNodeData * ) override;
 
@@ -119,6 +133,12 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
     //! \copydoc QgsQuickMapCanvasMap::incrementalRendering
     void setIncrementalRendering( bool incrementalRendering );
 
+    //! \copydoc QgsQuickMapCanvasMap::renderCacheHits
+    int renderCacheHits() const;
+
+    //! \copydoc QgsQuickMapCanvasMap::renderCacheMisses
+    int renderCacheMisses() const;
+
   signals:
 
     /**
@@ -143,6 +163,9 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
     //!\copydoc QgsQuickMapCanvasMap::incrementalRendering
     void incrementalRenderingChanged();
 
+    //! Emitted when renderCacheHits or renderCacheMisses change
+    void renderCacheStatisticsChanged();
+
   protected:
     void geometryChanged( const QRectF &newGeometry, const QRectF &oldGeometry ) override;
 
@@ -174,6 +197,8 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
     void onScreenChanged( QScreen *screen );
     void onExtentChanged();
     void onLayersChanged();
+    void onLayerRepaintRequested();
+    void clearCache();
 
   private:
 
@@ -189,7 +214,8 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
     bool mPinching = false;
     QPoint mPinchStartPoint;
     QgsMapRendererParallelJob *mJob = nullptr;
-    QgsMapRendererCache *mCache = nullptr;
+    QList<QgsMapRendererParallelJob *> mDetachedJobs; //!< canceled jobs which have not finished yet
+    std::unique_ptr<QgsMapRendererCache> mCache;
     QgsLabelingResults *mLabelingResults = nullptr;
     QImage mImage;
     QgsMapSettings mImageMapSettings;
@@ -200,6 +226,8 @@ class QUICK_EXPORT QgsQuickMapCanvasMap : public QQuickItem
     QList<QMetaObject::Connection> mLayerConnections;
     QTimer mMapUpdateTimer;
     bool mIncrementalRendering = false;
+    int mRenderCacheHits = 0;
+    int mRenderCacheMisses = 0;
 };
 
 #endif // QGSQUICKMAPCANVASMAP_H
@@ -45,6 +45,12 @@ NFAILURES=$(($NFAILURES+$?))
 $INPUT_EXECUTABLE --testFormEditors
 NFAILURES=$(($NFAILURES+$?))
 
+$INPUT_EXECUTABLE --testFeaturesListModel
+NFAILURES=$(($NFAILURES+$?))
+
+$INPUT_EXECUTABLE --testDigitizingController
+NFAILURES=$(($NFAILURES+$?))
+
 echo "Total $NFAILURES failures found in testing"
 
 exit $NFAILURES